@@ -538,7 +538,7 @@ void dai_wonder_city_distance(struct ai_type *ait, struct player *pplayer,
 
   pft_fill_unit_parameter(&parameter, ghost);
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
 
   pf_map_move_costs_iterate(pfm, ptile, move_cost, FALSE) {
     struct city *acity = tile_city(ptile);
@@ -996,7 +996,7 @@ static void process_attacker_want(struct ai_type *ait,
       pft_fill_utype_parameter(&parameter, punittype, city_tile(pcity),
                                pplayer);
       parameter.omniscience = !has_handicap(pplayer, H_MAP);
-      pfm = pf_map_new(&parameter);
+      pfm = adv_pf_map_new(&parameter);
 
       /* Set the move_time appropriatelly. */
       move_time = -1;
@@ -208,7 +208,7 @@ void dai_choose_diplomat_offensive(struct ai_type *ait,
 
     pft_fill_unit_parameter(&parameter, punit);
     parameter.omniscience = !has_handicap(pplayer, H_MAP);
-    pfm = pf_map_new(&parameter);
+    pfm = adv_pf_map_new(&parameter);
 
     find_city_to_diplomat(pplayer, punit, &acity, &time_to_dest, pfm);
 
@@ -695,7 +695,7 @@ void dai_manage_diplomat(struct ai_type *ait, struct player *pplayer,
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
   parameter.get_zoc = NULL; /* kludge */
   parameter.get_TB = no_intermediate_fights;
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
 
   pcity = tile_city(unit_tile(punit));
 
@@ -765,7 +765,7 @@ void dai_manage_diplomat(struct ai_type *ait, struct player *pplayer,
     parameter.omniscience = !has_handicap(pplayer, H_MAP);
     parameter.get_zoc = NULL; /* kludge */
     parameter.get_TB = no_intermediate_fights;
-    pfm = pf_map_new(&parameter);
+    pfm = adv_pf_map_new(&parameter);
   }
 
   /* If we are not busy, acquire a target. */
@@ -26,6 +26,7 @@
 
 /* aicore */
 #include "path_finding.h"
+#include "pf_regions.h"
 #include "pf_tools.h"
 
 /* server/advisors */
@@ -525,7 +526,7 @@ int aiferry_find_boat(struct ai_type *ait, struct unit *punit,
   param.get_MC = combined_land_sea_move;
   param.ignore_none_scopes = FALSE;
 
-  search_map = pf_map_new(&param);
+  search_map = adv_pf_map_new(&param);
 
   pf_map_positions_iterate(search_map, pos, TRUE) {
    /* Should this be !can_unit_exist_at_tile() instead of is_ocean() some day?
@@ -645,7 +646,7 @@ bool dai_amphibious_goto_constrained(struct ai_type *ait,
     return TRUE;
   }
 
-  pfm = pf_map_new(&parameter->combined);
+  pfm = adv_pf_map_new(&parameter->combined);
   path = pf_map_path(pfm, ptile);
 
   if (path) {
@@ -910,7 +911,7 @@ static bool aiferry_findcargo(struct ai_type *ait, struct unit *pferry)
    * might be "blocked" by unknown.  We don't want to fight though */
   parameter.get_TB = no_fights;
   
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
   pf_map_tiles_iterate(pfm, ptile, TRUE) {
     unit_list_iterate(ptile->units, aunit) {
       struct unit_ai *unit_data = def_ai_unit_data(aunit, ait);
@@ -940,6 +941,17 @@ static bool aiferry_findcargo(struct ai_type *ait, struct unit *pferry)
   return FALSE;
 }
 
+/****************************************************************************
+  Returns TRUE if the city signals for a ferry or builds one itself.
+****************************************************************************/
+static bool aiferry_city_wants_boat(struct ai_type *ait, struct city *pcity)
+{
+  return (def_ai_city_data(pcity, ait)->choice.need_boat
+          || (VUT_UTYPE == pcity->production.kind
+              && utype_has_role(pcity->production.value.utype,
+                                L_FERRYBOAT)));
+}
+
 /****************************************************************************
   A helper for ai_manage_ferryboat.  Finds a city that wants a ferry.  It
   might signal for the ferry using pcity->server.ai.choice.need_boat field or
@@ -960,6 +972,8 @@ static bool aiferry_find_interested_city(struct ai_type *ait,
   struct pf_parameter parameter;
   /* Early termination condition */
   int turns_horizon = FC_INFINITY;
+  /* The cities the ferry could reach, according to the regions */
+  int candidates = 0;
   /* Future return value */
   bool needed = FALSE;
 
@@ -969,12 +983,34 @@ static bool aiferry_find_interested_city(struct ai_type *ait,
   /* We are looking for our own cities, no need to look into the unknown */
   parameter.get_TB = no_fights_or_unknown;
   parameter.omniscience = FALSE;
-  pfm = pf_map_new(&parameter);
+
+  /* The search below would go through the whole sea when no city is
+   * found. The regions tell cheaply which cities are out of reach, and
+   * the search can stop once it saw all the others. */
+  city_list_iterate(unit_owner(pferry)->cities, pcity) {
+    if (aiferry_city_wants_boat(ait, pcity)) {
+      int turns = pf_regions_turns(&parameter, city_tile(pcity));
+
+      if (FC_INFINITY != turns) {
+        UNIT_LOG(LOGLEVEL_FERRY, pferry, "%s (%d, %d) is about %d turns "
+                 "away", city_name(pcity), TILE_XY(city_tile(pcity)),
+                 turns);
+        candidates++;
+      }
+    }
+  } city_list_iterate_end;
+
+  if (0 == candidates) {
+    UNIT_LOG(LOGLEVEL_FERRY, pferry, "no reachable city needs a ferry");
+    return FALSE;
+  }
+
+  pfm = adv_pf_map_new(&parameter);
 
   pf_map_positions_iterate(pfm, pos, TRUE) {
     struct city *pcity;
 
-    if (pos.turn >= turns_horizon) {
+    if (pos.turn >= turns_horizon || 0 == candidates) {
       /* Won't be able to find anything better than what we have */
       break;
     }
@@ -982,13 +1018,12 @@ static bool aiferry_find_interested_city(struct ai_type *ait,
     pcity = tile_city(pos.tile);
     
     if (pcity && city_owner(pcity) == unit_owner(pferry)
-        && (def_ai_city_data(pcity, ait)->choice.need_boat 
-            || (VUT_UTYPE == pcity->production.kind
-		&& utype_has_role(pcity->production.value.utype,
-				  L_FERRYBOAT)))) {
+        && aiferry_city_wants_boat(ait, pcity)) {
       bool really_needed = TRUE;
       int turns = city_production_turns_to_build(pcity, TRUE);
 
+      candidates--;
+
       UNIT_LOG(LOGLEVEL_FERRY, pferry, "%s (%d, %d) looks promising...", 
                city_name(pcity), TILE_XY(pcity->tile));
 
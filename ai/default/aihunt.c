@@ -312,7 +312,7 @@ static void dai_hunter_try_launch(struct ai_type *ait,
       UNIT_LOG(LOGLEVEL_HUNT, missile, "checking for hunt targets");
       pft_fill_unit_parameter(&parameter, punit);
       parameter.omniscience = !has_handicap(pplayer, H_MAP);
-      pfm = pf_map_new(&parameter);
+      pfm = adv_pf_map_new(&parameter);
 
       pf_map_move_costs_iterate(pfm, ptile, move_cost, FALSE) {
         if (move_cost > missile->moves_left / SINGLE_MOVE) {
@@ -423,7 +423,7 @@ int dai_hunter_manage(struct ai_type *ait, struct player *pplayer,
 
   pft_fill_unit_parameter(&parameter, punit);
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
 
   if (original_target) {
     dai_hunter_juiciness(pplayer, punit, original_target, 
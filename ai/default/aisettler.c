@@ -785,7 +785,7 @@ static struct cityresult *settler_map_iterate(struct ai_type *ait,
   struct player *pplayer = unit_owner(punit);
   struct pf_map *pfm;
 
-  pfm = pf_map_new(parameter);
+  pfm = adv_pf_map_new(parameter);
   pf_map_move_costs_iterate(pfm, ptile, move_cost, FALSE) {
     int turns;
 
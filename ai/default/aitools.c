@@ -330,7 +330,7 @@ struct tile *immediate_destination(struct unit *punit,
 
     pft_fill_unit_parameter(&parameter, punit);
     parameter.omniscience = !has_handicap(pplayer, H_MAP);
-    pfm = pf_map_new(&parameter);
+    pfm = adv_pf_map_new(&parameter);
     path = pf_map_path(pfm, punit->goto_tile);
 
     if (path) {
@@ -382,6 +382,29 @@ void dai_log_path(struct unit *punit,
 	   last->total_MC, last->total_EC, cc);
 }
 
+/**************************************************************************
+  Returns the map to reach the goal of 'parameter'. The map of the
+  previous goto of the unit is rebased if possible, so a unit going to the
+  same destination over several turns doesn't search its whole path again
+  each turn. The map is owned by the unit data, don't destroy it.
+**************************************************************************/
+static struct pf_map *dai_unit_goto_map(struct ai_type *ait,
+                                        struct unit *punit,
+                                        const struct pf_parameter *parameter)
+{
+  struct unit_ai *unit_data = def_ai_unit_data(punit, ait);
+
+  if (NULL != unit_data->goto_map) {
+    if (pf_map_rebase(unit_data->goto_map, parameter)) {
+      return unit_data->goto_map;
+    }
+    pf_map_destroy(unit_data->goto_map);
+  }
+
+  unit_data->goto_map = pf_map_new(parameter);
+  return unit_data->goto_map;
+}
+
 /**************************************************************************
   Go to specified destination, subject to given PF constraints,
   but do not disturb existing role or activity
@@ -396,6 +419,7 @@ bool dai_unit_goto_constrained(struct ai_type *ait, struct unit *punit,
                                struct pf_parameter *parameter)
 {
   bool alive = TRUE;
+  struct pf_parameter goal_parameter;
   struct pf_map *pfm;
   struct pf_path *path;
 
@@ -423,7 +447,9 @@ bool dai_unit_goto_constrained(struct ai_type *ait, struct unit *punit,
     return TRUE;
   }
 
-  pfm = pf_map_new(parameter);
+  goal_parameter = *parameter;
+  pft_fill_goal(&goal_parameter, ptile);
+  pfm = dai_unit_goto_map(ait, punit, &goal_parameter);
   path = pf_map_path(pfm, ptile);
 
   if (path) {
@@ -435,7 +461,6 @@ bool dai_unit_goto_constrained(struct ai_type *ait, struct unit *punit,
   }
 
   pf_path_destroy(path);
-  pf_map_destroy(pfm);
 
   return alive;
 }
@@ -456,7 +481,8 @@ bool goto_is_sane(struct unit *punit, struct tile *ptile)
     struct pf_map *pfm;
 
     pft_fill_unit_attack_param(&parameter, punit);
-    pfm = pf_map_new(&parameter);
+    pft_fill_goal(&parameter, ptile);
+    pfm = adv_pf_map_new(&parameter);
 
     if (pf_map_move_cost(pfm, ptile) != PF_IMPOSSIBLE_MC) {
       can_get_there = TRUE;
@@ -630,6 +656,24 @@ bool dai_unit_goto(struct ai_type *ait, struct unit *punit, struct tile *ptile)
   UNIT_LOG(LOG_DEBUG, punit, "ai_unit_goto to %d,%d", TILE_XY(ptile));
   dai_fill_unit_param(ait, &parameter, &risk_cost, punit, ptile);
 
+  if (NULL != parameter.data) {
+    /* The kept goto map of the unit needs the same data; forget it if
+     * the risks changed. See dai_unit_goto_map(). */
+    struct unit_ai *unit_data = def_ai_unit_data(punit, ait);
+
+    fc_assert(parameter.data == &risk_cost);
+    if (NULL != unit_data->goto_map
+        && (unit_data->goto_risk_cost.base_value != risk_cost.base_value
+            || unit_data->goto_risk_cost.fearfulness != risk_cost.fearfulness
+            || (unit_data->goto_risk_cost.enemy_zoc_cost
+                != risk_cost.enemy_zoc_cost))) {
+      pf_map_destroy(unit_data->goto_map);
+      unit_data->goto_map = NULL;
+    }
+    unit_data->goto_risk_cost = risk_cost;
+    parameter.data = &unit_data->goto_risk_cost;
+  }
+
   return dai_unit_goto_constrained(ait, punit, ptile, &parameter);
 }
 
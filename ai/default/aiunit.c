@@ -42,6 +42,7 @@
 
 /* common/aicore */
 #include "caravan.h"
+#include "pf_regions.h"
 #include "pf_tools.h"
 
 /* server */
@@ -518,7 +519,7 @@ static struct pf_path *find_rampage_target(struct unit *punit,
    * Hence no call ai_avoid_risks()
    */
 
-  tgt_map = pf_map_new(&parameter);
+  tgt_map = adv_pf_map_new(&parameter);
   pf_map_move_costs_iterate(tgt_map, iter_tile, move_cost, FALSE) {
     int want;
     bool move_needed;
@@ -714,7 +715,7 @@ int look_for_charge(struct ai_type *ait, struct player *pplayer,
 
   pft_fill_unit_parameter(&parameter, punit);
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
 
   pf_map_move_costs_iterate(pfm, ptile, move_cost, TRUE) {
     if (move_cost > max_move_cost) {
@@ -1074,6 +1075,36 @@ bool find_beachhead(const struct player *pplayer, struct pf_map *ferry_map,
   }
 }
 
+/****************************************************************************
+  Returns FALSE if the boat of 'ferry_map' certainly cannot reach the coast
+  near 'dest_tile', according to the regions of the map. It is much
+  cheaper than find_beachhead() for unreachable destinations, which would
+  expand the whole ferry map.
+****************************************************************************/
+static bool dai_boat_may_reach(struct pf_map *ferry_map,
+                               struct tile *dest_tile)
+{
+  const struct pf_parameter *param = pf_map_parameter(ferry_map);
+  const struct unit_class *pclass = utype_class(param->utype);
+
+  if (!param->omniscience
+      || !pf_regions_reachable(pclass, param->start_tile,
+                               param->start_tile)) {
+    /* Unknown tiles could be used, or the boat is not on its own. */
+    return TRUE;
+  }
+
+  /* The boat may stop on a tile next to a beach next to 'dest_tile',
+   * maybe overlapping on a non-native tile. */
+  square_iterate(dest_tile, 3, ptile) {
+    if (pf_regions_reachable(pclass, param->start_tile, ptile)) {
+      return TRUE;
+    }
+  } square_iterate_end;
+
+  return FALSE;
+}
+
 /****************************************************************************
   Find something to kill! This function is called for units to find targets
   to destroy and for cities that want to know if they should build offensive
@@ -1228,7 +1259,7 @@ int find_something_to_kill(struct ai_type *ait, struct player *pplayer,
 
   pft_fill_unit_attack_param(&parameter, punit);
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  punit_map = pf_map_new(&parameter);
+  punit_map = adv_pf_map_new(&parameter);
 
   if (MOVE_NONE == punit_class->adv.sea_move) {
     /* We need boat to move over sea. */
@@ -1255,7 +1286,7 @@ int find_something_to_kill(struct ai_type *ait, struct player *pplayer,
     boattype = unit_type(ferryboat);
     pft_fill_unit_overlap_param(&parameter, ferryboat);
     parameter.omniscience = !has_handicap(pplayer, H_MAP);
-    ferry_map = pf_map_new(&parameter);
+    ferry_map = adv_pf_map_new(&parameter);
   } else {
     boattype = best_role_unit_for_player(pplayer, L_FERRYBOAT);
     if (NULL == boattype) {
@@ -1267,7 +1298,7 @@ int find_something_to_kill(struct ai_type *ait, struct player *pplayer,
       pft_fill_utype_overlap_param(&parameter, boattype, punit_tile,
                                    pplayer);
       parameter.omniscience = !has_handicap(pplayer, H_MAP);
-      ferry_map = pf_map_new(&parameter);
+      ferry_map = adv_pf_map_new(&parameter);
     } else {
       ferry_map = NULL;
     }
@@ -1305,8 +1336,9 @@ int find_something_to_kill(struct ai_type *ait, struct player *pplayer,
       } else {
         struct tile *dest, *beach;
 
-        if (!find_beachhead(pplayer, ferry_map, atile, punit_type,
-                            &dest, &beach)) {
+        if (!dai_boat_may_reach(ferry_map, atile)
+            || !find_beachhead(pplayer, ferry_map, atile, punit_type,
+                               &dest, &beach)) {
           continue;   /* Impossible to go by boat. */
         }
         if (!pf_map_position(ferry_map, dest, &pos)) {
@@ -1584,7 +1616,7 @@ struct city *find_nearest_safe_city(struct unit *punit)
 
   pft_fill_unit_parameter(&parameter, punit);
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
 
   pf_map_move_costs_iterate(pfm, ptile, move_cost, TRUE) {
     if (move_cost > best) {
@@ -2785,7 +2817,7 @@ static void dai_manage_barbarian_leader(struct ai_type *ait,
   if (0 < body_guards) {
     pft_fill_unit_parameter(&parameter, leader);
     parameter.omniscience = !has_handicap(pplayer, H_MAP);
-    pfm = pf_map_new(&parameter);
+    pfm = adv_pf_map_new(&parameter);
 
     /* Find the closest body guard. FIXME: maybe choose the strongest too? */
     pf_map_tiles_iterate(pfm, ptile, FALSE) {
@@ -2850,7 +2882,7 @@ static void dai_manage_barbarian_leader(struct ai_type *ait,
 
   pft_fill_unit_parameter(&parameter, worst_danger);
   parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
   best_move_cost = pf_map_move_cost(pfm, leader_tile);
 
   /* Try to escape. */
@@ -3098,6 +3130,7 @@ void dai_unit_init(struct ai_type *ait, struct unit *punit)
   unit_data->passenger = 0;
   unit_data->bodyguard = 0;
   unit_data->charge = 0;
+  unit_data->goto_map = NULL;
 
   unit_set_ai_data(punit, ait, unit_data);
 }
@@ -3127,6 +3160,9 @@ void dai_unit_close(struct ai_type *ait, struct unit *punit)
   aiguard_clear_guard(ait, punit);
 
   if (unit_data != NULL) {
+    if (NULL != unit_data->goto_map) {
+      pf_map_destroy(unit_data->goto_map);
+    }
     unit_set_ai_data(punit, ait, NULL);
     FC_FREE(unit_data);
   }
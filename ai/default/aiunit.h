@@ -18,6 +18,9 @@
 #include "fc_types.h"
 #include "unittype.h"
 
+/* server/advisors */
+#include "advgoto.h"
+
 struct pf_map;
 struct pf_path;
 
@@ -43,6 +46,11 @@ struct unit_ai {
   bool done;  /* we are done controlling this unit this turn */
 
   enum ai_unit_task task;
+
+  /* The map of the last goto, kept to be rebased the next time. See
+   * dai_unit_goto_constrained(). */
+  struct pf_map *goto_map;
+  struct adv_risk_cost goto_risk_cost;
 };
 
 struct unit_type_ai
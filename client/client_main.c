@@ -54,6 +54,9 @@
 #include "research.h"
 #include "version.h"
 
+/* common/aicore */
+#include "path_finding.h"
+
 /* client/include */
 #include "chatline_g.h"
 #include "citydlg_g.h"
@@ -265,6 +268,7 @@ static void client_game_free(void)
   free_help_texts();
   attribute_free();
   agents_free();
+  pf_map_changes_free();
   game.client.ruleset_init = FALSE;
   game_free();
   /* update_queue_init() is correct at this point. The queue is reset to
@@ -289,6 +293,7 @@ static void client_game_reset(void)
   control_free();
   attribute_free();
   agents_free();
+  pf_map_changes_free();
 
   game_reset();
   mapimg_reset();
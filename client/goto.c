@@ -1064,6 +1064,7 @@ bool send_goto_tile(struct unit *punit, struct tile *ptile)
   struct pf_path *path;
 
   fill_client_goto_parameter(punit, &parameter, &dummy1, &dummy2);
+  pft_fill_goal(&parameter, ptile);
   pfm = pf_map_new(&parameter);
   path = pf_map_path(pfm, ptile);
   pf_map_destroy(pfm);
@@ -1100,6 +1101,7 @@ void send_patrol_route(void)
     parameter.start_tile = last_part->end_tile;
     parameter.moves_left_initially = last_part->end_moves_left;
     parameter.fuel_left_initially = last_part->end_fuel_left;
+    pft_fill_goal(&parameter, goto_map->parts[0].start_tile);
     pfm = pf_map_new(&parameter);
     return_path = pf_map_path(pfm, goto_map->parts[0].start_tile);
     if (!return_path) {
@@ -54,6 +54,9 @@
 #include "unitlist.h"
 #include "worklist.h"
 
+/* common/aicore */
+#include "path_finding.h"
+
 /* client/include */
 #include "chatline_g.h"
 #include "citydlg_g.h"
@@ -2740,6 +2743,11 @@ void handle_tile_info(const struct packet_tile_info *packet)
       tile_changed = TRUE;
   }
 
+  if (tile_changed) {
+    /* The move costs through the tile may be different now. */
+    pf_map_tile_changed(ptile);
+  }
+
   if (known_changed || tile_changed) {
     /* 
      * A tile can only change if it was known before and is still
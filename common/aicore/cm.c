@@ -1945,6 +1945,9 @@ static void cm_find_best_solution(struct cm_state *state,
   /* convert to the caller's format */
   convert_solution_to_result(state, &state->best, result);
 
+  /* Keep the effect cache, it may have been allocated during the search
+   * and its values do not depend on the arrangement of the workers. */
+  backup.effect_cache = state->pcity->effect_cache;
   memcpy(state->pcity, &backup, sizeof(backup));
 
   end_search(state);
@@ -15,8 +15,11 @@
 #include <fc_config.h>
 #endif
 
+#include <string.h>
+
 /* utility */
 #include "bitvector.h"
+#include "fcthreadpool.h"
 #include "log.h"
 #include "mem.h"
 #include "pqueue.h"
@@ -45,7 +48,8 @@
 enum pf_mode {
   PF_NORMAL = 1,        /* Usual goto */
   PF_DANGER,            /* Goto with dangerous positions */
-  PF_FUEL               /* Goto for fueled units */
+  PF_FUEL,              /* Goto for fueled units */
+  PF_CACHED             /* View on a map shared by a pf_map_cache */
 };
 #endif /* PF_DEBUG */
 
@@ -81,10 +85,15 @@ struct pf_map {
   bool (*get_position) (struct pf_map *pfm, struct tile *ptile,
                         struct pf_position *pos);
   bool (*iterate) (struct pf_map *pfm);
+  bool (*rebase) (struct pf_map *pfm, const struct pf_parameter *parameter);
 
   /* Private data. */
   struct tile *tile;          /* The current position (aka iterator). */
   struct pf_parameter params; /* Initial parameters. */
+
+  /* Set when the map is shared through a pf_map_cache. In this case, the
+   * tiles are recorded in the iteration order, see pf_map_iterate(). */
+  struct pf_map_cache_entry *cache_entry;
 };
 
 /* Down-cast macro. */
@@ -204,6 +213,268 @@ static void pf_position_fill_start_tile(struct pf_position *pos,
                                         const struct pf_parameter *param);
 
 
+/* ============================== Lattices =============================== */
+
+/* The nodes of the maps are allocated by blocks of PF_LATTICE_BLOCK_SIZE
+ * consecutive tile indexes, only when the search reaches them. Most of the
+ * searches don't visit the whole map, so we save the allocation and the
+ * clearing of the largest part of the lattice. The blocks of destroyed
+ * maps are kept in a pool (one per node type) to be reused by the next
+ * maps. */
+#define PF_LATTICE_BLOCK_SHIFT 6
+#define PF_LATTICE_BLOCK_SIZE (1 << PF_LATTICE_BLOCK_SHIFT)
+#define PF_LATTICE_BLOCK_MASK (PF_LATTICE_BLOCK_SIZE - 1)
+
+/* The maximal number of free blocks kept in a pool. */
+#define PF_LATTICE_POOL_SIZE 1024
+
+/* Free blocks of nodes of the same size. */
+struct pf_lattice_pool {
+  const size_t node_size;
+  int blocks_num;
+  char *blocks[PF_LATTICE_POOL_SIZE];
+};
+
+/* The pools are not protected against concurrent accesses. While maps are
+ * iterated by several threads (see pf_map_cache_fill()), the new blocks
+ * are allocated directly instead. */
+static bool pf_lattice_pools_locked = FALSE;
+
+/* Lattice of nodes. */
+struct pf_lattice {
+  struct pf_lattice_pool *pool;
+  char **blocks;                /* NULL for the blocks not reached yet. */
+  int blocks_num;
+};
+
+/****************************************************************************
+  Initialize a lattice for the current map. No node is allocated yet.
+****************************************************************************/
+static void pf_lattice_init(struct pf_lattice *lattice,
+                            struct pf_lattice_pool *pool)
+{
+  lattice->pool = pool;
+  lattice->blocks_num = ((MAP_INDEX_SIZE + PF_LATTICE_BLOCK_MASK)
+                         >> PF_LATTICE_BLOCK_SHIFT);
+  lattice->blocks = fc_calloc(lattice->blocks_num,
+                              sizeof(*lattice->blocks));
+}
+
+/****************************************************************************
+  Free a lattice. If 'node_free' is set, it is called for every allocated
+  node. The blocks are given back to the pool when it is not full.
+****************************************************************************/
+static void pf_lattice_free(struct pf_lattice *lattice,
+                            void (*node_free) (void *node))
+{
+  struct pf_lattice_pool *pool = lattice->pool;
+  char *block;
+  int i, j;
+
+  for (i = 0; i < lattice->blocks_num; i++) {
+    block = lattice->blocks[i];
+    if (NULL == block) {
+      continue;
+    }
+
+    if (NULL != node_free) {
+      for (j = 0; j < PF_LATTICE_BLOCK_SIZE; j++) {
+        node_free(block + j * pool->node_size);
+      }
+    }
+
+    if (PF_LATTICE_POOL_SIZE > pool->blocks_num) {
+      pool->blocks[pool->blocks_num++] = block;
+    } else {
+      free(block);
+    }
+  }
+  free(lattice->blocks);
+}
+
+/****************************************************************************
+  Returns a new block of zeroed nodes, from the pool if possible. This
+  might be called by the worker threads of pf_map_cache_fill().
+****************************************************************************/
+static char *pf_lattice_block_new(struct pf_lattice_pool *pool)
+{
+  char *block;
+
+  if (!pf_lattice_pools_locked && 0 < pool->blocks_num) {
+    block = pool->blocks[--pool->blocks_num];
+    memset(block, 0, PF_LATTICE_BLOCK_SIZE * pool->node_size);
+  } else {
+    block = fc_calloc(PF_LATTICE_BLOCK_SIZE, pool->node_size);
+  }
+  return block;
+}
+
+/****************************************************************************
+  Returns the node at 'index', allocating its block if needed. The node
+  is zeroed (NS_UNINIT) the first time.
+****************************************************************************/
+static inline void *pf_lattice_node(const struct pf_lattice *lattice,
+                                    int index)
+{
+  char **block = lattice->blocks + (index >> PF_LATTICE_BLOCK_SHIFT);
+
+  if (NULL == *block) {
+    *block = pf_lattice_block_new(lattice->pool);
+  }
+  return *block + (index & PF_LATTICE_BLOCK_MASK) * lattice->pool->node_size;
+}
+
+
+/* ============================ Game changes ============================= */
+
+/* To know if a map can be rebased (see pf_map_rebase()), we need to know
+ * what changed in the game since the map was created. Every change
+ * notified by pf_map_tile_changed() or pf_map_game_changed() gets a new
+ * stamp, greater than the previous ones. The maps remember the stamp
+ * at their creation. Only the changes which could modify the result of
+ * a 'get_MC' callback are needed here, the other callbacks are checked
+ * again at rebase time. */
+struct pf_tile_state {
+  const struct terrain *terrain;
+  bv_extras extras;
+  const struct player *owner;
+  const struct city *pcity;
+  unsigned int stamp;           /* The last change of these values. */
+};
+
+static unsigned int pf_changes_stamp = 0;   /* The last stamp given. */
+static unsigned int pf_game_stamp = 0;      /* Last pf_map_game_changed(). */
+static struct pf_tile_state *pf_tile_states = NULL;
+static int pf_tile_states_num = 0;
+/* The number of tiles having each extra, according to the tile states.
+ * See pf_map_extra_tiles(). */
+static int pf_extra_tiles[MAX_EXTRA_TYPES];
+
+/****************************************************************************
+  Returns TRUE if something changed on 'ptile' (or everywhere) since the
+  stamp was given.
+****************************************************************************/
+static inline bool pf_tile_changed_since(const struct tile *ptile,
+                                         unsigned int stamp)
+{
+  return (stamp < pf_game_stamp
+          || (NULL != pf_tile_states
+              && stamp < pf_tile_states[tile_index(ptile)].stamp));
+}
+
+/****************************************************************************
+  Record the values of the tile the move costs depend on. Returns TRUE if
+  they were different.
+****************************************************************************/
+static bool pf_tile_state_update(struct pf_tile_state *state,
+                                 const struct tile *ptile)
+{
+  if (state->terrain == tile_terrain(ptile)
+      && BV_ARE_EQUAL(state->extras, ptile->extras)
+      && state->owner == tile_owner(ptile)
+      && state->pcity == tile_city(ptile)) {
+    return FALSE;
+  }
+
+  if (!BV_ARE_EQUAL(state->extras, ptile->extras)) {
+    extra_type_iterate(pextra) {
+      int idx = extra_index(pextra);
+
+      if (BV_ISSET(state->extras, idx)) {
+        pf_extra_tiles[idx]--;
+      }
+      if (BV_ISSET(ptile->extras, idx)) {
+        pf_extra_tiles[idx]++;
+      }
+    } extra_type_iterate_end;
+  }
+
+  state->terrain = tile_terrain(ptile);
+  state->extras = ptile->extras;
+  state->owner = tile_owner(ptile);
+  state->pcity = tile_city(ptile);
+  return TRUE;
+}
+
+/****************************************************************************
+  Record the state of all the tiles if the map is new.
+****************************************************************************/
+static void pf_tile_states_check(void)
+{
+  if (pf_tile_states_num == MAP_INDEX_SIZE) {
+    return;
+  }
+
+  free(pf_tile_states);
+  memset(pf_extra_tiles, 0, sizeof(pf_extra_tiles));
+  pf_tile_states_num = MAP_INDEX_SIZE;
+  pf_tile_states = fc_calloc(pf_tile_states_num, sizeof(*pf_tile_states));
+  whole_map_iterate(atile) {
+    pf_tile_state_update(pf_tile_states + tile_index(atile), atile);
+  } whole_map_iterate_end;
+  pf_game_stamp = ++pf_changes_stamp;
+}
+
+/****************************************************************************
+  Notify that something which could change the move costs may have
+  happened on 'ptile' (terrain, extras, city, owner...). Nothing is
+  recorded if these values didn't change actually.
+****************************************************************************/
+void pf_map_tile_changed(const struct tile *ptile)
+{
+  pf_tile_states_check();
+
+  if (pf_tile_state_update(pf_tile_states + tile_index(ptile), ptile)) {
+    pf_tile_states[tile_index(ptile)].stamp = ++pf_changes_stamp;
+  }
+}
+
+/****************************************************************************
+  Notify that something which could change the move costs everywhere
+  happened (diplomatic states, rules...). No existing map can be rebased
+  after this.
+****************************************************************************/
+void pf_map_game_changed(void)
+{
+  pf_game_stamp = ++pf_changes_stamp;
+}
+
+/****************************************************************************
+  Free the memory used to record the game changes.
+****************************************************************************/
+void pf_map_changes_free(void)
+{
+  free(pf_tile_states);
+  pf_tile_states = NULL;
+  pf_tile_states_num = 0;
+  memset(pf_extra_tiles, 0, sizeof(pf_extra_tiles));
+  pf_map_game_changed();
+}
+
+/****************************************************************************
+  Returns the stamp of the last change notified by pf_map_tile_changed()
+  or pf_map_game_changed(). It changes each time the terrain, the extras,
+  the owner or the city of a tile change.
+****************************************************************************/
+unsigned int pf_map_changes_stamp(void)
+{
+  return pf_changes_stamp;
+}
+
+/****************************************************************************
+  Returns the number of tiles of the map which have the extra, as it was
+  at the last pf_map_tile_changed() call for each tile. This doesn't need
+  to look at the map, so it is cheap enough to be called for every new
+  path-finding map.
+****************************************************************************/
+int pf_map_extra_tiles(const struct extra_type *pextra)
+{
+  pf_tile_states_check();
+
+  return MAX(pf_extra_tiles[extra_index(pextra)], 0);
+}
+
+
 /* ================ Specific pf_normal_* mode structures ================= */
 
 /* Normal path-finding maps are used for most of units with standard rules.
@@ -235,7 +506,12 @@ struct pf_normal_map {
   struct pqueue *queue;     /* Queue of nodes we have reached but not
                              * processed yet (NS_NEW), sorted by their
                              * total_CC. */
-  struct pf_normal_node *lattice; /* Lattice of nodes. */
+  struct pf_lattice lattice; /* Lattice of nodes. */
+  int goal_min_MC;          /* Minimal MC of a step for goal-directed maps,
+                             * or 0. See pf_normal_map_goal_CC(). */
+  unsigned int stamp;       /* See pf_tile_changed_since(). */
+  bool rebased;             /* The nodes kept by pf_normal_map_rebase()
+                             * are not expanded yet. */
 };
 
 /* Up-cast macro. */
@@ -255,6 +531,20 @@ pf_normal_map_check(struct pf_map *pfm, const char *file,
 #define PF_NORMAL_MAP(pfm) ((struct pf_normal_map *) (pfm))
 #endif /* PF_DEBUG */
 
+/* Blocks of normal nodes ready to be reused. */
+static struct pf_lattice_pool pf_normal_pool = {
+  sizeof(struct pf_normal_node)
+};
+
+/****************************************************************************
+  Returns the node at 'index' of the normal map.
+****************************************************************************/
+static inline struct pf_normal_node *
+pf_normal_map_node(const struct pf_normal_map *pfnm, int index)
+{
+  return pf_lattice_node(&pfnm->lattice, index);
+}
+
 /* ================  Specific pf_normal_* mode functions ================= */
 
 /****************************************************************************
@@ -394,7 +684,7 @@ static void pf_normal_map_fill_position(const struct pf_normal_map *pfnm,
                                         struct pf_position *pos)
 {
   int index = tile_index(ptile);
-  struct pf_normal_node *node = pfnm->lattice + index;
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, index);
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
 
 #ifdef PF_DEBUG
@@ -422,7 +712,7 @@ static struct pf_path *
 pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
                              struct tile *dest_tile)
 {
-  struct pf_normal_node *node = pfnm->lattice + tile_index(dest_tile);
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tile_index(dest_tile));
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
   enum direction8 dir_next = PF_DIR_NONE;
   struct pf_path *path;
@@ -447,7 +737,7 @@ pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
     }
 
     ptile = mapstep(ptile, DIR_REVERSE(node->dir_to_here));
-    node = pfnm->lattice + tile_index(ptile);
+    node = pf_normal_map_node(pfnm, tile_index(ptile));
   }
 
   /* 2: Allocate the memory */
@@ -456,7 +746,7 @@ pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
 
   /* 3: Backtrack again and fill the positions this time */
   ptile = dest_tile;
-  node = pfnm->lattice + tile_index(ptile);
+  node = pf_normal_map_node(pfnm, tile_index(ptile));
 
   for (; i >= 0; i--) {
     pf_normal_map_fill_position(pfnm, ptile, &path->positions[i]);
@@ -468,7 +758,7 @@ pf_normal_map_construct_path(const struct pf_normal_map *pfnm,
     if (i > 0) {
       /* Step further back, if we haven't finished yet */
       ptile = mapstep(ptile, DIR_REVERSE(dir_next));
-      node = pfnm->lattice + tile_index(ptile);
+      node = pf_normal_map_node(pfnm, tile_index(ptile));
     }
   }
 
@@ -488,7 +778,7 @@ static int pf_normal_map_adjust_cost(const struct pf_normal_map *pfnm,
   fc_assert_ret_val(cost >= 0, PF_IMPOSSIBLE_MC);
 
   params = pf_map_parameter(PF_MAP(pfnm));
-  node = pfnm->lattice + tile_index(PF_MAP(pfnm)->tile);
+  node = pf_normal_map_node(pfnm, tile_index(PF_MAP(pfnm)->tile));
   moves_left = pf_moves_left(params, node->cost);
   if (cost > moves_left) {
     cost = moves_left;
@@ -496,6 +786,47 @@ static int pf_normal_map_adjust_cost(const struct pf_normal_map *pfnm,
   return cost;
 }
 
+/****************************************************************************
+  Returns the priority of a node of a goal-directed map: the total_CC of
+  the path to 'ptile' plus a lower bound of the cost needed to reach the
+  goal tile from there (A* algorithm).
+
+  The lower bound assumes every remaining step costs 'goal_min_MC', but
+  never more than the moves left, as pf_normal_map_adjust_cost() does.
+  It cannot decrease along a path, so the nodes are still processed with
+  their best cost.
+****************************************************************************/
+static inline int pf_normal_map_goal_CC(const struct pf_normal_map *pfnm,
+                                        const struct tile *ptile,
+                                        int cost, int extra)
+{
+  const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
+  int min_MC = pfnm->goal_min_MC;
+  int steps = real_map_distance(ptile, params->goal_tile);
+
+  if (0 < steps) {
+    int move_rate = pf_move_rate(params);
+    int moves_left = pf_moves_left(params, cost);
+    int steps_per_turn = (moves_left + min_MC - 1) / min_MC;
+    int turns;
+
+    if (steps <= steps_per_turn) {
+      /* The goal could be reached this turn. */
+      cost += MIN(steps * min_MC, moves_left);
+    } else {
+      /* End the current turn, then full turns. */
+      cost += moves_left;
+      steps -= steps_per_turn;
+      steps_per_turn = (move_rate + min_MC - 1) / min_MC;
+      turns = (steps - 1) / steps_per_turn;
+      steps -= turns * steps_per_turn;
+      cost += turns * move_rate + MIN(steps * min_MC, move_rate);
+    }
+  }
+
+  return pf_total_CC(params, cost, extra);
+}
+
 /****************************************************************************
   Bare-bones PF iterator. All Freeciv rules logic is hidden in 'get_costs'
   callback (compare to pf_normal_map_iterate function). This function is
@@ -518,7 +849,7 @@ static bool pf_jumbo_map_iterate(struct pf_map *pfm)
   struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
   struct tile *tile = pfm->tile;
   int index = tile_index(tile);
-  struct pf_normal_node *node = pfnm->lattice + index;
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, index);
   const struct pf_parameter *params = pf_map_parameter(pfm);
 
   /* Processing Stage */
@@ -531,7 +862,7 @@ static bool pf_jumbo_map_iterate(struct pf_map *pfm)
     /* Calculate the cost of every adjacent position and set them in the
      * priority queue for next call to pf_jumbo_map_iterate(). */
     int index1 = tile_index(tile1);
-    struct pf_normal_node *node1 = pfnm->lattice + index1;
+    struct pf_normal_node *node1 = pf_normal_map_node(pfnm, index1);
     int priority, cost1, extra_cost1;
 
     /* As for the previous position, 'tile1', 'node1' and 'index1' are
@@ -579,40 +910,28 @@ static bool pf_jumbo_map_iterate(struct pf_map *pfm)
   }
 
 #ifdef PF_DEBUG
-  fc_assert(NS_NEW == pfnm->lattice[index].status);
+  fc_assert(NS_NEW == pf_normal_map_node(pfnm, index)->status);
 #endif
 
   /* Change the pf_map iterator. Node status step B. to C. */
   pfm->tile = index_to_tile(index);
-  pfnm->lattice[index].status = NS_PROCESSED;
+  pf_normal_map_node(pfnm, index)->status = NS_PROCESSED;
 
   return TRUE;
 }
 
 /****************************************************************************
-  Primary method for iterative path-finding.
-
-  Plan: 1. Process previous position.
-        2. Get new nearest position and return it.
-
-  During the iteration, the node status will be changed:
-  A. NS_UNINIT: The node is not initialized, we didn't reach it at all.
-  B. NS_INIT: We have initialized the cached values, however, we failed to
-     reach this node.
-  C. NS_NEW: We have reached this node, but we are not sure it was the best
-     path.
-  (NS_WAITING not used here)
-  D. NS_PROCESSED: Now, we are sure we have the best path. Then, we won't
-     do anything more with this node.
+  Process a position of which we have the best path: register the
+  adjacent positions we can reach from it in the priority queue. A helper
+  for pf_normal_map_iterate().
 ****************************************************************************/
-static bool pf_normal_map_iterate(struct pf_map *pfm)
+static void pf_normal_map_expand(struct pf_normal_map *pfnm,
+                                 struct tile *tile)
 {
-  struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
-  struct tile *tile = pfm->tile;
   int index = tile_index(tile);
-  struct pf_normal_node *node = pfnm->lattice + index;
-  const struct pf_parameter *params = pf_map_parameter(pfm);
-  int cost_of_path;
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, index);
+  const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
+  int cost_of_path, priority;
   enum pf_move_scope scope = node->move_scope;
 
   /* There is no exit from DONT_LEAVE tiles! */
@@ -627,7 +946,7 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
       /* Calculate the cost of every adjacent position and set them in the
        * priority queue for next call to pf_normal_map_iterate(). */
       int index1 = tile_index(tile1);
-      struct pf_normal_node *node1 = pfnm->lattice + index1;
+      struct pf_normal_node *node1 = pf_normal_map_node(pfnm, index1);
       int cost;
       int extra = 0;
 
@@ -696,6 +1015,11 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
 
       /* Update costs. */
       cost_of_path = pf_total_CC(params, cost, extra);
+      if (0 < pfnm->goal_min_MC) {
+        priority = pf_normal_map_goal_CC(pfnm, tile1, cost, extra);
+      } else {
+        priority = cost_of_path;
+      }
 
       if (NS_INIT == node1->status) {
         /* We are reaching this node for the first time. */
@@ -703,8 +1027,8 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
         node1->extra_cost = extra;
         node1->cost = cost;
         node1->dir_to_here = dir;
-        /* As we prefer lower costs, let's reverse the cost of the path. */
-        pq_insert(pfnm->queue, index1, -cost_of_path);
+        /* As we prefer lower costs, let's reverse the priority. */
+        pq_insert(pfnm->queue, index1, -priority);
       } else if (cost_of_path < pf_total_CC(params, node1->cost,
                                             node1->extra_cost)) {
         /* We found a better route to 'tile1'. Let's register 'index1' to
@@ -713,11 +1037,70 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
         node1->extra_cost = extra;
         node1->cost = cost;
         node1->dir_to_here = dir;
-        /* As we prefer lower costs, let's reverse the cost of the path. */
-        pq_replace(pfnm->queue, index1, -cost_of_path);
+        /* As we prefer lower costs, let's reverse the priority. */
+        pq_replace(pfnm->queue, index1, -priority);
       }
     } adjc_dir_iterate_end;
   }
+}
+
+/****************************************************************************
+  Expand all the nodes kept by pf_normal_map_rebase(). They have the best
+  path already, but the positions around them must be queued again.
+****************************************************************************/
+static void pf_normal_map_expand_kept(struct pf_normal_map *pfnm)
+{
+  const struct pf_lattice *lattice = &pfnm->lattice;
+  const struct pf_normal_node *node;
+  int i, j, index;
+
+  for (i = 0; i < lattice->blocks_num; i++) {
+    if (NULL == lattice->blocks[i]) {
+      continue;
+    }
+
+    for (j = 0; j < PF_LATTICE_BLOCK_SIZE; j++) {
+      index = (i << PF_LATTICE_BLOCK_SHIFT) + j;
+      if (index >= MAP_INDEX_SIZE) {
+        break;
+      }
+      node = pf_normal_map_node(pfnm, index);
+      if (NS_PROCESSED == node->status) {
+        pf_normal_map_expand(pfnm, index_to_tile(index));
+      }
+    }
+  }
+  pfnm->rebased = FALSE;
+}
+
+/****************************************************************************
+  Primary method for iterative path-finding.
+
+  Plan: 1. Process previous position.
+        2. Get new nearest position and return it.
+
+  During the iteration, the node status will be changed:
+  A. NS_UNINIT: The node is not initialized, we didn't reach it at all.
+  B. NS_INIT: We have initialized the cached values, however, we failed to
+     reach this node.
+  C. NS_NEW: We have reached this node, but we are not sure it was the best
+     path.
+  (NS_WAITING not used here)
+  D. NS_PROCESSED: Now, we are sure we have the best path. Then, we won't
+     do anything more with this node.
+****************************************************************************/
+static bool pf_normal_map_iterate(struct pf_map *pfm)
+{
+  struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
+  int index;
+
+  if (pfnm->rebased) {
+    /* Process all the positions kept from the previous start tile. */
+    pf_normal_map_expand_kept(pfnm);
+  } else {
+    /* Process previous position. */
+    pf_normal_map_expand(pfnm, pfm->tile);
+  }
 
   /* Get the next node (the index with the highest priority). */
   if (!pq_remove(pfnm->queue, &index)) {
@@ -726,12 +1109,12 @@ static bool pf_normal_map_iterate(struct pf_map *pfm)
   }
 
 #ifdef PF_DEBUG
-  fc_assert(NS_NEW == pfnm->lattice[index].status);
+  fc_assert(NS_NEW == pf_normal_map_node(pfnm, index)->status);
 #endif
 
   /* Change the pf_map iterator. Node status step C. to D. */
   pfm->tile = index_to_tile(index);
-  pfnm->lattice[index].status = NS_PROCESSED;
+  pf_normal_map_node(pfnm, index)->status = NS_PROCESSED;
 
   return TRUE;
 }
@@ -743,7 +1126,7 @@ static inline bool pf_normal_map_iterate_until(struct pf_normal_map *pfnm,
                                                struct tile *ptile)
 {
   struct pf_map *pfm = PF_MAP(pfnm);
-  struct pf_normal_node *node = pfnm->lattice + tile_index(ptile);
+  struct pf_normal_node *node = pf_normal_map_node(pfnm, tile_index(ptile));
 
   if (NULL == pf_map_parameter(pfm)->get_costs) {
     /* Start position is handled in every function calling this function. */
@@ -782,7 +1165,7 @@ static int pf_normal_map_move_cost(struct pf_map *pfm, struct tile *ptile)
   if (ptile == pfm->params.start_tile) {
     return 0;
   } else if (pf_normal_map_iterate_until(pfnm, ptile)) {
-    return (pfnm->lattice[tile_index(ptile)].cost
+    return (pf_normal_map_node(pfnm, tile_index(ptile))->cost
             - pf_move_rate(pf_map_parameter(pfm))
             + pf_moves_left_initially(pf_map_parameter(pfm)));
   } else {
@@ -836,11 +1219,279 @@ static void pf_normal_map_destroy(struct pf_map *pfm)
 {
   struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
 
-  free(pfnm->lattice);
+  pf_lattice_free(&pfnm->lattice, NULL);
   pq_destroy(pfnm->queue);
   free(pfnm);
 }
 
+/****************************************************************************
+  Calculates cached values of the starting node.
+****************************************************************************/
+static void pf_normal_map_start_node_init(struct pf_normal_map *pfnm,
+                                          struct pf_normal_node *node)
+{
+  const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfnm));
+
+  if (!pf_normal_node_init(pfnm, node, params->start_tile, PF_MS_NONE)) {
+    /* Always fails. */
+    fc_assert(TRUE == pf_normal_node_init(pfnm, node, params->start_tile,
+                                          PF_MS_NONE));
+  }
+
+  if (NULL != params->transported_by_initially) {
+    /* Overwrite. It is safe because we cannot return to start tile with
+     * pf_normal_map. */
+    node->move_scope |= PF_MS_TRANSPORT;
+    if (!utype_can_freely_unload(params->utype,
+                                 params->transported_by_initially)
+        && NULL == tile_city(params->start_tile)
+        && !tile_has_native_base(params->start_tile,
+                                 params->transported_by_initially)) {
+      /* Cannot disembark, don't leave transporter. */
+      node->behavior = TB_DONT_LEAVE;
+    }
+  }
+}
+
+/****************************************************************************
+  Compare the cached values of a node with the ones calculated again for
+  the current state of the game. Returns a negative value if moving to or
+  from the node might be cheaper now, a positive value if it can only be
+  more expensive, or 0 if nothing changed.
+****************************************************************************/
+static int pf_normal_node_cmp(const struct pf_parameter *params,
+                              const struct pf_normal_node *cached,
+                              const struct pf_normal_node *fresh)
+{
+  if (TB_IGNORE == cached->behavior) {
+    /* We couldn't enter this node, the other values are not set. */
+    return (TB_IGNORE == fresh->behavior ? 0 : -1);
+  } else if (TB_IGNORE == fresh->behavior) {
+    return 1;
+  }
+
+  if (cached->move_scope != fresh->move_scope
+      || cached->action != fresh->action
+      || cached->node_known_type != fresh->node_known_type
+      || (PF_ACTION_NONE != cached->action
+          && NULL != params->is_action_possible)) {
+    /* We cannot know if it is better or worse. */
+    return -1;
+  }
+
+  /* TB_DONT_LEAVE is more restrictive than TB_NORMAL. */
+  if ((TB_NORMAL == fresh->behavior && TB_NORMAL != cached->behavior)
+      || fresh->zoc_number < cached->zoc_number
+      || fresh->extra_tile < cached->extra_tile) {
+    return -1;
+  }
+
+  return (cached->behavior != fresh->behavior
+          || cached->zoc_number != fresh->zoc_number
+          || cached->extra_tile != fresh->extra_tile ? 1 : 0);
+}
+
+/* Marks used by pf_normal_map_rebase(). */
+enum pf_rebase_mark {
+  PF_RB_NONE = 0,
+  PF_RB_CHANGED,        /* The node is more expensive to reach now. */
+  PF_RB_KEPT,           /* The best path goes through the new start tile. */
+  PF_RB_DROPPED         /* Must be searched again. */
+};
+
+/****************************************************************************
+  Rebase the map to the new start tile of 'parameter' (see pf_map_rebase()).
+
+  Like for the D* algorithm, we keep the part of the old search which is
+  still valid. The best path to a node from the old start tile is also the
+  best path from any tile on it, if nothing became cheaper meanwhile. So
+  we keep the subtree of the best paths under the new start tile, minus
+  the nodes which got more expensive and their own subtrees. The other
+  nodes are reset, they are searched again the next time the map is
+  iterated, from the kept nodes.
+
+  The moves are cheaper only if the costs differ by whole turns from the
+  old start tile, i.e. the unit must have the same moves left as when it
+  would have reached it following the best path. The tiles of which the
+  move costs might have changed (see pf_map_tile_changed()) and the nodes
+  which are cheaper to reach now make the rebase fail.
+
+  The old start tile is special: the unit left it, so the costs to enter
+  it changed. But reaching the goal through it again cannot be better
+  than the old best path.
+****************************************************************************/
+static bool pf_normal_map_rebase(struct pf_map *pfm,
+                                 const struct pf_parameter *parameter)
+{
+  struct pf_normal_map *pfnm = PF_NORMAL_MAP(pfm);
+  struct pf_parameter *params = &pfm->params;
+  const struct pf_parameter old_params = *params;
+  const struct pf_lattice *lattice = &pfnm->lattice;
+  int old_start = tile_index(params->start_tile);
+  int new_start = tile_index(parameter->start_tile);
+  int move_rate = pf_move_rate(parameter);
+  struct pf_normal_node *node, fresh, start;
+  enum pf_rebase_mark *marks;
+  enum pf_rebase_mark mark;
+  int *chain, chain_len;
+  int cost_shift, extra_shift;
+  int i, j, index;
+  bool valid = TRUE;
+
+  node = pf_normal_map_node(pfnm, new_start);
+  if (NS_PROCESSED != node->status || 0 >= move_rate) {
+    return FALSE;
+  }
+
+  /* The costs must differ by whole turns. */
+  cost_shift = node->cost - (move_rate - pf_moves_left_initially(parameter));
+  if (0 > cost_shift || 0 != cost_shift % move_rate) {
+    return FALSE;
+  }
+  extra_shift = node->extra_cost;
+
+  marks = fc_calloc(MAP_INDEX_SIZE, sizeof(*marks));
+  *params = *parameter;
+
+  /* The new start tile must be left as before. */
+  memset(&start, 0, sizeof(start));
+  pf_normal_map_start_node_init(pfnm, &start);
+  if (start.behavior != node->behavior
+      || start.move_scope != node->move_scope
+      || start.action != node->action
+      || start.node_known_type != node->node_known_type
+      || (ZOC_MINE == start.zoc_number) != (ZOC_MINE == node->zoc_number)) {
+    valid = FALSE;
+  }
+
+  /* Look for the changes. */
+  for (i = 0; valid && i < lattice->blocks_num; i++) {
+    if (NULL == lattice->blocks[i]) {
+      continue;
+    }
+
+    for (j = 0; valid && j < PF_LATTICE_BLOCK_SIZE; j++) {
+      index = (i << PF_LATTICE_BLOCK_SHIFT) + j;
+      if (index >= MAP_INDEX_SIZE) {
+        break;
+      }
+      node = pf_normal_map_node(pfnm, index);
+      if (NS_UNINIT == node->status || index == new_start) {
+        continue;
+      }
+
+      if (pf_tile_changed_since(index_to_tile(index), pfnm->stamp)) {
+        valid = FALSE;
+        break;
+      }
+
+      memset(&fresh, 0, sizeof(fresh));
+      pf_normal_node_init(pfnm, &fresh, index_to_tile(index),
+                          node->move_scope & PF_MS_CITY);
+      if (index == old_start) {
+        /* Only the costs to enter it may be lower. */
+        fresh.extra_tile = node->extra_tile;
+        if (ZOC_MINE != fresh.zoc_number && ZOC_MINE != node->zoc_number) {
+          fresh.zoc_number = node->zoc_number;
+        }
+      }
+
+      switch (pf_normal_node_cmp(params, node, &fresh)) {
+      case 0:
+        break;
+      case 1:
+        marks[index] = PF_RB_CHANGED;
+        break;
+      default:
+        valid = FALSE;
+        break;
+      }
+    }
+  }
+
+  if (!valid) {
+    *params = old_params;
+    free(marks);
+    return FALSE;
+  }
+
+  /* Find the nodes of which the best path goes through the new start
+   * tile, following the paths back. */
+  chain = fc_malloc(MAP_INDEX_SIZE * sizeof(*chain));
+  marks[old_start] = PF_RB_DROPPED;
+  marks[new_start] = PF_RB_KEPT;
+  for (i = 0; i < lattice->blocks_num; i++) {
+    if (NULL == lattice->blocks[i]) {
+      continue;
+    }
+
+    for (j = 0; j < PF_LATTICE_BLOCK_SIZE; j++) {
+      index = (i << PF_LATTICE_BLOCK_SHIFT) + j;
+      if (index >= MAP_INDEX_SIZE) {
+        break;
+      }
+      node = pf_normal_map_node(pfnm, index);
+      if (NS_PROCESSED != node->status) {
+        continue;
+      }
+
+      chain_len = 0;
+      while (PF_RB_KEPT != marks[index] && PF_RB_DROPPED != marks[index]) {
+        if (PF_RB_CHANGED == marks[index]) {
+          marks[index] = PF_RB_DROPPED;
+          break;
+        }
+        chain[chain_len++] = index;
+        index = tile_index(mapstep(index_to_tile(index),
+                                   DIR_REVERSE(node->dir_to_here)));
+        node = pf_normal_map_node(pfnm, index);
+      }
+      mark = marks[index];
+      while (0 < chain_len) {
+        marks[chain[--chain_len]] = mark;
+      }
+    }
+  }
+  free(chain);
+
+  /* Rebase the kept nodes, reset the other ones. */
+  for (i = 0; i < lattice->blocks_num; i++) {
+    if (NULL == lattice->blocks[i]) {
+      continue;
+    }
+
+    for (j = 0; j < PF_LATTICE_BLOCK_SIZE; j++) {
+      index = (i << PF_LATTICE_BLOCK_SHIFT) + j;
+      if (index >= MAP_INDEX_SIZE) {
+        break;
+      }
+      node = pf_normal_map_node(pfnm, index);
+      if (PF_RB_KEPT == marks[index]) {
+        node->cost -= cost_shift;
+        node->extra_cost -= extra_shift;
+      } else {
+        memset(node, 0, sizeof(*node));
+      }
+    }
+  }
+  free(marks);
+
+  start.cost = pf_normal_map_node(pfnm, new_start)->cost;
+  start.extra_cost = 0;
+  start.dir_to_here = PF_DIR_NONE;
+  start.status = NS_PROCESSED;
+  *pf_normal_map_node(pfnm, new_start) = start;
+
+  while (pq_remove(pfnm->queue, &index)) {
+    /* Empty the queue. */
+  }
+  pfnm->stamp = pf_changes_stamp;
+  pfnm->rebased = TRUE;
+  pfm->tile = params->start_tile;
+
+  return TRUE;
+}
+
 /****************************************************************************
   'pf_normal_map' constructor.
 ****************************************************************************/
@@ -860,7 +1511,7 @@ static struct pf_map *pf_normal_map_new(const struct pf_parameter *parameter)
 #endif /* PF_DEBUG */
 
   /* Allocate the map. */
-  pfnm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_normal_node));
+  pf_lattice_init(&pfnm->lattice, &pf_normal_pool);
   pfnm->queue = pq_create(INITIAL_QUEUE_SIZE);
 
   if (NULL == parameter->get_costs) {
@@ -881,36 +1532,37 @@ static struct pf_map *pf_normal_map_new(const struct pf_parameter *parameter)
   base_map->get_position = pf_normal_map_position;
   if (NULL != params->get_costs) {
     base_map->iterate = pf_jumbo_map_iterate;
+    base_map->rebase = NULL;
   } else {
     base_map->iterate = pf_normal_map_iterate;
+    base_map->rebase = pf_normal_map_rebase;
+  }
+  pfnm->stamp = pf_changes_stamp;
+  pfnm->rebased = FALSE;
+
+  /* Goal-directed search. A step into the unknown or an action can be
+   * cheaper than what 'get_MC' would return. */
+  if (NULL != params->goal_tile && NULL == params->get_costs
+      && 0 < params->goal_min_MC && 0 < params->move_rate) {
+    pfnm->goal_min_MC = MIN(params->goal_min_MC, SINGLE_MOVE);
+    pfnm->goal_min_MC = MIN(pfnm->goal_min_MC, params->move_rate);
+    if (!params->omniscience) {
+      pfnm->goal_min_MC = MIN(pfnm->goal_min_MC,
+                              params->utype->unknown_move_cost);
+    }
+  } else {
+    pfnm->goal_min_MC = 0;
   }
 
   /* Initialise starting node. */
-  node = pfnm->lattice + tile_index(params->start_tile);
+  node = pf_normal_map_node(pfnm, tile_index(params->start_tile));
   if (NULL == params->get_costs) {
-    if (!pf_normal_node_init(pfnm, node, params->start_tile, PF_MS_NONE)) {
-      /* Always fails. */
-      fc_assert(TRUE == pf_normal_node_init(pfnm, node, params->start_tile,
-                                            PF_MS_NONE));
-    }
-
-    if (NULL != params->transported_by_initially) {
-      /* Overwrite. It is safe because we cannot return to start tile with
-       * pf_normal_map. */
-      node->move_scope |= PF_MS_TRANSPORT;
-      if (!utype_can_freely_unload(params->utype,
-                                   params->transported_by_initially)
-          && NULL == tile_city(params->start_tile)
-          && !tile_has_native_base(params->start_tile,
-                                   params->transported_by_initially)) {
-        /* Cannot disembark, don't leave transporter. */
-        node->behavior = TB_DONT_LEAVE;
-      }
-    }
+    pf_normal_map_start_node_init(pfnm, node);
   }
 
   /* Initialise the iterator. */
   base_map->tile = params->start_tile;
+  base_map->cache_entry = NULL;
 
   /* This makes calculations of turn/moves_left more convenient, but we
    * need to subtract this value before we return cost to the user. Note
@@ -969,7 +1621,7 @@ struct pf_danger_map {
                                  * processed yet (NS_NEW and NS_WAITING),
                                  * sorted by their total_CC. */
   struct pqueue *danger_queue;  /* Dangerous positions. */
-  struct pf_danger_node *lattice; /* Lattice of nodes. */
+  struct pf_lattice lattice;    /* Lattice of nodes. */
 };
 
 /* Up-cast macro. */
@@ -989,6 +1641,20 @@ pf_danger_map_check(struct pf_map *pfm, const char *file,
 #define PF_DANGER_MAP(pfm) ((struct pf_danger_map *) (pfm))
 #endif /* PF_DEBUG */
 
+/* Blocks of danger nodes ready to be reused. */
+static struct pf_lattice_pool pf_danger_pool = {
+  sizeof(struct pf_danger_node)
+};
+
+/****************************************************************************
+  Returns the node at 'index' of the danger map.
+****************************************************************************/
+static inline struct pf_danger_node *
+pf_danger_map_node(const struct pf_danger_map *pfdm, int index)
+{
+  return pf_lattice_node(&pfdm->lattice, index);
+}
+
 /* ===============  Specific pf_danger_* mode functions ================== */
 
 /****************************************************************************
@@ -1137,7 +1803,7 @@ static void pf_danger_map_fill_position(const struct pf_danger_map *pfdm,
                                         struct pf_position *pos)
 {
   int index = tile_index(ptile);
-  struct pf_danger_node *node = pfdm->lattice + index;
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, index);
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfdm));
 
 #ifdef PF_DEBUG
@@ -1188,7 +1854,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
   enum direction8 dir_next = PF_DIR_NONE;
   struct pf_danger_pos *danger_seg = NULL;
   bool waited = FALSE;
-  struct pf_danger_node *node = pfdm->lattice + tile_index(ptile);
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tile_index(ptile));
   int length = 1;
   struct tile *iter_tile = ptile;
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pfdm));
@@ -1225,7 +1891,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
 
     /* Step backward. */
     iter_tile = mapstep(iter_tile, DIR_REVERSE(dir_next));
-    node = pfdm->lattice + tile_index(iter_tile);
+    node = pf_danger_map_node(pfdm, tile_index(iter_tile));
   }
 
   /* Allocate memory for path. */
@@ -1234,7 +1900,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
 
   /* Reset variables for main iteration. */
   iter_tile = ptile;
-  node = pfdm->lattice + tile_index(ptile);
+  node = pf_danger_map_node(pfdm, tile_index(ptile));
   danger_seg = NULL;
   waited = FALSE;
 
@@ -1308,7 +1974,7 @@ pf_danger_map_construct_path(const struct pf_danger_map *pfdm,
 
     /* 5: Step further back. */
     iter_tile = mapstep(iter_tile, DIR_REVERSE(dir_next));
-    node = pfdm->lattice + tile_index(iter_tile);
+    node = pf_danger_map_node(pfdm, tile_index(iter_tile));
   }
 
   fc_assert_msg(FALSE, "Cannot get to the starting point!");
@@ -1337,7 +2003,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
                                          struct pf_danger_node *node1)
 {
   struct tile *ptile = PF_MAP(pfdm)->tile;
-  struct pf_danger_node *node = pfdm->lattice + tile_index(ptile);
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tile_index(ptile));
   struct pf_danger_pos *pos;
   int length = 0, i;
 
@@ -1351,7 +2017,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
   while (node->is_dangerous && PF_DIR_NONE != node->dir_to_here) {
     length++;
     ptile = mapstep(ptile, DIR_REVERSE(node->dir_to_here));
-    node = pfdm->lattice + tile_index(ptile);
+    node = pf_danger_map_node(pfdm, tile_index(ptile));
   }
 
   /* Allocate memory for segment */
@@ -1359,7 +2025,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
 
   /* Reset tile and node pointers for main iteration */
   ptile = PF_MAP(pfdm)->tile;
-  node = pfdm->lattice + tile_index(ptile);
+  node = pf_danger_map_node(pfdm, tile_index(ptile));
 
   /* Now fill the positions */
   for (i = 0, pos = node1->danger_segment; i < length; i++, pos++) {
@@ -1374,7 +2040,7 @@ static void pf_danger_map_create_segment(struct pf_danger_map *pfdm,
 
     /* Step further down the tree */
     ptile = mapstep(ptile, DIR_REVERSE(node->dir_to_here));
-    node = pfdm->lattice + tile_index(ptile);
+    node = pf_danger_map_node(pfdm, tile_index(ptile));
   }
 
 #ifdef PF_DEBUG
@@ -1448,7 +2114,7 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
   const struct pf_parameter *const params = pf_map_parameter(pfm);
   struct tile *tile = pfm->tile;
   int index = tile_index(tile);
-  struct pf_danger_node *node = pfdm->lattice + index;
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, index);
   enum pf_move_scope scope = node->move_scope;
 
   /* The previous position is defined by 'tile' (tile pointer), 'node'
@@ -1487,7 +2153,7 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
         /* Calculate the cost of every adjacent position and set them in
          * the priority queues for next call to pf_danger_map_iterate(). */
         int index1 = tile_index(tile1);
-        struct pf_danger_node *node1 = pfdm->lattice + index1;
+        struct pf_danger_node *node1 = pf_danger_map_node(pfdm, index1);
         int cost;
         int extra = 0;
 
@@ -1655,7 +2321,7 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(index);
       pfm->tile = tile;
-      node = pfdm->lattice + index;
+      node = pf_danger_map_node(pfdm, index);
     } else {
       /* No dangerous nodes to process, go for a safe one. */
       if (!pq_remove(pfdm->queue, &index)) {
@@ -1664,13 +2330,13 @@ static bool pf_danger_map_iterate(struct pf_map *pfm)
       }
 
 #ifdef PF_DEBUG
-      fc_assert(NS_PROCESSED != pfdm->lattice[index].status);
+      fc_assert(NS_PROCESSED != pf_danger_map_node(pfdm, index)->status);
 #endif
 
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(index);
       pfm->tile = tile;
-      node = pfdm->lattice + index;
+      node = pf_danger_map_node(pfdm, index);
       if (NS_WAITING != node->status) {
         /* Node status step C. and D. */
 #ifdef PF_DEBUG
@@ -1707,7 +2373,7 @@ static inline bool pf_danger_map_iterate_until(struct pf_danger_map *pfdm,
                                                struct tile *ptile)
 {
   struct pf_map *pfm = PF_MAP(pfdm);
-  struct pf_danger_node *node = pfdm->lattice + tile_index(ptile);
+  struct pf_danger_node *node = pf_danger_map_node(pfdm, tile_index(ptile));
 
   /* Start position is handled in every function calling this function. */
 
@@ -1746,7 +2412,7 @@ static int pf_danger_map_move_cost(struct pf_map *pfm, struct tile *ptile)
   if (ptile == pfm->params.start_tile) {
     return 0;
   } else if (pf_danger_map_iterate_until(pfdm, ptile)) {
-    return (pfdm->lattice[tile_index(ptile)].cost
+    return (pf_danger_map_node(pfdm, tile_index(ptile))->cost
             - pf_move_rate(pf_map_parameter(pfm))
             + pf_moves_left_initially(pf_map_parameter(pfm)));
   } else {
@@ -1793,22 +2459,26 @@ static bool pf_danger_map_position(struct pf_map *pfm, struct tile *ptile,
   }
 }
 
+/****************************************************************************
+  Clean up the dangling danger segment of a node.
+****************************************************************************/
+static void pf_danger_node_free(void *ptr)
+{
+  struct pf_danger_node *node = ptr;
+
+  if (node->danger_segment) {
+    free(node->danger_segment);
+  }
+}
+
 /****************************************************************************
   'pf_danger_map' destructor.
 ****************************************************************************/
 static void pf_danger_map_destroy(struct pf_map *pfm)
 {
   struct pf_danger_map *pfdm = PF_DANGER_MAP(pfm);
-  struct pf_danger_node *node;
-  int i;
 
-  /* Need to clean up the dangling danger segments. */
-  for (i = 0, node = pfdm->lattice; i < MAP_INDEX_SIZE; i++, node++) {
-    if (node->danger_segment) {
-      free(node->danger_segment);
-    }
-  }
-  free(pfdm->lattice);
+  pf_lattice_free(&pfdm->lattice, pf_danger_node_free);
   pq_destroy(pfdm->queue);
   pq_destroy(pfdm->danger_queue);
   free(pfdm);
@@ -1833,7 +2503,7 @@ static struct pf_map *pf_danger_map_new(const struct pf_parameter *parameter)
 #endif /* PF_DEBUG */
 
   /* Allocate the map. */
-  pfdm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_danger_node));
+  pf_lattice_init(&pfdm->lattice, &pf_danger_pool);
   pfdm->queue = pq_create(INITIAL_QUEUE_SIZE);
   pfdm->danger_queue = pq_create(INITIAL_QUEUE_SIZE);
 
@@ -1855,9 +2525,10 @@ static struct pf_map *pf_danger_map_new(const struct pf_parameter *parameter)
   base_map->get_path = pf_danger_map_path;
   base_map->get_position = pf_danger_map_position;
   base_map->iterate = pf_danger_map_iterate;
+  base_map->rebase = NULL;
 
   /* Initialise starting node. */
-  node = pfdm->lattice + tile_index(params->start_tile);
+  node = pf_danger_map_node(pfdm, tile_index(params->start_tile));
   if (!pf_danger_node_init(pfdm, node, params->start_tile, PF_MS_NONE)) {
     /* Always fails. */
     fc_assert(TRUE == pf_danger_node_init(pfdm, node, params->start_tile,
@@ -1870,6 +2541,7 @@ static struct pf_map *pf_danger_map_new(const struct pf_parameter *parameter)
 
   /* Initialise the iterator. */
   base_map->tile = params->start_tile;
+  base_map->cache_entry = NULL;
 
   /* This makes calculations of turn/moves_left more convenient, but we
    * need to subtract this value before we return cost to the user. Note
@@ -1949,7 +2621,7 @@ struct pf_fuel_map {
                                  * total_CC */
   struct pqueue *waited_queue;  /* Queue of nodes to reach farer positions
                                  * after having refueled. */
-  struct pf_fuel_node *lattice; /* Lattice of nodes */
+  struct pf_lattice lattice;    /* Lattice of nodes */
 };
 
 /* Up-cast macro. */
@@ -1969,6 +2641,20 @@ pf_fuel_map_check(struct pf_map *pfm, const char *file,
 #define PF_FUEL_MAP(pfm) ((struct pf_fuel_map *) (pfm))
 #endif /* PF_DEBUG */
 
+/* Blocks of fuel nodes ready to be reused. */
+static struct pf_lattice_pool pf_fuel_pool = {
+  sizeof(struct pf_fuel_node)
+};
+
+/****************************************************************************
+  Returns the node at 'index' of the fuel map.
+****************************************************************************/
+static inline struct pf_fuel_node *
+pf_fuel_map_node(const struct pf_fuel_map *pffm, int index)
+{
+  return pf_lattice_node(&pffm->lattice, index);
+}
+
 /* =================  Specific pf_fuel_* mode functions ================== */
 
 /****************************************************************************
@@ -2265,7 +2951,7 @@ static void pf_fuel_map_fill_position(const struct pf_fuel_map *pffm,
                                       struct pf_position *pos)
 {
   int index = tile_index(ptile);
-  struct pf_fuel_node *node = pffm->lattice + index;
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, index);
   struct pf_fuel_pos *head = node->segment;
   const struct pf_parameter *params = pf_map_parameter(PF_MAP(pffm));
 
@@ -2304,7 +2990,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 {
   struct pf_path *path = fc_malloc(sizeof(*path));
   enum direction8 dir_next = PF_DIR_NONE;
-  struct pf_fuel_node *node = pffm->lattice + tile_index(ptile);
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, tile_index(ptile));
   struct pf_fuel_pos *segment = node->segment;
   int length = 1;
   struct tile *iter_tile = ptile;
@@ -2336,7 +3022,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 
     /* Step backward. */
     iter_tile = mapstep(iter_tile, DIR_REVERSE(segment->dir_to_here));
-    node = pffm->lattice + tile_index(iter_tile);
+    node = pf_fuel_map_node(pffm, tile_index(iter_tile));
     segment = segment->prev;
 #ifdef PF_DEBUG
     fc_assert(NULL != segment);
@@ -2353,7 +3039,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 
   /* Reset variables for main iteration. */
   iter_tile = ptile;
-  node = pffm->lattice + tile_index(ptile);
+  node = pf_fuel_map_node(pffm, tile_index(ptile));
   segment = node->segment;
 
   for (i = length - 1; i >= 0; i--) {
@@ -2406,7 +3092,7 @@ pf_fuel_map_construct_path(const struct pf_fuel_map *pffm,
 
     /* 5: Step further back. */
     iter_tile = mapstep(iter_tile, DIR_REVERSE(dir_next));
-    node = pffm->lattice + tile_index(iter_tile);
+    node = pf_fuel_map_node(pffm, tile_index(iter_tile));
     segment = segment->prev;
 #ifdef PF_DEBUG
     fc_assert(NULL != segment);
@@ -2447,7 +3133,7 @@ static inline void pf_fuel_map_create_segment(struct pf_fuel_map *pffm,
   do {
     next = pos;
     ptile = mapstep(ptile, DIR_REVERSE(node->dir_to_here));
-    node = pffm->lattice + tile_index(ptile);
+    node = pf_fuel_map_node(pffm, tile_index(ptile));
     pos = node->pos;
     if (NULL != pos) {
       if (pos->cost == node->cost
@@ -2553,7 +3239,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
   const struct pf_parameter *const params = pf_map_parameter(pfm);
   struct tile *tile = pfm->tile;
   int index = tile_index(tile);
-  struct pf_fuel_node *node = pffm->lattice + index;
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, index);
   enum pf_move_scope scope = node->move_scope;
   int priority, waited_priority;
   bool waited = FALSE;
@@ -2596,7 +3282,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
         /* Calculate the cost of every adjacent position and set them in
          * the priority queues for next call to pf_fuel_map_iterate(). */
         int index1 = tile_index(tile1);
-        struct pf_fuel_node *node1 = pffm->lattice + index1;
+        struct pf_fuel_node *node1 = pf_fuel_map_node(pffm, index1);
         int cost, extra = 0;
         int moves_left;
         int cost_of_path, old_cost_of_path;
@@ -2817,7 +3503,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(index);
       pfm->tile = tile;
-      node = pffm->lattice + index;
+      node = pf_fuel_map_node(pffm, index);
       waited = TRUE;
 #ifdef PF_DEBUG
       fc_assert(0 < node->moves_left_req);
@@ -2834,7 +3520,7 @@ static bool pf_fuel_map_iterate(struct pf_map *pfm)
       /* Change the pf_map iterator and reset data. */
       tile = index_to_tile(index);
       pfm->tile = tile;
-      node = pffm->lattice + index;
+      node = pf_fuel_map_node(pffm, index);
 #ifdef PF_DEBUG
       fc_assert(NS_PROCESSED != node->status);
 #endif
@@ -2877,7 +3563,7 @@ static inline bool pf_fuel_map_iterate_until(struct pf_fuel_map *pffm,
                                              struct tile *ptile)
 {
   struct pf_map *pfm = PF_MAP(pffm);
-  struct pf_fuel_node *node = pffm->lattice + tile_index(ptile);
+  struct pf_fuel_node *node = pf_fuel_map_node(pffm, tile_index(ptile));
 
   /* Start position is handled in every function calling this function. */
 
@@ -2915,7 +3601,7 @@ static int pf_fuel_map_move_cost(struct pf_map *pfm, struct tile *ptile)
   if (ptile == pfm->params.start_tile) {
     return 0;
   } else if (pf_fuel_map_iterate_until(pffm, ptile)) {
-    const struct pf_fuel_node *node = pffm->lattice + tile_index(ptile);
+    const struct pf_fuel_node *node = pf_fuel_map_node(pffm, tile_index(ptile));
 
     return (node->segment->cost
             - pf_move_rate(pf_map_parameter(pfm))
@@ -2964,21 +3650,25 @@ static bool pf_fuel_map_position(struct pf_map *pfm, struct tile *ptile,
   }
 }
 
+/****************************************************************************
+  Clean up the dangling fuel segments of a node.
+****************************************************************************/
+static void pf_fuel_node_free(void *ptr)
+{
+  struct pf_fuel_node *node = ptr;
+
+  pf_fuel_pos_unref(node->pos);
+  pf_fuel_pos_unref(node->segment);
+}
+
 /****************************************************************************
   'pf_fuel_map' destructor.
 ****************************************************************************/
 static void pf_fuel_map_destroy(struct pf_map *pfm)
 {
   struct pf_fuel_map *pffm = PF_FUEL_MAP(pfm);
-  struct pf_fuel_node *node;
-  int i;
 
-  /* Need to clean up the dangling fuel segments. */
-  for (i = 0, node = pffm->lattice; i < MAP_INDEX_SIZE; i++, node++) {
-    pf_fuel_pos_unref(node->pos);
-    pf_fuel_pos_unref(node->segment);
-  }
-  free(pffm->lattice);
+  pf_lattice_free(&pffm->lattice, pf_fuel_node_free);
   pq_destroy(pffm->queue);
   pq_destroy(pffm->waited_queue);
   free(pffm);
@@ -3003,7 +3693,7 @@ static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
 #endif /* PF_DEBUG */
 
   /* Allocate the map. */
-  pffm->lattice = fc_calloc(MAP_INDEX_SIZE, sizeof(struct pf_fuel_node));
+  pf_lattice_init(&pffm->lattice, &pf_fuel_pool);
   pffm->queue = pq_create(INITIAL_QUEUE_SIZE);
   pffm->waited_queue = pq_create(INITIAL_QUEUE_SIZE);
 
@@ -3025,9 +3715,10 @@ static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
   base_map->get_path = pf_fuel_map_path;
   base_map->get_position = pf_fuel_map_position;
   base_map->iterate = pf_fuel_map_iterate;
+  base_map->rebase = NULL;
 
   /* Initialise starting node. */
-  node = pffm->lattice + tile_index(params->start_tile);
+  node = pf_fuel_map_node(pffm, tile_index(params->start_tile));
   if (!pf_fuel_node_init(pffm, node, params->start_tile, PF_MS_NONE)) {
     /* Always fails. */
     fc_assert(TRUE == pf_fuel_node_init(pffm, node, params->start_tile,
@@ -3040,6 +3731,7 @@ static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
 
   /* Initialise the iterator. */
   base_map->tile = params->start_tile;
+  base_map->cache_entry = NULL;
 
   /* This makes calculations of turn/moves_left more convenient, but we
    * need to subtract this value before we return cost to the user. Note
@@ -3058,6 +3750,11 @@ static struct pf_map *pf_fuel_map_new(const struct pf_parameter *parameter)
 
 /* ====================== pf_map public functions ======================= */
 
+static void pf_map_cache_entry_record(struct pf_map_cache_entry *entry,
+                                      struct tile *ptile);
+static bool pf_map_cache_hash_cmp(const struct pf_parameter *param1,
+                                  const struct pf_parameter *param2);
+
 /****************************************************************************
   Factory function to create a new map according to the parameter.
   Does not do any iterations.
@@ -3094,6 +3791,49 @@ void pf_map_destroy(struct pf_map *pfm)
   pfm->destroy(pfm);
 }
 
+/****************************************************************************
+  Reuse the map for a new start position of the same unit, typically when
+  the unit moved along a path of this map, or when it got its moves back
+  for a new turn. Only the start tile, the moves left, the fuel left and
+  the user data can differ between 'parameter' and the parameter of the
+  map ('data' must then point to equivalent data).
+
+  The best paths going through the new start tile are kept if they didn't
+  get more expensive, they are available immediately. The other positions
+  are searched again when needed. Note the kept positions are not iterated
+  again by pf_map_iterate().
+
+  Returns FALSE if the map cannot be rebased (the game changed too much,
+  the unit is not in the same state, not supported map type...). The map
+  is unchanged then, and the caller should create a new one.
+****************************************************************************/
+bool pf_map_rebase(struct pf_map *pfm, const struct pf_parameter *parameter)
+{
+  struct pf_parameter same;
+
+#ifdef PF_DEBUG
+  fc_assert_ret_val(NULL != pfm, FALSE);
+  fc_assert_ret_val(NULL != parameter, FALSE);
+#endif
+
+  if (NULL == pfm->rebase) {
+    return FALSE;
+  }
+
+  same = *parameter;
+  same.start_tile = pfm->params.start_tile;
+  same.moves_left_initially = pfm->params.moves_left_initially;
+  same.fuel_left_initially = pfm->params.fuel_left_initially;
+  same.data = pfm->params.data;
+  if (!pf_map_cache_hash_cmp(&same, &pfm->params)
+      || same.goal_tile != pfm->params.goal_tile
+      || same.goal_min_MC != pfm->params.goal_min_MC) {
+    return FALSE;
+  }
+
+  return pfm->rebase(pfm, parameter);
+}
+
 /****************************************************************************
   Tries to find the minimal move cost to reach ptile. Returns
   PF_IMPOSSIBLE_MC if not reachable. If ptile has not been reached yet,
@@ -3174,6 +3914,11 @@ bool pf_map_iterate(struct pf_map *pfm)
     return FALSE;
   }
 
+  if (NULL != pfm->cache_entry) {
+    /* Remember the iteration order for the other users of this map. */
+    pf_map_cache_entry_record(pfm->cache_entry, pfm->tile);
+  }
+
   return TRUE;
 }
 
@@ -3697,3 +4442,511 @@ bool pf_reverse_map_unit_position(struct pf_reverse_map *pfrm,
   pos->moves_left = punit->moves_left;
   return TRUE;
 }
+
+
+/* ======================== pf_map_cache functions ======================= */
+
+/* The path-finding map cache allows to share the lattices of the maps
+ * which have been created with identical parameters. The users get a
+ * light 'struct pf_cache_map' which behaves as a normal pf_map, but the
+ * underlying map is expanded only once.
+ *
+ * The cache doesn't know anything about the game state the callbacks
+ * rely on. The user must call pf_map_cache_clear() each time something
+ * which might change the result of a path-finding occurs (units moving,
+ * cities founded or destroyed, terrain changes...). The maps already in
+ * use are not affected by the clearing, the users keep a reference on
+ * them. */
+
+/* A shared map. */
+struct pf_map_cache_entry {
+  struct pf_map *pfm;           /* The shared map. */
+  int ref_count;                /* The cache and every pf_cache_map. */
+
+  /* The tiles in the order they were returned by the iteration of the
+   * shared map. The first one is always the start tile. */
+  struct tile **tiles;
+  int tiles_num;
+  int tiles_size;
+
+  /* The index in 'tiles' for every tile of the map, -1 if not reached
+   * yet. Only allocated when needed, see pf_cache_map_sync_iterator(). */
+  int *tile_order;
+};
+
+static genhash_val_t pf_map_cache_hash_val(const struct pf_parameter *param);
+static bool pf_map_cache_hash_cmp(const struct pf_parameter *param1,
+                                  const struct pf_parameter *param2);
+static void pf_map_cache_entry_unref(struct pf_map_cache_entry *entry);
+
+#define SPECHASH_TAG pf_map_cache
+#define SPECHASH_IKEY_TYPE const struct pf_parameter *
+#define SPECHASH_IDATA_TYPE struct pf_map_cache_entry *
+#define SPECHASH_IKEY_VAL pf_map_cache_hash_val
+#define SPECHASH_IKEY_COMP pf_map_cache_hash_cmp
+#define SPECHASH_IDATA_FREE pf_map_cache_entry_unref
+#include "spechash.h"
+
+/* The cache structure. */
+struct pf_map_cache {
+  struct pf_map_cache_hash *hash;
+  int hits;                     /* Statistics, since the last clear. */
+  int misses;
+};
+
+/* Derived structure of struct pf_map, a view on the shared map. */
+struct pf_cache_map {
+  struct pf_map base_map;       /* Base structure, must be the first! */
+
+  struct pf_map_cache_entry *entry; /* The shared map. */
+  int cursor;                   /* Our position in 'entry->tiles'. */
+};
+
+/* Up-cast macro. */
+#ifdef PF_DEBUG
+static inline struct pf_cache_map *
+pf_cache_map_check(struct pf_map *pfm, const char *file,
+                   const char *function, int line)
+{
+  fc_assert_full(file, function, line,
+                 NULL != pfm && PF_CACHED == pfm->mode,
+                 return NULL, "Wrong pf_map to pf_cache_map conversion.");
+  return (struct pf_cache_map *) pfm;
+}
+#define PF_CACHE_MAP(pfm)                                                   \
+  pf_cache_map_check(pfm, __FILE__, __FUNCTION__, __FC_LINE__)
+#else
+#define PF_CACHE_MAP(pfm) ((struct pf_cache_map *) (pfm))
+#endif /* PF_DEBUG */
+
+/****************************************************************************
+  Hash function for the pf_map_cache keys. Parameters for the same unit
+  type differs mainly by the start tile and the moves left.
+****************************************************************************/
+static genhash_val_t pf_map_cache_hash_val(const struct pf_parameter *param)
+{
+  return (pf_map_hash_val(param)
+          ^ ((genhash_val_t) tile_index(param->start_tile) << 12)
+          ^ ((genhash_val_t) param->moves_left_initially << 2)
+          ^ (genhash_val_t) player_index(param->owner));
+}
+
+/****************************************************************************
+  Comparison function for the pf_map_cache keys. Unlike pf_map_hash_cmp(),
+  we need exactly the same parameters, else the callbacks may return
+  different results.
+****************************************************************************/
+static bool pf_map_cache_hash_cmp(const struct pf_parameter *param1,
+                                  const struct pf_parameter *param2)
+{
+  return (param1->start_tile == param2->start_tile
+          && param1->moves_left_initially == param2->moves_left_initially
+          && param1->fuel_left_initially == param2->fuel_left_initially
+          && param1->transported_by_initially
+             == param2->transported_by_initially
+          && param1->cargo_depth == param2->cargo_depth
+          && BV_ARE_EQUAL(param1->cargo_types, param2->cargo_types)
+          && param1->move_rate == param2->move_rate
+          && param1->fuel == param2->fuel
+          && param1->utype == param2->utype
+          && param1->owner == param2->owner
+          && param1->omniscience == param2->omniscience
+          && param1->get_MC == param2->get_MC
+          && param1->get_move_scope == param2->get_move_scope
+          && param1->ignore_none_scopes == param2->ignore_none_scopes
+          && param1->get_TB == param2->get_TB
+          && param1->get_EC == param2->get_EC
+          && param1->get_action == param2->get_action
+          && param1->actions == param2->actions
+          && param1->is_action_possible == param2->is_action_possible
+          && param1->get_zoc == param2->get_zoc
+          && param1->is_pos_dangerous == param2->is_pos_dangerous
+          && param1->get_moves_left_req == param2->get_moves_left_req
+          && param1->get_costs == param2->get_costs
+          && param1->data == param2->data);
+}
+
+/****************************************************************************
+  Returns TRUE if the maps created with this parameter can be shared.
+  Parameters with user data cannot be cached, because we cannot know if
+  the data changed.
+****************************************************************************/
+static bool pf_map_cache_accepts(const struct pf_parameter *parameter)
+{
+  return (NULL == parameter->data
+          && NULL != parameter->utype
+          && NULL != parameter->owner);
+}
+
+/****************************************************************************
+  Create a new shared map, with one reference for the cache.
+****************************************************************************/
+static struct pf_map_cache_entry *
+pf_map_cache_entry_new(const struct pf_parameter *parameter)
+{
+  struct pf_map *pfm = pf_map_new(parameter);
+  struct pf_map_cache_entry *entry;
+
+  if (NULL == pfm) {
+    return NULL;
+  }
+
+  entry = fc_malloc(sizeof(*entry));
+  entry->pfm = pfm;
+  pfm->cache_entry = entry;
+  entry->ref_count = 1;
+  entry->tiles_size = INITIAL_QUEUE_SIZE;
+  entry->tiles = fc_malloc(entry->tiles_size * sizeof(*entry->tiles));
+  entry->tiles[0] = parameter->start_tile;
+  entry->tiles_num = 1;
+  entry->tile_order = NULL;
+
+  return entry;
+}
+
+/****************************************************************************
+  Release a reference to the shared map. Destroys it if there is no other
+  user.
+****************************************************************************/
+static void pf_map_cache_entry_unref(struct pf_map_cache_entry *entry)
+{
+  fc_assert_ret(0 < entry->ref_count);
+
+  if (0 < --entry->ref_count) {
+    return;
+  }
+
+  pf_map_destroy(entry->pfm);
+  free(entry->tiles);
+  if (NULL != entry->tile_order) {
+    free(entry->tile_order);
+  }
+  free(entry);
+}
+
+/****************************************************************************
+  Record the tile returned by the iteration of the shared map.
+****************************************************************************/
+static void pf_map_cache_entry_record(struct pf_map_cache_entry *entry,
+                                      struct tile *ptile)
+{
+  if (entry->tiles_num >= entry->tiles_size) {
+    entry->tiles_size *= 2;
+    entry->tiles = fc_realloc(entry->tiles,
+                              entry->tiles_size * sizeof(*entry->tiles));
+  }
+  if (NULL != entry->tile_order) {
+    entry->tile_order[tile_index(ptile)] = entry->tiles_num;
+  }
+  entry->tiles[entry->tiles_num++] = ptile;
+}
+
+/****************************************************************************
+  Emulate the behaviour of the other maps when the user requests the
+  position of a tile not iterated yet: the iteration resumes from this
+  tile. Only called when the tile has been reached.
+****************************************************************************/
+static void pf_cache_map_sync_iterator(struct pf_cache_map *pfcm,
+                                       struct tile *ptile)
+{
+  struct pf_map_cache_entry *entry = pfcm->entry;
+  int order;
+
+  if (entry->tiles[pfcm->cursor] == ptile) {
+    return;
+  }
+
+  if (NULL == entry->tile_order) {
+    int i;
+
+    entry->tile_order = fc_malloc(MAP_INDEX_SIZE
+                                  * sizeof(*entry->tile_order));
+    for (i = 0; i < MAP_INDEX_SIZE; i++) {
+      entry->tile_order[i] = -1;
+    }
+    for (i = 0; i < entry->tiles_num; i++) {
+      entry->tile_order[tile_index(entry->tiles[i])] = i;
+    }
+  }
+
+  order = entry->tile_order[tile_index(ptile)];
+  if (order > pfcm->cursor) {
+    pfcm->cursor = order;
+    PF_MAP(pfcm)->tile = ptile;
+  }
+}
+
+/****************************************************************************
+  Iterate the view. Tiles already iterated by the shared map are just read
+  from the records.
+****************************************************************************/
+static bool pf_cache_map_iterate(struct pf_map *pfm)
+{
+  struct pf_cache_map *pfcm = PF_CACHE_MAP(pfm);
+  struct pf_map_cache_entry *entry = pfcm->entry;
+
+  if (pfcm->cursor + 1 >= entry->tiles_num
+      && !pf_map_iterate(entry->pfm)) {
+    /* The shared map was fully iterated. */
+    return FALSE;
+  }
+
+  pfm->tile = entry->tiles[++pfcm->cursor];
+  return TRUE;
+}
+
+/****************************************************************************
+  Return the move cost at ptile, see pf_map_move_cost().
+****************************************************************************/
+static int pf_cache_map_move_cost(struct pf_map *pfm, struct tile *ptile)
+{
+  struct pf_cache_map *pfcm = PF_CACHE_MAP(pfm);
+  int cost = pf_map_move_cost(pfcm->entry->pfm, ptile);
+
+  if (PF_IMPOSSIBLE_MC != cost) {
+    pf_cache_map_sync_iterator(pfcm, ptile);
+  }
+  return cost;
+}
+
+/****************************************************************************
+  Return the path to ptile, see pf_map_path().
+****************************************************************************/
+static struct pf_path *pf_cache_map_path(struct pf_map *pfm,
+                                         struct tile *ptile)
+{
+  struct pf_cache_map *pfcm = PF_CACHE_MAP(pfm);
+  struct pf_path *path = pf_map_path(pfcm->entry->pfm, ptile);
+
+  if (NULL != path) {
+    pf_cache_map_sync_iterator(pfcm, ptile);
+  }
+  return path;
+}
+
+/****************************************************************************
+  Get info about position at ptile, see pf_map_position().
+****************************************************************************/
+static bool pf_cache_map_position(struct pf_map *pfm, struct tile *ptile,
+                                  struct pf_position *pos)
+{
+  struct pf_cache_map *pfcm = PF_CACHE_MAP(pfm);
+
+  if (pf_map_position(pfcm->entry->pfm, ptile, pos)) {
+    pf_cache_map_sync_iterator(pfcm, ptile);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/****************************************************************************
+  'pf_cache_map' destructor. The shared map may survive.
+****************************************************************************/
+static void pf_cache_map_destroy(struct pf_map *pfm)
+{
+  struct pf_cache_map *pfcm = PF_CACHE_MAP(pfm);
+
+  pf_map_cache_entry_unref(pfcm->entry);
+  free(pfcm);
+}
+
+/****************************************************************************
+  'pf_cache_map' constructor.
+****************************************************************************/
+static struct pf_map *
+pf_cache_map_new(struct pf_map_cache_entry *entry)
+{
+  struct pf_cache_map *pfcm = fc_malloc(sizeof(*pfcm));
+  struct pf_map *base_map = &pfcm->base_map;
+
+#ifdef PF_DEBUG
+  /* Set the mode, used for cast check. */
+  base_map->mode = PF_CACHED;
+#endif /* PF_DEBUG */
+
+  /* Copy parameters. */
+  base_map->params = entry->pfm->params;
+
+  /* Initialize virtual function table. */
+  base_map->destroy = pf_cache_map_destroy;
+  base_map->get_move_cost = pf_cache_map_move_cost;
+  base_map->get_path = pf_cache_map_path;
+  base_map->get_position = pf_cache_map_position;
+  base_map->iterate = pf_cache_map_iterate;
+  base_map->rebase = NULL;
+
+  /* Initialise the iterator. */
+  base_map->tile = entry->tiles[0];
+  base_map->cache_entry = NULL;
+
+  entry->ref_count++;
+  pfcm->entry = entry;
+  pfcm->cursor = 0;
+
+  return PF_MAP(pfcm);
+}
+
+/****************************************************************************
+  'pf_map_cache' constructor.
+****************************************************************************/
+struct pf_map_cache *pf_map_cache_new(void)
+{
+  struct pf_map_cache *pfmc = fc_malloc(sizeof(*pfmc));
+
+  pfmc->hash = pf_map_cache_hash_new();
+  pfmc->hits = 0;
+  pfmc->misses = 0;
+
+  return pfmc;
+}
+
+/****************************************************************************
+  'pf_map_cache' destructor. The maps still in use are not destroyed.
+****************************************************************************/
+void pf_map_cache_destroy(struct pf_map_cache *pfmc)
+{
+  fc_assert_ret(NULL != pfmc);
+
+  pf_map_cache_clear(pfmc);
+  pf_map_cache_hash_destroy(pfmc->hash);
+  free(pfmc);
+}
+
+/****************************************************************************
+  Forget all the maps of the cache. Must be called each time the game state
+  changed in a way the path-finding results could be different.
+****************************************************************************/
+void pf_map_cache_clear(struct pf_map_cache *pfmc)
+{
+  fc_assert_ret(NULL != pfmc);
+
+  if (0 == pf_map_cache_hash_size(pfmc->hash)) {
+    return;
+  }
+
+  log_debug("PF cache: %d maps dropped (%d hits, %d misses).",
+            (int) pf_map_cache_hash_size(pfmc->hash),
+            pfmc->hits, pfmc->misses);
+  pf_map_cache_hash_clear(pfmc->hash);
+  pfmc->hits = 0;
+  pfmc->misses = 0;
+}
+
+/****************************************************************************
+  Returns a map for the parameter, sharing its lattice with the maps
+  created with the same parameter since the last pf_map_cache_clear(). The
+  returned map must be destroyed with pf_map_destroy() as usual.
+
+  Parameters with user data cannot be cached, because we cannot know if
+  the data changed. In this case (or when 'pfmc' is NULL), this is the
+  same as pf_map_new().
+
+  Goal-directed maps (see 'goal_tile' in the pf_parameter) use an existing
+  shared map if any, else they are created apart, because they don't
+  iterate the positions in the order the other users would expect.
+****************************************************************************/
+struct pf_map *pf_map_cache_map_new(struct pf_map_cache *pfmc,
+                                    const struct pf_parameter *parameter)
+{
+  struct pf_map_cache_entry *entry;
+
+  if (NULL == pfmc || !pf_map_cache_accepts(parameter)) {
+    return pf_map_new(parameter);
+  }
+
+  if (pf_map_cache_hash_lookup(pfmc->hash, parameter, &entry)) {
+    pfmc->hits++;
+  } else if (NULL != parameter->goal_tile) {
+    return pf_map_new(parameter);
+  } else {
+    entry = pf_map_cache_entry_new(parameter);
+    if (NULL == entry) {
+      return NULL;
+    }
+    pf_map_cache_hash_insert(pfmc->hash, &entry->pfm->params, entry);
+    pfmc->misses++;
+  }
+
+  return pf_cache_map_new(entry);
+}
+
+/****************************************************************************
+  Returns a map for the parameter if the cache already has one, else NULL.
+  Unlike pf_map_cache_map_new(), no map is ever created. The returned map
+  must be destroyed with pf_map_destroy() as usual.
+****************************************************************************/
+struct pf_map *pf_map_cache_map_get(struct pf_map_cache *pfmc,
+                                    const struct pf_parameter *parameter)
+{
+  struct pf_map_cache_entry *entry;
+
+  if (NULL == pfmc
+      || !pf_map_cache_accepts(parameter)
+      || !pf_map_cache_hash_lookup(pfmc->hash, parameter, &entry)) {
+    return NULL;
+  }
+
+  pfmc->hits++;
+  return pf_cache_map_new(entry);
+}
+
+/****************************************************************************
+  Job of pf_map_cache_fill(): fully expand one shared map. The tiles are
+  recorded by pf_map_iterate().
+****************************************************************************/
+static void pf_map_cache_fill_job(int index, void *data)
+{
+  struct pf_map_cache_entry **entries = data;
+  struct pf_map *pfm = entries[index]->pfm;
+
+  while (pf_map_iterate(pfm)) {
+    /* Nothing. */
+  }
+}
+
+/****************************************************************************
+  Create the shared maps for all the parameters which are not in the cache
+  yet, and expand them fully, in parallel with the worker threads of
+  'pool' (it may be NULL). Parameters which cannot be cached (see
+  pf_map_cache_map_new()) and goal-directed ones are ignored.
+
+  The callbacks of the parameters are called from several threads at
+  once; they must not modify anything. Because the maps are fully
+  expanded, this is only worth for maps most of which will be used.
+****************************************************************************/
+void pf_map_cache_fill(struct pf_map_cache *pfmc,
+                       const struct pf_parameter *parameters, int num,
+                       struct fc_threadpool *pool)
+{
+  struct pf_map_cache_entry **entries;
+  struct pf_map_cache_entry *entry;
+  int entries_num = 0;
+  int i;
+
+  fc_assert_ret(NULL != pfmc);
+
+  entries = fc_malloc(num * sizeof(*entries));
+  for (i = 0; i < num; i++) {
+    const struct pf_parameter *parameter = parameters + i;
+
+    if (!pf_map_cache_accepts(parameter)
+        || NULL != parameter->goal_tile
+        || pf_map_cache_hash_lookup(pfmc->hash, parameter, NULL)) {
+      continue;
+    }
+
+    entry = pf_map_cache_entry_new(parameter);
+    if (NULL == entry) {
+      continue;
+    }
+    pf_map_cache_hash_insert(pfmc->hash, &entry->pfm->params, entry);
+    pfmc->misses++;
+    entries[entries_num++] = entry;
+  }
+
+  pf_lattice_pools_locked = TRUE;
+  fc_threadpool_run(pool, entries_num, pf_map_cache_fill_job, entries);
+  pf_lattice_pools_locked = FALSE;
+
+  free(entries);
+}
@@ -238,6 +238,28 @@
  * The third argument passed to the iteration macros is a condition that
  * controls if the start tile of the pf_parameter should iterated or not.
  *
+ * If many searches are likely to be done with the same parameters (e.g.
+ * the AI evaluating different tasks for the same unit), the maps can be
+ * shared through a pf_map_cache. pf_map_cache_map_new() is then used
+ * instead of pf_map_new(). The returned map can be used (and must be
+ * destroyed) exactly as any other map, but the underlying lattice is
+ * expanded only once for all users. The cache must be cleared with
+ * pf_map_cache_clear() each time the game state changes in a way which
+ * could modify the results of the callbacks. When the maps of many units
+ * will be needed, pf_map_cache_fill() can expand them in advance with
+ * several threads.
+ *
+ * If the map is created for a single destination known in advance (case
+ * A), setting the goal in the parameter (see 'goal_tile' below) makes
+ * the search directed towards it instead of expanding in all directions.
+ *
+ * When a unit follows a path over several turns, the map used to find it
+ * can be kept and moved to the new position of the unit with
+ * pf_map_rebase(), instead of searching again from the start. Only the
+ * parts of the map which changed are searched again. To know what
+ * changed, the server must notify the game changes affecting the move
+ * costs with pf_map_tile_changed() and pf_map_game_changed().
+ *
  *
  * FILLING the struct pf_parameter:
  * This can either be done by hand or using the pft_* functions from
@@ -447,6 +469,18 @@ struct pf_parameter {
                     int *to_cost, int *to_extra,
                     const struct pf_parameter *param);
 
+  /* Goal-directed search. If 'goal_tile' is set, the normal maps are
+   * expanded by increasing total_CC plus a lower bound of the cost still
+   * needed to reach 'goal_tile' (A* algorithm), so pf_map_path() and
+   * friends on this tile visit only a fraction of the map. 'goal_min_MC'
+   * is the minimal MC which can be returned by 'get_MC' for a single step;
+   * the heuristic is disabled when it is 0 or less. Note that the map
+   * iteration functions don't return the positions by increasing cost
+   * anymore. This is ignored by jumbo maps, and by maps which deal with
+   * danger or fuel. See pft_fill_goal(). */
+  struct tile *goal_tile;
+  int goal_min_MC;
+
   /* User provided data. Can be used to attach arbitrary information
    * to the map. */
   void *data;
@@ -458,6 +492,12 @@ struct pf_map;
 /* The reverse map strucure. Opaque type. */
 struct pf_reverse_map;
 
+/* The map cache structure. Opaque type. */
+struct pf_map_cache;
+
+/* See "utility/fcthreadpool.h". */
+struct fc_threadpool;
+
 
 
 /* ========================= Public Interface ============================ */
@@ -466,6 +506,7 @@ struct pf_reverse_map;
 struct pf_map *pf_map_new(const struct pf_parameter *parameter)
                fc__warn_unused_result;
 void pf_map_destroy(struct pf_map *pfm);
+bool pf_map_rebase(struct pf_map *pfm, const struct pf_parameter *parameter);
 
 /* Method A) functions. */
 int pf_map_move_cost(struct pf_map *pfm, struct tile *ptile);
@@ -528,6 +569,28 @@ bool pf_reverse_map_unit_position(struct pf_reverse_map *pfrm,
                                   struct pf_position *pos);
 
 
+/* Map cache functions (share the maps created with the same parameter). */
+struct pf_map_cache *pf_map_cache_new(void) fc__warn_unused_result;
+void pf_map_cache_destroy(struct pf_map_cache *pfmc);
+void pf_map_cache_clear(struct pf_map_cache *pfmc);
+struct pf_map *pf_map_cache_map_new(struct pf_map_cache *pfmc,
+                                    const struct pf_parameter *parameter)
+               fc__warn_unused_result;
+struct pf_map *pf_map_cache_map_get(struct pf_map_cache *pfmc,
+                                    const struct pf_parameter *parameter)
+               fc__warn_unused_result;
+void pf_map_cache_fill(struct pf_map_cache *pfmc,
+                       const struct pf_parameter *parameters, int num,
+                       struct fc_threadpool *pool);
+
+
+/* Game changes, for pf_map_rebase(). */
+void pf_map_tile_changed(const struct tile *ptile);
+void pf_map_game_changed(void);
+void pf_map_changes_free(void);
+unsigned int pf_map_changes_stamp(void);
+int pf_map_extra_tiles(const struct extra_type *pextra);
+
 
 /* This macro iterates all reachable tiles.
  *
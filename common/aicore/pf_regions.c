@@ -0,0 +1,739 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+/* utility */
+#include "log.h"
+#include "mem.h"
+#include "pqueue.h"
+#include "shared.h"
+#include "support.h"
+
+/* common */
+#include "city.h"
+#include "game.h"
+#include "map.h"
+#include "movement.h"
+#include "terrain.h"
+#include "tile.h"
+#include "unittype.h"
+
+#include "pf_regions.h"
+
+/* The size of the sectors, in native coordinates. */
+#define PF_REGION_SECTOR_SIZE 8
+#define PF_REGION_SECTOR_TILES (PF_REGION_SECTOR_SIZE * PF_REGION_SECTOR_SIZE)
+
+#define PF_REGION_SECTORS_X                                                 \
+  ((map.xsize + PF_REGION_SECTOR_SIZE - 1) / PF_REGION_SECTOR_SIZE)
+#define PF_REGION_SECTORS_Y                                                 \
+  ((map.ysize + PF_REGION_SECTOR_SIZE - 1) / PF_REGION_SECTOR_SIZE)
+
+/* A link to a neighbour region. */
+struct pf_region_link {
+  int region;
+  int cost;                     /* From our center to its center. */
+};
+
+/* A connected group of tiles inside a sector. */
+struct pf_region {
+  int sector;                   /* -1 when the slot is unused. */
+  struct tile *center;
+  int step_cost;                /* Average cost to enter one of our tiles. */
+  int links_num;
+  int links_size;
+  struct pf_region_link *links;
+};
+
+/* The regions of one unit class. */
+struct pf_region_graph {
+  const struct unit_class *pclass;
+  int tiles_num;                /* MAP_INDEX_SIZE when created. */
+  int *tile_region;             /* Region of every tile, or -1. */
+
+  struct pf_region *regions;
+  int regions_num;              /* Used slots, including the unused ones. */
+  int regions_size;
+  int *free_slots;
+  int free_num;
+
+  bool *dirty_sectors;          /* Sectors to build again. */
+  bool dirty;
+
+  /* The costs from a region to all the others, computed when needed and
+   * dropped each time the graph is updated. */
+  int **distances;
+  int distances_size;
+
+  int *scratch;                 /* Tile costs, see pf_region_link_cost(). */
+};
+
+static struct pf_region_graph *pf_region_graphs[UCL_LAST];
+
+/****************************************************************************
+  Returns the sector of the tile.
+****************************************************************************/
+static inline int pf_region_sector(const struct tile *ptile)
+{
+  int nat_x, nat_y;
+
+  index_to_native_pos(&nat_x, &nat_y, tile_index(ptile));
+  return ((nat_y / PF_REGION_SECTOR_SIZE) * PF_REGION_SECTORS_X
+          + nat_x / PF_REGION_SECTOR_SIZE);
+}
+
+/****************************************************************************
+  Fill 'tiles' with the tiles of the sector and returns their number.
+****************************************************************************/
+static int pf_region_sector_tiles(int sector, struct tile **tiles)
+{
+  int x0 = (sector % PF_REGION_SECTORS_X) * PF_REGION_SECTOR_SIZE;
+  int y0 = (sector / PF_REGION_SECTORS_X) * PF_REGION_SECTOR_SIZE;
+  int x1 = MIN(x0 + PF_REGION_SECTOR_SIZE, map.xsize);
+  int y1 = MIN(y0 + PF_REGION_SECTOR_SIZE, map.ysize);
+  int tiles_num = 0;
+  int x, y;
+
+  for (y = y0; y < y1; y++) {
+    for (x = x0; x < x1; x++) {
+      tiles[tiles_num++] = native_pos_to_tile(x, y);
+    }
+  }
+  return tiles_num;
+}
+
+/****************************************************************************
+  Returns TRUE if a unit of the class can be on the tile on its own.
+****************************************************************************/
+static bool pf_region_passable(const struct unit_class *pclass,
+                               const struct tile *ptile)
+{
+  return (is_native_tile_to_class(pclass, ptile)
+          || (NULL != tile_city(ptile)
+              && is_native_near_tile(pclass, ptile)));
+}
+
+/****************************************************************************
+  Returns the cost to enter the tile, only considering the terrain.
+****************************************************************************/
+static inline int pf_region_tile_cost(const struct tile *ptile)
+{
+  const struct terrain *pterrain = tile_terrain(ptile);
+
+  return (NULL != pterrain
+          ? MAX(pterrain->movement_cost * SINGLE_MOVE, 1) : SINGLE_MOVE);
+}
+
+/****************************************************************************
+  Create an empty graph. All sectors have to be built.
+****************************************************************************/
+static struct pf_region_graph *
+pf_region_graph_new(const struct unit_class *pclass)
+{
+  struct pf_region_graph *graph = fc_malloc(sizeof(*graph));
+  int sectors_num = PF_REGION_SECTORS_X * PF_REGION_SECTORS_Y;
+  int i;
+
+  graph->pclass = pclass;
+  graph->tiles_num = MAP_INDEX_SIZE;
+  graph->tile_region = fc_malloc(graph->tiles_num
+                                 * sizeof(*graph->tile_region));
+  graph->scratch = fc_malloc(graph->tiles_num * sizeof(*graph->scratch));
+  for (i = 0; i < graph->tiles_num; i++) {
+    graph->tile_region[i] = -1;
+    graph->scratch[i] = -1;
+  }
+
+  graph->regions_size = 2 * sectors_num;
+  graph->regions = fc_malloc(graph->regions_size * sizeof(*graph->regions));
+  graph->regions_num = 0;
+  graph->free_slots = fc_malloc(graph->regions_size
+                                * sizeof(*graph->free_slots));
+  graph->free_num = 0;
+
+  graph->dirty_sectors = fc_malloc(sectors_num
+                                   * sizeof(*graph->dirty_sectors));
+  for (i = 0; i < sectors_num; i++) {
+    graph->dirty_sectors[i] = TRUE;
+  }
+  graph->dirty = TRUE;
+
+  graph->distances_size = 0;
+  graph->distances = NULL;
+
+  return graph;
+}
+
+/****************************************************************************
+  Forget the costs between the regions.
+****************************************************************************/
+static void pf_region_graph_clear_distances(struct pf_region_graph *graph)
+{
+  int i;
+
+  for (i = 0; i < graph->distances_size; i++) {
+    if (NULL != graph->distances[i]) {
+      free(graph->distances[i]);
+      graph->distances[i] = NULL;
+    }
+  }
+}
+
+/****************************************************************************
+  Free a graph.
+****************************************************************************/
+static void pf_region_graph_destroy(struct pf_region_graph *graph)
+{
+  int i;
+
+  for (i = 0; i < graph->regions_num; i++) {
+    if (-1 != graph->regions[i].sector) {
+      free(graph->regions[i].links);
+    }
+  }
+  pf_region_graph_clear_distances(graph);
+  if (NULL != graph->distances) {
+    free(graph->distances);
+  }
+  free(graph->regions);
+  free(graph->free_slots);
+  free(graph->dirty_sectors);
+  free(graph->tile_region);
+  free(graph->scratch);
+  free(graph);
+}
+
+/****************************************************************************
+  Returns a new region slot.
+****************************************************************************/
+static int pf_region_new(struct pf_region_graph *graph, int sector)
+{
+  struct pf_region *pregion;
+  int region;
+
+  if (0 < graph->free_num) {
+    region = graph->free_slots[--graph->free_num];
+  } else {
+    if (graph->regions_num >= graph->regions_size) {
+      graph->regions_size *= 2;
+      graph->regions = fc_realloc(graph->regions, graph->regions_size
+                                  * sizeof(*graph->regions));
+      graph->free_slots = fc_realloc(graph->free_slots, graph->regions_size
+                                     * sizeof(*graph->free_slots));
+    }
+    region = graph->regions_num++;
+  }
+
+  pregion = graph->regions + region;
+  pregion->sector = sector;
+  pregion->center = NULL;
+  pregion->step_cost = SINGLE_MOVE;
+  pregion->links_num = 0;
+  pregion->links_size = 8;
+  pregion->links = fc_malloc(pregion->links_size * sizeof(*pregion->links));
+
+  return region;
+}
+
+/****************************************************************************
+  Remove the link from 'region' to 'target', if any.
+****************************************************************************/
+static void pf_region_unlink(struct pf_region_graph *graph, int region,
+                             int target)
+{
+  struct pf_region *pregion = graph->regions + region;
+  int i;
+
+  for (i = 0; i < pregion->links_num; i++) {
+    if (pregion->links[i].region == target) {
+      pregion->links[i] = pregion->links[--pregion->links_num];
+      return;
+    }
+  }
+}
+
+/****************************************************************************
+  Free the region slot, and the links of the other regions to it.
+****************************************************************************/
+static void pf_region_release(struct pf_region_graph *graph, int region)
+{
+  struct pf_region *pregion = graph->regions + region;
+  int i;
+
+  for (i = 0; i < pregion->links_num; i++) {
+    if (-1 != graph->regions[pregion->links[i].region].sector) {
+      pf_region_unlink(graph, pregion->links[i].region, region);
+    }
+  }
+  free(pregion->links);
+  pregion->links = NULL;
+  pregion->sector = -1;
+  graph->free_slots[graph->free_num++] = region;
+}
+
+/****************************************************************************
+  Returns TRUE if 'region' has a link to 'target'.
+****************************************************************************/
+static bool pf_region_is_linked(const struct pf_region_graph *graph,
+                                int region, int target)
+{
+  const struct pf_region *pregion = graph->regions + region;
+  int i;
+
+  for (i = 0; i < pregion->links_num; i++) {
+    if (pregion->links[i].region == target) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/****************************************************************************
+  Returns the cost to move from the center of 'from' to the center of
+  'to', only moving on the tiles of these two adjacent regions.
+****************************************************************************/
+static int pf_region_link_cost(struct pf_region_graph *graph, int from,
+                               int to)
+{
+  const struct tile *dest = graph->regions[to].center;
+  int touched[2 * PF_REGION_SECTOR_TILES];
+  int touched_num = 0;
+  int cost = FC_INFINITY;
+  struct pqueue *queue = pq_create(PF_REGION_SECTOR_TILES);
+  int index, priority, i;
+
+  index = tile_index(graph->regions[from].center);
+  graph->scratch[index] = 0;
+  touched[touched_num++] = index;
+  pq_insert(queue, index, 0);
+
+  while (pq_priority(queue, &priority) && pq_remove(queue, &index)) {
+    struct tile *ptile = index_to_tile(index);
+
+    if (-priority > graph->scratch[index]) {
+      /* Outdated entry. */
+      continue;
+    }
+    if (ptile == dest) {
+      cost = graph->scratch[index];
+      break;
+    }
+
+    adjc_iterate(ptile, adjc_tile) {
+      int adjc_index = tile_index(adjc_tile);
+      int region = graph->tile_region[adjc_index];
+      int adjc_cost;
+
+      if (region != from && region != to) {
+        continue;
+      }
+
+      adjc_cost = graph->scratch[index] + pf_region_tile_cost(adjc_tile);
+      if (-1 == graph->scratch[adjc_index]) {
+        touched[touched_num++] = adjc_index;
+      } else if (adjc_cost >= graph->scratch[adjc_index]) {
+        continue;
+      }
+      graph->scratch[adjc_index] = adjc_cost;
+      pq_insert(queue, adjc_index, -adjc_cost);
+    } adjc_iterate_end;
+  }
+
+  pq_destroy(queue);
+  for (i = 0; i < touched_num; i++) {
+    graph->scratch[touched[i]] = -1;
+  }
+
+  return cost;
+}
+
+/****************************************************************************
+  Add a link from 'region' to 'target'.
+****************************************************************************/
+static void pf_region_link(struct pf_region_graph *graph, int region,
+                           int target)
+{
+  struct pf_region *pregion = graph->regions + region;
+
+  if (pregion->links_num >= pregion->links_size) {
+    pregion->links_size *= 2;
+    pregion->links = fc_realloc(pregion->links, pregion->links_size
+                                * sizeof(*pregion->links));
+  }
+  pregion->links[pregion->links_num].region = target;
+  pregion->links[pregion->links_num].cost =
+      pf_region_link_cost(graph, region, target);
+  pregion->links_num++;
+}
+
+/****************************************************************************
+  Remove the regions of a sector.
+****************************************************************************/
+static void pf_region_sector_clear(struct pf_region_graph *graph,
+                                   int sector)
+{
+  struct tile *tiles[PF_REGION_SECTOR_TILES];
+  int tiles_num = pf_region_sector_tiles(sector, tiles);
+  int i, index;
+
+  for (i = 0; i < tiles_num; i++) {
+    index = tile_index(tiles[i]);
+    if (-1 != graph->tile_region[index]) {
+      if (-1 != graph->regions[graph->tile_region[index]].sector) {
+        pf_region_release(graph, graph->tile_region[index]);
+      }
+      graph->tile_region[index] = -1;
+    }
+  }
+}
+
+/****************************************************************************
+  Build the regions of a sector. Their new indexes are appended to
+  'new_regions'.
+****************************************************************************/
+static void pf_region_sector_build(struct pf_region_graph *graph,
+                                   int sector, int *new_regions,
+                                   int *new_regions_num)
+{
+  struct tile *tiles[PF_REGION_SECTOR_TILES];
+  struct tile *group[PF_REGION_SECTOR_TILES];
+  int tiles_num = pf_region_sector_tiles(sector, tiles);
+  int group_num, region, cost_sum, x_sum, y_sum, best_dist;
+  int nat_x, nat_y, dist, i, j;
+
+  for (i = 0; i < tiles_num; i++) {
+    if (-1 != graph->tile_region[tile_index(tiles[i])]
+        || !pf_region_passable(graph->pclass, tiles[i])) {
+      continue;
+    }
+
+    /* Flood the connected tiles of the sector. */
+    region = pf_region_new(graph, sector);
+    new_regions[(*new_regions_num)++] = region;
+    graph->tile_region[tile_index(tiles[i])] = region;
+    group[0] = tiles[i];
+    group_num = 1;
+    for (j = 0; j < group_num; j++) {
+      adjc_iterate(group[j], adjc_tile) {
+        if (-1 == graph->tile_region[tile_index(adjc_tile)]
+            && pf_region_sector(adjc_tile) == sector
+            && pf_region_passable(graph->pclass, adjc_tile)) {
+          graph->tile_region[tile_index(adjc_tile)] = region;
+          group[group_num++] = adjc_tile;
+        }
+      } adjc_iterate_end;
+    }
+
+    /* The center is the tile the nearest to the barycenter. */
+    cost_sum = x_sum = y_sum = 0;
+    for (j = 0; j < group_num; j++) {
+      index_to_native_pos(&nat_x, &nat_y, tile_index(group[j]));
+      x_sum += nat_x;
+      y_sum += nat_y;
+      cost_sum += pf_region_tile_cost(group[j]);
+    }
+    best_dist = FC_INFINITY;
+    for (j = 0; j < group_num; j++) {
+      index_to_native_pos(&nat_x, &nat_y, tile_index(group[j]));
+      dist = ((nat_x * group_num - x_sum) * (nat_x * group_num - x_sum)
+              + (nat_y * group_num - y_sum) * (nat_y * group_num - y_sum));
+      if (dist < best_dist) {
+        best_dist = dist;
+        graph->regions[region].center = group[j];
+      }
+    }
+    graph->regions[region].step_cost = cost_sum / group_num;
+  }
+}
+
+/****************************************************************************
+  Link a new region to its neighbours. The links from the neighbours which
+  are not new themselves are added too.
+****************************************************************************/
+static void pf_region_link_neighbours(struct pf_region_graph *graph,
+                                      int region, const bool *is_new)
+{
+  struct tile *tiles[PF_REGION_SECTOR_TILES];
+  int tiles_num = pf_region_sector_tiles(graph->regions[region].sector,
+                                         tiles);
+  int i, target;
+
+  for (i = 0; i < tiles_num; i++) {
+    if (graph->tile_region[tile_index(tiles[i])] != region) {
+      continue;
+    }
+
+    adjc_iterate(tiles[i], adjc_tile) {
+      target = graph->tile_region[tile_index(adjc_tile)];
+      if (-1 == target || region == target
+          || pf_region_is_linked(graph, region, target)) {
+        continue;
+      }
+
+      pf_region_link(graph, region, target);
+      if (!is_new[target]) {
+        pf_region_link(graph, target, region);
+      }
+    } adjc_iterate_end;
+  }
+}
+
+/****************************************************************************
+  Build again the dirty sectors of the graph.
+****************************************************************************/
+static void pf_region_graph_update(struct pf_region_graph *graph)
+{
+  int sectors_num = PF_REGION_SECTORS_X * PF_REGION_SECTORS_Y;
+  int new_regions_size = PF_REGION_SECTOR_TILES;
+  int *new_regions = fc_malloc(new_regions_size * sizeof(*new_regions));
+  int new_regions_num = 0;
+  bool *is_new;
+  int sector, i;
+
+  for (sector = 0; sector < sectors_num; sector++) {
+    if (graph->dirty_sectors[sector]) {
+      pf_region_sector_clear(graph, sector);
+    }
+  }
+
+  for (sector = 0; sector < sectors_num; sector++) {
+    if (!graph->dirty_sectors[sector]) {
+      continue;
+    }
+    if (new_regions_num + PF_REGION_SECTOR_TILES > new_regions_size) {
+      new_regions_size *= 2;
+      new_regions = fc_realloc(new_regions,
+                               new_regions_size * sizeof(*new_regions));
+    }
+    pf_region_sector_build(graph, sector, new_regions, &new_regions_num);
+    graph->dirty_sectors[sector] = FALSE;
+  }
+
+  is_new = fc_calloc(graph->regions_num, sizeof(*is_new));
+  for (i = 0; i < new_regions_num; i++) {
+    is_new[new_regions[i]] = TRUE;
+  }
+  for (i = 0; i < new_regions_num; i++) {
+    pf_region_link_neighbours(graph, new_regions[i], is_new);
+  }
+  free(is_new);
+  free(new_regions);
+
+  pf_region_graph_clear_distances(graph);
+  if (graph->distances_size < graph->regions_size) {
+    graph->distances = fc_realloc(graph->distances, graph->regions_size
+                                  * sizeof(*graph->distances));
+    for (i = graph->distances_size; i < graph->regions_size; i++) {
+      graph->distances[i] = NULL;
+    }
+    graph->distances_size = graph->regions_size;
+  }
+  graph->dirty = FALSE;
+
+  log_debug("PF regions: %d regions for the class %s.",
+            graph->regions_num - graph->free_num,
+            uclass_rule_name(graph->pclass));
+}
+
+/****************************************************************************
+  Returns the up to date graph of the unit class.
+****************************************************************************/
+static struct pf_region_graph *
+pf_region_graph_get(const struct unit_class *pclass)
+{
+  struct pf_region_graph **pgraph = pf_region_graphs + uclass_index(pclass);
+
+  if (NULL != *pgraph && (*pgraph)->tiles_num != MAP_INDEX_SIZE) {
+    /* The map changed. */
+    pf_region_graph_destroy(*pgraph);
+    *pgraph = NULL;
+  }
+  if (NULL == *pgraph) {
+    *pgraph = pf_region_graph_new(pclass);
+  }
+  if ((*pgraph)->dirty) {
+    pf_region_graph_update(*pgraph);
+  }
+  return *pgraph;
+}
+
+/****************************************************************************
+  Returns the costs from the center of the region to the centers of all
+  the others, FC_INFINITY when there is no way.
+****************************************************************************/
+static const int *pf_region_distances(struct pf_region_graph *graph,
+                                      int source)
+{
+  struct pqueue *queue;
+  int *distances;
+  int region, priority, i;
+
+  if (NULL != graph->distances[source]) {
+    return graph->distances[source];
+  }
+
+  distances = fc_malloc(graph->regions_num * sizeof(*distances));
+  for (i = 0; i < graph->regions_num; i++) {
+    distances[i] = FC_INFINITY;
+  }
+  distances[source] = 0;
+
+  queue = pq_create(graph->regions_num);
+  pq_insert(queue, source, 0);
+  while (pq_priority(queue, &priority) && pq_remove(queue, &region)) {
+    const struct pf_region *pregion = graph->regions + region;
+
+    if (-priority > distances[region]) {
+      /* Outdated entry. */
+      continue;
+    }
+
+    for (i = 0; i < pregion->links_num; i++) {
+      const struct pf_region_link *plink = pregion->links + i;
+      int cost;
+
+      if (FC_INFINITY == plink->cost) {
+        continue;
+      }
+      cost = distances[region] + plink->cost;
+      if (cost < distances[plink->region]) {
+        distances[plink->region] = cost;
+        pq_insert(queue, plink->region, -cost);
+      }
+    }
+  }
+  pq_destroy(queue);
+
+  graph->distances[source] = distances;
+  return distances;
+}
+
+/****************************************************************************
+  Returns TRUE if a unit of the class could go from 'src_tile' to
+  'dest_tile' on its own, considering only the terrain, the extras and
+  the cities. Both tiles must be native to the class.
+****************************************************************************/
+bool pf_regions_reachable(const struct unit_class *pclass,
+                          const struct tile *src_tile,
+                          const struct tile *dest_tile)
+{
+  struct pf_region_graph *graph = pf_region_graph_get(pclass);
+  int from = graph->tile_region[tile_index(src_tile)];
+  int to = graph->tile_region[tile_index(dest_tile)];
+
+  if (-1 == from || -1 == to) {
+    return FALSE;
+  }
+  return (from == to
+          || FC_INFINITY != pf_region_distances(graph, from)[to]);
+}
+
+/****************************************************************************
+  Returns an approximation of the move cost from 'src_tile' to 'dest_tile'
+  for a unit of the class, or PF_IMPOSSIBLE_MC if it cannot go there on
+  its own (see pf_regions_reachable()). Roads, rivers, units and unit type
+  flags are not considered.
+****************************************************************************/
+int pf_regions_move_cost(const struct unit_class *pclass,
+                         const struct tile *src_tile,
+                         const struct tile *dest_tile)
+{
+  struct pf_region_graph *graph = pf_region_graph_get(pclass);
+  int from = graph->tile_region[tile_index(src_tile)];
+  int to = graph->tile_region[tile_index(dest_tile)];
+  const struct pf_region *pfrom, *pto;
+  int cost;
+
+  if (-1 == from || -1 == to) {
+    return PF_IMPOSSIBLE_MC;
+  }
+
+  pfrom = graph->regions + from;
+  if (from == to) {
+    return real_map_distance(src_tile, dest_tile) * pfrom->step_cost;
+  }
+
+  cost = pf_region_distances(graph, from)[to];
+  if (FC_INFINITY == cost) {
+    return PF_IMPOSSIBLE_MC;
+  }
+
+  pto = graph->regions + to;
+  return (real_map_distance(src_tile, pfrom->center) * pfrom->step_cost
+          + cost
+          + real_map_distance(pto->center, dest_tile) * pto->step_cost);
+}
+
+/****************************************************************************
+  Returns an approximation of the number of turns needed to reach
+  'dest_tile' with the parameter, or FC_INFINITY if impossible. See
+  pf_regions_move_cost().
+****************************************************************************/
+int pf_regions_turns(const struct pf_parameter *parameter,
+                     const struct tile *dest_tile)
+{
+  int cost = pf_regions_move_cost(utype_class(parameter->utype),
+                                  parameter->start_tile, dest_tile);
+
+  if (PF_IMPOSSIBLE_MC == cost) {
+    return FC_INFINITY;
+  } else if (cost <= parameter->moves_left_initially) {
+    return 0;
+  } else if (0 >= parameter->move_rate) {
+    return FC_INFINITY;
+  }
+  return ((cost - parameter->moves_left_initially + parameter->move_rate - 1)
+          / parameter->move_rate);
+}
+
+/****************************************************************************
+  The terrain, the extras or the city of the tile changed. The sectors of
+  the tile and its neighbours (as the cities depend on the adjacent
+  tiles) will be built again.
+****************************************************************************/
+void pf_regions_tile_changed(const struct tile *ptile)
+{
+  int i;
+
+  for (i = 0; i < UCL_LAST; i++) {
+    struct pf_region_graph *graph = pf_region_graphs[i];
+
+    if (NULL == graph || graph->tiles_num != MAP_INDEX_SIZE) {
+      continue;
+    }
+
+    graph->dirty_sectors[pf_region_sector(ptile)] = TRUE;
+    adjc_iterate(ptile, adjc_tile) {
+      graph->dirty_sectors[pf_region_sector(adjc_tile)] = TRUE;
+    } adjc_iterate_end;
+    graph->dirty = TRUE;
+  }
+}
+
+/****************************************************************************
+  Free all the region graphs.
+****************************************************************************/
+void pf_regions_free(void)
+{
+  int i;
+
+  for (i = 0; i < UCL_LAST; i++) {
+    if (NULL != pf_region_graphs[i]) {
+      pf_region_graph_destroy(pf_region_graphs[i]);
+      pf_region_graphs[i] = NULL;
+    }
+  }
+}
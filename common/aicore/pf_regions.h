@@ -0,0 +1,63 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+#ifndef FC__PF_REGIONS_H
+#define FC__PF_REGIONS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* common */
+#include "fc_types.h"
+
+/* common/aicore */
+#include "path_finding.h"
+
+/*
+ * Coarse view of the map for long-distance estimations.
+ *
+ * The map is cut into square sectors. Inside a sector, the connected
+ * groups of tiles a unit class can move on form the regions (a piece of
+ * a continent or of an ocean). Two regions are linked when some of their
+ * tiles are adjacent, with the cost to move from the center of one to
+ * the center of the other. There is one such graph per unit class,
+ * created the first time it is needed.
+ *
+ * The costs only consider the terrain (no road, no river, no unit), and
+ * the regions are known with full knowledge of the map. It is meant for
+ * the AI to estimate quickly if and how far a destination is, before
+ * computing a real path with a pf_map if needed.
+ *
+ * The server must call pf_regions_tile_changed() when the terrain or
+ * the extras of a tile change, or when a city is built or destroyed.
+ * Only the sector of the tile is updated, the next time the graph is
+ * used.
+ */
+
+bool pf_regions_reachable(const struct unit_class *pclass,
+                          const struct tile *src_tile,
+                          const struct tile *dest_tile);
+int pf_regions_move_cost(const struct unit_class *pclass,
+                         const struct tile *src_tile,
+                         const struct tile *dest_tile);
+int pf_regions_turns(const struct pf_parameter *parameter,
+                     const struct tile *dest_tile);
+
+void pf_regions_tile_changed(const struct tile *ptile);
+void pf_regions_free(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FC__PF_REGIONS_H */
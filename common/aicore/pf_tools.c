@@ -25,8 +25,12 @@
 /* common */
 #include "base.h"
 #include "combat.h"
+#include "extras.h"
 #include "game.h"
+#include "map.h"
 #include "movement.h"
+#include "road.h"
+#include "terrain.h"
 #include "tile.h"
 #include "unit.h"
 #include "unittype.h"
@@ -607,6 +611,9 @@ pft_fill_default_parameter(struct pf_parameter *parameter,
   parameter->get_action = NULL;
   parameter->is_action_possible = NULL;
   parameter->actions = PF_AA_NONE;
+  parameter->goal_tile = NULL;
+  parameter->goal_min_MC = 0;
+  parameter->data = NULL;
 
   parameter->utype = punittype;
 }
@@ -891,6 +898,88 @@ void pft_fill_amphibious_parameter(struct pft_amphibious *parameter)
   parameter->combined.data = parameter;
 }
 
+/****************************************************************************
+  Returns the minimal cost of a single step of the unit type, as it could
+  be returned by map_move_cost() with the roads currently built on the map.
+
+  Most rulesets have roads without any move cost (railroads), so only the
+  road types which really exist somewhere on the map are considered. The
+  number of tiles having each road is kept up to date by the
+  pf_map_tile_changed() notifications, so the map itself is not scanned.
+  This is the map the path-finding runs on, so a road the player doesn't
+  know about still counts: the estimate must never be above the real cost.
+****************************************************************************/
+static int pft_utype_min_move_cost(const struct unit_type *punittype)
+{
+  const struct unit_class *pclass = utype_class(punittype);
+  int min_cost = SINGLE_MOVE;
+
+  if (!uclass_has_flag(pclass, UCF_TERRAIN_SPEED)) {
+    /* Constant cost. */
+    return SINGLE_MOVE;
+  }
+
+  if (utype_has_flag(punittype, UTYF_IGTER)) {
+    min_cost = MIN(min_cost, MOVE_COST_IGTER);
+  }
+
+  terrain_type_iterate(pterrain) {
+    /* Terrains can be made native by extras, e.g. by bases for ships. */
+    if (BV_ISSET(pterrain->native_to, uclass_index(pclass))
+        || 0 < extra_type_list_size(pclass->cache.native_tile_extras)) {
+      min_cost = MIN(min_cost, pterrain->movement_cost * SINGLE_MOVE);
+    }
+  } terrain_type_iterate_end;
+
+  road_type_iterate(proad) {
+    struct extra_type *pextra = road_extra_get(proad);
+
+    if (road_provides_move_bonus(proad)
+        && proad->move_cost < min_cost
+        && is_native_extra_to_uclass(pextra, pclass)
+        && 0 < pf_map_extra_tiles(pextra)) {
+      min_cost = proad->move_cost;
+    }
+  } road_type_iterate_end;
+
+  return MAX(min_cost, 0);
+}
+
+/****************************************************************************
+  Returns the minimal MC the 'get_MC' callback of the parameter can return
+  for a single step, or 0 if we don't know it.
+****************************************************************************/
+static int pft_min_move_cost(const struct pf_parameter *parameter)
+{
+  if (parameter->get_MC == normal_move
+      || parameter->get_MC == overlap_move) {
+    return pft_utype_min_move_cost(parameter->utype);
+  } else if (parameter->get_MC == amphibious_move) {
+    const struct pft_amphibious *amphibious = parameter->data;
+
+    return MIN(amphibious->land_scale
+               * pft_min_move_cost(&amphibious->land),
+               amphibious->sea_scale
+               * pft_min_move_cost(&amphibious->sea));
+  }
+
+  /* Unknown callback. */
+  return 0;
+}
+
+/****************************************************************************
+  Direct the search towards 'ptile', for the maps which will be used to
+  find the path to a single destination. See 'goal_tile' in the
+  pf_parameter. This must be called after all the callbacks have been set.
+  For the move cost callbacks not defined here, the search stays
+  undirected.
+****************************************************************************/
+void pft_fill_goal(struct pf_parameter *parameter, struct tile *ptile)
+{
+  parameter->goal_tile = ptile;
+  parameter->goal_min_MC = pft_min_move_cost(parameter);
+}
+
 /**********************************************************************
   Concatenate two paths together.  The additional segment (src_path)
   should start where the initial segment (dest_path) stops.  The
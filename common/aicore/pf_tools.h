@@ -64,6 +64,8 @@ void pft_fill_utype_attack_param(struct pf_parameter *parameter,
                                  struct player *pplayer);
 
 void pft_fill_amphibious_parameter(struct pft_amphibious *parameter);
+void pft_fill_goal(struct pf_parameter *parameter, struct tile *ptile);
+
 enum tile_behavior no_fights_or_unknown(const struct tile *ptile,
                                         enum known_type known,
                                         const struct pf_parameter *param);
@@ -17,8 +17,23 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/* Optional compression methods of the network stream, see
+ * common/packets.c. */
+#ifdef HAVE_LIBZSTD
+#define NETWORK_CAPSTRING_ZSTD " compress-zstd"
+#else
+#define NETWORK_CAPSTRING_ZSTD ""
+#endif
+#ifdef HAVE_LIBLZ4
+#define NETWORK_CAPSTRING_LZ4 " compress-lz4"
+#else
+#define NETWORK_CAPSTRING_LZ4 ""
+#endif
+
 #define NETWORK_CAPSTRING (NETWORK_CAPSTRING_MANDATORY " "	\
-			   NETWORK_CAPSTRING_OPTIONAL)
+			   NETWORK_CAPSTRING_OPTIONAL		\
+			   NETWORK_CAPSTRING_ZSTD			\
+			   NETWORK_CAPSTRING_LZ4)
 
 extern const char * const our_capability;
 
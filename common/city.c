@@ -2760,26 +2760,24 @@ static inline void city_support(struct city *pcity)
 }
 
 /**************************************************************************
-  Refreshes the internal cached data in the city structure.
-
-  !full_refresh will not update tile_cache[] or bonus[].  These two
-  values do not need to be recalculated for AI CMA testing.
+  Refreshes the parts of the internal cached data in the city structure
+  which depend on what changed. 'dirty' is a bitmask of enum city_dirty.
+  See also city_refresh_from_main_map().
 
   'workers_map' is an boolean array which defines the placement of the
   workers within the city map. It uses the tile index and its size is
   defined by city_map_tiles_from_city(_pcity). See also cm_state_init().
-
-  If 'workers_map' is set, only basic updates are needed.
 **************************************************************************/
-void city_refresh_from_main_map(struct city *pcity, bool *workers_map)
+static void city_refresh_parts(struct city *pcity, bool *workers_map,
+                               int dirty)
 {
-  if (workers_map == NULL) {
-    /* do a full refresh */
-
+  if (dirty & (CD_TILES | CD_BUILDINGS)) {
     /* Calculate the bonus[] array values. */
     set_city_bonuses(pcity);
     /* Calculate the tile_cache[] values. */
     city_tile_cache_update(pcity);
+  }
+  if (dirty & (CD_UNITS | CD_BUILDINGS)) {
     /* manage settlers, and units */
     city_support(pcity);
   }
@@ -2813,6 +2811,35 @@ void city_refresh_from_main_map(struct city *pcity, bool *workers_map)
   set_surpluses(pcity);
 }
 
+/**************************************************************************
+  Refreshes the internal cached data in the city structure.
+
+  !full_refresh will not update tile_cache[] or bonus[].  These two
+  values do not need to be recalculated for AI CMA testing.
+
+  'workers_map' is an boolean array which defines the placement of the
+  workers within the city map. It uses the tile index and its size is
+  defined by city_map_tiles_from_city(_pcity). See also cm_state_init().
+
+  If 'workers_map' is set, only basic updates are needed.
+**************************************************************************/
+void city_refresh_from_main_map(struct city *pcity, bool *workers_map)
+{
+  city_refresh_parts(pcity, workers_map,
+                     NULL == workers_map ? CD_BUILDINGS : CD_WORKERS);
+}
+
+/**************************************************************************
+  Refreshes the internal cached data in the city structure after only
+  the changes in 'dirty', a bitmask of enum city_dirty. The result is the
+  same as a full city_refresh_from_main_map(), if nothing else changed
+  since the last refresh.
+**************************************************************************/
+void city_refresh_dirty_from_main_map(struct city *pcity, int dirty)
+{
+  city_refresh_parts(pcity, NULL, dirty);
+}
+
 /**************************************************************************
   Give corruption/waste generated by city.  otype gives the output type
   (O_SHIELD/O_TRADE).  'total' gives the total output of this type in the
@@ -2961,6 +2988,7 @@ void city_add_improvement(struct city *pcity,
 			  const struct impr_type *pimprove)
 {
   pcity->built[improvement_index(pimprove)].turn = game.info.turn; /*I_ACTIVE*/
+  effect_cache_buildings_changed(pcity->effect_cache);
 
   if (is_server() && is_wonder(pimprove)) {
     /* Client just read the info from the packets. */
@@ -2978,6 +3006,7 @@ void city_remove_improvement(struct city *pcity,
             improvement_rule_name(pimprove), pcity->name);
   
   pcity->built[improvement_index(pimprove)].turn = I_DESTROYED;
+  effect_cache_buildings_changed(pcity->effect_cache);
 
   if (is_server() && is_wonder(pimprove)) {
     /* Client just read the info from the packets. */
@@ -3109,6 +3138,7 @@ void destroy_city_virtual(struct city *pcity)
   if (pcity->tile_cache != NULL) {
     free(pcity->tile_cache);
   }
+  effect_cache_destroy(pcity->effect_cache);
 
   if (!is_server()) {
     unit_list_destroy(pcity->client.info_units_supported);
@@ -289,6 +289,20 @@ enum city_updates {
   CU_POPUP_DIALOG       = 1 << 2
 };
 
+/* What changed in a city since it was last refreshed. Each one needs only
+ * a part of city_refresh_from_main_map() to be redone, see
+ * city_refresh_dirty_from_main_map(). CD_UNITS does not recompute the
+ * effects of the city, so when effects require a number of units on a
+ * tile (MaxUnitsOnTile) the server does a full refresh instead, see
+ * city_refresh_partial(). */
+enum city_dirty {
+  CD_WORKERS            = 1 << 0, /* worked tiles or specialists */
+  CD_RATES              = 1 << 1, /* tax rates of the owner */
+  CD_UNITS              = 1 << 2, /* units supported or in the city */
+  CD_TILES              = 1 << 3, /* tiles of the city map */
+  CD_BUILDINGS          = 1 << 4  /* buildings or anything else */
+};
+
 /* See city_build_here_test(). */
 enum city_build_result {
   CB_OK,
@@ -299,6 +313,7 @@ enum city_build_result {
 };
 
 struct tile_cache; /* defined and only used within city.c */
+struct effect_cache; /* defined and only used within effects.c */
 
 struct adv_city; /* defined in ./server/advisors/infracache.h */
 
@@ -333,6 +348,9 @@ struct city {
    * radius. */
   int tile_cache_radius_sq;
 
+  /* Cache of the city effect values (see get_city_bonus()). */
+  struct effect_cache *effect_cache;
+
   /* the productions */
   int surplus[O_LAST]; /* Final surplus in each category. */
   int waste[O_LAST]; /* Waste/corruption in each category. */
@@ -410,6 +428,10 @@ struct city {
        * Set inside city_refresh() and city_refresh_queue_add(). */
       bool needs_refresh;
 
+      /* What changed, if city needs only a partial refresh at a later
+       * time. Set inside city_refresh_queue_add_dirty(). */
+      int refresh_dirty;
+
       /* the city map is synced with the client. */
       bool synced;
 
@@ -672,6 +694,7 @@ void city_remove_improvement(struct city *pcity,
 
 /* city update functions */
 void city_refresh_from_main_map(struct city *pcity, bool *workers_map);
+void city_refresh_dirty_from_main_map(struct city *pcity, int dirty);
 
 int city_waste(const struct city *pcity, Output_type_id otype, int total,
                int *breakdown);
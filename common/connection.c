@@ -158,30 +158,174 @@ int read_socket_data(int sock, struct socket_packet_buffer *buffer)
   return -1;
 }
 
+/* Size of the chunks of the send buffers. A reservation bigger than that
+ * gets a chunk of its own. */
+#define SEND_CHUNK_SIZE (16 * MAX_LEN_PACKET)
+
+/* Max number of chunks written to the socket in one call. */
+#define MAX_SEND_CHUNKS FC_MAX_IOVEC
+
+struct send_chunk {
+  struct send_chunk *next;
+  int start;                    /* First byte not sent yet. */
+  int end;                      /* End of the data. */
+  int capacity;
+  unsigned char *data;
+};
+
+/**************************************************************************
+  Return a chunk of at least 'size' bytes, reusing the spare one when
+  possible.
+**************************************************************************/
+static struct send_chunk *send_chunk_new(struct socket_send_buffer *buf,
+                                         int size)
+{
+  struct send_chunk *chunk;
+
+  if (NULL != buf->spare && buf->spare->capacity >= size) {
+    chunk = buf->spare;
+    buf->spare = NULL;
+  } else {
+    int capacity = MAX(size, SEND_CHUNK_SIZE);
+
+    chunk = fc_malloc(sizeof(*chunk) + capacity);
+    chunk->capacity = capacity;
+    chunk->data = (unsigned char *) (chunk + 1);
+    buf->nsize += capacity;
+  }
+
+  chunk->next = NULL;
+  chunk->start = 0;
+  chunk->end = 0;
+  return chunk;
+}
+
+/**************************************************************************
+  Keep a drained chunk as the spare one, or free it.
+**************************************************************************/
+static void send_chunk_release(struct socket_send_buffer *buf,
+                               struct send_chunk *chunk)
+{
+  if (NULL == buf->spare && SEND_CHUNK_SIZE == chunk->capacity) {
+    buf->spare = chunk;
+  } else {
+    buf->nsize -= chunk->capacity;
+    free(chunk);
+  }
+}
+
+/**************************************************************************
+  Make sure the tail chunk has at least 'size' contiguous free bytes, and
+  return them. They are part of the data only after send_buffer_commit().
+**************************************************************************/
+static unsigned char *send_buffer_reserve(struct socket_send_buffer *buf,
+                                          int size)
+{
+  struct send_chunk *tail = buf->tail;
+
+  if (NULL != tail && tail->start == tail->end) {
+    /* Everything was sent; the chain is this chunk alone. */
+    fc_assert(buf->head == tail);
+    if (tail->capacity >= size) {
+      tail->start = tail->end = 0;
+    } else {
+      send_chunk_release(buf, tail);
+      buf->head = buf->tail = tail = NULL;
+    }
+  }
+
+  if (NULL == tail || tail->capacity - tail->end < size) {
+    struct send_chunk *chunk = send_chunk_new(buf, size);
+
+    if (NULL == tail) {
+      buf->head = chunk;
+    } else {
+      tail->next = chunk;
+    }
+    buf->tail = tail = chunk;
+  }
+
+  return tail->data + tail->end;
+}
+
+/**************************************************************************
+  Returns whether the 'len' bytes of 'data' were written in place by the
+  caller of send_buffer_reserve().
+**************************************************************************/
+static bool send_buffer_is_reserved(const struct socket_send_buffer *buf,
+                                    const unsigned char *data, int len)
+{
+  return (NULL != buf->tail
+          && data == buf->tail->data + buf->tail->end
+          && len <= buf->tail->capacity - buf->tail->end);
+}
+
+/**************************************************************************
+  Append 'len' bytes written in the space returned by send_buffer_reserve()
+  to the data.
+**************************************************************************/
+static void send_buffer_commit(struct socket_send_buffer *buf, int len)
+{
+  buf->tail->end += len;
+  buf->ndata += len;
+}
+
+/**************************************************************************
+  Copy 'len' bytes of 'data' at the end of the chain, filling the free
+  space of the tail chunk first.
+**************************************************************************/
+static void send_buffer_append(struct socket_send_buffer *buf,
+                               const unsigned char *data, int len)
+{
+  while (0 < len) {
+    unsigned char *dest = send_buffer_reserve(buf, 1);
+    int n = MIN(len, buf->tail->capacity - buf->tail->end);
+
+    memcpy(dest, data, n);
+    send_buffer_commit(buf, n);
+    data += n;
+    len -= n;
+  }
+}
+
+/**************************************************************************
+  Drop the first 'len' bytes of the chain, which were sent.
+**************************************************************************/
+static void send_buffer_consume(struct socket_send_buffer *buf, int len)
+{
+  buf->ndata -= len;
+  while (0 < len || (buf->head != buf->tail
+                     && buf->head->start == buf->head->end)) {
+    struct send_chunk *head = buf->head;
+    int n = MIN(len, head->end - head->start);
+
+    head->start += n;
+    len -= n;
+    if (head->start == head->end && head != buf->tail) {
+      buf->head = head->next;
+      send_chunk_release(buf, head);
+    }
+  }
+}
+
 /**************************************************************************
   write wrapper function -vasc
 **************************************************************************/
 static int write_socket_data(struct connection *pc,
-			     struct socket_packet_buffer *buf, int limit)
+                             struct socket_send_buffer *buf, int limit)
 {
-  int start, nput, nblock;
+  /* The client socket is blocking; don't try to write too much at once. */
+  int max_block = (is_server() ? MAX_LEN_BUFFER : MAX_LEN_PACKET);
+  int written = 0;
 
   if (is_server() && pc->server.is_closing) {
     return 0;
   }
 
-  for (start=0; buf->ndata-start>limit;) {
-    fd_set writefs, exceptfs;
-    struct timeval tv;
-
-    FC_FD_ZERO(&writefs);
-    FC_FD_ZERO(&exceptfs);
-    FD_SET(pc->sock, &writefs);
-    FD_SET(pc->sock, &exceptfs);
-
-    tv.tv_sec = 0; tv.tv_usec = 0;
+  while (buf->ndata > limit) {
+    int ready = fc_socket_ready(pc->sock, FC_POLL_WRITE | FC_POLL_EXCEPT);
 
-    if (fc_select(pc->sock+1, NULL, &writefs, &exceptfs, &tv) <= 0) {
+    if (ready <= 0) {
       if (errno != EINTR) {
 	break;
       } else {
@@ -191,16 +335,32 @@ static int write_socket_data(struct connection *pc,
       }
     }
 
-    if (FD_ISSET(pc->sock, &exceptfs)) {
+    if (ready & FC_POLL_EXCEPT) {
       connection_close(pc, _("network exception"));
       return -1;
     }
 
-    if (FD_ISSET(pc->sock, &writefs)) {
-      nblock=MIN(buf->ndata-start, MAX_LEN_PACKET);
-      log_debug("trying to write %d limit=%d", nblock, limit);
-      if((nput=fc_writesocket(pc->sock, 
-			      (const char *)buf->data+start, nblock)) == -1) {
+    if (ready & FC_POLL_WRITE) {
+      struct fc_iovec iov[MAX_SEND_CHUNKS];
+      const struct send_chunk *chunk;
+      int niov = 0, nblock = 0, nput;
+
+      for (chunk = buf->head;
+           NULL != chunk && niov < MAX_SEND_CHUNKS && nblock < max_block;
+           chunk = chunk->next) {
+        int n = MIN(chunk->end - chunk->start, max_block - nblock);
+
+        if (0 < n) {
+          iov[niov].base = chunk->data + chunk->start;
+          iov[niov].len = n;
+          niov++;
+          nblock += n;
+        }
+      }
+
+      log_debug("trying to write %d in %d chunks limit=%d",
+                nblock, niov, limit);
+      if ((nput = fc_writevsocket(pc->sock, iov, niov)) == -1) {
 #ifdef NONBLOCKING_SOCKETS
 	if (errno == EWOULDBLOCK || errno == EAGAIN) {
 	  break;
@@ -209,13 +369,12 @@ static int write_socket_data(struct connection *pc,
         connection_close(pc, _("lagging connection"));
         return -1;
       }
-      start += nput;
+      send_buffer_consume(buf, nput);
+      written += nput;
     }
   }
 
-  if (start > 0) {
-    buf->ndata -= start;
-    memmove(buf->data, buf->data+start, buf->ndata);
+  if (written > 0) {
     pc->last_write = timer_renew(pc->last_write, TIMER_USER, TIMER_ACTIVE);
     timer_start(pc->last_write);
   }
@@ -252,12 +411,13 @@ static void flush_connection_send_buffer_packets(struct connection *pc)
 }
 
 /****************************************************************************
-  Add data to send to the connection.
+  Add data to send to the connection. The data is copied, unless it was
+  encoded in place at the end of the send buffer.
 ****************************************************************************/
 static bool add_connection_data(struct connection *pconn,
                                 const unsigned char *data, int len)
 {
-  struct socket_packet_buffer *buf;
+  struct socket_send_buffer *buf;
 
   if (NULL == pconn
       || !pconn->used
@@ -267,13 +427,17 @@ static bool add_connection_data(struct connection *pconn,
 
   buf = pconn->send_buffer;
   log_debug("add %d bytes to %d (space =%d)", len, buf->ndata, buf->nsize);
-  if (!buffer_ensure_free_extra_space(buf, len)) {
+  /* Don't gobble up too much mem. */
+  if (buf->ndata + len > MAX_LEN_BUFFER) {
     connection_close(pconn, _("buffer overflow"));
     return FALSE;
   }
 
-  memcpy(buf->data + buf->ndata, data, len);
-  buf->ndata += len;
+  if (send_buffer_is_reserved(buf, data, len)) {
+    send_buffer_commit(buf, len);
+  } else {
+    send_buffer_append(buf, data, len);
+  }
   return TRUE;
 }
 
@@ -310,6 +474,24 @@ bool connection_send_data(struct connection *pconn,
   return TRUE;
 }
 
+/****************************************************************************
+  Return 'size' contiguous bytes at the end of the send buffer of the
+  connection, where data can be written in place before being passed to
+  connection_send_data(); it won't be copied then. Nothing else may be
+  sent to the connection in between. Returns NULL if the connection can't
+  send.
+****************************************************************************/
+unsigned char *connection_send_reserve(struct connection *pconn, int size)
+{
+  if (NULL == pconn
+      || !pconn->used
+      || (is_server() && pconn->server.is_closing)) {
+    return NULL;
+  }
+
+  return send_buffer_reserve(pconn->send_buffer, size);
+}
+
 /**************************************************************************
   Turn on buffering, using a counter so that calls may be nested.
 **************************************************************************/
@@ -444,6 +626,41 @@ static void free_socket_packet_buffer(struct socket_packet_buffer *buf)
   }
 }
 
+/**************************************************************************
+  Return malloced send buffer, without chunks yet.
+**************************************************************************/
+static struct socket_send_buffer *new_socket_send_buffer(void)
+{
+  struct socket_send_buffer *buf = fc_malloc(sizeof(*buf));
+
+  buf->ndata = 0;
+  buf->do_buffer_sends = 0;
+  buf->nsize = 0;
+  buf->head = NULL;
+  buf->tail = NULL;
+  buf->spare = NULL;
+  return buf;
+}
+
+/**************************************************************************
+  Free malloced send buffer, with its chunks.
+**************************************************************************/
+static void free_socket_send_buffer(struct socket_send_buffer *buf)
+{
+  if (buf) {
+    while (NULL != buf->head) {
+      struct send_chunk *chunk = buf->head;
+
+      buf->head = chunk->next;
+      free(chunk);
+    }
+    if (NULL != buf->spare) {
+      free(buf->spare);
+    }
+    free(buf);
+  }
+}
+
 /**************************************************************************
   Return pointer to static string containing a description for this
   connection, based on pconn->name, pconn->addr, and (if applicable)
@@ -523,10 +740,31 @@ int get_next_request_id(int old_request_id)
 void free_compression_queue(struct connection *pc)
 {
 #ifdef USE_COMPRESSION
+  conn_compression_free(pc);
   byte_vector_free(&pc->compression.queue);
 #endif
 }
 
+/**************************************************************************
+  Free the batch of the given connection, with the packets not sent yet.
+**************************************************************************/
+static void free_batch(struct connection *pc)
+{
+  if (NULL != pc->batch.staged) {
+    genhash_destroy(pc->batch.staged);
+    pc->batch.staged = NULL;
+  }
+  if (NULL != pc->batch.entries) {
+    conn_batch_entry_list_destroy(pc->batch.entries);
+    pc->batch.entries = NULL;
+  }
+  pc->batch.level = 0;
+  pc->batch.capture = NULL;
+  pc->batch.size = 0;
+  pc->batch.serial = 0;
+  pc->batch.put_serial = 0;
+}
+
 /**************************************************************************
   Allocate and initialize packet hashs for given connection.
 **************************************************************************/
@@ -590,7 +828,7 @@ void connection_common_init(struct connection *pconn)
   pconn->closing_reason = NULL;
   pconn->last_write = NULL;
   pconn->buffer = new_socket_packet_buffer();
-  pconn->send_buffer = new_socket_packet_buffer();
+  pconn->send_buffer = new_socket_send_buffer();
   pconn->statistics.bytes_send = 0;
 
   init_packet_hashs(pconn);
@@ -598,7 +836,23 @@ void connection_common_init(struct connection *pconn)
 #ifdef USE_COMPRESSION
   byte_vector_init(&pconn->compression.queue);
   pconn->compression.frozen_level = 0;
+  pconn->compression.method = COMPRESS_UNKNOWN;
+  pconn->compression.compressor = NULL;
+  pconn->compression.decompressor = NULL;
+  pconn->compression.size_alone = 0;
+  pconn->compression.size_uncompressed = 0;
+  pconn->compression.size_compressed = 0;
+  pconn->compression.size_no_compression = 0;
 #endif
+
+  pconn->batch.level = 0;
+  pconn->batch.flushing = FALSE;
+  pconn->batch.capture = NULL;
+  pconn->batch.size = 0;
+  pconn->batch.serial = 0;
+  pconn->batch.put_serial = 0;
+  pconn->batch.entries = NULL;
+  pconn->batch.staged = NULL;
 }
 
 /**************************************************************************
@@ -619,7 +873,7 @@ void connection_common_close(struct connection *pconn)
     free_socket_packet_buffer(pconn->buffer);
     pconn->buffer = NULL;
 
-    free_socket_packet_buffer(pconn->send_buffer);
+    free_socket_send_buffer(pconn->send_buffer);
     pconn->send_buffer = NULL;
 
     if (pconn->last_write) {
@@ -628,6 +882,7 @@ void connection_common_close(struct connection *pconn)
     }
 
     free_compression_queue(pconn);
+    free_batch(pconn);
     free_packet_hashes(pconn);
   }
 }
@@ -640,6 +895,9 @@ void conn_reset_delta_state(struct connection *pc)
 {
   int i;
 
+  /* The batched packets have been serialized against the old state. */
+  conn_batch_flush(pc);
+
   for (i = 0; i < PACKET_LAST; i++) {
     if (packet_has_game_info_flag(i)) {
       if (NULL != pc->phs.sent && NULL != pc->phs.sent[i]) {
@@ -704,6 +962,217 @@ void conn_list_compression_thaw(const struct conn_list *pconn_list)
 #endif /* USE_COMPRESSION */
 }
 
+/****************************************************************************
+  Free a batch entry.
+****************************************************************************/
+static void conn_batch_entry_destroy(struct conn_batch_entry *pentry)
+{
+  if (NULL != pentry->packet) {
+    free(pentry->packet);
+  }
+  byte_vector_free(&pentry->data);
+  free(pentry);
+}
+
+/****************************************************************************
+  Hash function for the staged batch entries.
+****************************************************************************/
+static genhash_val_t conn_batch_entry_hash(const void *vkey)
+{
+  const struct conn_batch_entry *pentry = vkey;
+
+  return ((genhash_val_t) pentry->group << 20) ^ pentry->key;
+}
+
+/****************************************************************************
+  Comparison function for the staged batch entries.
+****************************************************************************/
+static bool conn_batch_entry_cmp(const void *vkey1, const void *vkey2)
+{
+  const struct conn_batch_entry *pentry1 = vkey1;
+  const struct conn_batch_entry *pentry2 = vkey2;
+
+  return (pentry1->group == pentry2->group
+          && pentry1->key == pentry2->key);
+}
+
+/****************************************************************************
+  Append a new entry to the batch of the connection.
+****************************************************************************/
+static struct conn_batch_entry *conn_batch_entry_new(struct connection *pc)
+{
+  struct conn_batch_entry *pentry = fc_calloc(1, sizeof(*pentry));
+
+  byte_vector_init(&pentry->data);
+  pentry->serial = ++pc->batch.serial;
+  conn_batch_entry_list_append(pc->batch.entries, pentry);
+  return pentry;
+}
+
+/****************************************************************************
+  Start a batch on the connection. Until the matching conn_batch_end(),
+  the packets sent to it are kept in order, and the packets of the
+  packets.def 'batch' groups (city and tile infos) only keep their last
+  version, at the place of the first one as long as no other packet was
+  sent since (see conn_batch_stage()). The whole batch is then sent as
+  one compressed block. Calls may be nested.
+
+  Nothing is read from the network during a batch, so the client never
+  waits for a batched packet.
+****************************************************************************/
+void conn_batch_begin(struct connection *pconn)
+{
+  if (NULL == pconn->batch.entries) {
+    pconn->batch.entries =
+        conn_batch_entry_list_new_full(conn_batch_entry_destroy);
+    pconn->batch.staged = genhash_new(conn_batch_entry_hash,
+                                      conn_batch_entry_cmp);
+  }
+  pconn->batch.level++;
+}
+
+/****************************************************************************
+  Returns TRUE if the packets sent to the connection go to its batch.
+****************************************************************************/
+bool conn_batch_active(const struct connection *pconn)
+{
+  return (0 < pconn->batch.level && !pconn->batch.flushing
+          && pconn->used);
+}
+
+/****************************************************************************
+  Stage the packet in the batch of the connection, replacing the staged
+  packet of the same group and key if any. Returns FALSE when the packet
+  must be sent now. 'send' sends the copy of the packet when the batch is
+  flushed.
+
+  A packet sent (not staged) after the staged one may depend on the state
+  it had then, e.g. a unit removed from a tile before the tile got fogged.
+  In this case, the staged packet is serialized at its place, and the new
+  one is staged after the other packets.
+****************************************************************************/
+bool conn_batch_stage(struct connection *pconn, int group, int key,
+                      const void *packet, size_t size, bool force_to_send,
+                      conn_batch_send_fn_t send)
+{
+  struct conn_batch_entry probe, *pentry;
+
+  if (!conn_batch_active(pconn) || NULL != pconn->batch.capture) {
+    return FALSE;
+  }
+
+  probe.group = group;
+  probe.key = key;
+  if (genhash_lookup(pconn->batch.staged, &probe, (void **) &pentry)
+      && pentry->serial < pconn->batch.put_serial) {
+    conn_batch_close(pconn, group, key);
+  }
+
+  if (genhash_lookup(pconn->batch.staged, &probe, (void **) &pentry)) {
+    if (pentry->packet_size != size) {
+      pentry->packet = fc_realloc(pentry->packet, size);
+      pconn->batch.size += size - pentry->packet_size;
+      pentry->packet_size = size;
+    }
+    /* Keep forcing if the replaced packet had to be forced. */
+    pentry->force_to_send = (pentry->force_to_send || force_to_send);
+  } else {
+    if (MAX_LEN_BUFFER < pconn->batch.size + size) {
+      conn_batch_flush(pconn);
+    }
+    pentry = conn_batch_entry_new(pconn);
+    pentry->group = group;
+    pentry->key = key;
+    pentry->packet = fc_malloc(size);
+    pentry->packet_size = size;
+    pentry->force_to_send = force_to_send;
+    pconn->batch.size += size;
+    genhash_insert(pconn->batch.staged, pentry, pentry);
+  }
+  memcpy(pentry->packet, packet, size);
+  pentry->send = send;
+
+  return TRUE;
+}
+
+/****************************************************************************
+  A packet cancelling the delta state of the given group and key is being
+  sent. The staged packet of that key, if any, is serialized now, so that
+  the cancel happens after it, and the later packets of that key start a
+  new entry.
+****************************************************************************/
+void conn_batch_close(struct connection *pconn, int group, int key)
+{
+  struct conn_batch_entry probe, *pentry;
+
+  if (!conn_batch_active(pconn) || NULL != pconn->batch.capture) {
+    return;
+  }
+
+  probe.group = group;
+  probe.key = key;
+  if (!genhash_remove_full(pconn->batch.staged, &probe, NULL,
+                           (void **) &pentry)) {
+    return;
+  }
+
+  pconn->batch.capture = pentry;
+  pconn->batch.size -= pentry->packet_size;
+  pentry->send(pconn, pentry->packet, pentry->force_to_send);
+  pconn->batch.capture = NULL;
+
+  free(pentry->packet);
+  pentry->packet = NULL;
+  pentry->packet_size = 0;
+}
+
+/****************************************************************************
+  Add serialized packet data to the batch of the connection.
+****************************************************************************/
+void conn_batch_put(struct connection *pconn,
+                    const unsigned char *data, int len)
+{
+  struct conn_batch_entry *pentry = pconn->batch.capture;
+  size_t old_size;
+
+  if (NULL == pentry) {
+    if (MAX_LEN_BUFFER < pconn->batch.size + len) {
+      conn_batch_flush(pconn);
+    }
+    pentry = conn_batch_entry_list_back(pconn->batch.entries);
+    if (NULL == pentry || NULL != pentry->packet
+        || MAX_LEN_BUFFER / 4 < byte_vector_size(&pentry->data) + len) {
+      pentry = conn_batch_entry_new(pconn);
+    }
+    pconn->batch.put_serial = pentry->serial;
+  }
+
+  old_size = byte_vector_size(&pentry->data);
+  byte_vector_reserve(&pentry->data, old_size + len);
+  memcpy(pentry->data.p + old_size, data, len);
+  pconn->batch.size += len;
+}
+
+/****************************************************************************
+  Start a batch on all connections of the list.
+****************************************************************************/
+void conn_list_batch_begin(const struct conn_list *pconn_list)
+{
+  conn_list_iterate(pconn_list, pconn) {
+    conn_batch_begin(pconn);
+  } conn_list_iterate_end;
+}
+
+/****************************************************************************
+  End a batch on all connections of the list.
+****************************************************************************/
+void conn_list_batch_end(const struct conn_list *pconn_list)
+{
+  conn_list_iterate(pconn_list, pconn) {
+    conn_batch_end(pconn);
+  } conn_list_iterate_end;
+}
+
 /**************************************************************************
   Returns TRUE if the given connection is attached to a player which it
   also controls (i.e. not a player observer).
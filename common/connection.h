@@ -117,6 +117,22 @@ struct socket_packet_buffer {
   unsigned char *data;
 };
 
+/***********************************************************
+  This is where the data waits to be sent. It is a chain of
+  chunks, written to the socket with scatter/gather writes;
+  the data is never moved once it is in a chunk.
+***********************************************************/
+struct send_chunk;
+
+struct socket_send_buffer {
+  int ndata;                    /* Bytes waiting in the chunks. */
+  int do_buffer_sends;
+  int nsize;                    /* Bytes allocated for the chunks. */
+  struct send_chunk *head;      /* Sent first. */
+  struct send_chunk *tail;      /* New data is appended here. */
+  struct send_chunk *spare;     /* A drained chunk kept for reuse. */
+};
+
 struct packet_header {
   unsigned int length : 4;      /* Actually 'enum data_type' */
   unsigned int type : 4;        /* Actually 'enum data_type' */
@@ -126,6 +142,47 @@ struct packet_header {
 #define SPECVEC_TYPE unsigned char
 #include "specvec.h"
 
+#ifdef USE_COMPRESSION
+/* Compression methods of the network stream. The method of a connection
+ * is the first one both sides have in their capability string, see
+ * common/packets.c. */
+enum conn_compression_method {
+  COMPRESS_UNKNOWN = -1,        /* Not decided yet. */
+  COMPRESS_ZLIB,
+  COMPRESS_ZSTD,
+  COMPRESS_LZ4
+};
+#endif /* USE_COMPRESSION */
+
+/* Sends again a packet staged by conn_batch_stage(). */
+typedef int (*conn_batch_send_fn_t) (struct connection *pc,
+                                     const void *packet,
+                                     bool force_to_send);
+
+/***********************************************************
+  An entry of a connection batch. It is either a packet
+  staged by conn_batch_stage(), which can be replaced by a
+  later packet of the same group and key until the batch is
+  flushed, or a run of already serialized packets.
+***********************************************************/
+struct conn_batch_entry {
+  int group;                    /* Packet type naming the batch group. */
+  int key;                      /* Key of the packet in the group. */
+  void *packet;                 /* Copy of the staged packet, or NULL. */
+  size_t packet_size;
+  bool force_to_send;
+  conn_batch_send_fn_t send;
+  int serial;                   /* Order of creation in the batch. */
+
+  struct byte_vector data;      /* Serialized packets, if 'packet' is NULL. */
+};
+
+#define SPECLIST_TAG conn_batch_entry
+#include "speclist.h"
+
+#define conn_batch_entry_list_iterate(entrylist, pentry)     TYPED_LIST_ITERATE(struct conn_batch_entry, entrylist, pentry)
+#define conn_batch_entry_list_iterate_end  LIST_ITERATE_END
+
 /***********************************************************
   The connection struct represents a single client or server
   at the other end of a network connection.
@@ -148,7 +205,7 @@ struct connection {
   struct player *playing;
 
   struct socket_packet_buffer *buffer;
-  struct socket_packet_buffer *send_buffer;
+  struct socket_send_buffer *send_buffer;
   struct timer *last_write;
 
   double ping_time;
@@ -258,8 +315,30 @@ struct connection {
     int frozen_level;
 
     struct byte_vector queue;
+
+    enum conn_compression_method method;
+    void *compressor;           /* Kept from one flush to the next. */
+    void *decompressor;
+
+    /* Statistics, in bytes. */
+    unsigned long size_alone;
+    unsigned long size_uncompressed;
+    unsigned long size_compressed;
+    unsigned long size_no_compression;
   } compression;
 #endif
+  struct {
+    int level;                  /* See conn_batch_begin(). */
+    bool flushing;
+    /* Receives the serialized packets instead of a new entry. */
+    struct conn_batch_entry *capture;
+    size_t size;                /* Bytes held by the entries. */
+    int serial;                 /* Serial of the last entry created. */
+    int put_serial;             /* Serial of the last entry put into. */
+
+    struct conn_batch_entry_list *entries;
+    struct genhash *staged;     /* Staged entries, by group and key. */
+  } batch;
   struct {
     int bytes_send;
   } statistics;
@@ -274,6 +353,7 @@ int read_socket_data(int sock, struct socket_packet_buffer *buffer);
 void flush_connection_send_buffer_all(struct connection *pc);
 bool connection_send_data(struct connection *pconn,
                           const unsigned char *data, int len);
+unsigned char *connection_send_reserve(struct connection *pconn, int size);
 
 void connection_do_buffer(struct connection *pc);
 void connection_do_unbuffer(struct connection *pc);
@@ -295,9 +375,26 @@ void conn_reset_delta_state(struct connection *pconn);
 void conn_compression_freeze(struct connection *pconn);
 bool conn_compression_thaw(struct connection *pconn);
 bool conn_compression_frozen(const struct connection *pconn);
+bool conn_compression_sync(struct connection *pconn);
+#ifdef USE_COMPRESSION
+void conn_compression_free(struct connection *pconn);
+#endif
 void conn_list_compression_freeze(const struct conn_list *pconn_list);
 void conn_list_compression_thaw(const struct conn_list *pconn_list);
 
+void conn_batch_begin(struct connection *pconn);
+void conn_batch_end(struct connection *pconn);
+void conn_batch_flush(struct connection *pconn);
+bool conn_batch_active(const struct connection *pconn);
+bool conn_batch_stage(struct connection *pconn, int group, int key,
+                      const void *packet, size_t size, bool force_to_send,
+                      conn_batch_send_fn_t send);
+void conn_batch_close(struct connection *pconn, int group, int key);
+void conn_batch_put(struct connection *pconn,
+                    const unsigned char *data, int len);
+void conn_list_batch_begin(const struct conn_list *pconn_list);
+void conn_list_batch_end(const struct conn_list *pconn_list);
+
 const char *conn_description(const struct connection *pconn);
 bool conn_controls_player(const struct connection *pconn);
 bool conn_is_global_observer(const struct connection *pconn);
@@ -23,6 +23,7 @@
 #include "mem.h"
 #include "support.h"
 #include "shared.h" /* ARRAY_SIZE */
+#include "timing.h"
 
 /* common */
 #include "city.h"
@@ -30,8 +31,10 @@
 #include "government.h"
 #include "improvement.h"
 #include "map.h"
+#include "nation.h"
 #include "packets.h"
 #include "player.h"
+#include "research.h"
 #include "tech.h"
 
 #include "effects.h"
@@ -117,8 +120,115 @@ static struct {
     /* ...advances... */
     struct effect_list *advances[A_LAST];
   } reqs;
+
+  /* The different requirements of the effects of each type, indexed by
+   * their slot in the compiled requirements. */
+  struct requirement_vector slots[EFT_COUNT];
+
+  /* The effects of each type split by their gate (see effect_gate()):
+   * those without a gate, and a group for each gate. */
+  struct {
+    struct effect_list *ungated;
+    int num_gates;
+    struct effect_gate *gates;
+  } gated[EFT_COUNT];
+
+  /* What the player and city values of each effect type depend on, see
+   * effect_cache_deps_init(). */
+  int deps[EFT_COUNT];
+
+  /* Whether any effect has a requirement of each kind. */
+  bool req_kinds[VUT_COUNT];
 } ruleset_cache;
 
+/* The effects of a type which share a gate. */
+struct effect_gate {
+  struct universal source;
+  struct effect_list *effects;
+};
+
+/* Requirements past this number in an effect type are not shared. */
+#define EFFECT_REQ_SLOTS 256
+
+/* The targets a compiled effect needs, see effect_req_needs(). */
+enum effect_target {
+  EFFECT_NEEDS_PLAYER = 1 << 0,
+  EFFECT_NEEDS_CITY = 1 << 1,
+  EFFECT_NEEDS_TILE = 1 << 2,
+  EFFECT_NEEDS_UNIT = 1 << 3,
+  EFFECT_NEEDS_UNITTYPE = 1 << 4,
+  EFFECT_NEEDS_OUTPUT = 1 << 5,
+  EFFECT_NEEDS_SPECIALIST = 1 << 6
+};
+
+/* What a player or city effect value depends on, see effect_req_deps(). */
+enum effect_dep {
+  EFFECT_DEP_ADVANCE = 1 << 0,
+  EFFECT_DEP_WONDER = 1 << 1,
+  EFFECT_DEP_BUILDING = 1 << 2,
+  EFFECT_DEP_GOVERNMENT = 1 << 3,
+  EFFECT_DEP_SIZE = 1 << 4,
+  EFFECT_DEP_YEAR = 1 << 5,
+  /* Anything else; the value is not cached. */
+  EFFECT_DEP_OTHER = 1 << 6
+};
+
+#define EFFECT_DEP_ALL ((EFFECT_DEP_OTHER << 1) - 1)
+
+/* How deep the obsolete_by requirements of buildings are followed. */
+#define EFFECT_DEP_DEPTH 4
+
+/* Define this to check the compiled requirements against the plain
+ * are_reqs_active() loop: each get_target_bonus_effects() call runs both,
+ * asserts that they give the same bonus, and the time spent by each is
+ * logged when the ruleset cache is freed (e.g. at the end of an
+ * autogame). The timers are not thread safe, so run the server with
+ * 'citythreads' set to 1. */
+/* #define EFFECT_REQS_BENCHMARK */
+
+#ifdef EFFECT_REQS_BENCHMARK
+/* How many times each path is run per call, so that the time spent
+ * reading the timers stays small in comparison. */
+#define EFFECT_REQS_BENCHMARK_RUNS 5
+
+static struct {
+  struct timer *plain;
+  struct timer *compiled;
+  int calls;
+  int mismatches;
+} effect_reqs_benchmark;
+
+static void effect_reqs_benchmark_report(void);
+#endif /* EFFECT_REQS_BENCHMARK */
+
+/* The effect values of a player or a city. An entry is valid as long as
+ * what it depends on did not change. */
+struct effect_cache {
+  unsigned int ruleset_gen;
+  unsigned int advance_gen;
+  unsigned int wonder_gen;
+  const struct player *owner;
+  const struct research *presearch;
+  const struct government *pgov;
+  int size;
+  int year;
+
+  bool valid[EFT_COUNT];
+  int value[EFT_COUNT];
+};
+
+/* Bumped when the ruleset, any research, any wonder or any building
+ * changes. */
+static struct {
+  unsigned int ruleset;
+  unsigned int advance;
+  unsigned int wonder;
+  unsigned int building;
+} effect_cache_gen;
+
+/* Set while other threads may read the caches, see effect_cache_freeze(). */
+static bool effect_cache_frozen = FALSE;
+
 
 /**************************************************************************
   Get a list of effects of this type.
@@ -163,6 +273,277 @@ struct effect_list *get_req_source_effects(struct universal *psource)
   }
 }
 
+/**************************************************************************
+  Returns the targets without which is_req_active() cannot be TRUE for the
+  requirement, when evaluated with RPT_CERTAIN.
+**************************************************************************/
+static int effect_req_needs(const struct requirement *preq)
+{
+  switch (preq->source.kind) {
+  case VUT_GOVERNMENT:
+  case VUT_STYLE:
+  case VUT_AI_LEVEL:
+    return EFFECT_NEEDS_PLAYER;
+  case VUT_MINSIZE:
+    return EFFECT_NEEDS_CITY;
+  case VUT_TERRAINALTER:
+  case VUT_CITYTILE:
+    return EFFECT_NEEDS_TILE;
+  case VUT_UNITSTATE:
+    return EFFECT_NEEDS_UNIT;
+  case VUT_UTYPE:
+  case VUT_UCLASS:
+  case VUT_UCFLAG:
+    return EFFECT_NEEDS_UNITTYPE;
+  case VUT_OTYPE:
+    return (preq->present ? EFFECT_NEEDS_OUTPUT : 0);
+  case VUT_SPECIALIST:
+    return (preq->present ? EFFECT_NEEDS_SPECIALIST : 0);
+  default:
+    return 0;
+  }
+}
+
+/**************************************************************************
+  Returns a rough cost of evaluating the requirement, to check the cheap
+  requirements of an effect first.
+**************************************************************************/
+static int effect_req_cost(const struct requirement *preq)
+{
+  int cost;
+
+  switch (preq->source.kind) {
+  case VUT_NONE:
+  case VUT_OTYPE:
+  case VUT_SPECIALIST:
+    return 0;
+  case VUT_GOVERNMENT:
+  case VUT_STYLE:
+  case VUT_AI_LEVEL:
+  case VUT_MINYEAR:
+  case VUT_UTYPE:
+  case VUT_UTFLAG:
+  case VUT_UCLASS:
+  case VUT_UCFLAG:
+  case VUT_UNITSTATE:
+    cost = 1;
+    break;
+  default:
+    cost = 2;
+    break;
+  }
+
+  /* Wide ranges iterate over tiles, cities or players. */
+  switch (preq->range) {
+  case REQ_RANGE_CADJACENT:
+  case REQ_RANGE_ADJACENT:
+  case REQ_RANGE_TRADEROUTE:
+    cost += 2;
+    break;
+  case REQ_RANGE_CONTINENT:
+  case REQ_RANGE_TEAM:
+  case REQ_RANGE_ALLIANCE:
+  case REQ_RANGE_WORLD:
+    cost += 3;
+    break;
+  default:
+    break;
+  }
+
+  /* A requirement which stays unmet once unmet is the most likely to
+   * reject the effect. */
+  return 2 * cost + (is_req_unchanging(preq) ? 0 : 1);
+}
+
+/**************************************************************************
+  Returns whether two requirements cannot both be met, because they ask
+  for different values of a property a target has only one of.
+**************************************************************************/
+static bool effect_reqs_exclusive(const struct requirement *preq1,
+                                  const struct requirement *preq2)
+{
+  if (!preq1->present || !preq2->present
+      || preq1->source.kind != preq2->source.kind) {
+    return FALSE;
+  }
+
+  switch (preq1->source.kind) {
+  case VUT_GOVERNMENT:
+  case VUT_STYLE:
+  case VUT_AI_LEVEL:
+  case VUT_OTYPE:
+  case VUT_SPECIALIST:
+    return !are_universals_equal(&preq1->source, &preq2->source);
+  default:
+    return FALSE;
+  }
+}
+
+/**************************************************************************
+  Returns the slot of the requirement among the requirements of the
+  effects of the type, adding it if needed.
+**************************************************************************/
+static int effect_req_slot(enum effect_type type,
+                           const struct requirement *preq)
+{
+  struct requirement_vector *slots = ruleset_cache.slots + type;
+  int i;
+
+  for (i = 0; i < requirement_vector_size(slots); i++) {
+    if (are_requirements_equal(requirement_vector_get(slots, i), preq)) {
+      return i;
+    }
+  }
+
+  if (EFFECT_REQ_SLOTS <= requirement_vector_size(slots)) {
+    return -1;
+  }
+  requirement_vector_append(slots, *preq);
+
+  return i;
+}
+
+/**************************************************************************
+  Returns the source the effect is indexed by: a government, a nation or
+  a city building the target must have for the effect to be active (see
+  effect_gate_is_open()). The kind is VUT_NONE if there is none.
+**************************************************************************/
+static struct universal effect_gate(const struct effect *peffect)
+{
+  struct universal gate = { .kind = VUT_NONE, .value = { .advance = NULL } };
+  int best = 0;
+
+  requirement_vector_iterate(&peffect->reqs, preq) {
+    int rank = 0;
+
+    if (!preq->present || preq->survives) {
+      continue;
+    }
+
+    switch (preq->source.kind) {
+    case VUT_GOVERNMENT:
+      rank = 3;
+      break;
+    case VUT_NATION:
+      rank = (REQ_RANGE_PLAYER == preq->range ? 2 : 0);
+      break;
+    case VUT_IMPROVEMENT:
+      rank = (REQ_RANGE_LOCAL == preq->range
+              || REQ_RANGE_CITY == preq->range ? 1 : 0);
+      break;
+    default:
+      break;
+    }
+
+    if (rank > best) {
+      best = rank;
+      gate = preq->source;
+    }
+  } requirement_vector_iterate_end;
+
+  return gate;
+}
+
+/**************************************************************************
+  Returns the list of the effects of the type with the gate, adding it if
+  needed.
+**************************************************************************/
+static struct effect_list *effect_gate_list(enum effect_type type,
+                                            const struct universal *gate)
+{
+  struct effect_gate *pgate;
+  int i;
+
+  if (VUT_NONE == gate->kind) {
+    return ruleset_cache.gated[type].ungated;
+  }
+
+  for (i = 0; i < ruleset_cache.gated[type].num_gates; i++) {
+    pgate = ruleset_cache.gated[type].gates + i;
+    if (are_universals_equal(&pgate->source, gate)) {
+      return pgate->effects;
+    }
+  }
+
+  ruleset_cache.gated[type].gates =
+      fc_realloc(ruleset_cache.gated[type].gates,
+                 (i + 1) * sizeof(*ruleset_cache.gated[type].gates));
+  ruleset_cache.gated[type].num_gates = i + 1;
+  pgate = ruleset_cache.gated[type].gates + i;
+  pgate->source = *gate;
+  pgate->effects = effect_list_new();
+
+  return pgate->effects;
+}
+
+/**************************************************************************
+  Returns whether the target has the gate of the effects of a group, so
+  that they may be active.
+**************************************************************************/
+static inline bool effect_gate_is_open(const struct universal *gate,
+                                       const struct player *target_player,
+                                       const struct city *target_city)
+{
+  switch (gate->kind) {
+  case VUT_GOVERNMENT:
+    return (NULL != target_player
+            && government_of_player(target_player) == gate->value.govern);
+  case VUT_NATION:
+    return (NULL != target_player
+            && nation_of_player(target_player) == gate->value.nation);
+  case VUT_IMPROVEMENT:
+    return (NULL != target_city
+            && city_has_building(target_city, gate->value.building));
+  default:
+    return TRUE;
+  }
+}
+
+/**************************************************************************
+  Compile the requirements of the effect for get_target_bonus_effects().
+**************************************************************************/
+static void effect_compile(struct effect *peffect)
+{
+  struct effect_req *creqs;
+  int count = 0, i;
+
+  peffect->compiled.never = FALSE;
+  peffect->compiled.needs = 0;
+  creqs = fc_realloc(peffect->compiled.reqs,
+                     requirement_vector_size(&peffect->reqs)
+                     * sizeof(*creqs));
+
+  requirement_vector_iterate(&peffect->reqs, preq) {
+    int cost = effect_req_cost(preq);
+
+    if (VUT_NONE == preq->source.kind) {
+      /* Always met, or never. */
+      peffect->compiled.never |= !preq->present;
+      continue;
+    }
+
+    for (i = 0; i < count; i++) {
+      if (are_requirements_opposites(preq, &creqs[i].req)
+          || effect_reqs_exclusive(preq, &creqs[i].req)) {
+        peffect->compiled.never = TRUE;
+      }
+    }
+    peffect->compiled.needs |= effect_req_needs(preq);
+
+    /* Insert sorted by cost, keeping the ruleset order for equal costs. */
+    for (i = count; 0 < i && cost < effect_req_cost(&creqs[i - 1].req); i--) {
+      creqs[i] = creqs[i - 1];
+    }
+    creqs[i].req = *preq;
+    creqs[i].slot = effect_req_slot(peffect->type, preq);
+    count++;
+  } requirement_vector_iterate_end;
+
+  peffect->compiled.count = count;
+  peffect->compiled.reqs = creqs;
+  peffect->compiled.gate = effect_gate(peffect);
+}
+
 /**************************************************************************
   Add effect to ruleset cache.
 **************************************************************************/
@@ -176,10 +557,16 @@ struct effect *effect_new(enum effect_type type, int value)
   peffect->value = value;
 
   requirement_vector_init(&peffect->reqs);
+  peffect->compiled.never = FALSE;
+  peffect->compiled.needs = 0;
+  peffect->compiled.count = 0;
+  peffect->compiled.reqs = NULL;
+  peffect->compiled.gate.kind = VUT_NONE;
 
   /* Now add the effect to the ruleset cache. */
   effect_list_append(ruleset_cache.tracker, peffect);
   effect_list_append(get_effects(type), peffect);
+  effect_list_append(ruleset_cache.gated[type].ungated, peffect);
   return peffect;
 }
 
@@ -189,8 +576,18 @@ struct effect *effect_new(enum effect_type type, int value)
 void effect_req_append(struct effect *peffect, struct requirement *preq)
 {
   struct effect_list *eff_list = get_req_source_effects(&preq->source);
+  struct universal old_gate = peffect->compiled.gate;
 
   requirement_vector_append(&peffect->reqs, *preq);
+  effect_compile(peffect);
+
+  ruleset_cache.req_kinds[preq->source.kind] = TRUE;
+
+  if (!are_universals_equal(&old_gate, &peffect->compiled.gate)) {
+    effect_list_remove(effect_gate_list(peffect->type, &old_gate), peffect);
+    effect_list_append(effect_gate_list(peffect->type,
+                                        &peffect->compiled.gate), peffect);
+  }
 
   if (eff_list) {
     effect_list_append(eff_list, peffect);
@@ -222,6 +619,19 @@ void ruleset_cache_init(void)
   for (i = 0; i < ARRAY_SIZE(ruleset_cache.reqs.advances); i++) {
     ruleset_cache.reqs.advances[i] = effect_list_new();
   }
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.slots); i++) {
+    requirement_vector_init(&ruleset_cache.slots[i]);
+  }
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.gated); i++) {
+    ruleset_cache.gated[i].ungated = effect_list_new();
+    ruleset_cache.gated[i].num_gates = 0;
+    ruleset_cache.gated[i].gates = NULL;
+  }
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.deps); i++) {
+    ruleset_cache.deps[i] = EFFECT_DEP_OTHER;
+  }
+  memset(ruleset_cache.req_kinds, 0, sizeof(ruleset_cache.req_kinds));
+  effect_cache_gen.ruleset++;
 }
 
 /**************************************************************************
@@ -236,6 +646,7 @@ void ruleset_cache_free(void)
   if (plist) {
     effect_list_iterate(plist, peffect) {
       requirement_vector_free(&peffect->reqs);
+      free(peffect->compiled.reqs);
       free(peffect);
     } effect_list_iterate_end;
     effect_list_destroy(plist);
@@ -278,6 +689,29 @@ void ruleset_cache_free(void)
     }
   }
 
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.slots); i++) {
+    requirement_vector_free(&ruleset_cache.slots[i]);
+  }
+
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.gated); i++) {
+    int j;
+
+    if (ruleset_cache.gated[i].ungated) {
+      effect_list_destroy(ruleset_cache.gated[i].ungated);
+      ruleset_cache.gated[i].ungated = NULL;
+    }
+    for (j = 0; j < ruleset_cache.gated[i].num_gates; j++) {
+      effect_list_destroy(ruleset_cache.gated[i].gates[j].effects);
+    }
+    free(ruleset_cache.gated[i].gates);
+    ruleset_cache.gated[i].gates = NULL;
+    ruleset_cache.gated[i].num_gates = 0;
+  }
+
+#ifdef EFFECT_REQS_BENCHMARK
+  effect_reqs_benchmark_report();
+#endif
+
   initialized = FALSE;
 }
 
@@ -361,6 +795,322 @@ void send_ruleset_cache(struct conn_list *dest)
   } effect_list_iterate_end;
 }
 
+/**************************************************************************
+  Returns what the value of an effect with the requirement depends on,
+  when evaluated for a player or a city by get_player_bonus() or
+  get_city_bonus(). depth limits how far the obsolete_by requirements of
+  the buildings are followed.
+**************************************************************************/
+static int effect_req_deps(const struct requirement *preq, int depth)
+{
+  int deps;
+
+  switch (preq->source.kind) {
+  case VUT_NONE:
+  case VUT_UTYPE:
+  case VUT_UTFLAG:
+  case VUT_UCLASS:
+  case VUT_UCFLAG:
+  case VUT_UNITSTATE:
+  case VUT_OTYPE:
+  case VUT_SPECIALIST:
+    /* Constant without a unit, output or specialist target. */
+    return 0;
+  case VUT_ADVANCE:
+  case VUT_TECHFLAG:
+    if (REQ_RANGE_PLAYER == preq->range || REQ_RANGE_WORLD == preq->range) {
+      return EFFECT_DEP_ADVANCE;
+    }
+    return EFFECT_DEP_OTHER;
+  case VUT_GOVERNMENT:
+    return EFFECT_DEP_GOVERNMENT;
+  case VUT_MINSIZE:
+    return (REQ_RANGE_CITY == preq->range
+            ? EFFECT_DEP_SIZE : EFFECT_DEP_OTHER);
+  case VUT_MINYEAR:
+    return EFFECT_DEP_YEAR;
+  case VUT_IMPROVEMENT:
+    switch (preq->range) {
+    case REQ_RANGE_LOCAL:
+    case REQ_RANGE_CITY:
+      deps = EFFECT_DEP_BUILDING;
+      break;
+    case REQ_RANGE_PLAYER:
+    case REQ_RANGE_WORLD:
+      deps = EFFECT_DEP_WONDER;
+      break;
+    default:
+      return EFFECT_DEP_OTHER;
+    }
+    if (depth >= EFFECT_DEP_DEPTH) {
+      return EFFECT_DEP_OTHER;
+    }
+
+    /* See improvement_obsolete(). */
+    requirement_vector_iterate(&preq->source.value.building->obsolete_by,
+                               pobsolete) {
+      deps |= effect_req_deps(pobsolete, depth + 1);
+    } requirement_vector_iterate_end;
+    return deps;
+  default:
+    return EFFECT_DEP_OTHER;
+  }
+}
+
+/**************************************************************************
+  Find out what the values of each effect type depend on. Called once the
+  ruleset is loaded; until then no value is cached.
+**************************************************************************/
+void effect_cache_deps_init(void)
+{
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.deps); i++) {
+    int deps = 0;
+
+    effect_list_iterate(get_effects(i), peffect) {
+      requirement_vector_iterate(&peffect->reqs, preq) {
+        deps |= effect_req_deps(preq, 0);
+      } requirement_vector_iterate_end;
+    } effect_list_iterate_end;
+
+    ruleset_cache.deps[i] = deps;
+  }
+  effect_cache_gen.ruleset++;
+}
+
+/**************************************************************************
+  Free the effect cache of a player or a city.
+**************************************************************************/
+void effect_cache_destroy(struct effect_cache *pcache)
+{
+  free(pcache);
+}
+
+/**************************************************************************
+  Forget the cached values which depend on any of the deps.
+**************************************************************************/
+static void effect_cache_invalidate(struct effect_cache *pcache, int deps)
+{
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE(pcache->valid); i++) {
+    if (ruleset_cache.deps[i] & deps) {
+      pcache->valid[i] = FALSE;
+    }
+  }
+}
+
+/**************************************************************************
+  Called when the state of any tech of any research changes.
+**************************************************************************/
+void effect_cache_advances_changed(void)
+{
+  fc_assert(!effect_cache_frozen);
+  effect_cache_gen.advance++;
+}
+
+/**************************************************************************
+  Called when any wonder is built or lost.
+**************************************************************************/
+void effect_cache_wonders_changed(void)
+{
+  fc_assert(!effect_cache_frozen);
+  effect_cache_gen.wonder++;
+}
+
+/**************************************************************************
+  Called when a building of the city of the cache is built or lost.
+**************************************************************************/
+void effect_cache_buildings_changed(struct effect_cache *pcache)
+{
+  fc_assert(!effect_cache_frozen);
+  effect_cache_gen.building++;
+  if (NULL != pcache) {
+    effect_cache_invalidate(pcache, EFFECT_DEP_BUILDING);
+  }
+}
+
+/**************************************************************************
+  Returns what changed, among the deps, in the state the values of the
+  cache depend on since they were computed. EFFECT_DEP_ALL if the ruleset
+  or the owner changed.
+**************************************************************************/
+static int effect_cache_changes(const struct effect_cache *pcache,
+                                const struct player *pplayer,
+                                const struct city *pcity, int deps)
+{
+  int changed = 0;
+
+  if (pcache->ruleset_gen != effect_cache_gen.ruleset
+      || pcache->owner != pplayer) {
+    return EFFECT_DEP_ALL;
+  }
+
+  if ((deps & EFFECT_DEP_ADVANCE)
+      && (pcache->advance_gen != effect_cache_gen.advance
+          || pcache->presearch != research_get(pplayer))) {
+    changed |= EFFECT_DEP_ADVANCE;
+  }
+  if ((deps & EFFECT_DEP_WONDER)
+      && pcache->wonder_gen != effect_cache_gen.wonder) {
+    changed |= EFFECT_DEP_WONDER;
+  }
+  if ((deps & EFFECT_DEP_GOVERNMENT) && pcache->pgov != pplayer->government) {
+    changed |= EFFECT_DEP_GOVERNMENT;
+  }
+  if ((deps & EFFECT_DEP_SIZE)
+      && pcache->size != (NULL != pcity ? city_size_get(pcity) : 0)) {
+    changed |= EFFECT_DEP_SIZE;
+  }
+  if ((deps & EFFECT_DEP_YEAR) && pcache->year != game.info.year) {
+    changed |= EFFECT_DEP_YEAR;
+  }
+
+  return changed;
+}
+
+/**************************************************************************
+  Returns the effect bonus for the player or, if pcity is given, for the
+  city of the player, from the cache of the target when it is still
+  valid. Only the server caches the values, the client changes the state
+  they depend on without calling the effect_cache_*_changed() hooks.
+  While the cache is frozen, it is only read.
+**************************************************************************/
+static int effect_cache_bonus(const struct player *pplayer,
+                              const struct city *pcity,
+                              enum effect_type effect_type)
+{
+  struct effect_cache **ppcache, *pcache;
+  int deps, changed;
+
+  if (!is_server() || NULL == pplayer
+      || (ruleset_cache.deps[effect_type] & EFFECT_DEP_OTHER)) {
+    return get_target_bonus_effects(NULL,
+                                    pplayer, NULL, pcity, NULL,
+                                    (NULL != pcity ? city_tile(pcity) : NULL),
+                                    NULL, NULL, NULL, NULL, effect_type);
+  }
+
+  /* The cache does not change the value of the target. */
+  ppcache = (NULL != pcity ? &((struct city *) pcity)->effect_cache
+             : &((struct player *) pplayer)->effect_cache);
+  pcache = *ppcache;
+  deps = ruleset_cache.deps[effect_type];
+
+  if (effect_cache_frozen) {
+    /* Other threads may be reading the cache: use it if it is valid, but
+     * do not store anything. */
+    if (NULL != pcache && pcache->valid[effect_type]
+        && 0 == effect_cache_changes(pcache, pplayer, pcity, deps)) {
+      return pcache->value[effect_type];
+    }
+    return get_target_bonus_effects(NULL,
+                                    pplayer, NULL, pcity, NULL,
+                                    (NULL != pcity ? city_tile(pcity) : NULL),
+                                    NULL, NULL, NULL, NULL, effect_type);
+  }
+
+  if (NULL == pcache) {
+    pcache = fc_calloc(1, sizeof(*pcache));
+    *ppcache = pcache;
+  }
+
+  /* Check only what the value of this effect type depends on; the values
+   * which depend on the rest are checked when they are asked for. */
+  changed = effect_cache_changes(pcache, pplayer, pcity, deps);
+  if (0 != changed) {
+    effect_cache_invalidate(pcache, changed);
+    pcache->ruleset_gen = effect_cache_gen.ruleset;
+    pcache->owner = pplayer;
+    if (changed & EFFECT_DEP_ADVANCE) {
+      pcache->advance_gen = effect_cache_gen.advance;
+      pcache->presearch = research_get(pplayer);
+    }
+    if (changed & EFFECT_DEP_WONDER) {
+      pcache->wonder_gen = effect_cache_gen.wonder;
+    }
+    if (changed & EFFECT_DEP_GOVERNMENT) {
+      pcache->pgov = pplayer->government;
+    }
+    if (changed & EFFECT_DEP_SIZE) {
+      pcache->size = (NULL != pcity ? city_size_get(pcity) : 0);
+    }
+    if (changed & EFFECT_DEP_YEAR) {
+      pcache->year = game.info.year;
+    }
+  }
+
+  if (!pcache->valid[effect_type]) {
+    pcache->value[effect_type] =
+        get_target_bonus_effects(NULL,
+                                 pplayer, NULL, pcity, NULL,
+                                 (NULL != pcity ? city_tile(pcity) : NULL),
+                                 NULL, NULL, NULL, NULL, effect_type);
+    pcache->valid[effect_type] = TRUE;
+  }
+
+  return pcache->value[effect_type];
+}
+
+/**************************************************************************
+  Compute the values of all the effect types the cache of the player
+  holds. Until the state they depend on changes, get_player_bonus() then
+  only reads the cache, so several threads can call it at the same time.
+**************************************************************************/
+void effect_cache_fill(const struct player *pplayer)
+{
+  int i;
+
+  fc_assert_ret(!effect_cache_frozen);
+
+  for (i = 0; i < ARRAY_SIZE(ruleset_cache.deps); i++) {
+    if (!(ruleset_cache.deps[i] & EFFECT_DEP_OTHER)) {
+      (void) effect_cache_bonus(pplayer, NULL, i);
+    }
+  }
+}
+
+/**************************************************************************
+  Make the caches read-only, until effect_cache_thaw(): the bonuses are
+  then computed without being stored, so several threads can ask for
+  them. The game state must not change in the meantime.
+**************************************************************************/
+void effect_cache_freeze(void)
+{
+  fc_assert(!effect_cache_frozen);
+  effect_cache_frozen = TRUE;
+}
+
+/**************************************************************************
+  Let the caches store the bonuses again, see effect_cache_freeze().
+**************************************************************************/
+void effect_cache_thaw(void)
+{
+  fc_assert(effect_cache_frozen);
+  effect_cache_frozen = FALSE;
+}
+
+/**************************************************************************
+  Returns a number which changes each time the ruleset, any research, any
+  wonder or any building changes.
+**************************************************************************/
+unsigned int effect_cache_stamp(void)
+{
+  /* The counters only grow, so their sum changes with any of them. */
+  return (effect_cache_gen.ruleset + effect_cache_gen.advance
+          + effect_cache_gen.wonder + effect_cache_gen.building);
+}
+
+/**************************************************************************
+  Returns TRUE if any effect of the ruleset has a requirement of the kind,
+  e.g. VUT_MAXTILEUNITS, whose effect values change when units move.
+**************************************************************************/
+bool effects_have_req_kind(enum universals_n kind)
+{
+  return ruleset_cache.req_kinds[kind];
+}
+
 /**************************************************************************
   Returns TRUE if the building has any effect bonuses of the given type.
 
@@ -462,6 +1212,158 @@ bool is_building_replaced(const struct city *pcity,
   return TRUE;
 }
 
+/**************************************************************************
+  Returns the effect bonus of a given type for any target, evaluating the
+  compiled requirements of the effects. See get_target_bonus_effects().
+**************************************************************************/
+static int target_bonus_effects_compiled(struct effect_list *plist,
+                                         const struct player *target_player,
+                                         const struct player *other_player,
+                                         const struct city *target_city,
+                                         const struct impr_type *target_building,
+                                         const struct tile *target_tile,
+                                         const struct unit *target_unit,
+                                         const struct unit_type *target_unittype,
+                                         const struct output_type *target_output,
+                                         const struct specialist *target_specialist,
+                                         enum effect_type effect_type)
+{
+  /* The result of each requirement slot: 0 not evaluated yet,
+   * 1 not active, 2 active. */
+  unsigned char slots[EFFECT_REQ_SLOTS];
+  struct effect_list *peffects;
+  int bonus = 0, targets = 0, num_gates, g;
+
+  if (target_unittype == NULL && target_unit != NULL) {
+    target_unittype = unit_type(target_unit);
+  }
+
+  targets |= (target_player != NULL ? EFFECT_NEEDS_PLAYER : 0);
+  targets |= (target_city != NULL ? EFFECT_NEEDS_CITY : 0);
+  targets |= (target_tile != NULL ? EFFECT_NEEDS_TILE : 0);
+  targets |= (target_unit != NULL ? EFFECT_NEEDS_UNIT : 0);
+  targets |= (target_unittype != NULL ? EFFECT_NEEDS_UNITTYPE : 0);
+  targets |= (target_output != NULL ? EFFECT_NEEDS_OUTPUT : 0);
+  targets |= (target_specialist != NULL ? EFFECT_NEEDS_SPECIALIST : 0);
+  memset(slots, 0,
+         requirement_vector_size(&ruleset_cache.slots[effect_type]));
+
+  if (NULL != plist) {
+    /* Keep the ruleset order of the effects in the list. */
+    peffects = get_effects(effect_type);
+    num_gates = 0;
+  } else {
+    peffects = ruleset_cache.gated[effect_type].ungated;
+    num_gates = ruleset_cache.gated[effect_type].num_gates;
+  }
+
+  /* Loop over the effects of this type without a gate, then over those
+   * of each gate the target has. */
+  for (g = -1; g < num_gates; g++) {
+    if (0 <= g) {
+      const struct effect_gate *pgate =
+          ruleset_cache.gated[effect_type].gates + g;
+
+      if (!effect_gate_is_open(&pgate->source, target_player,
+                               target_city)) {
+        continue;
+      }
+      peffects = pgate->effects;
+    }
+
+    effect_list_iterate(peffects, peffect) {
+      bool active = !peffect->compiled.never
+                    && (peffect->compiled.needs & ~targets) == 0;
+      int i;
+
+      /* For each effect, see if it is active: are_reqs_active(), with the
+       * compiled requirements. */
+      for (i = 0; active && i < peffect->compiled.count; i++) {
+        const struct effect_req *creq = peffect->compiled.reqs + i;
+
+        if (0 <= creq->slot && 0 != slots[creq->slot]) {
+          active = (2 == slots[creq->slot]);
+          continue;
+        }
+
+        active = is_req_active(target_player, other_player, target_city,
+                               target_building, target_tile,
+                               target_unit, target_unittype,
+                               target_output, target_specialist,
+                               &creq->req, RPT_CERTAIN);
+        if (0 <= creq->slot) {
+          slots[creq->slot] = (active ? 2 : 1);
+        }
+      }
+
+      if (active) {
+        /* And if so add on the value. */
+        bonus += peffect->value;
+
+        if (plist) {
+          effect_list_append(plist, peffect);
+        }
+      }
+    } effect_list_iterate_end;
+  }
+
+  return bonus;
+}
+
+#ifdef EFFECT_REQS_BENCHMARK
+/**************************************************************************
+  Returns the effect bonus of a given type for any target, checking the
+  plain requirement vectors of all the effects of the type.
+**************************************************************************/
+static int target_bonus_effects_plain(const struct player *target_player,
+                                      const struct player *other_player,
+                                      const struct city *target_city,
+                                      const struct impr_type *target_building,
+                                      const struct tile *target_tile,
+                                      const struct unit *target_unit,
+                                      const struct unit_type *target_unittype,
+                                      const struct output_type *target_output,
+                                      const struct specialist *target_specialist,
+                                      enum effect_type effect_type)
+{
+  int bonus = 0;
+
+  effect_list_iterate(get_effects(effect_type), peffect) {
+    if (are_reqs_active(target_player, other_player, target_city,
+                        target_building, target_tile,
+                        target_unit, target_unittype,
+                        target_output, target_specialist,
+                        &peffect->reqs, RPT_CERTAIN)) {
+      bonus += peffect->value;
+    }
+  } effect_list_iterate_end;
+
+  return bonus;
+}
+
+/**************************************************************************
+  Log the result of the benchmark of the compiled requirements and start
+  a new one.
+**************************************************************************/
+static void effect_reqs_benchmark_report(void)
+{
+  if (0 == effect_reqs_benchmark.calls) {
+    return;
+  }
+
+  log_normal("Effect requirements: %d calls, %d mismatches, "
+             "plain %.2f s, compiled %.2f s (%d runs each).",
+             effect_reqs_benchmark.calls, effect_reqs_benchmark.mismatches,
+             timer_read_seconds(effect_reqs_benchmark.plain),
+             timer_read_seconds(effect_reqs_benchmark.compiled),
+             EFFECT_REQS_BENCHMARK_RUNS);
+
+  timer_destroy(effect_reqs_benchmark.plain);
+  timer_destroy(effect_reqs_benchmark.compiled);
+  memset(&effect_reqs_benchmark, 0, sizeof(effect_reqs_benchmark));
+}
+#endif /* EFFECT_REQS_BENCHMARK */
+
 /**************************************************************************
   Returns the effect bonus of a given type for any target.
 
@@ -486,26 +1388,51 @@ int get_target_bonus_effects(struct effect_list *plist,
                              const struct specialist *target_specialist,
                              enum effect_type effect_type)
 {
-  int bonus = 0;
+#ifdef EFFECT_REQS_BENCHMARK
+  int plain = 0, bonus = 0, i;
 
-  /* Loop over all effects of this type. */
-  effect_list_iterate(get_effects(effect_type), peffect) {
-    /* For each effect, see if it is active. */
-    if (are_reqs_active(target_player, other_player, target_city,
-                        target_building, target_tile,
-                        target_unit, target_unittype,
-                        target_output, target_specialist,
-			&peffect->reqs, RPT_CERTAIN)) {
-      /* And if so add on the value. */
-      bonus += peffect->value;
+  if (NULL == effect_reqs_benchmark.plain) {
+    effect_reqs_benchmark.plain = timer_new(TIMER_CPU, TIMER_ACTIVE);
+    effect_reqs_benchmark.compiled = timer_new(TIMER_CPU, TIMER_ACTIVE);
+  }
+  effect_reqs_benchmark.calls++;
+
+  timer_start(effect_reqs_benchmark.plain);
+  for (i = 0; i < EFFECT_REQS_BENCHMARK_RUNS; i++) {
+    plain = target_bonus_effects_plain(target_player, other_player,
+                                       target_city, target_building,
+                                       target_tile, target_unit,
+                                       target_unittype, target_output,
+                                       target_specialist, effect_type);
+  }
+  timer_stop(effect_reqs_benchmark.plain);
+
+  timer_start(effect_reqs_benchmark.compiled);
+  for (i = 0; i < EFFECT_REQS_BENCHMARK_RUNS; i++) {
+    /* Fill the list only once. */
+    bonus = target_bonus_effects_compiled(0 == i ? plist : NULL,
+                                          target_player, other_player,
+                                          target_city, target_building,
+                                          target_tile, target_unit,
+                                          target_unittype, target_output,
+                                          target_specialist, effect_type);
+  }
+  timer_stop(effect_reqs_benchmark.compiled);
 
-      if (plist) {
-	effect_list_append(plist, peffect);
-      }
-    }
-  } effect_list_iterate_end;
+  if (plain != bonus) {
+    effect_reqs_benchmark.mismatches++;
+  }
+  fc_assert_msg(plain == bonus, "%s: plain %d, compiled %d.",
+                effect_type_name(effect_type), plain, bonus);
 
   return bonus;
+#else  /* EFFECT_REQS_BENCHMARK */
+  return target_bonus_effects_compiled(plist, target_player, other_player,
+                                       target_city, target_building,
+                                       target_tile, target_unit,
+                                       target_unittype, target_output,
+                                       target_specialist, effect_type);
+#endif /* EFFECT_REQS_BENCHMARK */
 }
 
 /**************************************************************************
@@ -533,10 +1460,7 @@ int get_player_bonus(const struct player *pplayer,
     return 0;
   }
 
-  return get_target_bonus_effects(NULL,
-                                  pplayer, NULL, NULL, NULL,
-                                  NULL, NULL, NULL, NULL,
-                                  NULL, effect_type);
+  return effect_cache_bonus(pplayer, NULL, effect_type);
 }
 
 /**************************************************************************
@@ -548,10 +1472,7 @@ int get_city_bonus(const struct city *pcity, enum effect_type effect_type)
     return 0;
   }
 
-  return get_target_bonus_effects(NULL,
-                                  city_owner(pcity), NULL, pcity, NULL,
-                                  city_tile(pcity), NULL, NULL, NULL,
-                                  NULL, effect_type);
+  return effect_cache_bonus(city_owner(pcity), pcity, effect_type);
 }
 
 /**************************************************************************
@@ -262,6 +262,14 @@ extern "C" {
 #define SPECENUM_COUNT EFT_COUNT
 #include "specenum_gen.h"
 
+/* A compiled requirement of an effect. 'slot' numbers the different
+ * requirements of the effects of the same type, so that one evaluation can
+ * be shared by all of them; it is -1 when there are too many. */
+struct effect_req {
+  struct requirement req;
+  int slot;
+};
+
 /* An effect is provided by a source.  If the source is present, and the
  * other conditions (described below) are met, the effect will be active.
  * Note the difference between effect and effect_type. */
@@ -276,6 +284,19 @@ struct effect {
   /* An effect can have multiple requirements.  The effect will only be
    * active if all of these requirement are met. */
   struct requirement_vector reqs;
+
+  /* The requirements as evaluated by get_target_bonus_effects(): cheapest
+   * first, without those always met. 'never' is set when they contradict
+   * each other, and 'needs' holds the targets without which they cannot
+   * be met. 'gate' is a source the target must have for the effect to be
+   * active, VUT_NONE if there is none to index the effect by. */
+  struct {
+    bool never;
+    int needs;
+    int count;
+    struct effect_req *reqs;
+    struct universal gate;
+  } compiled;
 };
 
 /* An effect_list is a list of effects. */
@@ -299,6 +320,21 @@ void ruleset_cache_free(void);
 void recv_ruleset_effect(const struct packet_ruleset_effect *packet);
 void send_ruleset_cache(struct conn_list *dest);
 
+/* cache of the effect values of the players and cities */
+struct effect_cache;
+
+void effect_cache_deps_init(void);
+void effect_cache_destroy(struct effect_cache *pcache);
+void effect_cache_advances_changed(void);
+void effect_cache_wonders_changed(void);
+void effect_cache_buildings_changed(struct effect_cache *pcache);
+void effect_cache_fill(const struct player *pplayer);
+void effect_cache_freeze(void);
+void effect_cache_thaw(void);
+unsigned int effect_cache_stamp(void);
+
+bool effects_have_req_kind(enum universals_n kind);
+
 int effect_cumulative_max(enum effect_type type);
 int effect_cumulative_min(enum effect_type type);
 
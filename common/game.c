@@ -32,6 +32,7 @@
 #include "city.h"
 #include "connection.h"
 #include "disaster.h"
+#include "effects.h"
 #include "extras.h"
 #include "government.h"
 #include "idex.h"
@@ -390,6 +391,10 @@ static void game_defaults(void)
     game.server.occupychance      = GAME_DEFAULT_OCCUPYCHANCE;
     game.server.onsetbarbarian    = GAME_DEFAULT_ONSETBARBARIAN;
     game.server.phase_mode_stored = GAME_DEFAULT_PHASE_MODE;
+    game.server.pfthreads         = GAME_DEFAULT_PFTHREADS;
+    game.server.citythreads       = GAME_DEFAULT_CITYTHREADS;
+    game.server.mapimg_threads    = GAME_DEFAULT_MAPIMG_THREADS;
+    game.server.mapimg_background = GAME_DEFAULT_MAPIMG_BACKGROUND;
     game.server.pingtime          = GAME_DEFAULT_PINGTIME;
     game.server.pingtimeout       = GAME_DEFAULT_PINGTIMEOUT;
     game.server.razechance        = GAME_DEFAULT_RAZECHANCE;
@@ -398,8 +403,11 @@ static void game_defaults(void)
     sz_strlcpy(game.server.rulesetdir, GAME_DEFAULT_RULESETDIR);
     game.server.save_compress_level = GAME_DEFAULT_COMPRESS_LEVEL;
     game.server.save_compress_type = GAME_DEFAULT_COMPRESS_TYPE;
+    game.server.save_binary       = GAME_DEFAULT_SAVE_BINARY;
     sz_strlcpy(game.server.save_name, GAME_DEFAULT_SAVE_NAME);
     game.server.save_nturns       = GAME_DEFAULT_SAVETURNS;
+    game.server.save_async        = GAME_DEFAULT_SAVE_ASYNC;
+    game.server.save_deltas       = GAME_DEFAULT_SAVE_DELTAS;
     game.server.save_options.save_known = TRUE;
     game.server.save_options.save_private_map = TRUE;
     game.server.save_options.save_random = TRUE;
@@ -576,6 +584,7 @@ void initialize_globals(void)
       } city_built_iterate_end;
     } city_list_iterate_end;
   } players_iterate_end;
+  effect_cache_wonders_changed();
 }
 
 /**************************************************************************
@@ -115,6 +115,7 @@ struct civ_game {
       int autoupgrade_veteran_loss;
       enum barbarians_rate barbarianrate;
       int base_incite_cost;
+      int citythreads;
       int civilwarsize;
       int conquercost;
       int contactturns;
@@ -132,6 +133,8 @@ struct civ_game {
       int init_vis_radius_sq;
       int kick_time;
       int killunhomed;    /* slowly killing unhomed units */
+      bool mapimg_background;
+      int mapimg_threads;
       int maxconnectionsperhost;
       int max_players;
       char nationset[MAX_LEN_NAME];
@@ -147,6 +150,7 @@ struct civ_game {
       int num_phases;
       int occupychance;
       int onsetbarbarian;
+      int pfthreads;
       int pingtime;
       int pingtimeout;
       int ransom_gold;
@@ -155,8 +159,11 @@ struct civ_game {
       int revolution_length;
       int save_compress_level;
       enum fz_method save_compress_type;
+      bool save_binary;
       int save_nturns;
       int save_frequency;
+      bool save_async;
+      int save_deltas;
       unsigned autosaves; /* FIXME: char would be enough, but current settings.c code wants to
                              write sizeof(unsigned) bytes */
       bool savepalace;
@@ -503,6 +510,20 @@ extern struct civ_game game;
 #define GAME_MIN_NETWAIT             0
 #define GAME_MAX_NETWAIT             20
 
+#define GAME_DEFAULT_PFTHREADS       0
+#define GAME_MIN_PFTHREADS           0
+#define GAME_MAX_PFTHREADS           16
+
+#define GAME_DEFAULT_CITYTHREADS     0
+#define GAME_MIN_CITYTHREADS         0
+#define GAME_MAX_CITYTHREADS         16
+
+#define GAME_DEFAULT_MAPIMG_THREADS  0
+#define GAME_MIN_MAPIMG_THREADS      0
+#define GAME_MAX_MAPIMG_THREADS      16
+
+#define GAME_DEFAULT_MAPIMG_BACKGROUND FALSE
+
 #define GAME_DEFAULT_PINGTIME        20
 #define GAME_MIN_PINGTIME            1
 #define GAME_MAX_PINGTIME            1800
@@ -554,6 +575,11 @@ extern struct civ_game game;
 #define GAME_MAX_SAVEFREQUENCY       1440
 
 #define GAME_DEFAULT_AUTOSAVES       (1 << AS_TURN | 1 << AS_GAME_OVER | 1 << AS_QUITIDLE | 1 << AS_INTERRUPT)
+#define GAME_DEFAULT_SAVE_ASYNC      FALSE
+
+#define GAME_DEFAULT_SAVE_DELTAS     0
+#define GAME_MIN_SAVE_DELTAS         0
+#define GAME_MAX_SAVE_DELTAS         50
 
 #define GAME_DEFAULT_SKILL_LEVEL     AI_LEVEL_EASY
 #define GAME_HARDCODED_DEFAULT_SKILL_LEVEL 3 /* that was 'easy' in old saves */
@@ -588,6 +614,8 @@ extern struct civ_game game;
 #  define GAME_DEFAULT_COMPRESS_TYPE FZ_PLAIN
 #endif
 
+#define GAME_DEFAULT_SAVE_BINARY     FALSE
+
 #define GAME_DEFAULT_ALLOWED_CITY_NAMES CNM_PLAYER_UNIQUE
 
 #define GAME_DEFAULT_PLRCOLORMODE PLRCOL_PLR_ORDER
@@ -1082,6 +1082,9 @@ class Packet:
         self.want_force="force" in arr
         if self.want_force: arr.remove("force")
 
+        self.want_batch="batch" in arr
+        if self.want_batch: arr.remove("batch")
+
         self.cancel=[]
         removes=[]
         remaining=[]
@@ -1299,6 +1302,25 @@ class Packet:
         else:
             restrict=""
 
+        # See set_batch_groups().
+        batch=""
+        if self.want_batch:
+            key=self.key_fields[0].name
+            if self.want_force:
+                force="force_to_send"
+            else:
+                force="FALSE"
+            batch='''  if (conn_batch_stage(pc, %(batch_group)s, packet->%(key)s,
+                       packet, sizeof(*packet), %(force)s,
+                       send_%(name)s_batched)) {
+    return 0;
+  }
+'''%self.get_dict(vars())
+        for group in self.batch_close:
+            key=self.fields[0].name
+            batch=batch+'''  conn_batch_close(pc, %(group)s, packet->%(key)s);
+'''%self.get_dict(vars())
+
         result='''%(send_prototype)s
 {
   if(!pc->used) {
@@ -1307,7 +1329,7 @@ class Packet:
     return -1;
   }
   fc_assert_ret_val(NULL != pc->phs.variant, -1);
-%(restrict)s  ensure_valid_variant_%(name)s(pc);
+%(restrict)s%(batch)s  ensure_valid_variant_%(name)s(pc);
 
   switch(pc->phs.variant[%(type)s]) {
 '''%self.get_dict(vars())
@@ -1346,6 +1368,22 @@ class Packet:
         result=result+self.get_ensure_valid_variant()
         return result
 
+    # Returns a code fragement which is the implementation of the
+    # function sending a packet staged in a connection batch.
+    def get_batch_send(self):
+        if not self.want_batch: return ""
+        if self.want_force:
+            args="packet, force_to_send"
+        else:
+            args="packet"
+        return '''static int send_%(name)s_batched(struct connection *pc,
+                                     const void *packet, bool force_to_send)
+{
+  return send_%(name)s(pc, %(args)s);
+}
+
+'''%self.get_dict(vars())
+
     # Returns a code fragement which is the implementation of the
     # lsend function.
     def get_lsend(self):
@@ -1391,6 +1429,34 @@ class Packet:
 
 '''%self.get_dict(vars())
 
+# Packets with the batch flag are grouped with the packets they cancel:
+# a packet of a group replaces the staged packet with the same key in a
+# connection batch. Other packets cancelling a group close it for their
+# key, see conn_batch_close().
+def set_batch_groups(packets):
+    by_type={}
+    for p in packets:
+        by_type[p.type]=p
+        p.batch_group=None
+        p.batch_close=[]
+
+    for p in packets:
+        if not p.want_batch: continue
+        assert len(p.key_fields)>=1,repr(p.name)
+        group=[p]
+        for i in p.cancel:
+            q=by_type[i]
+            assert q.want_batch,"%s cancels %s which is not batched"%(p.name,q.name)
+            group.append(q)
+        p.batch_group=min(group,key=lambda x:x.type_number).type
+
+    for p in packets:
+        if p.want_batch: continue
+        for i in p.cancel:
+            group=by_type[i].batch_group
+            if group and group not in p.batch_close:
+                p.batch_close.append(group)
+
 # Returns a code fragement which is the implementation of the
 # delta_stats_report() function.
 def get_report(packets):
@@ -1568,6 +1634,7 @@ def main():
         str=str.strip()
         if str:
             packets.append(Packet(str,types))
+    set_batch_groups(packets)
 
     ### parsing finished
 
@@ -1674,6 +1741,7 @@ static int stats_total_sent;
     for p in packets:
         output_c.write(p.get_variants())
         output_c.write(p.get_receive())
+        output_c.write(p.get_batch_send())
         output_c.write(p.get_send())
         output_c.write(p.get_lsend())
         output_c.write(p.get_dsend())
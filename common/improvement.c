@@ -24,6 +24,7 @@
 #include "support.h"
 
 /* common */
+#include "effects.h"
 #include "game.h"
 #include "map.h"
 #include "tech.h"
@@ -719,6 +720,7 @@ void wonder_built(const struct city *pcity, const struct impr_type *pimprove)
   if (is_great_wonder(pimprove)) {
     game.info.great_wonder_owners[index] = player_number(pplayer);
   }
+  effect_cache_wonders_changed();
 }
 
 /**************************************************************************
@@ -743,6 +745,7 @@ void wonder_destroyed(const struct city *pcity,
                    == player_number(pplayer));
     game.info.great_wonder_owners[index] = WONDER_DESTROYED;
   }
+  effect_cache_wonders_changed();
 }
 
 /**************************************************************************
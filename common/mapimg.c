@@ -17,6 +17,10 @@
 
 #include <stdarg.h>
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 #ifdef HAVE_MAPIMG_MAGICKWAND
   #include <wand/MagickWand.h>
 #endif /* HAVE_MAPIMG_MAGICKWAND */
@@ -25,6 +29,8 @@
 #include "astring.h"
 #include "bitvector.h"
 #include "fcintl.h"
+#include "fcthread.h"
+#include "fcthreadpool.h"
 #include "log.h"
 #include "mem.h"
 #include "netintf.h"
@@ -77,7 +83,9 @@ enum img_special {
 };
 
 static const struct rgbcolor *imgcolor_special(enum img_special imgcolor);
+#ifdef HAVE_MAPIMG_MAGICKWAND
 static const struct rgbcolor *imgcolor_player(int plr_id);
+#endif /* HAVE_MAPIMG_MAGICKWAND */
 static const struct rgbcolor
   *imgcolor_terrain(const struct terrain *pterrain);
 
@@ -94,9 +102,8 @@ struct tile_shape {
 
 struct img;
 
-typedef bv_pixel (*plot_func)(const struct tile *ptile,
-                              const struct player *pplayer,
-                              bool knowledge);
+typedef bv_pixel (*plot_func)(const struct img *pimg,
+                              const struct tile *ptile);
 typedef void (*base_coor_func)(struct img *pimg, int *base_x, int *base_y,
                                int x, int y);
 
@@ -120,21 +127,16 @@ static struct tile_shape tile_rect = {
   }
 };
 
-static bv_pixel pixel_tile_rect(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge);
-static bv_pixel pixel_city_rect(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge);
-static bv_pixel pixel_unit_rect(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge);
-static bv_pixel pixel_fogofwar_rect(const struct tile *ptile,
-                                    const struct player *pplayer,
-                                    bool knowledge);
-static bv_pixel pixel_border_rect(const struct tile *ptile,
-                                  const struct player *pplayer,
-                                  bool knowledge);
+static bv_pixel pixel_tile_rect(const struct img *pimg,
+                                const struct tile *ptile);
+static bv_pixel pixel_city_rect(const struct img *pimg,
+                                const struct tile *ptile);
+static bv_pixel pixel_unit_rect(const struct img *pimg,
+                                const struct tile *ptile);
+static bv_pixel pixel_fogofwar_rect(const struct img *pimg,
+                                    const struct tile *ptile);
+static bv_pixel pixel_border_rect(const struct img *pimg,
+                                  const struct tile *ptile);
 static void base_coor_rect(struct img *pimg, int *base_x, int *base_y,
                            int x, int y);
 
@@ -162,21 +164,16 @@ static struct tile_shape tile_hexa = {
   }
 };
 
-static bv_pixel pixel_tile_hexa(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge);
-static bv_pixel pixel_city_hexa(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge);
-static bv_pixel pixel_unit_hexa(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge);
-static bv_pixel pixel_fogofwar_hexa(const struct tile *ptile,
-                                    const struct player *pplayer,
-                                    bool knowledge);
-static bv_pixel pixel_border_hexa(const struct tile *ptile,
-                                  const struct player *pplayer,
-                                  bool knowledge);
+static bv_pixel pixel_tile_hexa(const struct img *pimg,
+                                const struct tile *ptile);
+static bv_pixel pixel_city_hexa(const struct img *pimg,
+                                const struct tile *ptile);
+static bv_pixel pixel_unit_hexa(const struct img *pimg,
+                                const struct tile *ptile);
+static bv_pixel pixel_fogofwar_hexa(const struct img *pimg,
+                                    const struct tile *ptile);
+static bv_pixel pixel_border_hexa(const struct img *pimg,
+                                  const struct tile *ptile);
 static void base_coor_hexa(struct img *pimg, int *base_x, int *base_y,
                            int x, int y);
 
@@ -200,21 +197,16 @@ static struct tile_shape tile_isohexa = {
   }
 };
 
-static bv_pixel pixel_tile_isohexa(const struct tile *ptile,
-                                   const struct player *pplayer,
-                                   bool knowledge);
-static bv_pixel pixel_city_isohexa(const struct tile *ptile,
-                                   const struct player *pplayer,
-                                   bool knowledge);
-static bv_pixel pixel_unit_isohexa(const struct tile *ptile,
-                                   const struct player *pplayer,
-                                   bool knowledge);
-static bv_pixel pixel_fogofwar_isohexa(const struct tile *ptile,
-                                       const struct player *pplayer,
-                                       bool knowledge);
-static bv_pixel pixel_border_isohexa(const struct tile *ptile,
-                                     const struct player *pplayer,
-                                     bool knowledge);
+static bv_pixel pixel_tile_isohexa(const struct img *pimg,
+                                   const struct tile *ptile);
+static bv_pixel pixel_city_isohexa(const struct img *pimg,
+                                   const struct tile *ptile);
+static bv_pixel pixel_unit_isohexa(const struct img *pimg,
+                                   const struct tile *ptile);
+static bv_pixel pixel_fogofwar_isohexa(const struct img *pimg,
+                                       const struct tile *ptile);
+static bv_pixel pixel_border_isohexa(const struct img *pimg,
+                                     const struct tile *ptile);
 static void base_coor_isohexa(struct img *pimg, int *base_x, int *base_y,
                               int x, int y);
 
@@ -266,6 +258,8 @@ BV_DEFINE(bv_mapdef_arg, MAPDEF_COUNT);
 #define SPECENUM_VALUE0NAME "ppm"
 #define SPECENUM_VALUE1     IMGTOOL_MAGICKWAND
 #define SPECENUM_VALUE1NAME "magick"
+#define SPECENUM_VALUE2     IMGTOOL_PNG
+#define SPECENUM_VALUE2NAME "png"
 #include "specenum_gen.h"
 
 /* player definitions */
@@ -362,11 +356,35 @@ struct mapdef;
 #define IMG_LINE_HEIGHT 5
 #define IMG_TEXT_HEIGHT 12
 
+/* The state of a tile as drawn in an image. It is taken from the game
+ * by img_snapshot(), so that the image can be drawn in other threads. */
+struct img_tile {
+  const struct terrain *terrain;
+  enum known_type known;
+  int owner;                    /* Player indices, or -1. */
+  int city;
+  int unit;
+};
+
 struct img {
   struct mapdef *def; /* map definition */
   int turn; /* save turn */
   char title[MAX_LEN_MAPDEF];
 
+  /* game data used by the image (see img_snapshot()) */
+  struct img_tile *tiles;
+  bool single_player; /* only one player; 'known' and 'fogofwar' apply */
+  bool borders;
+  bool fogofwar;
+  struct rgbcolor plrcolor[MAX_NUM_PLAYER_SLOTS];
+  char plrname[MAX_NUM_PLAYER_SLOTS][MAX_LEN_NAME];
+
+  /* images made in the background (see mapimg_create()) */
+  bool background;
+  struct mapdef bgdef;
+  char mapimgfile[MAX_LEN_PATH];
+  char path[MAX_LEN_PATH];
+
   /* topology definition */
   struct tile_shape *tileshape;
   plot_func pixel_tile;
@@ -389,18 +407,37 @@ struct img {
 
 static struct img *img_new(struct mapdef *mapdef, int topo, int xsize, int ysize);
 static void img_destroy(struct img *pimg);
+static void img_map_new(struct img *pimg);
+static void img_snapshot(struct img *pimg);
+static inline enum known_type img_tile_known(const struct img *pimg,
+                                             const struct tile *ptile);
+static inline int img_tile_owner(const struct img *pimg,
+                                 const struct tile *ptile);
+static inline const struct rgbcolor *img_color_player(const struct img *pimg,
+                                                      int plr_id);
 static inline void img_set_pixel(struct img *pimg, const int index,
                                  const struct rgbcolor *pcolor);
 static inline int img_index(const int x, const int y,
                             const struct img *pimg);
-static const char *img_playerstr(const struct player *pplayer);
+static const char *img_playerstr(const struct img *pimg, int plr_id,
+                                 char *buf, size_t buf_len);
+static void img_plot_rows(struct img *pimg, int x, int y,
+                          const struct rgbcolor *pcolor, const bv_pixel pixel,
+                          int row_min, int row_max);
 static void img_plot(struct img *pimg, int x, int y,
                      const struct rgbcolor *pcolor, const bv_pixel pixel);
 static void img_plot_tile(struct img *pimg, const struct tile *ptile,
-                          const struct rgbcolor *pcolor, const bv_pixel pixel);
+                          const struct rgbcolor *pcolor, const bv_pixel pixel,
+                          int row_min, int row_max);
+static void img_log(const struct img *pimg, const char *file,
+                    const char *function, int line, const char *format, ...)
+                    fc__attribute((__format__(__printf__, 5, 6)));
 static bool img_save(const struct img *pimg, const char *mapimgfile,
                      const char *path);
 static bool img_save_ppm(const struct img *pimg, const char *mapimgfile);
+#ifdef HAVE_LIBZ
+static bool img_save_png(const struct img *pimg, const char *mapimgfile);
+#endif /* HAVE_LIBZ */
 #ifdef HAVE_MAPIMG_MAGICKWAND
 static bool img_save_magickwand(const struct img *pimg,
                                 const char *mapimgfile);
@@ -408,6 +445,24 @@ static bool img_save_magickwand(const struct img *pimg,
 static bool img_filename(const char *mapimgfile, enum imageformat format,
                          char *filename, size_t filename_len);
 static void img_createmap(struct img *pimg);
+static void img_createmap_band(int index, void *data);
+static void img_render_tile(struct img *pimg, const struct tile *ptile,
+                            int row_min, int row_max);
+
+/* Images made in the background. */
+#define SPECLIST_TAG img
+#define SPECLIST_TYPE struct img
+#include "speclist.h"
+
+#define img_list_iterate(img_list, pimg) \
+  TYPED_LIST_ITERATE(struct img, img_list, pimg)
+#define img_list_iterate_end \
+  LIST_ITERATE_END
+
+static void img_background_thread(void *arg);
+static void img_background_wait(void);
+static bool img_create(struct mapdef *pmapdef, const char *savename,
+                       const char *path, struct img_list *images);
 
 /* == image toolkits == */
 typedef bool (*img_save_func)(const struct img *pimg,
@@ -428,6 +483,11 @@ static struct toolkit img_toolkits[] = {
   GEN_TOOLKIT(IMGTOOL_PPM, IMGFORMAT_PPM, IMGFORMAT_PPM,
               img_save_ppm,
               N_("Standard ppm files"))
+#ifdef HAVE_LIBZ
+  GEN_TOOLKIT(IMGTOOL_PNG, IMGFORMAT_PNG, IMGFORMAT_PNG,
+              img_save_png,
+              N_("Built-in png files"))
+#endif /* HAVE_LIBZ */
 #ifdef HAVE_MAPIMG_MAGICKWAND
   GEN_TOOLKIT(IMGTOOL_MAGICKWAND, IMGFORMAT_GIF,
               IMGFORMAT_GIF + IMGFORMAT_PNG + IMGFORMAT_PPM + IMGFORMAT_JPG,
@@ -469,6 +529,10 @@ static void mapimg_log(const char *file, const char *function, int line,
   mapimg_log(__FILE__, __FUNCTION__, __FC_LINE__, format, ## __VA_ARGS__)
 #define MAPIMG_ASSERT_RET_VAL(cond, expr)                                   \
   fc_assert_action(cond, MAPIMG_LOG(_("internal error")); return (expr))
+/* Errors about an image which may be saved in the background. */
+#define IMG_LOG(pimg, format, ...)                                          \
+  img_log(pimg, __FILE__, __FUNCTION__, __FC_LINE__, format,                \
+          ## __VA_ARGS__)
 
 /* == additional functions == */
 
@@ -487,6 +551,11 @@ static struct {
   mapimg_tile_player_func mapimg_tile_unit;
   mapimg_plrcolor_count_func mapimg_plrcolor_count;
   mapimg_plrcolor_get_func mapimg_plrcolor_get;
+
+  int threads;                     /* Extra threads to draw an image. */
+  struct fc_threadpool *workers;
+  fc_thread *bg_thread;            /* Draws and saves images in the
+                                    * background. */
 } mapimg = { .init = FALSE };
 
 /*
@@ -541,6 +610,8 @@ void mapimg_reset(void)
     return;
   }
 
+  img_background_wait();
+
   if (mapdef_list_size(mapimg.mapdef) > 0) {
     mapdef_list_iterate(mapimg.mapdef, pmapdef) {
       mapdef_list_remove(mapimg.mapdef, pmapdef);
@@ -561,9 +632,51 @@ void mapimg_free(void)
   mapimg_reset();
   mapdef_list_destroy(mapimg.mapdef);
 
+  if (NULL != mapimg.workers) {
+    fc_threadpool_destroy(mapimg.workers);
+    mapimg.workers = NULL;
+  }
+  mapimg.threads = 0;
+
   mapimg.init = FALSE;
 }
 
+/****************************************************************************
+  Set the number of extra threads used to draw each map image. With 0, the
+  images are drawn in a single thread.
+****************************************************************************/
+void mapimg_set_threads(int threads)
+{
+  if (!mapimg_initialised() || threads == mapimg.threads) {
+    return;
+  }
+
+  /* The workers may be in use by the background thread. */
+  img_background_wait();
+
+  if (NULL != mapimg.workers) {
+    fc_threadpool_destroy(mapimg.workers);
+    mapimg.workers = NULL;
+  }
+  if (0 < threads) {
+    mapimg.workers = fc_threadpool_new(threads);
+  }
+  mapimg.threads = threads;
+}
+
+/****************************************************************************
+  Wait for the map images created in the background to be saved. They
+  must be before the map is freed.
+****************************************************************************/
+void mapimg_wait(void)
+{
+  if (!mapimg_initialised()) {
+    return;
+  }
+
+  img_background_wait();
+}
+
 /****************************************************************************
   Return the number of map image definitions.
 ****************************************************************************/
@@ -1315,12 +1428,15 @@ bool mapimg_id2str(int id, char *str, size_t str_len)
   contains the map definition and <mapext> the selected image extension.
   If 'force' is FALSE, the image is only created if game.info.turn is a
   multiple of the map setting turns.
+
+  If 'background' is TRUE, only the data of the game needed by the images
+  is taken now; they are drawn and saved by another thread. The errors
+  are then logged, and not reported by the return value.
 ****************************************************************************/
 bool mapimg_create(struct mapdef *pmapdef, bool force, const char *savename,
-                   const char *path)
+                   const char *path, bool background)
 {
-  struct img *pimg;
-  char mapimgfile[MAX_LEN_PATH];
+  struct img_list *images = NULL;
   bool ret = TRUE;
 #ifdef DEBUG
   struct timer *timer_cpu, *timer_user;
@@ -1356,6 +1472,12 @@ bool mapimg_create(struct mapdef *pmapdef, bool force, const char *savename,
   timer_start(timer_user);
 #endif
 
+  /* The images of the previous call may still use the workers. */
+  img_background_wait();
+  if (background) {
+    images = img_list_new();
+  }
+
   /* create map */
   switch (pmapdef->player.show) {
   case SHOW_PLRNAME: /* display player given by name */
@@ -1363,15 +1485,7 @@ bool mapimg_create(struct mapdef *pmapdef, bool force, const char *savename,
   case SHOW_NONE:    /* no player one the map */
   case SHOW_ALL:     /* show all players in one map */
   case SHOW_PLRBV:   /* display player(s) given by bitvector */
-    generate_save_name(savename, mapimgfile, sizeof(mapimgfile),
-                       mapimg_generate_name(pmapdef));
-
-    pimg = img_new(pmapdef, CURRENT_TOPOLOGY, map.xsize, map.ysize);
-    img_createmap(pimg);
-    if (!img_save(pimg, mapimgfile, path)) {
-      ret = FALSE;
-    }
-    img_destroy(pimg);
+    ret = img_create(pmapdef, savename, path, images);
     break;
   case SHOW_EACH:    /* one map for each player */
   case SHOW_HUMAN:   /* one map for each human player */
@@ -1386,16 +1500,7 @@ bool mapimg_create(struct mapdef *pmapdef, bool force, const char *savename,
       BV_CLR_ALL(pmapdef->player.checked_plrbv);
       BV_SET(pmapdef->player.checked_plrbv, player_index(pplayer));
 
-      generate_save_name(savename, mapimgfile, sizeof(mapimgfile),
-                         mapimg_generate_name(pmapdef));
-
-      pimg = img_new(pmapdef, CURRENT_TOPOLOGY, map.xsize, map.ysize);
-      img_createmap(pimg);
-      if (!img_save(pimg, mapimgfile, path)) {
-        ret = FALSE;
-      }
-      img_destroy(pimg);
-
+      ret = img_create(pmapdef, savename, path, images);
       if (!ret) {
         break;
       }
@@ -1403,6 +1508,22 @@ bool mapimg_create(struct mapdef *pmapdef, bool force, const char *savename,
     break;
   }
 
+  if (NULL != images) {
+    if (0 == img_list_size(images)) {
+      img_list_destroy(images);
+    } else {
+      mapimg.bg_thread = fc_malloc(sizeof(*mapimg.bg_thread));
+      if (0 != fc_thread_start(mapimg.bg_thread, img_background_thread,
+                               images)) {
+        log_error("Can't start a thread to save the map images; "
+                  "saving them now.");
+        free(mapimg.bg_thread);
+        mapimg.bg_thread = NULL;
+        img_background_thread(images);
+      }
+    }
+  }
+
 #ifdef DEBUG
   log_debug("Image generation time: %g seconds (%g apparent)",
             timer_read_seconds(timer_cpu),
@@ -1439,7 +1560,8 @@ bool mapimg_colortest(const char *savename, const char *path)
   pimg = img_new(pmapdef, 0, SIZE_X + 2,
                  SIZE_Y * (max_playercolor / SIZE_X) + 2);
 
-  pixel = pimg->pixel_tile(NULL, NULL, FALSE);
+  img_map_new(pimg);
+  pixel = pimg->pixel_tile(pimg, NULL);
 
   pcolor = imgcolor_special(IMGCOLOR_OCEAN);
   for (i = 0; i < MAX(max_playercolor, max_terraincolor); i++) {
@@ -1698,6 +1820,27 @@ static void mapimg_log(const char *file, const char *function, int line,
 #endif
 }
 
+/****************************************************************************
+  Error about an image. For an image saved in the background, the error
+  buffer is owned by the main thread: the error is logged instead.
+****************************************************************************/
+static void img_log(const struct img *pimg, const char *file,
+                    const char *function, int line, const char *format, ...)
+{
+  char buf[MAX_LEN_ERRORBUF];
+  va_list args;
+
+  va_start(args, format);
+  fc_vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  if (pimg->background) {
+    log_error(_("Map image: %s"), buf);
+  } else {
+    mapimg_log(file, function, line, "%s", buf);
+  }
+}
+
 /****************************************************************************
   Generate an identifier for a map image.
 
@@ -1848,7 +1991,7 @@ static struct img *img_new(struct mapdef *mapdef, int topo, int xsize, int ysize
 {
   struct img *pimg;
 
-  pimg = fc_malloc(sizeof(*pimg));
+  pimg = fc_calloc(1, sizeof(*pimg));
 
   pimg->def = mapdef;
   pimg->turn = game.info.turn;
@@ -1927,15 +2070,25 @@ static struct img *img_new(struct mapdef *mapdef, int topo, int xsize, int ysize
     pimg->base_coor = base_coor_rect;
   }
 
-  /* Here the map image is saved as an array of RGB color values. */
-  pimg->map = fc_calloc(pimg->imgsize.x * pimg->imgsize.y,
-                        sizeof(*pimg->map));
-  /* Initialise map. */
-  memset(pimg->map, 0, pimg->imgsize.x * pimg->imgsize.y);
+  /* The pixels are allocated by img_map_new(), when the image is drawn. */
+  pimg->map = NULL;
+  pimg->tiles = NULL;
 
   return pimg;
 }
 
+/****************************************************************************
+  Allocate the pixels of the image. The map image is saved as an array of
+  RGB color values.
+****************************************************************************/
+static void img_map_new(struct img *pimg)
+{
+  fc_assert_ret(pimg->map == NULL);
+
+  pimg->map = fc_calloc(pimg->imgsize.x * pimg->imgsize.y,
+                        sizeof(*pimg->map));
+}
+
 /****************************************************************************
   Destroy a image.
 ****************************************************************************/
@@ -1943,11 +2096,104 @@ static void img_destroy(struct img *pimg)
 {
   if (pimg != NULL) {
     /* do not free pimg->def */
-    free(pimg->map);
+    if (pimg->map != NULL) {
+      free(pimg->map);
+    }
+    if (pimg->tiles != NULL) {
+      free(pimg->tiles);
+    }
     free(pimg);
   }
 }
 
+/****************************************************************************
+  Take from the game the data the image is drawn from: the state of the
+  tiles as known by the displayed player, if there is only one, and the
+  colors and names of the players. After this, the image can be drawn and
+  saved in another thread.
+****************************************************************************/
+static void img_snapshot(struct img *pimg)
+{
+  struct player *pplayer = NULL;
+  struct player *plr_tile, *plr_city, *plr_unit;
+  bool plr_knowledge = pimg->def->layers[MAPIMG_LAYER_KNOWLEDGE];
+
+  if (bvplayers_count(pimg->def) == 1) {
+    /* only one player; get player id for 'known' and 'fogofwar' */
+    players_iterate(aplayer) {
+      if (BV_ISSET(pimg->def->player.checked_plrbv,
+                   player_index(aplayer))) {
+        pplayer = aplayer;
+        break;
+      }
+    } players_iterate_end;
+  }
+
+  pimg->single_player = (pplayer != NULL);
+  pimg->borders = (game.info.borders > 0);
+  pimg->fogofwar = game.info.fogofwar;
+
+  players_iterate(aplayer) {
+    int plr_id = player_index(aplayer);
+
+    if (aplayer->rgb != NULL) {
+      pimg->plrcolor[plr_id] = *aplayer->rgb;
+    } else {
+      pimg->plrcolor[plr_id] = *imgcolor_special(IMGCOLOR_ERROR);
+    }
+    sz_strlcpy(pimg->plrname[plr_id], player_name(aplayer));
+  } players_iterate_end;
+
+  pimg->tiles = fc_malloc(MAP_INDEX_SIZE * sizeof(*pimg->tiles));
+  whole_map_iterate(ptile) {
+    struct img_tile *itile = pimg->tiles + tile_index(ptile);
+
+    itile->known = (pplayer != NULL
+                    ? mapimg.mapimg_tile_known(ptile, pplayer, plr_knowledge)
+                    : TILE_KNOWN_SEEN);
+    itile->terrain = mapimg.mapimg_tile_terrain(ptile, pplayer,
+                                                plr_knowledge);
+
+    plr_tile = mapimg.mapimg_tile_owner(ptile, pplayer, plr_knowledge);
+    itile->owner = (plr_tile != NULL ? player_index(plr_tile) : -1);
+    plr_city = mapimg.mapimg_tile_city(ptile, pplayer, plr_knowledge);
+    itile->city = (plr_city != NULL ? player_index(plr_city) : -1);
+    plr_unit = mapimg.mapimg_tile_unit(ptile, pplayer, plr_knowledge);
+    itile->unit = (plr_unit != NULL ? player_index(plr_unit) : -1);
+  } whole_map_iterate_end;
+}
+
+/****************************************************************************
+  Return the knowledge of the tile, as taken by img_snapshot().
+****************************************************************************/
+static inline enum known_type img_tile_known(const struct img *pimg,
+                                             const struct tile *ptile)
+{
+  return pimg->tiles[tile_index(ptile)].known;
+}
+
+/****************************************************************************
+  Return the index of the owner of the tile, as taken by img_snapshot(),
+  or -1.
+****************************************************************************/
+static inline int img_tile_owner(const struct img *pimg,
+                                 const struct tile *ptile)
+{
+  return pimg->tiles[tile_index(ptile)].owner;
+}
+
+/****************************************************************************
+  Return the color of the player, as taken by img_snapshot().
+****************************************************************************/
+static inline const struct rgbcolor *img_color_player(const struct img *pimg,
+                                                      int plr_id)
+{
+  fc_assert_ret_val(plr_id >= 0 && plr_id < MAX_NUM_PLAYER_SLOTS,
+                    imgcolor_special(IMGCOLOR_ERROR));
+
+  return &pimg->plrcolor[plr_id];
+}
+
 /****************************************************************************
   Set the color of one pixel.
 ****************************************************************************/
@@ -1976,12 +2222,14 @@ static inline int img_index(const int x, const int y,
 }
 
 /****************************************************************************
-  Plot one tile at (x,y). Only the pixel of the tile set within 'pixel' are ploted.
+  Plot one tile at (x,y). Only the pixel of the tile set within 'pixel' and
+  in the rows from 'row_min' to 'row_max' (excluded) are ploted.
 ****************************************************************************/
-static void img_plot(struct img *pimg, int x, int y,
-                     const struct rgbcolor *pcolor, const bv_pixel pixel)
+static void img_plot_rows(struct img *pimg, int x, int y,
+                          const struct rgbcolor *pcolor, const bv_pixel pixel,
+                          int row_min, int row_max)
 {
-  int base_x, base_y, i, index;
+  int base_x, base_y, i, index, row;
 
   if (!BV_ISSET_ANY(pixel)) {
     return;
@@ -1991,24 +2239,38 @@ static void img_plot(struct img *pimg, int x, int y,
 
   for (i = 0; i < NUM_PIXEL; i++) {
     if (BV_ISSET(pixel, i)) {
-      index = img_index(base_x + pimg->tileshape->x[i],
-                        base_y + pimg->tileshape->y[i], pimg);
+      row = base_y + pimg->tileshape->y[i];
+      if (row < row_min || row >= row_max) {
+        continue;
+      }
+      index = img_index(base_x + pimg->tileshape->x[i], row, pimg);
       img_set_pixel(pimg, index, pcolor);
     }
   }
 }
 
 /****************************************************************************
-  Plot one tile. Only the pixel of the tile set within 'pixel' are ploted.
+  Plot one tile at (x,y). Only the pixel of the tile set within 'pixel' are ploted.
+****************************************************************************/
+static void img_plot(struct img *pimg, int x, int y,
+                     const struct rgbcolor *pcolor, const bv_pixel pixel)
+{
+  img_plot_rows(pimg, x, y, pcolor, pixel, 0, pimg->imgsize.y);
+}
+
+/****************************************************************************
+  Plot one tile. Only the pixel of the tile set within 'pixel' and in the
+  rows from 'row_min' to 'row_max' (excluded) are ploted.
 ****************************************************************************/
 static void img_plot_tile(struct img *pimg, const struct tile *ptile,
-                          const struct rgbcolor *pcolor, const bv_pixel pixel)
+                          const struct rgbcolor *pcolor, const bv_pixel pixel,
+                          int row_min, int row_max)
 {
   int x, y;
 
   index_to_map_pos(&x, &y, tile_index(ptile));
 
-  img_plot(pimg, x, y, pcolor, pixel);
+  img_plot_rows(pimg, x, y, pcolor, pixel, row_min, row_max);
 }
 
 /****************************************************************************
@@ -2022,7 +2284,7 @@ static bool img_save(const struct img *pimg, const char *mapimgfile,
   char tmpname[600];
 
   if (!toolkit) {
-    MAPIMG_LOG(_("toolkit not defined"));
+    IMG_LOG(pimg, _("toolkit not defined"));
     return FALSE;
   }
 
@@ -2039,7 +2301,8 @@ static bool img_save(const struct img *pimg, const char *mapimgfile,
 
   sz_strlcat(tmpname, mapimgfile);
 
-  MAPIMG_ASSERT_RET_VAL(toolkit->img_save, FALSE);
+  fc_assert_action(toolkit->img_save != NULL,
+                   IMG_LOG(pimg, _("internal error")); return FALSE);
 
   return toolkit->img_save(pimg, tmpname);
 }
@@ -2078,7 +2341,7 @@ static bool img_save_magickwand(const struct img *pimg,
   struct player *pplr_now = NULL, *pplr_only = NULL;
   bool ret = TRUE;
   char imagefile[MAX_LEN_PATH];
-  char str_color[32], comment[2048] = "", title[258];
+  char str_color[32], comment[2048] = "", title[258], plrstr[256];
   magickwand_size_t img_width, img_height, map_width, map_height;
   int x, y, xxx, yyy, row, i, index, plrwidth, plroffset, textoffset;
   bool withplr = BV_ISSET_ANY(pimg->def->player.checked_plrbv);
@@ -2247,14 +2510,15 @@ static bool img_save_magickwand(const struct img *pimg,
   cat_snprintf(comment, sizeof(comment), "map definition: %s\n",
                pimg->def->maparg);
   if (BV_ISSET_ANY(pimg->def->player.checked_plrbv)) {
-    players_iterate(pplayer) {
-      if (!BV_ISSET(pimg->def->player.checked_plrbv, player_index(pplayer))) {
+    for (i = 0; i < MAX_NUM_PLAYER_SLOTS; i++) {
+      if (!BV_ISSET(pimg->def->player.checked_plrbv, i)
+          || pimg->plrname[i][0] == '\0') {
         continue;
       }
 
-      pcolor = imgcolor_player(player_index(pplayer));
-      cat_snprintf(comment, sizeof(comment), "%s\n", img_playerstr(pplayer));
-    } players_iterate_end;
+      cat_snprintf(comment, sizeof(comment), "%s\n",
+                   img_playerstr(pimg, i, plrstr, sizeof(plrstr)));
+    }
   }
   MagickCommentImage(mw, comment);
 
@@ -2281,25 +2545,25 @@ static bool img_save_magickwand(const struct img *pimg,
 ****************************************************************************/
 static bool img_save_ppm(const struct img *pimg, const char *mapimgfile)
 {
-  char ppmname[MAX_LEN_PATH];
+  char ppmname[MAX_LEN_PATH], plrstr[256];
   FILE *fp;
-  int x, y, xxx, yyy, index;
+  int x, y, xxx, yyy, i, index;
   const struct rgbcolor *pcolor;
 
   if (pimg->def->format != IMGFORMAT_PPM) {
-    MAPIMG_LOG(_("the ppm toolkit can only create images in the ppm "
-                 "format"));
+    IMG_LOG(pimg, _("the ppm toolkit can only create images in the ppm "
+                    "format"));
     return FALSE;
   }
 
   if (!img_filename(mapimgfile, IMGFORMAT_PPM, ppmname, sizeof(ppmname))) {
-    MAPIMG_LOG(_("error generating the file name"));
+    IMG_LOG(pimg, _("error generating the file name"));
     return FALSE;
   }
 
   fp = fopen(ppmname, "w");
   if (!fp) {
-    MAPIMG_LOG(_("could not open file: %s"), ppmname);
+    IMG_LOG(pimg, _("could not open file: %s"), ppmname);
     return FALSE;
   }
 
@@ -2310,14 +2574,14 @@ static bool img_save_ppm(const struct img *pimg, const char *mapimgfile)
   if (pimg->def->colortest) {
     fprintf(fp, "# color test\n");
   } else if (BV_ISSET_ANY(pimg->def->player.checked_plrbv)) {
-    players_iterate(pplayer) {
-      if (!BV_ISSET(pimg->def->player.checked_plrbv, player_index(pplayer))) {
+    for (i = 0; i < MAX_NUM_PLAYER_SLOTS; i++) {
+      if (!BV_ISSET(pimg->def->player.checked_plrbv, i)
+          || pimg->plrname[i][0] == '\0') {
         continue;
       }
 
-      pcolor = imgcolor_player(player_index(pplayer));
-      fprintf(fp, "# %s\n", img_playerstr(pplayer));
-    } players_iterate_end;
+      fprintf(fp, "# %s\n", img_playerstr(pimg, i, plrstr, sizeof(plrstr)));
+    }
   } else {
     fprintf(fp, "# no players\n");
   }
@@ -2352,6 +2616,228 @@ static bool img_save_ppm(const struct img *pimg, const char *mapimgfile)
   return TRUE;
 }
 
+#ifdef HAVE_LIBZ
+/* Size of the IDAT chunks of the png files. */
+#define PNG_IDAT_SIZE (64 * 1024)
+
+/****************************************************************************
+  Write a 32 bits integer in network byte order, as used by png files.
+****************************************************************************/
+static inline void png_put_uint32(unsigned char *buf, unsigned long val)
+{
+  buf[0] = (val >> 24) & 0xff;
+  buf[1] = (val >> 16) & 0xff;
+  buf[2] = (val >> 8) & 0xff;
+  buf[3] = val & 0xff;
+}
+
+/****************************************************************************
+  Write a chunk of a png file.
+****************************************************************************/
+static bool png_write_chunk(FILE *fp, const char *type,
+                            const unsigned char *data, size_t len)
+{
+  unsigned char head[8], crc[4];
+  uLong sum;
+
+  png_put_uint32(head, len);
+  memcpy(head + 4, type, 4);
+
+  sum = crc32(0L, head + 4, 4);
+  if (len > 0) {
+    sum = crc32(sum, data, len);
+  }
+  png_put_uint32(crc, sum);
+
+  return (fwrite(head, sizeof(head), 1, fp) == 1
+          && (len == 0 || fwrite(data, len, 1, fp) == 1)
+          && fwrite(crc, sizeof(crc), 1, fp) == 1);
+}
+
+/****************************************************************************
+  Write an uncompressed UTF-8 text (iTXt chunk) to a png file.
+****************************************************************************/
+static bool png_write_text(FILE *fp, const char *keyword, const char *text)
+{
+  size_t keyword_len = strlen(keyword), text_len = strlen(text);
+  /* keyword, compression flag and method, language and translated
+   * keyword (both empty), text */
+  size_t len = keyword_len + 5 + text_len;
+  unsigned char *data = fc_malloc(len);
+  bool ret;
+
+  memcpy(data, keyword, keyword_len);
+  memset(data + keyword_len, 0, 5);
+  memcpy(data + keyword_len + 5, text, text_len);
+
+  ret = png_write_chunk(fp, "iTXt", data, len);
+  free(data);
+
+  return ret;
+}
+
+/****************************************************************************
+  Compress the input of the stream into IDAT chunks. With Z_FINISH, the
+  end of the data is written.
+****************************************************************************/
+static bool png_write_data(FILE *fp, z_stream *stream, unsigned char *out,
+                           int flush)
+{
+  int zret;
+
+  do {
+    zret = deflate(stream, flush);
+    if (zret == Z_STREAM_ERROR) {
+      return FALSE;
+    }
+
+    if (stream->avail_out == 0
+        || (zret == Z_STREAM_END && stream->avail_out < PNG_IDAT_SIZE)) {
+      if (!png_write_chunk(fp, "IDAT", out,
+                           PNG_IDAT_SIZE - stream->avail_out)) {
+        return FALSE;
+      }
+      stream->next_out = out;
+      stream->avail_out = PNG_IDAT_SIZE;
+    }
+  } while (flush == Z_FINISH ? zret != Z_STREAM_END : stream->avail_in > 0);
+
+  return TRUE;
+}
+
+/****************************************************************************
+  Save an image as png file (toolkit: png). The file is written with zlib,
+  without any other library.
+****************************************************************************/
+static bool img_save_png(const struct img *pimg, const char *mapimgfile)
+{
+  static const unsigned char signature[8] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+  };
+  char pngname[MAX_LEN_PATH], plrstr[256];
+  struct astring comment = ASTRING_INIT;
+  unsigned char header[13], *row, *out, *ppixel;
+  const struct rgbcolor *pcolor;
+  z_stream stream;
+  FILE *fp;
+  int width, height, x, y, xxx, yyy, i;
+  size_t row_len;
+  bool ret;
+
+  if (pimg->def->format != IMGFORMAT_PNG) {
+    IMG_LOG(pimg, _("the png toolkit can only create images in the png "
+                    "format"));
+    return FALSE;
+  }
+
+  if (!img_filename(mapimgfile, IMGFORMAT_PNG, pngname, sizeof(pngname))) {
+    IMG_LOG(pimg, _("error generating the file name"));
+    return FALSE;
+  }
+
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    IMG_LOG(pimg, _("could not initialise the compression"));
+    return FALSE;
+  }
+
+  fp = fopen(pngname, "wb");
+  if (!fp) {
+    IMG_LOG(pimg, _("could not open file: %s"), pngname);
+    deflateEnd(&stream);
+    return FALSE;
+  }
+
+  width = pimg->imgsize.x * pimg->def->zoom;
+  height = pimg->imgsize.y * pimg->def->zoom;
+
+  png_put_uint32(header, width);
+  png_put_uint32(header + 4, height);
+  header[8] = 8;  /* bit depth */
+  header[9] = 2;  /* color type: RGB */
+  header[10] = 0; /* compression method: deflate */
+  header[11] = 0; /* filter method */
+  header[12] = 0; /* no interlace */
+
+  astr_add(&comment, "version:2\n");
+  astr_add(&comment, "map definition: %s\n", pimg->def->maparg);
+  if (pimg->def->colortest) {
+    astr_add(&comment, "color test\n");
+  } else if (BV_ISSET_ANY(pimg->def->player.checked_plrbv)) {
+    for (i = 0; i < MAX_NUM_PLAYER_SLOTS; i++) {
+      if (!BV_ISSET(pimg->def->player.checked_plrbv, i)
+          || pimg->plrname[i][0] == '\0') {
+        continue;
+      }
+
+      astr_add(&comment, "%s\n",
+               img_playerstr(pimg, i, plrstr, sizeof(plrstr)));
+    }
+  } else {
+    astr_add(&comment, "no players\n");
+  }
+
+  ret = (fwrite(signature, sizeof(signature), 1, fp) == 1
+         && png_write_chunk(fp, "IHDR", header, sizeof(header))
+         && png_write_text(fp, "Title", pimg->title)
+         && png_write_text(fp, "Comment", astr_str(&comment)));
+  astr_free(&comment);
+
+  /* Each row starts with its filter type (0: none). */
+  row_len = 1 + 3 * width;
+  row = fc_malloc(row_len);
+  out = fc_malloc(PNG_IDAT_SIZE);
+  stream.next_out = out;
+  stream.avail_out = PNG_IDAT_SIZE;
+
+  /* y coordinate */
+  for (y = 0; ret && y < pimg->imgsize.y; y++) {
+    row[0] = 0;
+    ppixel = row + 1;
+    /* x coordinate */
+    for (x = 0; x < pimg->imgsize.x; x++) {
+      pcolor = pimg->map[img_index(x, y, pimg)];
+      if (pcolor == NULL) {
+        pcolor = imgcolor_special(IMGCOLOR_BACKGROUND);
+      }
+
+      /* zoom for x */
+      for (xxx = 0; xxx < pimg->def->zoom; xxx++) {
+        *ppixel++ = pcolor->r;
+        *ppixel++ = pcolor->g;
+        *ppixel++ = pcolor->b;
+      }
+    }
+
+    /* zoom for y */
+    for (yyy = 0; ret && yyy < pimg->def->zoom; yyy++) {
+      stream.next_in = row;
+      stream.avail_in = row_len;
+      ret = png_write_data(fp, &stream, out, Z_NO_FLUSH);
+    }
+  }
+
+  ret = (ret && png_write_data(fp, &stream, out, Z_FINISH)
+         && png_write_chunk(fp, "IEND", NULL, 0));
+
+  deflateEnd(&stream);
+  free(out);
+  free(row);
+
+  if (fclose(fp) != 0) {
+    ret = FALSE;
+  }
+
+  if (ret) {
+    log_verbose("Map image saved as '%s'.", pngname);
+  } else {
+    IMG_LOG(pimg, _("error saving map image '%s'"), pngname);
+  }
+
+  return ret;
+}
+#endif /* HAVE_LIBZ */
+
 /****************************************************************************
   Generate the final filename.
 ****************************************************************************/
@@ -2367,128 +2853,240 @@ static bool img_filename(const char *mapimgfile, enum imageformat format,
 }
 
 /****************************************************************************
-  Return a definition string for the player.
+  Return a definition string for the player, written in 'buf'.
 ****************************************************************************/
-static const char *img_playerstr(const struct player *pplayer)
+static const char *img_playerstr(const struct img *pimg, int plr_id,
+                                 char *buf, size_t buf_len)
 {
-  static char buf[512];
-  const struct rgbcolor *pcolor = imgcolor_player(player_index(pplayer));
+  const struct rgbcolor *pcolor = img_color_player(pimg, plr_id);
 
-  fc_snprintf(buf, sizeof(buf),
+  fc_snprintf(buf, buf_len,
               "playerno:%d:color:(%3d, %3d, %3d):name:\"%s\"",
-              player_number(pplayer), pcolor->r, pcolor->g, pcolor->b,
-              player_name(pplayer));
+              plr_id, pcolor->r, pcolor->g, pcolor->b,
+              pimg->plrname[plr_id]);
 
   return buf;
 }
 
+/* The rows drawn by each job of img_createmap(). */
+struct img_band {
+  struct img *pimg;
+  int rows;
+  int tile_rows;      /* rows covered by one tile, from its base row */
+};
+
 /****************************************************************************
   Create the map considering the options (terrain, player(s), cities,
-  units, borders, known, fogofwar, ...).
+  units, borders, known, fogofwar, ...), from the data taken by
+  img_snapshot(). With extra threads (see mapimg_set_threads()), the image
+  is split into bands of rows drawn at the same time. Each pixel belongs to
+  one band, and is drawn with the tiles in the same order as by a single
+  thread, so the result does not depend on the number of threads.
 ****************************************************************************/
 static void img_createmap(struct img *pimg)
 {
+  struct img_band band;
+  int bands = 1, i;
+
+  img_map_new(pimg);
+
+  band.tile_rows = 0;
+  for (i = 0; i < NUM_PIXEL; i++) {
+    band.tile_rows = MAX(band.tile_rows, pimg->tileshape->y[i] + 1);
+  }
+
+  if (fc_threadpool_size(mapimg.workers) > 0) {
+    /* Several bands per thread, as the tiles do not cover the rows
+     * evenly for all topologies. */
+    bands = 4 * (fc_threadpool_size(mapimg.workers) + 1);
+  }
+
+  band.pimg = pimg;
+  band.rows = MAX((pimg->imgsize.y + bands - 1) / bands, band.tile_rows);
+  bands = (pimg->imgsize.y + band.rows - 1) / band.rows;
+
+  fc_threadpool_run(mapimg.workers, bands, img_createmap_band, &band);
+}
+
+/****************************************************************************
+  Draw the band 'index' of the image (job of img_createmap()).
+****************************************************************************/
+static void img_createmap_band(int index, void *data)
+{
+  const struct img_band *band = (const struct img_band *) data;
+  struct img *pimg = band->pimg;
+  int row_min = index * band->rows;
+  int row_max = MIN(row_min + band->rows, pimg->imgsize.y);
+  int x, y, base_x, base_y;
+
+  whole_map_iterate(ptile) {
+    index_to_map_pos(&x, &y, tile_index(ptile));
+    pimg->base_coor(pimg, &base_x, &base_y, x, y);
+    if (base_y < row_max && base_y + band->tile_rows > row_min) {
+      img_render_tile(pimg, ptile, row_min, row_max);
+    }
+  } whole_map_iterate_end;
+}
+
+/****************************************************************************
+  Draw the part of the tile in the rows from 'row_min' to 'row_max'
+  (excluded).
+****************************************************************************/
+static void img_render_tile(struct img *pimg, const struct tile *ptile,
+                            int row_min, int row_max)
+{
+  const struct img_tile *itile = pimg->tiles + tile_index(ptile);
   const struct rgbcolor *pcolor;
   bv_pixel pixel;
   int player_id;
-  struct player *pplayer = NULL;
-  struct player *plr_tile = NULL, *plr_city = NULL, *plr_unit = NULL;
-  enum known_type tile_knowledge = TILE_UNKNOWN;
-  struct terrain *pterrain = NULL;
+  bool single_player = pimg->single_player;
   bool plr_knowledge = pimg->def->layers[MAPIMG_LAYER_KNOWLEDGE];
 
-  whole_map_iterate(ptile) {
-    if (bvplayers_count(pimg->def) == 1) {
-      /* only one player; get player id for 'known' and 'fogofwar' */
-      players_iterate(aplayer) {
-        if (BV_ISSET(pimg->def->player.checked_plrbv,
-                     player_index(aplayer))) {
-          pplayer = aplayer;
-          tile_knowledge = mapimg.mapimg_tile_known(ptile, pplayer,
-                                                    plr_knowledge);
-          break;
-        }
-      } players_iterate_end;
-    }
-
-    /* known tiles */
-    if (plr_knowledge && pplayer != NULL && tile_knowledge == TILE_UNKNOWN) {
-      /* plot nothing iff tile is not known */
-      continue;
-    }
+  /* known tiles */
+  if (plr_knowledge && single_player && itile->known == TILE_UNKNOWN) {
+    /* plot nothing iff tile is not known */
+    return;
+  }
 
-    /* terrain */
-    pterrain = mapimg.mapimg_tile_terrain(ptile, pplayer, plr_knowledge);
-    if (pimg->def->layers[MAPIMG_LAYER_TERRAIN]) {
-      /* full terrain */
-      pixel = pimg->pixel_tile(ptile, pplayer, plr_knowledge);
-      pcolor = imgcolor_terrain(pterrain);
-      img_plot_tile(pimg, ptile, pcolor, pixel);
+  /* terrain */
+  if (pimg->def->layers[MAPIMG_LAYER_TERRAIN]) {
+    /* full terrain */
+    pixel = pimg->pixel_tile(pimg, ptile);
+    pcolor = imgcolor_terrain(itile->terrain);
+    img_plot_tile(pimg, ptile, pcolor, pixel, row_min, row_max);
+  } else {
+    /* basic terrain */
+    pixel = pimg->pixel_tile(pimg, ptile);
+    if (is_ocean(itile->terrain)) {
+      img_plot_tile(pimg, ptile, imgcolor_special(IMGCOLOR_OCEAN), pixel,
+                    row_min, row_max);
     } else {
-      /* basic terrain */
-      pixel = pimg->pixel_tile(ptile, pplayer, plr_knowledge);
-      if (is_ocean(pterrain)) {
-        img_plot_tile(pimg, ptile, imgcolor_special(IMGCOLOR_OCEAN), pixel);
-      } else {
-        img_plot_tile(pimg, ptile, imgcolor_special(IMGCOLOR_GROUND), pixel);
-      }
+      img_plot_tile(pimg, ptile, imgcolor_special(IMGCOLOR_GROUND), pixel,
+                    row_min, row_max);
     }
+  }
 
-    /* (land) area within borders and borders */
-    plr_tile = mapimg.mapimg_tile_owner(ptile, pplayer, plr_knowledge);
-    if (game.info.borders > 0 && NULL != plr_tile) {
-      player_id = player_index(plr_tile);
-      if (pimg->def->layers[MAPIMG_LAYER_AREA] && !is_ocean(pterrain)
-          && BV_ISSET(pimg->def->player.checked_plrbv, player_id)) {
-        /* the tile is land and inside the players borders */
-        pixel = pimg->pixel_tile(ptile, pplayer, plr_knowledge);
-        pcolor = imgcolor_player(player_id);
-        img_plot_tile(pimg, ptile, pcolor, pixel);
-      } else if (pimg->def->layers[MAPIMG_LAYER_BORDERS]
-                 && (BV_ISSET(pimg->def->player.checked_plrbv, player_id)
-                     || (plr_knowledge && pplayer != NULL))) {
-        /* plot borders if player is selected or view range of the one
-         * displayed player */
-        pixel = pimg->pixel_border(ptile, pplayer, plr_knowledge);
-        pcolor = imgcolor_player(player_id);
-        img_plot_tile(pimg, ptile, pcolor, pixel);
-      }
+  /* (land) area within borders and borders */
+  if (pimg->borders && itile->owner != -1) {
+    player_id = itile->owner;
+    if (pimg->def->layers[MAPIMG_LAYER_AREA] && !is_ocean(itile->terrain)
+        && BV_ISSET(pimg->def->player.checked_plrbv, player_id)) {
+      /* the tile is land and inside the players borders */
+      pixel = pimg->pixel_tile(pimg, ptile);
+      pcolor = img_color_player(pimg, player_id);
+      img_plot_tile(pimg, ptile, pcolor, pixel, row_min, row_max);
+    } else if (pimg->def->layers[MAPIMG_LAYER_BORDERS]
+               && (BV_ISSET(pimg->def->player.checked_plrbv, player_id)
+                   || (plr_knowledge && single_player))) {
+      /* plot borders if player is selected or view range of the one
+       * displayed player */
+      pixel = pimg->pixel_border(pimg, ptile);
+      pcolor = img_color_player(pimg, player_id);
+      img_plot_tile(pimg, ptile, pcolor, pixel, row_min, row_max);
     }
+  }
 
-    /* cities and units */
-    plr_city = mapimg.mapimg_tile_city(ptile, pplayer, plr_knowledge);
-    plr_unit = mapimg.mapimg_tile_unit(ptile, pplayer, plr_knowledge);
-    if (pimg->def->layers[MAPIMG_LAYER_CITIES] && plr_city) {
-      player_id = player_index(plr_city);
-      if (BV_ISSET(pimg->def->player.checked_plrbv, player_id)
-          || (plr_knowledge && pplayer != NULL)) {
-        /* plot cities if player is selected or view range of the one
-         * displayed player */
-        pixel = pimg->pixel_city(ptile, pplayer, plr_knowledge);
-        pcolor = imgcolor_player(player_id);
-        img_plot_tile(pimg, ptile, pcolor, pixel);
-      }
-    } else if (pimg->def->layers[MAPIMG_LAYER_UNITS] && plr_unit) {
-      player_id = player_index(plr_unit);
-      if (BV_ISSET(pimg->def->player.checked_plrbv, player_id)
-          || (plr_knowledge && pplayer != NULL)) {
-        /* plot units if player is selected or view range of the one
-         * displayed player */
-        pixel = pimg->pixel_unit(ptile, pplayer, plr_knowledge);
-        pcolor = imgcolor_player(player_id);
-        img_plot_tile(pimg, ptile, pcolor, pixel);
-      }
+  /* cities and units */
+  if (pimg->def->layers[MAPIMG_LAYER_CITIES] && itile->city != -1) {
+    player_id = itile->city;
+    if (BV_ISSET(pimg->def->player.checked_plrbv, player_id)
+        || (plr_knowledge && single_player)) {
+      /* plot cities if player is selected or view range of the one
+       * displayed player */
+      pixel = pimg->pixel_city(pimg, ptile);
+      pcolor = img_color_player(pimg, player_id);
+      img_plot_tile(pimg, ptile, pcolor, pixel, row_min, row_max);
+    }
+  } else if (pimg->def->layers[MAPIMG_LAYER_UNITS] && itile->unit != -1) {
+    player_id = itile->unit;
+    if (BV_ISSET(pimg->def->player.checked_plrbv, player_id)
+        || (plr_knowledge && single_player)) {
+      /* plot units if player is selected or view range of the one
+       * displayed player */
+      pixel = pimg->pixel_unit(pimg, ptile);
+      pcolor = img_color_player(pimg, player_id);
+      img_plot_tile(pimg, ptile, pcolor, pixel, row_min, row_max);
     }
+  }
+
+  /* fogofwar; if only 1 player is plotted */
+  if (pimg->fogofwar && pimg->def->layers[MAPIMG_LAYER_FOGOFWAR]
+      && single_player && itile->known == TILE_KNOWN_UNSEEN) {
+    pixel = pimg->pixel_fogofwar(pimg, ptile);
+    pcolor = NULL;
+    img_plot_tile(pimg, ptile, pcolor, pixel, row_min, row_max);
+  }
+}
+
+/****************************************************************************
+  Draw and save the images of the list in the background, then free them
+  (main function of the thread started by mapimg_create()).
+****************************************************************************/
+static void img_background_thread(void *arg)
+{
+  struct img_list *images = (struct img_list *) arg;
+
+  img_list_iterate(images, pimg) {
+    img_createmap(pimg);
+    img_save(pimg, pimg->mapimgfile,
+             pimg->path[0] != '\0' ? pimg->path : NULL);
+    img_destroy(pimg);
+  } img_list_iterate_end;
+
+  img_list_destroy(images);
+}
 
-    /* fogofwar; if only 1 player is plotted */
-    if (game.info.fogofwar && pimg->def->layers[MAPIMG_LAYER_FOGOFWAR]
-        && pplayer != NULL
-        && tile_knowledge == TILE_KNOWN_UNSEEN) {
-      pixel = pimg->pixel_fogofwar(ptile, pplayer, plr_knowledge);
-      pcolor = NULL;
-      img_plot_tile(pimg, ptile, pcolor, pixel);
+/****************************************************************************
+  Wait for the images drawn in the background, if any, to be saved.
+****************************************************************************/
+static void img_background_wait(void)
+{
+  if (mapimg.bg_thread != NULL) {
+    fc_thread_wait(mapimg.bg_thread);
+    free(mapimg.bg_thread);
+    mapimg.bg_thread = NULL;
+  }
+}
+
+/****************************************************************************
+  Create one map image for the definition. If 'images' is not NULL, only
+  the data of the game is taken now, and the image is added to this list
+  to be drawn and saved in the background.
+****************************************************************************/
+static bool img_create(struct mapdef *pmapdef, const char *savename,
+                       const char *path, struct img_list *images)
+{
+  char mapimgfile[MAX_LEN_PATH];
+  struct img *pimg;
+  bool ret;
+
+  generate_save_name(savename, mapimgfile, sizeof(mapimgfile),
+                     mapimg_generate_name(pmapdef));
+
+  pimg = img_new(pmapdef, CURRENT_TOPOLOGY, map.xsize, map.ysize);
+  img_snapshot(pimg);
+
+  if (images != NULL && pmapdef->tool != IMGTOOL_MAGICKWAND) {
+    /* The definition may change or be deleted meanwhile. The magickwand
+     * toolkit is not used in the background as it reads the diplomatic
+     * state of the players when saving. */
+    pimg->background = TRUE;
+    pimg->bgdef = *pmapdef;
+    pimg->def = &pimg->bgdef;
+    sz_strlcpy(pimg->mapimgfile, mapimgfile);
+    if (path != NULL) {
+      sz_strlcpy(pimg->path, path);
     }
-  } whole_map_iterate_end;
+    img_list_append(images, pimg);
+
+    return TRUE;
+  }
+
+  img_createmap(pimg);
+  ret = img_save(pimg, mapimgfile, path);
+  img_destroy(pimg);
+
+  return ret;
 }
 
 /*
@@ -2513,9 +3111,8 @@ static void img_createmap(struct img *pimg)
   24 25 26 27 28 29
   30 31 32 33 34 35
 ****************************************************************************/
-static bv_pixel pixel_tile_rect(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge)
+static bv_pixel pixel_tile_rect(const struct img *pimg,
+                                const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2532,9 +3129,8 @@ static bv_pixel pixel_tile_rect(const struct tile *ptile,
   -- 25 26 27 28 --
   -- -- -- -- -- --
 ****************************************************************************/
-static bv_pixel pixel_city_rect(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge)
+static bv_pixel pixel_city_rect(const struct img *pimg,
+                                const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2568,9 +3164,8 @@ static bv_pixel pixel_city_rect(const struct tile *ptile,
   -- -- -- -- -- --
   -- -- -- -- -- --
 ****************************************************************************/
-static bv_pixel pixel_unit_rect(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge)
+static bv_pixel pixel_unit_rect(const struct img *pimg,
+                                const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2591,9 +3186,8 @@ static bv_pixel pixel_unit_rect(const struct tile *ptile,
   24 -- 26 -- 28 --
   -- 31 -- 33 -- 35
 ****************************************************************************/
-static bv_pixel pixel_fogofwar_rect(const struct tile *ptile,
-                                    const struct player *pplayer,
-                                    bool knowledge)
+static bv_pixel pixel_fogofwar_rect(const struct img *pimg,
+                                    const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2633,13 +3227,12 @@ static bv_pixel pixel_fogofwar_rect(const struct tile *ptile,
 
              [S]
 ****************************************************************************/
-static bv_pixel pixel_border_rect(const struct tile *ptile,
-                                  const struct player *pplayer,
-                                  bool knowledge)
+static bv_pixel pixel_border_rect(const struct img *pimg,
+                                  const struct tile *ptile)
 {
   bv_pixel pixel;
   struct tile *pnext;
-  struct player *owner;
+  int owner;
 
   BV_CLR_ALL(pixel);
 
@@ -2650,17 +3243,15 @@ static bv_pixel pixel_border_rect(const struct tile *ptile,
     return pixel;
   }
 
-  owner = mapimg.mapimg_tile_owner(ptile, pplayer, knowledge);
-  if (NULL == owner) {
+  owner = img_tile_owner(pimg, ptile);
+  if (-1 == owner) {
     /* no border */
     return pixel;
   }
 
   pnext = mapstep(ptile, DIR8_NORTH);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 0);
     BV_SET(pixel, 1);
     BV_SET(pixel, 2);
@@ -2670,10 +3261,8 @@ static bv_pixel pixel_border_rect(const struct tile *ptile,
   }
 
   pnext = mapstep(ptile, DIR8_EAST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 5);
     BV_SET(pixel, 11);
     BV_SET(pixel, 17);
@@ -2683,10 +3272,8 @@ static bv_pixel pixel_border_rect(const struct tile *ptile,
   }
 
   pnext = mapstep(ptile, DIR8_SOUTH);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 30);
     BV_SET(pixel, 31);
     BV_SET(pixel, 32);
@@ -2696,10 +3283,8 @@ static bv_pixel pixel_border_rect(const struct tile *ptile,
   }
 
   pnext = mapstep(ptile, DIR8_WEST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 0);
     BV_SET(pixel, 6);
     BV_SET(pixel, 12);
@@ -2731,9 +3316,8 @@ static void base_coor_rect(struct img *pimg, int *base_x, int *base_y,
      30 31 32 33
         34 35
 ****************************************************************************/
-static bv_pixel pixel_tile_hexa(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge)
+static bv_pixel pixel_tile_hexa(const struct img *pimg,
+                                const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2752,9 +3336,8 @@ static bv_pixel pixel_tile_hexa(const struct tile *ptile,
      -- 31 32 --
         -- --
 ****************************************************************************/
-static bv_pixel pixel_city_hexa(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge)
+static bv_pixel pixel_city_hexa(const struct img *pimg,
+                                const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2793,9 +3376,8 @@ static bv_pixel pixel_city_hexa(const struct tile *ptile,
      -- -- -- --
         -- --
 ****************************************************************************/
-static bv_pixel pixel_unit_hexa(const struct tile *ptile,
-                                const struct player *pplayer,
-                                bool knowledge)
+static bv_pixel pixel_unit_hexa(const struct img *pimg,
+                                const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2818,9 +3400,8 @@ static bv_pixel pixel_unit_hexa(const struct tile *ptile,
      30 -- 32 --
         -- 35
 ****************************************************************************/
-static bv_pixel pixel_fogofwar_hexa(const struct tile *ptile,
-                                    const struct player *pplayer,
-                                    bool knowledge)
+static bv_pixel pixel_fogofwar_hexa(const struct img *pimg,
+                                    const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2857,13 +3438,12 @@ static bv_pixel pixel_fogofwar_hexa(const struct tile *ptile,
           30 -- -- 33
    [S]       34 35       [E]
 ****************************************************************************/
-static bv_pixel pixel_border_hexa(const struct tile *ptile,
-                                  const struct player *pplayer,
-                                  bool knowledge)
+static bv_pixel pixel_border_hexa(const struct img *pimg,
+                                  const struct tile *ptile)
 {
   bv_pixel pixel;
   struct tile *pnext;
-  struct player *owner;
+  int owner;
 
   BV_CLR_ALL(pixel);
 
@@ -2874,17 +3454,15 @@ static bv_pixel pixel_border_hexa(const struct tile *ptile,
     return pixel;
   }
 
-  owner = mapimg.mapimg_tile_owner(ptile, pplayer, knowledge);
-  if (NULL == owner) {
+  owner = img_tile_owner(pimg, ptile);
+  if (-1 == owner) {
     /* no border */
     return pixel;
   }
 
   pnext = mapstep(ptile, DIR8_WEST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 0);
     BV_SET(pixel, 2);
     BV_SET(pixel, 6);
@@ -2893,20 +3471,16 @@ static bv_pixel pixel_border_hexa(const struct tile *ptile,
   /* not used: DIR8_NORTHWEST */
 
   pnext = mapstep(ptile, DIR8_NORTH);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 1);
     BV_SET(pixel, 5);
     BV_SET(pixel, 11);
   }
 
   pnext = mapstep(ptile, DIR8_NORTHEAST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 11);
     BV_SET(pixel, 17);
     BV_SET(pixel, 23);
@@ -2914,10 +3488,8 @@ static bv_pixel pixel_border_hexa(const struct tile *ptile,
   }
 
   pnext = mapstep(ptile, DIR8_EAST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 29);
     BV_SET(pixel, 33);
     BV_SET(pixel, 35);
@@ -2926,20 +3498,16 @@ static bv_pixel pixel_border_hexa(const struct tile *ptile,
   /* not used. DIR8_SOUTHEAST */
 
   pnext = mapstep(ptile, DIR8_SOUTH);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 24);
     BV_SET(pixel, 30);
     BV_SET(pixel, 34);
   }
 
   pnext = mapstep(ptile, DIR8_SOUTHWEST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 6);
     BV_SET(pixel, 12);
     BV_SET(pixel, 18);
@@ -2970,9 +3538,8 @@ static void base_coor_hexa(struct img *pimg, int *base_x, int *base_y,
      26 27 28 29 30 31
         32 33 34 35
 ****************************************************************************/
-static bv_pixel pixel_tile_isohexa(const struct tile *ptile,
-                                   const struct player *pplayer,
-                                   bool knowledge)
+static bv_pixel pixel_tile_isohexa(const struct img *pimg,
+                                   const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -2989,9 +3556,8 @@ static bv_pixel pixel_tile_isohexa(const struct tile *ptile,
      -- 27 28 29 30 --
         -- -- -- --
 ****************************************************************************/
-static bv_pixel pixel_city_isohexa(const struct tile *ptile,
-                                   const struct player *pplayer,
-                                   bool knowledge)
+static bv_pixel pixel_city_isohexa(const struct img *pimg,
+                                   const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -3028,9 +3594,8 @@ static bv_pixel pixel_city_isohexa(const struct tile *ptile,
      -- -- -- -- -- --
         -- -- -- --
 ****************************************************************************/
-static bv_pixel pixel_unit_isohexa(const struct tile *ptile,
-                                   const struct player *pplayer,
-                                   bool knowledge)
+static bv_pixel pixel_unit_isohexa(const struct img *pimg,
+                                   const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -3051,9 +3616,8 @@ static bv_pixel pixel_unit_isohexa(const struct tile *ptile,
      -- 27 28 -- -- 31
         -- -- 34 35
 ****************************************************************************/
-static bv_pixel pixel_fogofwar_isohexa(const struct tile *ptile,
-                                       const struct player *pplayer,
-                                       bool knowledge)
+static bv_pixel pixel_fogofwar_isohexa(const struct img *pimg,
+                                       const struct tile *ptile)
 {
   bv_pixel pixel;
 
@@ -3093,13 +3657,12 @@ static bv_pixel pixel_fogofwar_isohexa(const struct tile *ptile,
 
                [S]
 ****************************************************************************/
-static bv_pixel pixel_border_isohexa(const struct tile *ptile,
-                                     const struct player *pplayer,
-                                     bool knowledge)
+static bv_pixel pixel_border_isohexa(const struct img *pimg,
+                                     const struct tile *ptile)
 {
   bv_pixel pixel;
   struct tile *pnext;
-  struct player *owner;
+  int owner;
 
   BV_CLR_ALL(pixel);
 
@@ -3110,17 +3673,15 @@ static bv_pixel pixel_border_isohexa(const struct tile *ptile,
     return pixel;
   }
 
-  owner = mapimg.mapimg_tile_owner(ptile, pplayer, knowledge);
-  if (NULL == owner) {
+  owner = img_tile_owner(pimg, ptile);
+  if (-1 == owner) {
     /* no border */
     return pixel;
   }
 
   pnext = mapstep(ptile, DIR8_NORTH);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 0);
     BV_SET(pixel, 1);
     BV_SET(pixel, 2);
@@ -3130,30 +3691,24 @@ static bv_pixel pixel_border_isohexa(const struct tile *ptile,
   /* not used: DIR8_NORTHEAST */
 
   pnext = mapstep(ptile, DIR8_EAST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 3);
     BV_SET(pixel, 9);
     BV_SET(pixel, 17);
   }
 
   pnext = mapstep(ptile, DIR8_SOUTHEAST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 25);
     BV_SET(pixel, 31);
     BV_SET(pixel, 35);
   }
 
   pnext = mapstep(ptile, DIR8_SOUTH);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 32);
     BV_SET(pixel, 33);
     BV_SET(pixel, 34);
@@ -3163,20 +3718,16 @@ static bv_pixel pixel_border_isohexa(const struct tile *ptile,
   /* not used: DIR8_SOUTHWEST */
 
   pnext = mapstep(ptile, DIR8_WEST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 18);
     BV_SET(pixel, 26);
     BV_SET(pixel, 32);
   }
 
   pnext = mapstep(ptile, DIR8_NORTHWEST);
-  if (!pnext || (mapimg.mapimg_tile_known(pnext, pplayer,
-                                          knowledge) != TILE_UNKNOWN
-                 && mapimg.mapimg_tile_owner(pnext, pplayer,
-                                             knowledge) != owner)) {
+  if (!pnext || (img_tile_known(pimg, pnext) != TILE_UNKNOWN
+                 && img_tile_owner(pimg, pnext) != owner)) {
     BV_SET(pixel, 0);
     BV_SET(pixel, 4);
     BV_SET(pixel, 10);
@@ -3288,8 +3839,10 @@ static const struct rgbcolor *imgcolor_special(enum img_special imgcolor)
   return &rgb_special[imgcolor];
 }
 
+#ifdef HAVE_MAPIMG_MAGICKWAND
 /****************************************************************************
-  Return rgbcolor for player.
+  Return rgbcolor for player. The images are drawn with the colors taken
+  by img_snapshot() instead.
 
   FIXME: nearly identical with get_player_color() in colors_common.c.
 ****************************************************************************/
@@ -3303,6 +3856,7 @@ static const struct rgbcolor *imgcolor_player(int plr_id)
 
   return pplayer->rgb;
 }
+#endif /* HAVE_MAPIMG_MAGICKWAND */
 
 /****************************************************************************
   Return rgbcolor for terrain.
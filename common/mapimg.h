@@ -22,6 +22,8 @@
     mapimg_count()      Return the number of map image definitions.
     mapimg_error()      Return the last error message.
     mapimg_help()       Return a help text.
+    mapimg_set_threads() Set the number of extra threads drawing an image.
+    mapimg_wait()       Wait for the images created in the background.
 
   * Advanced functions:
 
@@ -118,13 +120,15 @@ void mapimg_free(void);
 int mapimg_count(void);
 char *mapimg_help(void);
 const char *mapimg_error(void);
+void mapimg_set_threads(int threads);
+void mapimg_wait(void);
 
 bool mapimg_define(const char *maparg, bool check);
 bool mapimg_delete(int id);
 bool mapimg_show(int id, char *str, size_t str_len, bool detail);
 bool mapimg_id2str(int id, char *str, size_t str_len);
 bool mapimg_create(struct mapdef *pmapdef, bool force, const char *savename,
-                   const char *path);
+                   const char *path, bool background);
 bool mapimg_colortest(const char *savename, const char *path);
 
 struct mapdef *mapimg_isvalid(int id);
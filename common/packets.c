@@ -33,11 +33,13 @@
 /* utility */
 #include "capability.h"
 #include "fcintl.h"
+#include "genhash.h"
 #include "log.h"
 #include "mem.h"
 #include "support.h"
 
 /* commmon */
+#include "capstr.h"
 #include "dataio.h"
 #include "game.h"
 #include "events.h"
@@ -47,6 +49,12 @@
 
 #ifdef USE_COMPRESSION
 #include <zlib.h>
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
 /*
  * Value for the 16bit size to indicate a jumbo packet
  */
@@ -59,8 +67,18 @@
 
 /*
  * All compressed packets this size or greater are sent as a jumbo packet.
+ * So are the ones that could be, see conn_compression_flush().
  */
 #define JUMBO_BORDER 		(64*1024-COMPRESSION_BORDER-1)
+
+/*
+ * Keep this a decent amount less than MAX_LEN_BUFFER to avoid the
+ * (remote) possibility of trying to dump MAX_LEN_BUFFER to the
+ * network in one go
+ */
+#define MAX_LEN_COMPRESS_QUEUE (MAX_LEN_BUFFER/2)
+FC_STATIC_ASSERT(MAX_LEN_COMPRESS_QUEUE < MAX_LEN_BUFFER,
+                 compress_queue_maxlen_too_big);
 #endif
 
 #define log_compress    log_debug
@@ -73,11 +91,6 @@
 #define PACKET_SIZE_STATISTICS 0
 
 #ifdef USE_COMPRESSION
-static int stat_size_alone = 0;
-static int stat_size_uncompressed = 0;
-static int stat_size_compressed = 0;
-static int stat_size_no_compression = 0;
-
 /****************************************************************************
   Returns the compression level. Initilialize it if needed.
 ****************************************************************************/
@@ -96,72 +109,359 @@ static inline int get_compression_level(void)
   return level;
 }
 
+/****************************************************************************
+  Returns the compression method of the connection. Until the connection is
+  established, the capabilities of the other side are not known to both
+  ends, so zlib is used. The server sends the data queued up to the join
+  reply as a block of its own, see conn_compression_sync(); the method is
+  decided at the first block which follows it.
+****************************************************************************/
+static enum conn_compression_method
+conn_compression_method(struct connection *pconn)
+{
+  if (COMPRESS_UNKNOWN != pconn->compression.method) {
+    return pconn->compression.method;
+  }
+
+  if (!pconn->established) {
+    return COMPRESS_ZLIB;
+  }
+
+  /* Drop the zlib compressor used so far. */
+  conn_compression_free(pconn);
+  pconn->compression.method = COMPRESS_ZLIB;
+#ifdef HAVE_LIBLZ4
+  if (has_capability("compress-lz4", our_capability)
+      && has_capability("compress-lz4", pconn->capability)) {
+    pconn->compression.method = COMPRESS_LZ4;
+  }
+#endif /* HAVE_LIBLZ4 */
+#ifdef HAVE_LIBZSTD
+  if (has_capability("compress-zstd", our_capability)
+      && has_capability("compress-zstd", pconn->capability)) {
+    pconn->compression.method = COMPRESS_ZSTD;
+  }
+#endif /* HAVE_LIBZSTD */
+  log_compress("COMPRESS: using method %d for %s",
+               pconn->compression.method, conn_description(pconn));
+
+  return pconn->compression.method;
+}
+
+/****************************************************************************
+  Free the compressor and decompressor of the connection.
+****************************************************************************/
+void conn_compression_free(struct connection *pconn)
+{
+  switch (pconn->compression.method) {
+  case COMPRESS_UNKNOWN:
+    /* zlib is used until the method is decided. */
+  case COMPRESS_ZLIB:
+    if (NULL != pconn->compression.compressor) {
+      deflateEnd(pconn->compression.compressor);
+    }
+    break;
+  case COMPRESS_ZSTD:
+#ifdef HAVE_LIBZSTD
+    ZSTD_freeCCtx(pconn->compression.compressor);
+    ZSTD_freeDCtx(pconn->compression.decompressor);
+    pconn->compression.compressor = NULL;
+    pconn->compression.decompressor = NULL;
+#endif /* HAVE_LIBZSTD */
+    break;
+  case COMPRESS_LZ4:
+    break;
+  }
+
+  if (NULL != pconn->compression.compressor) {
+    free(pconn->compression.compressor);
+    pconn->compression.compressor = NULL;
+  }
+  if (NULL != pconn->compression.decompressor) {
+    free(pconn->compression.decompressor);
+    pconn->compression.decompressor = NULL;
+  }
+
+  pconn->compression.method = COMPRESS_UNKNOWN;
+}
+
+/****************************************************************************
+  Returns the max size of 'len' bytes once compressed by conn_compress().
+****************************************************************************/
+static size_t conn_compress_bound(struct connection *pconn, size_t len)
+{
+  switch (conn_compression_method(pconn)) {
+  case COMPRESS_ZLIB:
+    return compressBound(len);
+  case COMPRESS_ZSTD:
+#ifdef HAVE_LIBZSTD
+    return ZSTD_compressBound(len);
+#endif /* HAVE_LIBZSTD */
+    break;
+  case COMPRESS_LZ4:
+#ifdef HAVE_LIBLZ4
+    /* The compressed data follows its uncompressed size. */
+    return 4 + LZ4_compressBound(len);
+#endif /* HAVE_LIBLZ4 */
+    break;
+  case COMPRESS_UNKNOWN:
+    break;
+  }
+
+  fc_assert_msg(FALSE, "Unsupported compression method %d.",
+                pconn->compression.method);
+  return 0;
+}
+
+/****************************************************************************
+  Compress 'len' bytes of 'data' into 'out', which can hold
+  conn_compress_bound() bytes, reusing the compressor of the connection.
+  Returns the compressed size, or 0 on failure.
+****************************************************************************/
+static size_t conn_compress(struct connection *pconn,
+                            const unsigned char *data, size_t len,
+                            unsigned char *out, size_t out_size)
+{
+  int compression_level = get_compression_level();
+
+  switch (conn_compression_method(pconn)) {
+  case COMPRESS_ZLIB:
+    {
+      z_stream *stream = pconn->compression.compressor;
+
+      if (NULL == stream) {
+        stream = fc_calloc(1, sizeof(*stream));
+        pconn->compression.compressor = stream;
+        if (Z_OK != deflateInit(stream, compression_level)) {
+          free(stream);
+          pconn->compression.compressor = NULL;
+          return 0;
+        }
+      } else {
+        deflateReset(stream);
+      }
+
+      stream->next_in = (Bytef *) data;
+      stream->avail_in = len;
+      stream->next_out = out;
+      stream->avail_out = out_size;
+      fc_assert_ret_val(Z_STREAM_END == deflate(stream, Z_FINISH), 0);
+
+      return out_size - stream->avail_out;
+    }
+  case COMPRESS_ZSTD:
+#ifdef HAVE_LIBZSTD
+    {
+      size_t size;
+
+      if (NULL == pconn->compression.compressor) {
+        pconn->compression.compressor = ZSTD_createCCtx();
+        fc_assert_ret_val(NULL != pconn->compression.compressor, 0);
+      }
+
+      size = ZSTD_compressCCtx(pconn->compression.compressor,
+                               out, out_size, data, len,
+                               (-1 == compression_level
+                                ? ZSTD_CLEVEL_DEFAULT : compression_level));
+      fc_assert_ret_val(!ZSTD_isError(size), 0);
+
+      return size;
+    }
+#endif /* HAVE_LIBZSTD */
+    break;
+  case COMPRESS_LZ4:
+#ifdef HAVE_LIBLZ4
+    {
+      struct data_out dout;
+      int size;
+
+      if (NULL == pconn->compression.compressor) {
+        pconn->compression.compressor = fc_malloc(LZ4_sizeofState());
+      }
+
+      dio_output_init(&dout, out, 4);
+      dio_put_uint32(&dout, len);
+      size = LZ4_compress_fast_extState(pconn->compression.compressor,
+                                        (const char *) data,
+                                        (char *) out + 4, len,
+                                        out_size - 4, 1);
+      fc_assert_ret_val(0 < size, 0);
+
+      return 4 + size;
+    }
+#endif /* HAVE_LIBLZ4 */
+    break;
+  case COMPRESS_UNKNOWN:
+    break;
+  }
+
+  fc_assert_msg(FALSE, "Unsupported compression method %d.",
+                pconn->compression.method);
+  return 0;
+}
+
+/****************************************************************************
+  Decompress 'len' bytes of 'data' received from the connection. Returns
+  a newly allocated buffer and sets its size, or returns NULL on failure.
+****************************************************************************/
+static unsigned char *conn_decompress(struct connection *pconn,
+                                      const unsigned char *data,
+                                      size_t len, size_t *psize)
+{
+  /* We don't know the decompressed size, or can't trust it. We assume a
+   * bad case here: an expansion by an factor of 100. */
+  size_t max_size = 100 * len;
+  unsigned char *decompressed;
+
+  switch (conn_compression_method(pconn)) {
+  case COMPRESS_ZLIB:
+    {
+      uLongf size = max_size;
+
+      decompressed = fc_malloc(size);
+      if (Z_OK != uncompress(decompressed, &size, data, len)) {
+        free(decompressed);
+        return NULL;
+      }
+      *psize = size;
+
+      return decompressed;
+    }
+  case COMPRESS_ZSTD:
+#ifdef HAVE_LIBZSTD
+    {
+      unsigned long long size = ZSTD_getFrameContentSize(data, len);
+
+      if (ZSTD_CONTENTSIZE_UNKNOWN == size
+          || ZSTD_CONTENTSIZE_ERROR == size || max_size < size) {
+        return NULL;
+      }
+
+      if (NULL == pconn->compression.decompressor) {
+        pconn->compression.decompressor = ZSTD_createDCtx();
+        fc_assert_ret_val(NULL != pconn->compression.decompressor, NULL);
+      }
+
+      decompressed = fc_malloc(MAX(size, 1));
+      *psize = ZSTD_decompressDCtx(pconn->compression.decompressor,
+                                   decompressed, size, data, len);
+      if (ZSTD_isError(*psize) || *psize != size) {
+        free(decompressed);
+        return NULL;
+      }
+
+      return decompressed;
+    }
+#endif /* HAVE_LIBZSTD */
+    break;
+  case COMPRESS_LZ4:
+#ifdef HAVE_LIBLZ4
+    {
+      struct data_in din;
+      int size;
+
+      if (4 > len) {
+        return NULL;
+      }
+      dio_input_init(&din, data, 4);
+      dio_get_uint32(&din, &size);
+      if (0 > size || max_size < size) {
+        return NULL;
+      }
+
+      decompressed = fc_malloc(MAX(size, 1));
+      if (size != LZ4_decompress_safe((const char *) data + 4,
+                                      (char *) decompressed, len - 4,
+                                      size)) {
+        free(decompressed);
+        return NULL;
+      }
+      *psize = size;
+
+      return decompressed;
+    }
+#endif /* HAVE_LIBLZ4 */
+    break;
+  case COMPRESS_UNKNOWN:
+    break;
+  }
+
+  return NULL;
+}
+
 /****************************************************************************
   Send all waiting data. Return TRUE on success.
+
+  The data is compressed in place at the end of the send buffer of the
+  connection. As the header must come first, its size is decided from the
+  bound of the compressed size: the receiver accepts jumbo headers for
+  any size.
 ****************************************************************************/
 static bool conn_compression_flush(struct connection *pconn)
 {
-  int compression_level = get_compression_level();
-  uLongf compressed_size = 12 + 1.001 * pconn->compression.queue.size;
-  int error;
-  Bytef compressed[compressed_size];
+  size_t queue_size = byte_vector_size(&pconn->compression.queue);
+  size_t bound = conn_compress_bound(pconn, queue_size);
+  size_t compressed_size;
+  unsigned char *out;
   bool jumbo;
+  int header_size;
   unsigned long compressed_packet_len;
 
-  error = compress2(compressed, &compressed_size,
-                    pconn->compression.queue.p,
-                    pconn->compression.queue.size,
-                    compression_level);
-  fc_assert_ret_val(error == Z_OK, FALSE);
+  fc_assert_ret_val(0 < bound, FALSE);
 
   /* Compression signalling currently assumes a 2-byte packet length; if that
    * changes, the protocol should probably be changed */
   fc_assert_ret_val(data_type_size(pconn->packet_header.length) == 2, FALSE);
 
   /* Include normal length field in decision */
-  jumbo = (compressed_size+2 >= JUMBO_BORDER);
+  jumbo = (bound+2 >= JUMBO_BORDER);
+  header_size = (jumbo ? 6 : 2);
+
+  out = connection_send_reserve(pconn, header_size + bound);
+  if (NULL == out) {
+    /* Connection closed or closing; nothing to send. */
+    return pconn->used;
+  }
 
-  compressed_packet_len = compressed_size + (jumbo ? 6 : 2);
-  if (compressed_packet_len < pconn->compression.queue.size) {
+  compressed_size = conn_compress(pconn, pconn->compression.queue.p,
+                                  queue_size, out + header_size, bound);
+  fc_assert_ret_val(0 < compressed_size, FALSE);
+
+  compressed_packet_len = compressed_size + header_size;
+  if (compressed_packet_len < queue_size) {
     struct data_out dout;
 
-    log_compress("COMPRESS: compressed %lu bytes to %ld (level %d)",
-                 (unsigned long) pconn->compression.queue.size,
-                 compressed_size, compression_level);
-    stat_size_uncompressed += pconn->compression.queue.size;
-    stat_size_compressed += compressed_size;
+    log_compress("COMPRESS: compressed %lu bytes to %lu (method %d)",
+                 (unsigned long) queue_size,
+                 (unsigned long) compressed_size,
+                 pconn->compression.method);
+    pconn->compression.size_uncompressed += queue_size;
+    pconn->compression.size_compressed += compressed_size;
 
+    dio_output_init(&dout, out, header_size);
     if (!jumbo) {
-      unsigned char header[2];
       FC_STATIC_ASSERT(COMPRESSION_BORDER > MAX_LEN_PACKET,
                        uncompressed_compressed_packet_len_overlap);
 
-      log_compress("COMPRESS: sending %ld as normal", compressed_size);
-
-      dio_output_init(&dout, header, sizeof(header));
+      log_compress("COMPRESS: sending %lu as normal",
+                   (unsigned long) compressed_size);
       dio_put_uint16(&dout, 2 + compressed_size + COMPRESSION_BORDER);
-      connection_send_data(pconn, header, sizeof(header));
-      connection_send_data(pconn, compressed, compressed_size);
     } else {
-      unsigned char header[6];
       FC_STATIC_ASSERT(JUMBO_SIZE >= JUMBO_BORDER+COMPRESSION_BORDER,
                        compressed_normal_jumbo_packet_len_overlap);
 
-      log_compress("COMPRESS: sending %ld as jumbo", compressed_size);
-      dio_output_init(&dout, header, sizeof(header));
+      log_compress("COMPRESS: sending %lu as jumbo",
+                   (unsigned long) compressed_size);
       dio_put_uint16(&dout, JUMBO_SIZE);
       dio_put_uint32(&dout, 6 + compressed_size);
-      connection_send_data(pconn, header, sizeof(header));
-      connection_send_data(pconn, compressed, compressed_size);
     }
+    connection_send_data(pconn, out, compressed_packet_len);
   } else {
     log_compress("COMPRESS: would enlarge %lu bytes to %ld; "
                  "sending uncompressed",
-                 (unsigned long) pconn->compression.queue.size,
-                 compressed_packet_len);
-    connection_send_data(pconn, pconn->compression.queue.p,
-                         pconn->compression.queue.size);
-    stat_size_no_compression += pconn->compression.queue.size;
+                 (unsigned long) queue_size, compressed_packet_len);
+    connection_send_data(pconn, pconn->compression.queue.p, queue_size);
+    pconn->compression.size_no_compression += queue_size;
   }
   return pconn->used;
 }
@@ -187,6 +487,171 @@ bool conn_compression_thaw(struct connection *pconn)
   return pconn->used;
 }
 
+/****************************************************************************
+  Send the data waiting in the compression queue now, as a block of its
+  own. The connection stays frozen. Returns TRUE on success.
+****************************************************************************/
+bool conn_compression_sync(struct connection *pconn)
+{
+#ifdef USE_COMPRESSION
+  if (0 < pconn->compression.frozen_level
+      && 0 < byte_vector_size(&pconn->compression.queue)) {
+    if (!conn_compression_flush(pconn)) {
+      return FALSE;
+    }
+    byte_vector_reserve(&pconn->compression.queue, 0);
+  }
+#endif /* USE_COMPRESSION */
+  return pconn->used;
+}
+
+/**************************************************************************
+  Send the data to the connection, or add it to the compression queue if
+  the connection is frozen. Returns FALSE on failure.
+**************************************************************************/
+static bool conn_send_or_queue(struct connection *pc,
+                               const unsigned char *data, int len)
+{
+#ifdef USE_COMPRESSION
+  if (TRUE) {
+    int size = len;
+
+    if (conn_compression_frozen(pc)) {
+      struct byte_vector *queue = &pc->compression.queue;
+      size_t old_size = byte_vector_size(queue);
+
+      if (data == queue->p + old_size
+          && old_size + len <= queue->size_alloc) {
+        /* Encoded in place, see conn_send_reserve(). */
+        byte_vector_reserve(queue, old_size + len);
+      } else {
+        /* If this packet would cause us to overfill the queue, flush
+         * everything that's in there already before queuing this one */
+        if (MAX_LEN_COMPRESS_QUEUE < old_size + len) {
+          log_compress2("COMPRESS: huge queue, forcing to flush (%lu/%lu)",
+                        (long unsigned) old_size,
+                        (long unsigned) MAX_LEN_COMPRESS_QUEUE);
+          if (!conn_compression_flush(pc)) {
+            return FALSE;
+          }
+          old_size = 0;
+        }
+
+        byte_vector_reserve(queue, old_size + len);
+        memcpy(queue->p + old_size, data, len);
+      }
+      log_compress2("COMPRESS: putting %d bytes into the queue", len);
+    } else {
+      pc->compression.size_alone += size;
+      log_compress("COMPRESS: sending %d bytes alone (%lu bytes total)",
+                   len, pc->compression.size_alone);
+      connection_send_data(pc, data, len);
+    }
+
+    log_compress2("COMPRESS: STATS: alone=%lu compression-expand=%lu "
+                  "compression (before/after) = %lu/%lu",
+                  pc->compression.size_alone,
+                  pc->compression.size_no_compression,
+                  pc->compression.size_uncompressed,
+                  pc->compression.size_compressed);
+  }
+#else  /* USE_COMPRESSION */
+  connection_send_data(pc, data, len);
+#endif /* USE_COMPRESSION */
+
+  return TRUE;
+}
+
+/**************************************************************************
+  Returns where the next packet to the connection should be encoded: at
+  the end of the compression queue when the connection is frozen, else at
+  the end of its send buffer, so that send_packet_data() doesn't copy it.
+  Returns 'fallback', which holds MAX_LEN_PACKET bytes, when the packet is
+  batched or can't be sent.
+**************************************************************************/
+unsigned char *conn_send_reserve(struct connection *pc,
+                                 unsigned char *fallback)
+{
+  unsigned char *buffer;
+
+  if (!pc->used || conn_batch_active(pc)) {
+    return fallback;
+  }
+
+#ifdef USE_COMPRESSION
+  if (conn_compression_frozen(pc)) {
+    struct byte_vector *queue = &pc->compression.queue;
+    size_t size = byte_vector_size(queue);
+
+    /* Flush now if the packet could overfill the queue, as
+     * conn_send_or_queue() can't once it is encoded there. */
+    if (MAX_LEN_COMPRESS_QUEUE < size + MAX_LEN_PACKET) {
+      log_compress2("COMPRESS: huge queue, forcing to flush (%lu/%lu)",
+                    (long unsigned) size,
+                    (long unsigned) MAX_LEN_COMPRESS_QUEUE);
+      if (!conn_compression_flush(pc)) {
+        return fallback;
+      }
+      size = 0;
+    }
+
+    byte_vector_reserve(queue, size + MAX_LEN_PACKET);
+    byte_vector_reserve(queue, size);
+    return queue->p + size;
+  }
+#endif /* USE_COMPRESSION */
+
+  buffer = connection_send_reserve(pc, MAX_LEN_PACKET);
+  return (NULL != buffer ? buffer : fallback);
+}
+
+/****************************************************************************
+  Send the packets of the batch of the connection, as one compressed block
+  when possible. The batch stays open. See also conn_batch_begin().
+****************************************************************************/
+void conn_batch_flush(struct connection *pconn)
+{
+  if (NULL == pconn->batch.entries
+      || 0 == conn_batch_entry_list_size(pconn->batch.entries)) {
+    return;
+  }
+
+  fc_assert_ret(!pconn->batch.flushing);
+  pconn->batch.flushing = TRUE;
+  conn_compression_freeze(pconn);
+
+  conn_batch_entry_list_iterate(pconn->batch.entries, pentry) {
+    if (NULL != pentry->packet) {
+      pentry->send(pconn, pentry->packet, pentry->force_to_send);
+    } else if (0 < byte_vector_size(&pentry->data)) {
+      conn_send_or_queue(pconn, pentry->data.p,
+                         byte_vector_size(&pentry->data));
+    }
+  } conn_batch_entry_list_iterate_end;
+
+  genhash_clear(pconn->batch.staged);
+  conn_batch_entry_list_clear(pconn->batch.entries);
+  pconn->batch.size = 0;
+
+  conn_compression_thaw(pconn);
+  pconn->batch.flushing = FALSE;
+}
+
+/****************************************************************************
+  End a batch started by conn_batch_begin(). The outermost call sends the
+  batched packets.
+****************************************************************************/
+void conn_batch_end(struct connection *pconn)
+{
+  pconn->batch.level--;
+  fc_assert_action_msg(pconn->batch.level >= 0,
+                       pconn->batch.level = 0,
+                       "Too many calls to conn_batch_end on %s!",
+                       conn_description(pconn));
+  if (0 == pconn->batch.level) {
+    conn_batch_flush(pconn);
+  }
+}
 
 /**************************************************************************
   It returns the request id of the outgoing packet (or 0 if is_server()).
@@ -213,54 +678,13 @@ int send_packet_data(struct connection *pc, unsigned char *data, int len,
     pc->outgoing_packet_notify(pc, packet_type, len, result);
   }
 
-#ifdef USE_COMPRESSION
-  if (TRUE) {
-    int size = len;
-
-    if (conn_compression_frozen(pc)) {
-      size_t old_size;
-
-      /* Keep this a decent amount less than MAX_LEN_BUFFER to avoid the
-       * (remote) possibility of trying to dump MAX_LEN_BUFFER to the
-       * network in one go */
-#define MAX_LEN_COMPRESS_QUEUE (MAX_LEN_BUFFER/2)
-      FC_STATIC_ASSERT(MAX_LEN_COMPRESS_QUEUE < MAX_LEN_BUFFER,
-                       compress_queue_maxlen_too_big);
-
-      /* If this packet would cause us to overfill the queue, flush
-       * everything that's in there already before queuing this one */
-      if (MAX_LEN_COMPRESS_QUEUE
-          < byte_vector_size(&pc->compression.queue) + len) {
-        log_compress2("COMPRESS: huge queue, forcing to flush (%lu/%lu)",
-                      (long unsigned)
-                      byte_vector_size(&pc->compression.queue),
-                      (long unsigned) MAX_LEN_COMPRESS_QUEUE);
-        if (!conn_compression_flush(pc)) {
-          return -1;
-        }
-        byte_vector_reserve(&pc->compression.queue, 0);
-      }
-
-      old_size = byte_vector_size(&pc->compression.queue);
-      byte_vector_reserve(&pc->compression.queue, old_size + len);
-      memcpy(pc->compression.queue.p + old_size, data, len);
-      log_compress2("COMPRESS: putting %s into the queue",
-                    packet_name(packet_type));
-    } else {
-      stat_size_alone += size;
-      log_compress("COMPRESS: sending %s alone (%d bytes total)",
-                   packet_name(packet_type), stat_size_alone);
-      connection_send_data(pc, data, len);
-    }
-
-    log_compress2("COMPRESS: STATS: alone=%d compression-expand=%d "
-                  "compression (before/after) = %d/%d",
-                  stat_size_alone, stat_size_no_compression,
-                  stat_size_uncompressed, stat_size_compressed);
+  if (conn_batch_active(pc)) {
+    log_compress2("COMPRESS: putting %s into the batch",
+                  packet_name(packet_type));
+    conn_batch_put(pc, data, len);
+  } else if (!conn_send_or_queue(pc, data, len)) {
+    return -1;
   }
-#else  /* USE_COMPRESSION */
-  connection_send_data(pc, data, len);
-#endif /* USE_COMPRESSION */
 
 #if PACKET_SIZE_STATISTICS
   {
@@ -421,21 +845,15 @@ void *get_packet_from_connection(struct connection *pc,
   }
 
   if (compressed_packet) {
-    uLong compressed_size = whole_packet_len - header_size;
-    /* 
-     * We don't know the decompressed size. We assume a bad case
-     * here: an expansion by an factor of 100. 
-     */
-    unsigned long int decompressed_size = 100 * compressed_size;
-    void *decompressed = fc_malloc(decompressed_size);
-    int error;
+    size_t compressed_size = whole_packet_len - header_size;
+    size_t decompressed_size;
+    unsigned char *decompressed;
     struct socket_packet_buffer *buffer = pc->buffer;
-    
-    error =
-	uncompress(decompressed, &decompressed_size,
-		   ADD_TO_POINTER(buffer->data, header_size), 
-		   compressed_size);
-    if (error != Z_OK) {
+
+    decompressed = conn_decompress(pc, ADD_TO_POINTER(buffer->data,
+                                                      header_size),
+                                   compressed_size, &decompressed_size);
+    if (NULL == decompressed) {
       log_verbose("Uncompressing of the packet stream failed. "
                   "The connection will be closed now.");
       connection_close(pc, _("decoding error"));
@@ -469,8 +887,9 @@ void *get_packet_from_connection(struct connection *pc,
 
     buffer->ndata += decompressed_size;
     
-    log_compress("COMPRESS: decompressed %ld into %ld",
-                 compressed_size, decompressed_size);
+    log_compress("COMPRESS: decompressed %lu into %lu",
+                 (unsigned long) compressed_size,
+                 (unsigned long) decompressed_size);
 
     return get_packet_from_connection(pc, ptype);
   }
@@ -111,11 +111,15 @@ void pre_send_packet_player_attribute_chunk(struct connection *pc,
 					    struct packet_player_attribute_chunk
 					    *packet);
 
+/* The packet is encoded where it will be sent from when possible, see
+ * conn_send_reserve(). Nothing else may be sent to the connection before
+ * SEND_PACKET_END. */
 #define SEND_PACKET_START(packet_type) \
-  unsigned char buffer[MAX_LEN_PACKET]; \
+  unsigned char stack_buffer[MAX_LEN_PACKET]; \
+  unsigned char *buffer = conn_send_reserve(pc, stack_buffer); \
   struct data_out dout; \
   \
-  dio_output_init(&dout, buffer, sizeof(buffer)); \
+  dio_output_init(&dout, buffer, MAX_LEN_PACKET); \
   dio_put_type(&dout, pc->packet_header.length, 0); \
   dio_put_type(&dout, pc->packet_header.type, packet_type);
 
@@ -157,6 +161,8 @@ void pre_send_packet_player_attribute_chunk(struct connection *pc,
   log_packet("Error on field '" #field "'" __VA_ARGS__); \
   return NULL
 
+unsigned char *conn_send_reserve(struct connection *pc,
+                                 unsigned char *fallback);
 int send_packet_data(struct connection *pc, unsigned char *data, int len,
                      enum packet_type packet_type);
 bool packet_check(struct data_in *din, struct connection *pc);
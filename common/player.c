@@ -25,6 +25,7 @@
 
 /* common */
 #include "city.h"
+#include "effects.h"
 #include "fc_interface.h"
 #include "featured_text.h"
 #include "game.h"
@@ -691,6 +692,7 @@ void player_destroy(struct player *pplayer)
   }
 
   dbv_free(&pplayer->tile_known);
+  effect_cache_destroy(pplayer->effect_cache);
 
   free(pplayer);
   pslot->player = NULL;
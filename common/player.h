@@ -198,6 +198,7 @@ struct attribute_block_s {
 
 struct ai_type;
 struct ai_data;
+struct effect_cache; /* defined and only used within effects.c */
 
 struct player {
   struct player_slot *slot;
@@ -250,6 +251,9 @@ struct player {
 
   struct dbv tile_known;
 
+  /* Cache of the player effect values (see get_player_bonus()). */
+  struct effect_cache *effect_cache;
+
   struct rgbcolor *rgb;
 
   int culture; /* National level culture - does not include culture of individual
@@ -265,6 +269,8 @@ struct player {
                             * (Previously 'capital'.) */
 
       struct player_tile *private_map;
+      /* Tiles to send to the player when send_tile_info() is thawed. */
+      struct dbv tile_dirty;
 
       bv_player really_gives_vision; /* takes into account that p3 may see
                                       * what p1 has via p2 */
@@ -22,6 +22,7 @@
 #include "support.h"
 
 /* common */
+#include "effects.h"
 #include "fc_types.h"
 #include "game.h"
 #include "player.h"
@@ -322,6 +323,7 @@ void research_update(struct research *presearch)
       }
     } advance_index_iterate_end;
   }
+  effect_cache_advances_changed();
 }
 
 /****************************************************************************
@@ -366,6 +368,9 @@ enum tech_state research_invention_set(struct research *presearch,
   if (value == TECH_KNOWN) {
     game.info.global_advances[tech] = TRUE;
   }
+  if (value == TECH_KNOWN || old == TECH_KNOWN) {
+    effect_cache_advances_changed();
+  }
   return old;
 }
 
@@ -39,6 +39,8 @@ struct vision *vision_new(struct player *pplayer, struct tile *ptile)
   vision->can_reveal_tiles = TRUE;
   vision->radius_sq[V_MAIN] = -1;
   vision->radius_sq[V_INVIS] = -1;
+  vision->moved_from = NULL;
+  vision->moved_to = NULL;
 
   return vision;
 }
@@ -50,6 +52,14 @@ void vision_free(struct vision *vision)
 {
   fc_assert(-1 == vision->radius_sq[V_MAIN]);
   fc_assert(-1 == vision->radius_sq[V_INVIS]);
+
+  /* Do not leave a dangling link to a source being moved. */
+  if (NULL != vision->moved_from) {
+    vision->moved_from->moved_to = NULL;
+  }
+  if (NULL != vision->moved_to) {
+    vision->moved_to->moved_from = NULL;
+  }
   free(vision);
 }
 
@@ -68,6 +68,10 @@ extern "C" {
   note that for all the code in the middle both the new and the old
   vision sources are active.  The same process applies when transferring
   a unit or city between players, etc.
+
+  A moving source can use vision_move_sight(new_vision, radius, old_vision)
+  instead of vision_change_sight(): then only the tiles entering the sight
+  are unfogged, and clearing the old source only fogs the tiles leaving it.
 ****************************************************************************/
 
 /* Invariants: V_MAIN vision ranges must always be more than V_INVIS
@@ -94,6 +98,11 @@ struct vision {
 
   /* The radius of the vision source. */
   v_radius_t radius_sq;
+
+  /* Set while the sight of 'moved_from' is handed over to this source,
+   * see vision_move_sight() in server/maphand.c. */
+  struct vision *moved_from;
+  struct vision *moved_to;
 };
 
 /* Initialize a vision radius array. */
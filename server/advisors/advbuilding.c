@@ -37,6 +37,7 @@
 
 /* server/advisors */
 #include "advdata.h"
+#include "advgoto.h"
 #include "advtools.h"
 #include "infracache.h" /* adv_city */
 
@@ -83,7 +84,7 @@ static void calculate_city_clusters(struct player *pplayer)
     unit_tile_set(ghost, pcity->tile);
     pft_fill_unit_parameter(&parameter, ghost);
     parameter.omniscience = !has_handicap(pplayer, H_MAP);
-    pfm = pf_map_new(&parameter);
+    pfm = adv_pf_map_new(&parameter);
 
     pf_map_move_costs_iterate(pfm, ptile, move_cost, FALSE) {
       struct city *acity = tile_city(ptile);
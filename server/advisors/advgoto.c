@@ -15,6 +15,9 @@
 #include <fc_config.h>
 #endif
 
+/* utility */
+#include "fcthreadpool.h"
+
 /* common */
 #include "ai.h"
 #include "combat.h"
@@ -37,6 +40,13 @@
 
 #include "advgoto.h"
 
+/* Maps shared by the advisors and the AI, see adv_pf_map_new(). */
+static struct pf_map_cache *adv_pf_cache = NULL;
+
+/* Maps computed in advance, see adv_pf_batch_begin(). */
+static struct pf_map_cache *adv_pf_batch = NULL;
+static struct fc_threadpool *adv_pf_workers = NULL;
+
 static bool adv_unit_move(struct unit *punit, struct tile *ptile);
 
 /**************************************************************************
@@ -435,3 +445,95 @@ void adv_avoid_risks(struct pf_parameter *parameter,
 
   risk_cost->enemy_zoc_cost = PF_TURN_FACTOR * 20;
 }
+
+/**************************************************************************
+  Create a path-finding map for the advisors. Maps created with the same
+  parameter are sharing the same lattice until the next call to
+  adv_pf_cache_clear(), so many units evaluating several tasks don't
+  expand the same maps again and again. Must be destroyed with
+  pf_map_destroy() as usual.
+**************************************************************************/
+struct pf_map *adv_pf_map_new(const struct pf_parameter *parameter)
+{
+  if (NULL != adv_pf_batch) {
+    struct pf_map *pfm = pf_map_cache_map_get(adv_pf_batch, parameter);
+
+    if (NULL != pfm) {
+      return pfm;
+    }
+  }
+
+  if (NULL == adv_pf_cache) {
+    adv_pf_cache = pf_map_cache_new();
+  }
+
+  return pf_map_cache_map_new(adv_pf_cache, parameter);
+}
+
+/**************************************************************************
+  Forget the maps shared by the advisors. Must be called when the game
+  state changes in a way that could modify the path-finding results (unit
+  moves, city changes, terrain changes, diplomatic changes...).
+**************************************************************************/
+void adv_pf_cache_clear(void)
+{
+  if (NULL != adv_pf_cache) {
+    pf_map_cache_clear(adv_pf_cache);
+  }
+}
+
+/**************************************************************************
+  Free the maps shared by the advisors.
+**************************************************************************/
+void adv_pf_cache_free(void)
+{
+  adv_pf_batch_end();
+  if (NULL != adv_pf_cache) {
+    pf_map_cache_destroy(adv_pf_cache);
+    adv_pf_cache = NULL;
+  }
+  if (NULL != adv_pf_workers) {
+    fc_threadpool_destroy(adv_pf_workers);
+    adv_pf_workers = NULL;
+  }
+}
+
+/**************************************************************************
+  Compute in advance the maps for all the parameters, with the number of
+  extra threads set by the 'pfthreads' server setting. Until
+  adv_pf_batch_end(), adv_pf_map_new() returns these maps for the same
+  parameters, even if the cache was cleared meanwhile: the maps keep the
+  state of the game at the time of this call. Does nothing if the
+  setting is 0.
+**************************************************************************/
+void adv_pf_batch_begin(const struct pf_parameter *parameters, int num)
+{
+  adv_pf_batch_end();
+
+  if (0 >= game.server.pfthreads || 0 >= num) {
+    return;
+  }
+
+  if (NULL != adv_pf_workers
+      && fc_threadpool_size(adv_pf_workers) != game.server.pfthreads) {
+    fc_threadpool_destroy(adv_pf_workers);
+    adv_pf_workers = NULL;
+  }
+  if (NULL == adv_pf_workers) {
+    adv_pf_workers = fc_threadpool_new(game.server.pfthreads);
+  }
+
+  adv_pf_batch = pf_map_cache_new();
+  pf_map_cache_fill(adv_pf_batch, parameters, num, adv_pf_workers);
+}
+
+/**************************************************************************
+  Forget the maps computed by adv_pf_batch_begin().
+**************************************************************************/
+void adv_pf_batch_end(void)
+{
+  if (NULL != adv_pf_batch) {
+    pf_map_cache_destroy(adv_pf_batch);
+    adv_pf_batch = NULL;
+  }
+}
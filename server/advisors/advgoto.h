@@ -43,6 +43,13 @@ void adv_avoid_risks(struct pf_parameter *parameter,
                      struct unit *punit,
                      const double fearfulness);
 
+struct pf_map *adv_pf_map_new(const struct pf_parameter *parameter)
+               fc__warn_unused_result;
+void adv_pf_cache_clear(void);
+void adv_pf_cache_free(void);
+void adv_pf_batch_begin(const struct pf_parameter *parameters, int num);
+void adv_pf_batch_end(void);
+
 int adv_unittype_att_rating(const struct unit_type *punittype, int veteran,
                             int moves_left, int hp);
 int adv_unit_att_rating(const struct unit *punit);
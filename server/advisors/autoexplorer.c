@@ -140,7 +140,7 @@ static bool explorer_goto(struct unit *punit, struct tile *ptile)
 
   UNIT_LOG(LOG_DEBUG, punit, "explorer_goto to %d,%d", TILE_XY(ptile));
 
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
   path = pf_map_path(pfm, ptile);
 
   if (path != NULL) {
@@ -308,7 +308,7 @@ enum unit_move_result manage_auto_explorer(struct unit *punit)
   /* When exploring, even AI should pretend to not cheat. */
   parameter.omniscience = FALSE;
 
-  pfm = pf_map_new(&parameter);
+  pfm = adv_pf_map_new(&parameter);
   pf_map_move_costs_iterate(pfm, ptile, move_cost, FALSE) {
     int desirable;
     double log_desirable;
@@ -337,6 +337,50 @@ autosettler_tile_behavior(const struct tile *ptile,
   return TB_NORMAL;
 }
 
+/****************************************************************************
+  Fill the path-finding parameter used by the workers to look for tasks.
+****************************************************************************/
+static void settler_fill_pf_parameter(struct pf_parameter *parameter,
+                                      const struct unit *punit)
+{
+  pft_fill_unit_parameter(parameter, punit);
+  parameter->omniscience = !has_handicap(unit_owner(punit), H_MAP);
+  parameter->get_TB = autosettler_tile_behavior;
+}
+
+/****************************************************************************
+  Compute in advance, with the extra threads set by the 'pfthreads' server
+  setting, the maps the workers of the player are likely to use. Must be
+  followed by a call to adv_pf_batch_end().
+****************************************************************************/
+static void settler_prefetch_pf_maps(struct player *pplayer)
+{
+  struct pf_parameter *parameters;
+  int num = 0;
+
+  if (0 >= game.server.pfthreads) {
+    return;
+  }
+
+  parameters = fc_malloc(unit_list_size(pplayer->units)
+                         * sizeof(*parameters));
+  unit_list_iterate(pplayer->units, punit) {
+    if ((punit->ai_controlled || pplayer->ai_controlled)
+        && unit_has_type_flag(punit, UTYF_SETTLERS)
+        && !unit_has_orders(punit)
+        && punit->moves_left > 0
+        && (ACTIVITY_IDLE == punit->activity
+            || ACTIVITY_SENTRY == punit->activity
+            || ACTIVITY_GOTO == punit->activity)) {
+      /* Units which are going to look for a new task, see below. */
+      settler_fill_pf_parameter(parameters + num++, punit);
+    }
+  } unit_list_iterate_end;
+
+  adv_pf_batch_begin(parameters, num);
+  free(parameters);
+}
+
 /****************************************************************************
   Finds tiles to improve, using punit.
 
@@ -376,10 +420,8 @@ int settler_evaluate_improvements(struct unit *punit,
   /* closest worker, if any, headed towards target tile */
   struct unit *enroute = NULL;
 
-  pft_fill_unit_parameter(&parameter, punit);
-  parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  parameter.get_TB = autosettler_tile_behavior;
-  pfm = pf_map_new(&parameter);
+  settler_fill_pf_parameter(&parameter, punit);
+  pfm = adv_pf_map_new(&parameter);
 
   city_list_iterate(pplayer->cities, pcity) {
     struct tile *pcenter = city_tile(pcity);
@@ -692,10 +734,8 @@ static int settler_evaluate_city_requests(struct unit *punit,
   struct worker_task *best = NULL;
   int dist = FC_INFINITY;
 
-  pft_fill_unit_parameter(&parameter, punit);
-  parameter.omniscience = !has_handicap(pplayer, H_MAP);
-  parameter.get_TB = autosettler_tile_behavior;
-  pfm = pf_map_new(&parameter);
+  settler_fill_pf_parameter(&parameter, punit);
+  pfm = adv_pf_map_new(&parameter);
 
   /* Have nearby cities requests? */
   city_list_iterate(pplayer->cities, pcity) {
@@ -926,10 +966,8 @@ void auto_settler_setup_work(struct player *pplayer, struct unit *punit,
     }
 
     if (!path) {
-      pft_fill_unit_parameter(&parameter, punit);
-      parameter.omniscience = !has_handicap(pplayer, H_MAP);
-      parameter.get_TB = autosettler_tile_behavior;
-      pfm = pf_map_new(&parameter);
+      settler_fill_pf_parameter(&parameter, punit);
+      pfm = adv_pf_map_new(&parameter);
       path = pf_map_path(pfm, best_tile);
     }
 
@@ -1028,6 +1066,8 @@ void auto_settlers_player(struct player *pplayer)
    * player auto-settler mode) or if the player is an AI.  But don't
    * auto-settle with a unit under orders even for an AI player - these come
    * from the human player and take precedence. */
+  settler_prefetch_pf_maps(pplayer);
+
   unit_list_iterate_safe(pplayer->units, punit) {
     if ((punit->ai_controlled || pplayer->ai_controlled)
         && (unit_has_type_flag(punit, UTYF_SETTLERS)
@@ -1061,6 +1101,8 @@ void auto_settlers_player(struct player *pplayer)
       }
     }
   } unit_list_iterate_safe_end;
+  adv_pf_batch_end();
+
   /* Reset auto settler state for the next run. */
   if (pplayer->ai_controlled) {
     CALL_PLR_AI_FUNC(settler_reset, pplayer, pplayer);
@@ -51,6 +51,10 @@
 #include "unitlist.h"
 #include "vision.h"
 
+/* common/aicore */
+#include "path_finding.h"
+#include "pf_regions.h"
+
 /* common/scriptcore */
 #include "luascript_types.h"
 
@@ -134,7 +138,8 @@ void city_thaw_workers(struct city *pcity)
   pcity->server.workers_frozen--;
   fc_assert(pcity->server.workers_frozen >= 0);
   if (pcity->server.workers_frozen == 0 && pcity->server.needs_arrange) {
-    city_refresh(pcity); /* Citizen count sanity */
+    /* Citizen count sanity */
+    city_refresh_partial(pcity, CD_WORKERS);
     auto_arrange_workers(pcity);
   }
 }
@@ -1045,6 +1050,7 @@ bool transfer_city(struct player *ptaker, struct city *pcity,
   pcity->owner = ptaker;
   map_claim_ownership(pcenter, ptaker, pcenter, TRUE);
   city_list_prepend(ptaker->cities, pcity);
+  adv_pf_cache_clear();
 
   transfer_city_units(ptaker, pgiver, old_city_units,
 		      pcity, NULL,
@@ -1335,6 +1341,9 @@ void create_city(struct player *pplayer, struct tile *ptile,
   fc_allocate_mutex(&game.server.mutexes.city_list);
   idex_register_city(pcity);
   fc_release_mutex(&game.server.mutexes.city_list);
+  adv_pf_cache_clear();
+  pf_map_tile_changed(ptile);
+  pf_regions_tile_changed(ptile);
 
   if (city_list_size(pplayer->cities) == 0) {
     /* Free initial buildings, or at least a palace if they were
@@ -1620,6 +1629,9 @@ dbv_free(&tile_processed);
 
   fc_allocate_mutex(&game.server.mutexes.city_list);
   game_remove_city(pcity);
+  adv_pf_cache_clear();
+  pf_map_tile_changed(pcenter);
+  pf_regions_tile_changed(pcenter);
   fc_release_mutex(&game.server.mutexes.city_list);
 
   /* Remove any extras that were only there because the city was there. */
@@ -1629,6 +1641,7 @@ dbv_free(&tile_processed);
       tile_remove_extra(pcenter, pextra);
     }
   } extra_type_iterate_end;
+  pf_map_tile_changed(pcenter);
 
   players_iterate(other_player) {
     if (map_is_known_and_seen(pcenter, other_player, V_MAIN)) {
@@ -2556,17 +2569,18 @@ void building_lost(struct city *pcity, const struct impr_type *pimprove)
     * building created (via city_refresh() in in city_build_building())
 
   If the upkeep for a unit changes, an update is send to the player.
+  Returns whether the upkeep of any unit changed.
 **************************************************************************/
-void city_units_upkeep(const struct city *pcity)
+bool city_units_upkeep(const struct city *pcity)
 {
   int free[O_LAST], cost;
   struct unit_type *ut;
   struct player *plr;
-  bool update;
+  bool update, changed = FALSE;
 
   if (!pcity || !pcity->units_supported
       || unit_list_size(pcity->units_supported) < 1) {
-    return;
+    return FALSE;
   }
 
   memset(free, 0, O_LAST * sizeof(*free));
@@ -2602,8 +2616,11 @@ void city_units_upkeep(const struct city *pcity)
     if (update) {
       /* update unit information to the player */
       send_unit_info(plr, punit);
+      changed = TRUE;
     }
   } unit_list_iterate_end;
+
+  return changed;
 }
 
 /**************************************************************************
@@ -2721,7 +2738,8 @@ static bool city_map_update_tile_direct(struct tile *ptile, bool queued)
     if (queued) {
       city_freeze_workers_queue(pwork); /* place the displaced later */
     } else {
-      city_refresh(pwork); /* Specialist added, keep citizen count sanity */
+      /* Specialist added, keep citizen count sanity */
+      city_refresh_partial(pwork, CD_TILES);
       auto_arrange_workers(pwork);
       send_city_info(NULL, pwork);
     }
@@ -2857,6 +2875,30 @@ void city_refresh_vision(struct city *pcity)
   ASSERT_VISION(pcity->server.vision);
 }
 
+/**************************************************************************
+  Returns the squared city radius the effects give to the city.
+**************************************************************************/
+static int city_map_radius_sq_by_effects(const struct city *pcity)
+{
+  int radius_sq = game.info.init_city_radius_sq
+                  + get_city_bonus(pcity, EFT_CITY_RADIUS_SQ);
+
+  /* check minimum / maximum allowed city radii */
+  return CLIP(CITY_MAP_MIN_RADIUS_SQ, radius_sq, CITY_MAP_MAX_RADIUS_SQ);
+}
+
+/**************************************************************************
+  Returns whether city_map_update_radius_sq() would change the city map,
+  without changing anything.
+**************************************************************************/
+bool city_map_radius_sq_outdated(const struct city *pcity)
+{
+  fc_assert_ret_val(pcity != NULL, FALSE);
+
+  return (city_map_tiles(city_map_radius_sq_by_effects(pcity))
+          != city_map_tiles(city_map_radius_sq_get(pcity)));
+}
+
 /**************************************************************************
   Updates the squared city radius. Returns if the radius is changed.
 **************************************************************************/
@@ -2867,12 +2909,7 @@ bool city_map_update_radius_sq(struct city *pcity)
 
   int city_tiles_old, city_tiles_new;
   int city_radius_sq_old = city_map_radius_sq_get(pcity);
-  int city_radius_sq_new = game.info.init_city_radius_sq
-                           + get_city_bonus(pcity, EFT_CITY_RADIUS_SQ);
-
-  /* check minimum / maximum allowed city radii */
-  city_radius_sq_new = CLIP(CITY_MAP_MIN_RADIUS_SQ, city_radius_sq_new,
-                            CITY_MAP_MAX_RADIUS_SQ);
+  int city_radius_sq_new = city_map_radius_sq_by_effects(pcity);
 
   if (city_radius_sq_new == city_radius_sq_old) {
     /* no change */
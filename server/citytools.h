@@ -63,7 +63,7 @@ void remove_trade_route(struct city *pc1, struct city *pc2, bool announce);
 void do_sell_building(struct player *pplayer, struct city *pcity,
 		      struct impr_type *pimprove);
 void building_lost(struct city *pcity, const struct impr_type *pimprove);
-void city_units_upkeep(const struct city *pcity);
+bool city_units_upkeep(const struct city *pcity);
 
 bool is_production_equal(const struct universal *one,
 			 const struct universal *two);
@@ -90,6 +90,7 @@ bool city_map_update_tile_now(struct tile *ptile);
 void city_map_update_all(struct city *pcity);
 void city_map_update_all_cities_for_player(struct player *pplayer);
 
+bool city_map_radius_sq_outdated(const struct city *pcity);
 bool city_map_update_radius_sq(struct city *pcity);
 
 void city_landlocked_sell_coastal_improvements(struct tile *ptile);
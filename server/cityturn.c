@@ -22,6 +22,7 @@
 
 /* utility */
 #include "fcintl.h"
+#include "fcthreadpool.h"
 #include "log.h"
 #include "mem.h"
 #include "rand.h"
@@ -30,6 +31,7 @@
 
 /* common/aicore */
 #include "cm.h"
+#include "path_finding.h"
 
 /* common */
 #include "achievements.h"
@@ -37,6 +39,7 @@
 #include "citizens.h"
 #include "city.h"
 #include "culture.h"
+#include "effects.h"
 #include "events.h"
 #include "disaster.h"
 #include "game.h"
@@ -130,7 +133,7 @@ static bool player_balance_treasury_units(struct player *pplayer);
 static bool disband_city(struct city *pcity);
 
 static void define_orig_production_values(struct city *pcity);
-static void update_city_activity(struct city *pcity);
+static void update_city_activity(struct city *pcity, bool refreshed);
 static void nullify_caravan_and_disband_plus(struct city *pcity);
 static bool city_illness_check(const struct city * pcity);
 
@@ -139,6 +142,24 @@ static bool do_city_migration(struct city *pcity_from,
                               struct city *pcity_to);
 static void check_city_migrations_player(const struct player *pplayer);
 
+/* Threads refreshing the cities in advance, see city_refresh_batch(). */
+static struct fc_threadpool *city_refresh_workers = NULL;
+
+/* What the cities refreshed in advance depend on besides their own state,
+ * see city_refresh_batch_outdated(). */
+struct city_refresh_stamp {
+  unsigned int effects;                 /* effect_cache_stamp() */
+  unsigned int tiles;                   /* pf_map_changes_stamp() */
+  const struct government *pgov;
+  int tax, lux, sci;
+  int cities;
+};
+
+/* Full and partial city refreshes done this turn, see
+ * city_refresh_counts_log(). */
+static int city_refreshes_full = 0;
+static int city_refreshes_partial = 0;
+
 /**************************************************************************
   Updates unit upkeeps and city internal cached data. Returns whether
   city radius has changed.
@@ -148,6 +169,8 @@ bool city_refresh(struct city *pcity)
   bool retval;
 
   pcity->server.needs_refresh = FALSE;
+  pcity->server.refresh_dirty = 0;
+  city_refreshes_full++;
 
   retval = city_map_update_radius_sq(pcity);
   city_units_upkeep(pcity); /* update unit upkeep */
@@ -162,15 +185,186 @@ bool city_refresh(struct city *pcity)
   return retval;
 }
 
+/**************************************************************************
+  Like city_refresh(), but only updates what depends on the changes in
+  'dirty', a bitmask of enum city_dirty. Any change not listed needs a
+  full city_refresh(). Returns whether city radius has changed.
+**************************************************************************/
+bool city_refresh_partial(struct city *pcity, int dirty)
+{
+  bool retval = FALSE;
+
+  if ((dirty & CD_BUILDINGS)
+      || ((dirty & CD_UNITS) && effects_have_req_kind(VUT_MAXTILEUNITS))) {
+    return city_refresh(pcity);
+  }
+
+  city_refreshes_partial++;
+
+  if (dirty & CD_TILES) {
+    retval = city_map_update_radius_sq(pcity);
+  }
+  if (dirty & CD_UNITS) {
+    city_units_upkeep(pcity); /* update unit upkeep */
+  }
+  city_refresh_dirty_from_main_map(pcity, dirty);
+  if (dirty & CD_TILES) {
+    city_style_refresh(pcity);
+  }
+
+  if (retval) {
+    /* Force a sync of the city after the change. */
+    send_city_info(city_owner(pcity), pcity);
+  }
+
+  return retval;
+}
+
+/**************************************************************************
+  Log how many full and partial city refreshes were done this turn.
+  Called at turn end.
+**************************************************************************/
+void city_refresh_counts_log(void)
+{
+  log_verbose("City refreshes this turn: %d full, %d partial.",
+              city_refreshes_full, city_refreshes_partial);
+  city_refreshes_full = 0;
+  city_refreshes_partial = 0;
+}
+
+/**************************************************************************
+  Refresh one of the cities listed in data. Job of city_refresh_batch().
+**************************************************************************/
+static void city_refresh_batch_job(int index, void *data)
+{
+  struct city *pcity = ((struct city **) data)[index];
+
+  city_refresh_from_main_map(pcity, NULL);
+  city_style_refresh(pcity);
+}
+
+/**************************************************************************
+  Record the state of the game the cities of the player depend on.
+**************************************************************************/
+static void city_refresh_stamp_get(const struct player *pplayer,
+                                   struct city_refresh_stamp *stamp)
+{
+  memset(stamp, 0, sizeof(*stamp));
+  stamp->effects = effect_cache_stamp();
+  stamp->tiles = pf_map_changes_stamp();
+  stamp->pgov = pplayer->government;
+  stamp->tax = pplayer->economic.tax;
+  stamp->lux = pplayer->economic.luxury;
+  stamp->sci = pplayer->economic.science;
+  stamp->cities = city_list_size(pplayer->cities);
+}
+
+/**************************************************************************
+  Returns TRUE if the state of the game the cities of the player depend
+  on changed since the stamp was recorded by city_refresh_batch(): a
+  wonder, a building, a tech, a tile, the government, the rates or the
+  number of cities. The cities refreshed in advance must then be
+  refreshed again, as they would be without extra threads.
+**************************************************************************/
+static bool city_refresh_batch_outdated(const struct player *pplayer,
+                                        const struct city_refresh_stamp *stamp)
+{
+  struct city_refresh_stamp now;
+
+  city_refresh_stamp_get(pplayer, &now);
+
+  return 0 != memcmp(&now, stamp, sizeof(now));
+}
+
+/**************************************************************************
+  Refresh in advance the n cities of the player, with the number of extra
+  threads set by the 'citythreads' server setting, mark them in
+  refreshed[] and record the stamp of the state they depend on. The
+  cities whose city map would change are left for city_refresh(). Does
+  nothing if the setting is 0, or if the effects depend on state the
+  stamp does not follow.
+**************************************************************************/
+static void city_refresh_batch(struct player *pplayer, struct city **cities,
+                               bool *refreshed, int n,
+                               struct city_refresh_stamp *stamp)
+{
+  struct city *batch[n];
+  int i, num = 0;
+
+  memset(refreshed, 0, n * sizeof(*refreshed));
+  city_refresh_stamp_get(pplayer, stamp);
+
+  /* Moving units and the culture of the other cities can change the
+   * effects of a city without changing the stamp. */
+  if (0 >= game.server.citythreads
+      || effects_have_req_kind(VUT_MAXTILEUNITS)
+      || effects_have_req_kind(VUT_MINCULTURE)) {
+    return;
+  }
+
+  if (NULL != city_refresh_workers
+      && fc_threadpool_size(city_refresh_workers)
+         != game.server.citythreads) {
+    fc_threadpool_destroy(city_refresh_workers);
+    city_refresh_workers = NULL;
+  }
+  if (NULL == city_refresh_workers) {
+    city_refresh_workers = fc_threadpool_new(game.server.citythreads);
+  }
+
+  /* The jobs only write to their own city, its tiles cache and its units,
+   * but the effect caches are shared: fill in the main thread the caches
+   * of the players and the Gov_Center value of the cities, which the
+   * waste of the other cities of the player looks at. The caches are
+   * frozen while the jobs run, so that they only read them. */
+  players_iterate(aplayer) {
+    effect_cache_fill(aplayer);
+  } players_iterate_end;
+
+  for (i = 0; i < n; i++) {
+    (void) is_gov_center(cities[i]);
+    if (!city_map_radius_sq_outdated(cities[i])) {
+      batch[num++] = cities[i];
+      refreshed[i] = TRUE;
+    }
+  }
+
+  effect_cache_freeze();
+  fc_threadpool_run(city_refresh_workers, num, city_refresh_batch_job,
+                    batch);
+  effect_cache_thaw();
+  city_refreshes_full += num;
+}
+
+/**************************************************************************
+  Free the threads refreshing the cities in advance.
+**************************************************************************/
+void city_refresh_workers_free(void)
+{
+  if (NULL != city_refresh_workers) {
+    fc_threadpool_destroy(city_refresh_workers);
+    city_refresh_workers = NULL;
+  }
+}
+
 /**************************************************************************
   Called on government change or wonder completion or stuff like that
   -- Syela
 **************************************************************************/
 void city_refresh_for_player(struct player *pplayer)
+{
+  city_refresh_partial_for_player(pplayer, CD_BUILDINGS);
+}
+
+/**************************************************************************
+  Like city_refresh_for_player(), for changes which need only a partial
+  refresh of the cities, see city_refresh_partial().
+**************************************************************************/
+void city_refresh_partial_for_player(struct player *pplayer, int dirty)
 {
   conn_list_do_buffer(pplayer->connections);
   city_list_iterate(pplayer->cities, pcity) {
-    if (city_refresh(pcity)) {
+    if (city_refresh_partial(pcity, dirty)) {
       auto_arrange_workers(pcity);
     }
     send_city_info(pplayer, pcity);
@@ -186,6 +380,10 @@ void city_refresh_queue_add(struct city *pcity)
   if (NULL == city_refresh_queue) {
     city_refresh_queue = city_list_new();
   } else if (city_list_find_number(city_refresh_queue, pcity->id)) {
+    if (0 != pcity->server.refresh_dirty) {
+      /* A partial refresh is pending, but no longer enough. */
+      pcity->server.needs_refresh = TRUE;
+    }
     return;
   }
 
@@ -193,6 +391,22 @@ void city_refresh_queue_add(struct city *pcity)
   pcity->server.needs_refresh = TRUE;
 }
 
+/****************************************************************************
+  Queue pending city_refresh_partial() for later, after the changes in
+  'dirty', a bitmask of enum city_dirty.
+****************************************************************************/
+void city_refresh_queue_add_dirty(struct city *pcity, int dirty)
+{
+  if (NULL == city_refresh_queue) {
+    city_refresh_queue = city_list_new();
+  }
+  if (!city_list_find_number(city_refresh_queue, pcity->id)) {
+    city_list_prepend(city_refresh_queue, pcity);
+  }
+
+  pcity->server.refresh_dirty |= dirty;
+}
+
 /*************************************************************************
   Refresh the listed cities.
   Called after significant changes to borders, and arranging workers.
@@ -209,6 +423,14 @@ void city_refresh_queue_processing(void)
         auto_arrange_workers(pcity);
       }
       send_city_info(city_owner(pcity), pcity);
+    } else if (0 != pcity->server.refresh_dirty) {
+      int dirty = pcity->server.refresh_dirty;
+
+      pcity->server.refresh_dirty = 0;
+      if (city_refresh_partial(pcity, dirty)) {
+        auto_arrange_workers(pcity);
+      }
+      send_city_info(city_owner(pcity), pcity);
     }
   } city_list_iterate_end;
 
@@ -402,12 +624,8 @@ void auto_arrange_workers(struct city *pcity)
     cm_print_result(cmr);
   }
 
-  if (city_refresh(pcity)) {
-    log_error("%s radius changed when already arranged workers.",
-              city_name(pcity));
-    /* Can't do anything - don't want to enter infinite recursive loop
-     * by trying to arrange workers more. */
-  }
+  /* Only the workers changed, so the radius can not change here. */
+  city_refresh_partial(pcity, CD_WORKERS);
   sanity_check_city(pcity);
 
   cm_result_destroy(cmr);
@@ -543,6 +761,8 @@ void update_city_activities(struct player *pplayer)
 
   if (n > 0) {
     struct city *cities[n];
+    bool refreshed[n];
+    struct city_refresh_stamp stamp;
     int i = 0, r;
 
     city_list_iterate(pplayer->cities, pcity) {
@@ -577,13 +797,23 @@ void update_city_activities(struct player *pplayer)
      * 2 - The nation as a whole balances the treasury. If the treasury is
      *     not balance units and buildings are sold. */
 
-    /* Iterate over cities in a random order. */
+    /* Refresh the cities in advance, then update them one by one in a
+     * random order. */
+    city_refresh_batch(pplayer, cities, refreshed, n, &stamp);
     while (i > 0) {
       r = fc_rand(i);
+      if (refreshed[r] && city_refresh_batch_outdated(pplayer, &stamp)) {
+        /* The update of a city changed what the others depend on. */
+        memset(refreshed, 0, i * sizeof(*refreshed));
+      }
       /* update unit upkeep */
-      city_units_upkeep(cities[r]);
-      update_city_activity(cities[r]);
-      cities[r] = cities[--i];
+      if (city_units_upkeep(cities[r])) {
+        refreshed[r] = FALSE;
+      }
+      update_city_activity(cities[r], refreshed[r]);
+      i--;
+      cities[r] = cities[i];
+      refreshed[r] = refreshed[i];
     }
 
     if (pplayer->economic.gold < 0 && game.info.gold_upkeep_style > 0) {
@@ -2706,9 +2936,11 @@ void nullify_prechange_production(struct city *pcity)
 }
 
 /**************************************************************************
- Called every turn, at end of turn, for every city.
+ Called every turn, at end of turn, for every city. refreshed tells if the
+ city was refreshed by city_refresh_batch() and its units keep their
+ upkeep.
 **************************************************************************/
-static void update_city_activity(struct city *pcity)
+static void update_city_activity(struct city *pcity, bool refreshed)
 {
   struct player *pplayer;
   struct government *gov;
@@ -2720,7 +2952,9 @@ static void update_city_activity(struct city *pcity)
   pplayer = city_owner(pcity);
   gov = government_of_city(pcity);
 
-  if (city_refresh(pcity)) {
+  if ((!refreshed || pcity->server.needs_refresh
+       || 0 != pcity->server.refresh_dirty)
+      && city_refresh(pcity)) {
     auto_arrange_workers(pcity);
   }
 
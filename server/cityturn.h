@@ -22,10 +22,15 @@ struct conn_list;
 struct cm_result;
 
 bool city_refresh(struct city *pcity);          /* call if city has changed */
+bool city_refresh_partial(struct city *pcity, int dirty);
 void city_refresh_for_player(struct player *pplayer); /* tax/govt changed */
+void city_refresh_partial_for_player(struct player *pplayer, int dirty);
+void city_refresh_counts_log(void);
 
 void city_refresh_queue_add(struct city *pcity);
+void city_refresh_queue_add_dirty(struct city *pcity, int dirty);
 void city_refresh_queue_processing(void);
+void city_refresh_workers_free(void);
 
 void auto_arrange_workers(struct city *pcity); /* will arrange the workers */
 void apply_cmresult_to_city(struct city *pcity, const struct cm_result *cmr);
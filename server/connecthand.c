@@ -141,6 +141,8 @@ void establish_new_connection(struct connection *pconn)
   sz_strlcpy(packet.challenge_file, new_challenge_filename(pconn));
   packet.conn_id = pconn->id;
   send_packet_server_join_reply(pconn, &packet);
+  /* The compression method may change once established. */
+  conn_compression_sync(pconn);
 
   /* "establish" the connection */
   pconn->established = TRUE;
@@ -34,6 +34,9 @@
 #include "research.h"
 #include "unit.h"
 
+/* common/aicore */
+#include "path_finding.h"
+
 /* common/scriptcore */
 #include "luascript_types.h"
 
@@ -47,6 +50,7 @@
 #include "unittools.h"
 
 /* server/advisors */
+#include "advgoto.h"
 #include "autosettlers.h"
 
 /* server/scripting */
@@ -597,6 +601,10 @@ void handle_diplomacy_accept_treaty_req(struct player *pplayer,
       sync_cities();
     }
 
+    /* Diplomatic states or map knowledge may have changed. */
+    adv_pf_cache_clear();
+    pf_map_game_changed();
+
   cleanup:
     treaty_list_remove(treaties, ptreaty);
     clear_treaty(ptreaty);
@@ -141,6 +141,7 @@ static void check_edited_tile_terrains(void)
 {
   if (need_continents_reassigned) {
     assign_continent_numbers();
+    map_borders_dirty_all();
     send_all_known_tiles(NULL);
     need_continents_reassigned = FALSE;
   }
@@ -1362,6 +1363,7 @@ void handle_edit_player_vision(struct connection *pc, int plr_no,
 ****************************************************************************/
 void handle_edit_recalculate_borders(struct connection *pc)
 {
+  map_borders_dirty_all();
   map_calculate_borders();
 }
 
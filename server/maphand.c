@@ -38,6 +38,10 @@
 #include "unitlist.h"
 #include "vision.h"
 
+/* common/aicore */
+#include "path_finding.h"
+#include "pf_regions.h"
+
 /* generator */
 #include "utilities.h"
 
@@ -52,6 +56,9 @@
 #include "unithand.h"
 #include "unittools.h"
 
+/* server/advisors */
+#include "advgoto.h"
+
 #include "maphand.h"
 
 #define MAXIMUM_CLAIMED_OCEAN_SIZE (20)
@@ -59,7 +66,36 @@
 /* Suppress send_tile_info() during game_load() */
 static bool send_tile_suppressed = FALSE;
 
+/* While send_tile_info() is frozen, the tiles to send are only marked in
+ * the players' tile_dirty maps, and sent once when it is thawed. */
+static int send_tile_frozen_level = 0;
+static bv_player send_tile_dirty_players;
+/* Dirty tiles of the global observers. */
+static struct dbv send_tile_dirty_observers;
+
+/* What map_claim_border() depends on for a border source, to know whether
+ * map_calculate_borders() has to claim its border again. */
+struct border_source {
+  bool is_source;
+  int radius_sq;
+  int strength;
+  int city_radius_sq;
+  struct player *owner;
+  Continent_id continent;
+  bool claim_ocean;
+};
+
+/* The border sources at the last map_calculate_borders(), indexed by tile
+ * index, and the tiles changed since then. */
+static struct border_source *border_sources = NULL;
+static struct dbv border_dirty;
+static bool border_all_dirty = TRUE;
+static enum borders_mode border_mode;
+
 static void player_tile_init(struct tile *ptile, struct player *pplayer);
+static void really_send_tile_info(struct conn_list *dest, struct tile *ptile,
+                                  bool send_unknown);
+static void send_tile_info_flush(void);
 static void give_tile_info_from_player_to_player(struct player *pfrom,
 						 struct player *pdest,
 						 struct tile *ptile);
@@ -241,6 +277,11 @@ bool upgrade_city_extras(struct city *pcity, struct extra_type **gained)
     }
   } extra_type_iterate_end;
 
+  if (upgradet) {
+    pf_map_tile_changed(ptile);
+    pf_regions_tile_changed(ptile);
+  }
+
   return upgradet;
 }
 
@@ -438,7 +479,7 @@ void send_all_known_tiles(struct conn_list *dest)
       conn_list_do_buffer(dest);
     }
 
-    send_tile_info(dest, ptile, FALSE);
+    really_send_tile_info(dest, ptile, FALSE);
   } whole_map_iterate_end;
 
   conn_list_do_unbuffer(dest);
@@ -456,16 +497,182 @@ bool send_tile_suppression(bool now)
   return formerly;
 }
 
+/**************************************************************************
+  Freeze send_tile_info(): until the matching send_tile_info_thaw(), the
+  tiles are only marked as dirty for the players (and global observers)
+  they would be sent to. Each dirty tile is then sent once, in its last
+  state, instead of once per change. Calls may be nested.
+
+  This is used for each request of a client and for the turn change, so
+  the many updates of the same tiles done by vision and border changes
+  are not all sent (and delta-compared).
+**************************************************************************/
+void send_tile_info_freeze(void)
+{
+  send_tile_frozen_level++;
+}
+
+/**************************************************************************
+  Thaw send_tile_info(). At the last level, the dirty tiles are sent.
+**************************************************************************/
+void send_tile_info_thaw(void)
+{
+  fc_assert_ret(send_tile_frozen_level > 0);
+
+  send_tile_frozen_level--;
+  if (send_tile_frozen_level == 0) {
+    send_tile_info_flush();
+  }
+}
+
+/**************************************************************************
+  Mark the tile as dirty for the player, if it would be sent to it.
+**************************************************************************/
+static void send_tile_info_mark(struct player *pplayer, struct tile *ptile,
+                                bool send_unknown)
+{
+  if (NULL == pplayer->server.private_map
+      || 0 == conn_list_size(pplayer->connections)
+      || (!send_unknown && !map_is_known(ptile, pplayer))) {
+    /* Nothing would be sent. */
+    return;
+  }
+
+  dbv_set(&pplayer->server.tile_dirty, tile_index(ptile));
+  BV_SET(send_tile_dirty_players, player_index(pplayer));
+}
+
+/**************************************************************************
+  Mark the tile as dirty for the global observers.
+**************************************************************************/
+static void send_tile_info_mark_observers(struct tile *ptile)
+{
+  if (dbv_bits(&send_tile_dirty_observers) != MAP_INDEX_SIZE) {
+    dbv_resize(&send_tile_dirty_observers, MAP_INDEX_SIZE);
+  }
+
+  dbv_set(&send_tile_dirty_observers, tile_index(ptile));
+}
+
+/**************************************************************************
+  Send the tiles set in 'dirty' to dest, in the order of the tile indexes,
+  and clear them. Returns the number of tiles sent.
+**************************************************************************/
+static int send_dirty_tiles(struct dbv *dirty, struct conn_list *dest,
+                            bool send_unknown)
+{
+  int sent = 0;
+  int i, bit;
+
+  for (i = 0; i < _BV_BYTES(dirty->bits); i++) {
+    if (0 == dirty->vec[i]) {
+      /* Skip 8 clean tiles at once. */
+      continue;
+    }
+    for (bit = 0; bit < 8; bit++) {
+      if (dirty->vec[i] & (1u << bit)) {
+        really_send_tile_info(dest, index_to_tile(i * 8 + bit),
+                              send_unknown);
+        sent++;
+      }
+    }
+    dirty->vec[i] = 0;
+  }
+
+  return sent;
+}
+
+/**************************************************************************
+  Send the dirty tiles to the players and observers. A tile which is no
+  longer known by a player is sent as unknown, as the player knew it when
+  it was marked.
+**************************************************************************/
+static void send_tile_info_flush(void)
+{
+  int sent = 0;
+
+  if (BV_ISSET_ANY(send_tile_dirty_players)) {
+    players_iterate(pplayer) {
+      if (BV_ISSET(send_tile_dirty_players, player_index(pplayer))
+          && NULL != pplayer->server.tile_dirty.vec) {
+        sent += send_dirty_tiles(&pplayer->server.tile_dirty,
+                                 pplayer->connections, TRUE);
+      }
+    } players_iterate_end;
+    BV_CLR_ALL(send_tile_dirty_players);
+  }
+
+  if (NULL != send_tile_dirty_observers.vec
+      && dbv_bits(&send_tile_dirty_observers) == MAP_INDEX_SIZE) {
+    /* (Else, the map was changed by loading a game.) */
+    struct conn_list *observers = conn_list_new();
+
+    conn_list_iterate(game.est_connections, pconn) {
+      if (NULL == pconn->playing && pconn->observer) {
+        conn_list_append(observers, pconn);
+      }
+    } conn_list_iterate_end;
+    sent += send_dirty_tiles(&send_tile_dirty_observers, observers, FALSE);
+    conn_list_destroy(observers);
+  }
+  dbv_free(&send_tile_dirty_observers);
+
+  if (sent > 0) {
+    log_debug("send_tile_info_flush(): %d tiles sent", sent);
+  }
+}
+
 /**************************************************************************
   Send tile information to all the clients in dest which know and see
   the tile. If dest is NULL, sends to all clients (game.est_connections)
   which know and see tile.
 
+  While send_tile_info() is frozen, the tile is only marked as dirty for
+  the players of the connections of dest, and sent to all connections of
+  these players at the thaw (see send_tile_info_freeze()).
+
   Note that this function does not update the playermap.  For that call
   update_tile_knowledge().
 **************************************************************************/
 void send_tile_info(struct conn_list *dest, struct tile *ptile,
                     bool send_unknown)
+{
+  if (send_tile_suppressed) {
+    return;
+  }
+
+  if (0 == send_tile_frozen_level) {
+    really_send_tile_info(dest, ptile, send_unknown);
+    return;
+  }
+
+  if (!dest) {
+    players_iterate(pplayer) {
+      send_tile_info_mark(pplayer, ptile, send_unknown);
+    } players_iterate_end;
+    conn_list_iterate(game.est_connections, pconn) {
+      if (NULL == pconn->playing && pconn->observer) {
+        send_tile_info_mark_observers(ptile);
+        break;
+      }
+    } conn_list_iterate_end;
+    return;
+  }
+
+  conn_list_iterate(dest, pconn) {
+    if (NULL != pconn->playing) {
+      send_tile_info_mark(pconn->playing, ptile, send_unknown);
+    } else if (pconn->observer) {
+      send_tile_info_mark_observers(ptile);
+    }
+  } conn_list_iterate_end;
+}
+
+/**************************************************************************
+  Send tile information at once (see send_tile_info()).
+**************************************************************************/
+static void really_send_tile_info(struct conn_list *dest, struct tile *ptile,
+                                  bool send_unknown)
 {
   struct packet_tile_info info;
   const struct player *owner;
@@ -1028,6 +1235,8 @@ void change_playertile_site(struct player_tile *ptile,
 void map_set_known(struct tile *ptile, struct player *pplayer)
 {
   dbv_set(&pplayer->tile_known, tile_index(ptile));
+  map_border_tile_changed(ptile);
+  adv_pf_cache_clear();
 }
 
 /***************************************************************
@@ -1036,6 +1245,7 @@ void map_set_known(struct tile *ptile, struct player *pplayer)
 void map_clear_known(struct tile *ptile, struct player *pplayer)
 {
   dbv_clr(&pplayer->tile_known, tile_index(ptile));
+  map_border_tile_changed(ptile);
 }
 
 /****************************************************************************
@@ -1079,6 +1289,7 @@ void player_map_init(struct player *pplayer)
   } whole_map_iterate_end;
 
   dbv_init(&pplayer->tile_known, MAP_INDEX_SIZE);
+  dbv_init(&pplayer->server.tile_dirty, MAP_INDEX_SIZE);
 }
 
 /**************************************************************************
@@ -1094,6 +1305,8 @@ void player_map_free(struct player *pplayer)
   pplayer->server.private_map = NULL;
 
   dbv_free(&pplayer->tile_known);
+  dbv_free(&pplayer->server.tile_dirty);
+  BV_CLR(send_tile_dirty_players, player_index(pplayer));
 }
 
 /**************************************************************************
@@ -1150,10 +1363,16 @@ void remove_player_from_maps(struct player *pplayer)
     /* Free all claimed tiles. */
     if (tile_owner(ptile) == pplayer) {
       tile_set_owner(ptile, NULL, NULL);
+      pf_map_tile_changed(ptile);
       /* Update anyone who can see the tile (e.g. global observers) */
       send_tile_info(NULL, ptile, FALSE);
     }
   } whole_map_iterate_end;
+  if (send_tile_frozen_level > 0) {
+    /* The references to the player must reach the clients before the
+     * player is destroyed. */
+    send_tile_info_flush();
+  }
   conn_list_do_unbuffer(game.est_connections);
 }
 
@@ -1260,6 +1479,11 @@ bool update_player_tile_knowledge(struct player *pplayer, struct tile *ptile)
 ****************************************************************************/
 void update_tile_knowledge(struct tile *ptile)
 {
+  /* The tile changed, the paths through it may be different now. */
+  adv_pf_cache_clear();
+  pf_map_tile_changed(ptile);
+  pf_regions_tile_changed(ptile);
+
   /* Players */
   players_iterate(pplayer) {
     if (map_is_known_and_seen(ptile, pplayer, V_MAIN)) {
@@ -1691,6 +1915,8 @@ void terrain_changed(struct tile *ptile)
     upgrade_city_extras(pcity, NULL);
   }
 
+  pf_map_tile_changed(ptile);
+  pf_regions_tile_changed(ptile);
   bounce_units_on_terrain_change(ptile);
 }
 
@@ -1766,6 +1992,7 @@ void check_terrain_change(struct tile *ptile, struct terrain *oldter)
 
   if (need_to_reassign_continents(oldter, newter)) {
     assign_continent_numbers();
+    map_borders_dirty_all();
     send_all_known_tiles(NULL);
   }
 
@@ -1838,7 +2065,7 @@ static void map_unit_homecity_enqueue(struct tile *ptile)
       continue;
     }
 
-    city_refresh_queue_add(phome);
+    city_refresh_queue_add_dirty(phome, CD_UNITS);
   } unit_list_iterate_end;
 }
 
@@ -1851,6 +2078,10 @@ static void map_claim_border_ownership(struct tile *ptile,
 {
   struct player *ploser = tile_owner(ptile);
 
+  if (ploser != powner || tile_claimer(ptile) != psource) {
+    map_border_tile_changed(ptile);
+  }
+
   if (BORDERS_SEE_INSIDE == game.info.borders
       || BORDERS_EXPAND == game.info.borders) {
     if (ploser != powner) {
@@ -1955,6 +2186,11 @@ void map_claim_border(struct tile *ptile, struct player *owner)
       continue;
     }
 
+    if (dr != 0 && dclaimer == ptile && tile_owner(dtile) == owner) {
+      /* Already ours. */
+      continue;
+    }
+
     /* Always claim source itself (distance, dr, to it 0) */
     if (dr != 0 && NULL != dclaimer && dclaimer != ptile) {
       struct city *ccity = tile_city(dclaimer);
@@ -1995,11 +2231,102 @@ void map_claim_border(struct tile *ptile, struct player *owner)
   } circle_dxyr_iterate_end;
 }
 
+/*************************************************************************
+  Fill what map_claim_border() depends on for the tile as border source.
+*************************************************************************/
+static void border_source_get(struct border_source *psource,
+                              struct tile *ptile)
+{
+  struct city *pcity;
+
+  /* Cleared as a whole, as the sources are compared with memcmp(). */
+  memset(psource, 0, sizeof(*psource));
+  if (!is_border_source(ptile)) {
+    return;
+  }
+
+  psource->is_source = TRUE;
+  psource->radius_sq = tile_border_source_radius_sq(ptile);
+  psource->strength = tile_border_source_strength(ptile);
+  if (NULL != (pcity = tile_city(ptile))) {
+    psource->city_radius_sq = city_map_radius_sq_get(pcity);
+  }
+  psource->owner = tile_owner(ptile);
+  psource->continent = tile_continent(ptile);
+  psource->claim_ocean = (NULL != psource->owner
+                          && 0 < num_known_tech_with_flag(psource->owner,
+                                                          TF_CLAIM_OCEAN));
+}
+
+/*************************************************************************
+  Mark the tiles in the radius of a border source as changed.
+*************************************************************************/
+static void border_circle_set_dirty(struct tile *ptile, int radius_sq)
+{
+  circle_iterate(ptile, radius_sq, dtile) {
+    dbv_set(&border_dirty, tile_index(dtile));
+  } circle_iterate_end;
+}
+
+/*************************************************************************
+  Returns whether a tile in the radius of a border source has changed.
+*************************************************************************/
+static bool border_circle_is_dirty(struct tile *ptile, int radius_sq)
+{
+  circle_iterate(ptile, radius_sq, dtile) {
+    if (dbv_isset(&border_dirty, tile_index(dtile))) {
+      return TRUE;
+    }
+  } circle_iterate_end;
+
+  return FALSE;
+}
+
+/*************************************************************************
+  Note that a tile changed in a way which may change the borders
+  claimed by the sources around it: owner, claimer or known state.
+*************************************************************************/
+void map_border_tile_changed(const struct tile *ptile)
+{
+  if (NULL != border_sources) {
+    dbv_set(&border_dirty, tile_index(ptile));
+  }
+}
+
+/*************************************************************************
+  Make the next map_calculate_borders() claim the borders of all the
+  sources, e.g. after the continents have been renumbered.
+*************************************************************************/
+void map_borders_dirty_all(void)
+{
+  border_all_dirty = TRUE;
+}
+
+/*************************************************************************
+  Free the border sources of map_calculate_borders().
+*************************************************************************/
+void map_borders_free(void)
+{
+  if (NULL != border_sources) {
+    free(border_sources);
+    border_sources = NULL;
+    dbv_free(&border_dirty);
+  }
+  border_all_dirty = TRUE;
+}
+
 /*************************************************************************
   Update borders for all sources. Call this on turn end.
+
+  Only the sources which changed since the last call, or which have a
+  changed tile in their radius, claim their border again: the others
+  would not claim anything, since a claim only ever gives a tile to a
+  stronger source.
 *************************************************************************/
 void map_calculate_borders(void)
 {
+  int claimed = 0;
+
   if (BORDERS_DISABLED == game.info.borders) {
     return;
   }
@@ -2011,11 +2338,51 @@ void map_calculate_borders(void)
 
   log_verbose("map_calculate_borders()");
 
+  if (NULL == border_sources || dbv_bits(&border_dirty) != MAP_INDEX_SIZE) {
+    map_borders_free();
+    border_sources = fc_calloc(MAP_INDEX_SIZE, sizeof(*border_sources));
+    dbv_init(&border_dirty, MAP_INDEX_SIZE);
+  }
+  if (border_mode != game.info.borders) {
+    border_mode = game.info.borders;
+    border_all_dirty = TRUE;
+  }
+
+  /* A changed source changes the claims of its whole radius. */
+  whole_map_iterate(ptile) {
+    struct border_source *psource = border_sources + tile_index(ptile);
+    struct border_source source;
+
+    border_source_get(&source, ptile);
+    if (0 != memcmp(&source, psource, sizeof(source))) {
+      if (psource->is_source) {
+        border_circle_set_dirty(ptile, psource->radius_sq);
+      }
+      if (source.is_source) {
+        border_circle_set_dirty(ptile, source.radius_sq);
+      }
+      *psource = source;
+    }
+  } whole_map_iterate_end;
+
+  /* The same tiles are claimed from many sources. */
+  send_tile_info_freeze();
   whole_map_iterate(ptile) {
-    if (is_border_source(ptile)) {
+    const struct border_source *psource = border_sources + tile_index(ptile);
+
+    if (psource->is_source
+        && (border_all_dirty
+            || border_circle_is_dirty(ptile, psource->radius_sq))) {
       map_claim_border(ptile, ptile->owner);
+      claimed++;
     }
   } whole_map_iterate_end;
+  send_tile_info_thaw();
+
+  /* The claims made above do not make other sources claim more. */
+  dbv_clr_all(&border_dirty);
+  border_all_dirty = FALSE;
+  log_debug("map_calculate_borders(): %d sources claimed", claimed);
 
   log_verbose("map_calculate_borders() workers");
   city_thaw_workers_queue();
@@ -2076,6 +2443,287 @@ void map_claim_base(struct tile *ptile, struct base_type *pbase,
   }
 }
 
+/* Vision radii up to this many tiles have their footprint stored as bit
+ * masks, one word per row. */
+#define VISION_MASK_MAX_RADIUS 15
+#define VISION_MASK_MAX_RADIUS_SQ \
+  ((VISION_MASK_MAX_RADIUS + 1) * (VISION_MASK_MAX_RADIUS + 1) - 1)
+#define VISION_MASK_WIDTH (2 * VISION_MASK_MAX_RADIUS + 1)
+
+/* The tiles of a vision radius, relative to its center: the bit
+ * 'dx + radius' of the row 'dy + radius' is set when (dx, dy) is in the
+ * circle. */
+struct vision_mask {
+  bool built;
+  int topology_id;
+  int radius;
+  unsigned int rows[VISION_MASK_WIDTH];
+};
+
+static struct vision_mask vision_masks[VISION_MASK_MAX_RADIUS_SQ + 1];
+
+/* The footprints of the old and the new source of a moving vision, in a
+ * square of 'radius' tiles around the map position (x, y) of the new
+ * source. */
+struct vision_frame {
+  int x, y;
+  int radius;
+  unsigned int old_rows[V_COUNT][VISION_MASK_WIDTH];
+  unsigned int new_rows[V_COUNT][VISION_MASK_WIDTH];
+};
+
+/* The tiles of a vision frame to change. */
+enum vision_frame_part {
+  VFP_ENTERING,         /* In the new footprint only, gets +1. */
+  VFP_LEAVING,          /* In the old footprint only, gets -1. */
+  VFP_COMMON            /* In both footprints, gets +1. */
+};
+
+/****************************************************************************
+  Returns the footprint mask of the vision radius, building it the first
+  time.
+****************************************************************************/
+static const struct vision_mask *vision_mask_get(int radius_sq)
+{
+  struct vision_mask *mask;
+  int dx, dy;
+
+  fc_assert_ret_val(0 <= radius_sq && radius_sq <= VISION_MASK_MAX_RADIUS_SQ,
+                    NULL);
+
+  mask = vision_masks + radius_sq;
+  if (mask->built && mask->topology_id == map.topology_id) {
+    return mask;
+  }
+
+  /* Same circle as circle_dxyr_iterate(). */
+  mask->radius = (int) sqrt((double) radius_sq);
+  for (dy = -mask->radius; dy <= mask->radius; dy++) {
+    unsigned int row = 0;
+
+    for (dx = -mask->radius; dx <= mask->radius; dx++) {
+      if (map_vector_to_sq_distance(dx, dy) <= radius_sq) {
+        row |= 1u << (dx + mask->radius);
+      }
+    }
+    mask->rows[dy + mask->radius] = row;
+  }
+  mask->topology_id = map.topology_id;
+  mask->built = TRUE;
+
+  return mask;
+}
+
+/****************************************************************************
+  Fill the vision frame of a source moving from 'old_tile' to 'new_tile'.
+  Returns FALSE if the footprints are too large for the masks, or for the
+  map: a wrapping map could then have the same tile twice in the frame.
+****************************************************************************/
+static bool vision_frame_build(struct vision_frame *frame,
+                               const struct tile *old_tile,
+                               const v_radius_t old_radius_sq,
+                               const struct tile *new_tile,
+                               const v_radius_t new_radius_sq)
+{
+  const struct vision_mask *old_masks[V_COUNT], *new_masks[V_COUNT];
+  int dx, dy, i, old_radius = -1, new_radius = -1;
+
+  vision_layer_iterate(v) {
+    if (old_radius_sq[v] > VISION_MASK_MAX_RADIUS_SQ
+        || new_radius_sq[v] > VISION_MASK_MAX_RADIUS_SQ) {
+      return FALSE;
+    }
+    old_masks[v] = (0 <= old_radius_sq[v]
+                    ? vision_mask_get(old_radius_sq[v]) : NULL);
+    new_masks[v] = (0 <= new_radius_sq[v]
+                    ? vision_mask_get(new_radius_sq[v]) : NULL);
+    if (NULL != old_masks[v]) {
+      old_radius = MAX(old_radius, old_masks[v]->radius);
+    }
+    if (NULL != new_masks[v]) {
+      new_radius = MAX(new_radius, new_masks[v]->radius);
+    }
+  } vision_layer_iterate_end;
+
+  /* The old footprint is seen from the new center, shifted by the move. */
+  map_distance_vector(&dx, &dy, old_tile, new_tile);
+  frame->radius = MAX(new_radius,
+                      old_radius + MAX(MAX(dx, -dx), MAX(dy, -dy)));
+  if (2 * frame->radius + 1 > VISION_MASK_WIDTH
+      || 2 * (2 * frame->radius + 1) > MIN(map.xsize, map.ysize)) {
+    return FALSE;
+  }
+
+  index_to_map_pos(&frame->x, &frame->y, tile_index(new_tile));
+  memset(frame->old_rows, 0, sizeof(frame->old_rows));
+  memset(frame->new_rows, 0, sizeof(frame->new_rows));
+  vision_layer_iterate(v) {
+    const struct vision_mask *mask;
+
+    if (NULL != (mask = new_masks[v])) {
+      for (i = -mask->radius; i <= mask->radius; i++) {
+        frame->new_rows[v][i + frame->radius] =
+            mask->rows[i + mask->radius] << (frame->radius - mask->radius);
+      }
+    }
+    if (NULL != (mask = old_masks[v])) {
+      for (i = -mask->radius; i <= mask->radius; i++) {
+        frame->old_rows[v][i - dy + frame->radius] =
+            mask->rows[i + mask->radius]
+            << (frame->radius - mask->radius - dx);
+      }
+    }
+  } vision_layer_iterate_end;
+
+  return TRUE;
+}
+
+/****************************************************************************
+  Change the seen count of the tiles of one part of a vision frame. The
+  entering part also gives the tiles in common a chance to be revealed,
+  like adding the new source would do.
+****************************************************************************/
+static void vision_frame_change_seen(const struct vision_frame *frame,
+                                     struct player *pplayer,
+                                     enum vision_frame_part part,
+                                     bool can_reveal_tiles)
+{
+  const int sign = (VFP_LEAVING == part ? -1 : 1);
+  int i, x;
+
+  for (i = 0; i <= 2 * frame->radius; i++) {
+    unsigned int rows[V_COUNT], tiles = 0;
+
+    vision_layer_iterate(v) {
+      const unsigned int old_row = frame->old_rows[v][i];
+      const unsigned int new_row = frame->new_rows[v][i];
+
+      switch (part) {
+      case VFP_ENTERING:
+        rows[v] = new_row & ~old_row;
+        if (can_reveal_tiles) {
+          tiles |= new_row;
+        }
+        break;
+      case VFP_LEAVING:
+        rows[v] = old_row & ~new_row;
+        break;
+      case VFP_COMMON:
+        rows[v] = old_row & new_row;
+        break;
+      }
+      tiles |= rows[v];
+    } vision_layer_iterate_end;
+
+    for (x = 0; 0 != tiles; x++, tiles >>= 1) {
+      struct tile *ptile;
+      v_radius_t change;
+      bool changed = FALSE;
+
+      if (!(tiles & 1)
+          || NULL == (ptile = map_pos_to_tile(frame->x + x - frame->radius,
+                                              frame->y + i - frame->radius))) {
+        continue;
+      }
+
+      vision_layer_iterate(v) {
+        change[v] = ((rows[v] >> x) & 1 ? sign : 0);
+        changed |= (0 != change[v]);
+      } vision_layer_iterate_end;
+
+      if (changed || !map_is_known(ptile, pplayer)) {
+        shared_vision_change_seen(pplayer, ptile, change, can_reveal_tiles);
+      }
+    }
+  }
+}
+
+/****************************************************************************
+  Give the sight points of a vision source to 'vision', a new source
+  replacing 'old_vision', e.g. for a moving unit. Only the tiles entering
+  the sight are unfogged now, and only the tiles leaving it will be fogged
+  when 'old_vision' is cleared; the tiles in common are not touched.
+
+  Falls back to vision_change_sight() when the sources cannot be diffed.
+****************************************************************************/
+void vision_move_sight(struct vision *vision, const v_radius_t radius_sq,
+                       struct vision *old_vision)
+{
+  struct vision_frame frame;
+
+  if (NULL == old_vision
+      || vision->player != old_vision->player
+      || vision->can_reveal_tiles != old_vision->can_reveal_tiles
+      || NULL != vision->moved_from || NULL != vision->moved_to
+      || NULL != old_vision->moved_from || NULL != old_vision->moved_to
+      || -1 != vision->radius_sq[V_MAIN]
+      || -1 != vision->radius_sq[V_INVIS]
+      || -1 == old_vision->radius_sq[V_MAIN]
+      || !vision_frame_build(&frame, old_vision->tile, old_vision->radius_sq,
+                             vision->tile, radius_sq)) {
+    vision_change_sight(vision, radius_sq);
+    return;
+  }
+
+  buffer_shared_vision(vision->player);
+  vision_frame_change_seen(&frame, vision->player, VFP_ENTERING,
+                           vision->can_reveal_tiles);
+  unbuffer_shared_vision(vision->player);
+
+  memcpy(vision->radius_sq, radius_sq, sizeof(v_radius_t));
+  vision->moved_from = old_vision;
+  old_vision->moved_to = vision;
+}
+
+/****************************************************************************
+  Clear the sight of the old source of a move: only the tiles leaving the
+  sight lose their sight points, the others now belong to the new source.
+****************************************************************************/
+static void vision_move_sight_finish(struct vision *old_vision)
+{
+  struct vision *vision = old_vision->moved_to;
+  struct vision_frame frame;
+
+  if (vision_frame_build(&frame, old_vision->tile, old_vision->radius_sq,
+                         vision->tile, vision->radius_sq)) {
+    buffer_shared_vision(vision->player);
+    vision_frame_change_seen(&frame, vision->player, VFP_LEAVING,
+                             vision->can_reveal_tiles);
+    unbuffer_shared_vision(vision->player);
+  } else {
+    fc_assert(FALSE);
+  }
+
+  vision->moved_from = NULL;
+  old_vision->moved_to = NULL;
+  old_vision->radius_sq[V_MAIN] = -1;
+  old_vision->radius_sq[V_INVIS] = -1;
+}
+
+/****************************************************************************
+  Stop handing over the sight of the old source of a move to 'vision':
+  both sources get back all the sight points of their radius, before one
+  of them is changed alone.
+****************************************************************************/
+static void vision_move_sight_cancel(struct vision *vision)
+{
+  struct vision *old_vision = vision->moved_from;
+  struct vision_frame frame;
+
+  if (vision_frame_build(&frame, old_vision->tile, old_vision->radius_sq,
+                         vision->tile, vision->radius_sq)) {
+    buffer_shared_vision(vision->player);
+    vision_frame_change_seen(&frame, vision->player, VFP_COMMON,
+                             vision->can_reveal_tiles);
+    unbuffer_shared_vision(vision->player);
+  } else {
+    fc_assert(FALSE);
+  }
+
+  vision->moved_from = NULL;
+  old_vision->moved_to = NULL;
+}
+
 /****************************************************************************
   Change the sight points for the vision source, fogging or unfogging tiles
   as needed.
@@ -2084,6 +2732,19 @@ void map_claim_base(struct tile *ptile, struct base_type *pbase,
 ****************************************************************************/
 void vision_change_sight(struct vision *vision, const v_radius_t radius_sq)
 {
+  if (0 != memcmp(vision->radius_sq, radius_sq, sizeof(v_radius_t))) {
+    if (NULL != vision->moved_to) {
+      if (-1 == radius_sq[V_MAIN] && -1 == radius_sq[V_INVIS]) {
+        vision_move_sight_finish(vision);
+        return;
+      }
+      vision_move_sight_cancel(vision->moved_to);
+    }
+    if (NULL != vision->moved_from) {
+      vision_move_sight_cancel(vision);
+    }
+  }
+
   map_vision_update(vision->player, vision->tile, vision->radius_sq,
                     radius_sq, vision->can_reveal_tiles);
   memcpy(vision->radius_sq, radius_sq, sizeof(v_radius_t));
@@ -56,6 +56,8 @@ void give_citymap_from_player_to_player(struct city *pcity,
 void send_all_known_tiles(struct conn_list *dest);
 
 bool send_tile_suppression(bool now);
+void send_tile_info_freeze(void);
+void send_tile_info_thaw(void);
 void send_tile_info(struct conn_list *dest, struct tile *ptile,
                     bool send_unknown);
 
@@ -104,6 +106,9 @@ void enable_fog_of_war_player(struct player *pplayer);
 void disable_fog_of_war_player(struct player *pplayer);
 
 void map_calculate_borders(void);
+void map_border_tile_changed(const struct tile *ptile);
+void map_borders_dirty_all(void);
+void map_borders_free(void);
 void map_claim_border(struct tile *ptile, struct player *powner);
 void map_claim_ownership(struct tile *ptile, struct player *powner,
                          struct tile *psource, bool claim_bases);
@@ -124,6 +129,8 @@ void bounce_units_on_terrain_change(struct tile *ptile);
 
 void vision_change_sight(struct vision *vision,
                          const v_radius_t radius_sq);
+void vision_move_sight(struct vision *vision, const v_radius_t radius_sq,
+                       struct vision *old_vision);
 void vision_clear_sight(struct vision *vision);
 
 void change_playertile_site(struct player_tile *ptile,
@@ -40,6 +40,9 @@
 #include "tech.h"
 #include "unitlist.h"
 
+/* common/aicore */
+#include "path_finding.h"
+
 /* common/scriptcore */
 #include "luascript_types.h"
 
@@ -66,6 +69,7 @@
 
 /* server/advisors */
 #include "advdata.h"
+#include "advgoto.h"
 #include "autosettlers.h"
 
 /* server/scripting */
@@ -304,7 +308,7 @@ void handle_player_rates(struct player *pplayer,
     pplayer->economic.luxury = luxury;
     pplayer->economic.science = science;
 
-    city_refresh_for_player(pplayer);
+    city_refresh_partial_for_player(pplayer, CD_RATES);
     send_player_info_c(pplayer, pplayer->connections);
   }
 }
@@ -706,6 +710,8 @@ void handle_diplomacy_cancel_pact(struct player *pplayer,
   /* do the change */
   ds_plrplr2->type = ds_plr2plr->type = new_type;
   ds_plrplr2->turns_left = ds_plr2plr->turns_left = 16;
+  adv_pf_cache_clear();
+  pf_map_game_changed();
 
   if (new_type == DS_WAR) {
     pplayer->last_war_action = game.info.turn;
@@ -1932,6 +1938,8 @@ void make_contact(struct player *pplayer1, struct player *pplayer2,
 
     ds_plr1plr2->type = new_state;
     ds_plr2plr1->type = new_state;
+    adv_pf_cache_clear();
+    pf_map_game_changed();
     ds_plr1plr2->first_contact_turn = game.info.turn;
     ds_plr2plr1->first_contact_turn = game.info.turn;
     notify_player(pplayer1, ptile, E_FIRST_CONTACT, ftc_server,
@@ -6430,6 +6430,7 @@ static bool load_rulesetdir(const char *rsdir, bool act, bool save_script)
       /* Populate remaining caches. */
       techs_precalc_data();
       improvement_feature_cache_init();
+      effect_cache_deps_init();
       unit_class_iterate(pclass) {
         set_unit_class_caches(pclass);
       } unit_class_iterate_end;
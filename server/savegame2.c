@@ -82,6 +82,7 @@
 #include "rand.h"
 #include "registry.h"
 #include "shared.h"
+#include "string_vector.h"
 #include "support.h"            /* bool type */
 #include "timing.h"
 
@@ -472,6 +473,10 @@ void savegame2_load(struct section_file *file)
   if (!has_capabilities("+version2", savefile_options)) {
     /* load old format (freeciv 2.2.x) */
     log_verbose("loading savefile in old format ...");
+    if (!secfile_stream_finish(file)) {
+      log_error("Failure loading savegame!");
+      return;
+    }
     secfile_allow_digital_boolean(file, TRUE);
     legacy_game_load(file);
   } else {
@@ -550,13 +555,25 @@ static void savegame2_load_real(struct section_file *file)
   sg_load_players_basic(loading);
   /* [map]; needs width and height loaded by [settings]  */
   sg_load_map(loading);
+  /* Give the memory of the big sections back as soon as they are loaded,
+   * for the game data built from the next ones. */
+  secfile_section_release(file, "map");
   /* [player<i>] */
   sg_load_players(loading);
+  players_iterate(pplayer) {
+    secfile_section_release(file, "player%d", player_number(pplayer));
+  } players_iterate_end;
   /* [event_cache] */
   sg_load_event_cache(loading);
   /* [mapimg] */
   sg_load_mapimg(loading);
 
+  /* A streamed savegame is only read to its end now. */
+  if (sg_success && !secfile_stream_finish(file)) {
+    log_sg("The savegame is corrupted.");
+    sg_success = FALSE;
+  }
+
   /* Sanity checks for the loaded game. */
   sg_load_sanitycheck(loading);
 
@@ -724,6 +741,443 @@ static void savedata_destroy(struct savedata *saving)
   free(saving);
 }
 
+/* =======================================================================
+ * Delta savegames.
+ *
+ * A delta savegame only holds the entries which differ from the previous
+ * savegame, in the same sections, plus a SAVEGAME2_DELTA_SECTION section
+ * naming the previous savegame and listing what was removed. Loading it
+ * loads the previous savegames back to a full one, and replays the
+ * deltas on it.
+ * ======================================================================= */
+
+#define SAVEGAME2_DELTA_SECTION "savedelta"
+
+#define SPECHASH_TAG delta_entry
+#define SPECHASH_CSTR_KEY_TYPE
+#define SPECHASH_INT_DATA_TYPE
+#include "spechash.h"
+
+/****************************************************************************
+  Returns TRUE iff the entries have the same type and value.
+****************************************************************************/
+static bool delta_entries_equal(const struct entry *pentry1,
+                                const struct entry *pentry2)
+{
+  if (entry_type(pentry1) != entry_type(pentry2)) {
+    return FALSE;
+  }
+
+  switch (entry_type(pentry1)) {
+  case ENTRY_BOOL:
+    {
+      bool value1, value2;
+
+      return (entry_bool_get(pentry1, &value1)
+              && entry_bool_get(pentry2, &value2)
+              && value1 == value2);
+    }
+  case ENTRY_INT:
+    {
+      int value1, value2;
+
+      return (entry_int_get(pentry1, &value1)
+              && entry_int_get(pentry2, &value2)
+              && value1 == value2);
+    }
+  case ENTRY_STR:
+    {
+      const char *value1, *value2;
+
+      return (entry_str_get(pentry1, &value1)
+              && entry_str_get(pentry2, &value2)
+              && 0 == strcmp(value1, value2)
+              && entry_str_escaped(pentry1) == entry_str_escaped(pentry2));
+    }
+  }
+
+  return FALSE;
+}
+
+/****************************************************************************
+  Copy the entry, with its comment, at the end of the section.
+****************************************************************************/
+static struct entry *delta_entry_copy(struct section *psection,
+                                      const struct entry *pentry)
+{
+  struct entry *pcopy = NULL;
+
+  switch (entry_type(pentry)) {
+  case ENTRY_BOOL:
+    {
+      bool value;
+
+      if (entry_bool_get(pentry, &value)) {
+        pcopy = section_entry_bool_new(psection, entry_name(pentry), value);
+      }
+    }
+    break;
+  case ENTRY_INT:
+    {
+      int value;
+
+      if (entry_int_get(pentry, &value)) {
+        pcopy = section_entry_int_new(psection, entry_name(pentry), value);
+      }
+    }
+    break;
+  case ENTRY_STR:
+    {
+      const char *value;
+
+      if (entry_str_get(pentry, &value)) {
+        pcopy = section_entry_str_new(psection, entry_name(pentry), value,
+                                      entry_str_escaped(pentry));
+      }
+    }
+    break;
+  }
+
+  if (NULL != pcopy && NULL != entry_comment(pentry)) {
+    entry_set_comment(pcopy, entry_comment(pentry));
+  }
+
+  return pcopy;
+}
+
+/****************************************************************************
+  Set the value and the comment of 'pentry' to the ones of 'pvalue', an
+  entry of the same type.
+****************************************************************************/
+static void delta_entry_set(struct entry *pentry, const struct entry *pvalue)
+{
+  switch (entry_type(pvalue)) {
+  case ENTRY_BOOL:
+    {
+      bool value;
+
+      if (entry_bool_get(pvalue, &value)) {
+        entry_bool_set(pentry, value);
+      }
+    }
+    break;
+  case ENTRY_INT:
+    {
+      int value;
+
+      if (entry_int_get(pvalue, &value)) {
+        entry_int_set(pentry, value);
+      }
+    }
+    break;
+  case ENTRY_STR:
+    {
+      const char *value;
+
+      if (entry_str_get(pvalue, &value)) {
+        entry_str_set(pentry, value);
+        entry_str_set_escaped(pentry, entry_str_escaped(pvalue));
+      }
+    }
+    break;
+  }
+
+  entry_set_comment(pentry, entry_comment(pvalue));
+}
+
+/****************************************************************************
+  Add to 'delta' the entries of 'psection' which are not in 'pold' or
+  differ, and to 'removed' the paths of the entries of 'pold' which are not
+  in 'psection'. 'pold' may be NULL. The entries of both sections are
+  usually in the same order, so they are matched by walking the two lists;
+  a hash table of the old entries is only built at the first mismatch.
+****************************************************************************/
+static void delta_section_save(struct section_file *delta,
+                               const struct section *pold,
+                               const struct section *psection,
+                               struct strvec *removed)
+{
+  const char *name = section_name(psection);
+  const struct entry **olds = NULL;
+  bool *matched = NULL;
+  struct delta_entry_hash *by_name = NULL;
+  struct section *pdelta = NULL;
+  int num_olds = 0, next = 0, i;
+
+  if (NULL != pold) {
+    num_olds = entry_list_size(section_entries(pold));
+    olds = fc_malloc(MAX(num_olds, 1) * sizeof(*olds));
+    matched = fc_calloc(MAX(num_olds, 1), sizeof(*matched));
+    i = 0;
+    entry_list_iterate(section_entries(pold), pentry) {
+      olds[i++] = pentry;
+    } entry_list_iterate_end;
+  }
+
+  entry_list_iterate(section_entries(psection), pentry) {
+    int found = -1;
+
+    if (next < num_olds
+        && 0 == strcmp(entry_name(olds[next]), entry_name(pentry))) {
+      found = next++;
+    } else if (0 < num_olds) {
+      if (NULL == by_name) {
+        by_name = delta_entry_hash_new_nentries(num_olds);
+        for (i = 0; i < num_olds; i++) {
+          delta_entry_hash_insert(by_name, entry_name(olds[i]), i);
+        }
+      }
+      if (delta_entry_hash_lookup(by_name, entry_name(pentry), &found)) {
+        next = found + 1;
+      } else {
+        found = -1;
+      }
+    }
+
+    if (0 <= found) {
+      matched[found] = TRUE;
+      if (delta_entries_equal(olds[found], pentry)) {
+        continue;
+      }
+    }
+
+    if (NULL == pdelta) {
+      pdelta = secfile_section_new(delta, name);
+    }
+    delta_entry_copy(pdelta, pentry);
+  } entry_list_iterate_end;
+
+  for (i = 0; i < num_olds; i++) {
+    if (!matched[i]) {
+      char path[MAX_LEN_PATH];
+
+      entry_path(olds[i], path, sizeof(path));
+      strvec_append(removed, path);
+    }
+  }
+
+  if (NULL != by_name) {
+    delta_entry_hash_destroy(by_name);
+  }
+  free(olds);
+  free(matched);
+}
+
+/****************************************************************************
+  Returns the number of entries of the section file.
+****************************************************************************/
+static int delta_count_entries(const struct section_file *file)
+{
+  int count = 0;
+
+  section_list_iterate(secfile_sections(file), psection) {
+    count += entry_list_size(section_entries(psection));
+  } section_list_iterate_end;
+
+  return count;
+}
+
+/****************************************************************************
+  Build in 'delta' a delta savegame of 'file', made by savegame2_save(),
+  against 'prev', the content of the previous savegame 'prev_name'.
+  Called only in ./server/srv_main.c:save_game().
+****************************************************************************/
+void savegame2_save_delta(struct section_file *delta,
+                          const struct section_file *prev,
+                          const struct section_file *file,
+                          const char *prev_name)
+{
+  struct strvec *removed = strvec_new();
+  struct strvec *removed_sections = strvec_new();
+
+  fc_assert_ret(NULL != delta && NULL != prev && NULL != file);
+
+  secfile_insert_str(delta, prev_name, SAVEGAME2_DELTA_SECTION ".previous");
+  secfile_insert_int(delta, delta_count_entries(prev),
+                     SAVEGAME2_DELTA_SECTION ".previous_entries");
+
+  section_list_iterate(secfile_sections(file), psection) {
+    delta_section_save(delta,
+                       secfile_section_by_name(prev, section_name(psection)),
+                       psection, removed);
+  } section_list_iterate_end;
+
+  section_list_iterate(secfile_sections(prev), psection) {
+    if (NULL == secfile_section_by_name(file, section_name(psection))) {
+      strvec_append(removed_sections, section_name(psection));
+    }
+  } section_list_iterate_end;
+
+  if (0 < strvec_size(removed)) {
+    secfile_insert_str_vec(delta, strvec_data(removed), strvec_size(removed),
+                           SAVEGAME2_DELTA_SECTION ".removed");
+  }
+  if (0 < strvec_size(removed_sections)) {
+    secfile_insert_str_vec(delta, strvec_data(removed_sections),
+                           strvec_size(removed_sections),
+                           SAVEGAME2_DELTA_SECTION ".removed_sections");
+  }
+
+  strvec_destroy(removed);
+  strvec_destroy(removed_sections);
+}
+
+/****************************************************************************
+  Returns TRUE iff the section file is a delta savegame.
+****************************************************************************/
+bool savegame2_is_delta(const struct section_file *file)
+{
+  /* The delta section is the first one, so that a streamed savegame
+   * doesn't need to be read to its end to know it isn't a delta. */
+  struct section *psection = secfile_section_first(file);
+
+  return (NULL != psection
+          && 0 == strcmp(section_name(psection), SAVEGAME2_DELTA_SECTION));
+}
+
+/****************************************************************************
+  Replay the delta savegame on 'file'.
+****************************************************************************/
+static void delta_apply(struct section_file *file,
+                        const struct section_file *delta)
+{
+  const char **paths;
+  size_t num, i;
+
+  if ((paths = secfile_lookup_str_vec(delta, &num, SAVEGAME2_DELTA_SECTION
+                                      ".removed_sections"))) {
+    for (i = 0; i < num; i++) {
+      struct section *psection = secfile_section_by_name(file, paths[i]);
+
+      if (NULL != psection) {
+        section_destroy(psection);
+      }
+    }
+    free(paths);
+  }
+
+  if ((paths = secfile_lookup_str_vec(delta, &num, SAVEGAME2_DELTA_SECTION
+                                      ".removed"))) {
+    for (i = 0; i < num; i++) {
+      struct entry *pentry = secfile_entry_by_path(file, paths[i]);
+
+      if (NULL != pentry) {
+        entry_destroy(pentry);
+      }
+    }
+    free(paths);
+  }
+
+  section_list_iterate(secfile_sections(delta), pdelta) {
+    const char *name = section_name(pdelta);
+    struct section *psection;
+
+    if (0 == strcmp(name, SAVEGAME2_DELTA_SECTION)) {
+      continue;
+    }
+
+    psection = secfile_section_by_name(file, name);
+    if (NULL == psection) {
+      psection = secfile_section_new(file, name);
+    }
+
+    entry_list_iterate(section_entries(pdelta), pentry) {
+      struct entry *pold = secfile_entry_lookup(file, "%s.%s", name,
+                                                entry_name(pentry));
+
+      if (NULL != pold && entry_type(pold) == entry_type(pentry)) {
+        /* Update in place, keeping the order of the entries. */
+        delta_entry_set(pold, pentry);
+      } else {
+        if (NULL != pold) {
+          entry_destroy(pold);
+        }
+        delta_entry_copy(psection, pentry);
+      }
+    } entry_list_iterate_end;
+  } section_list_iterate_end;
+}
+
+/****************************************************************************
+  Load the full game from a delta savegame: load the previous savegames,
+  back to a full one, and replay the deltas on it. 'delta' was loaded
+  from 'filename' and is destroyed. Returns NULL on error.
+  Called only in ./server/stdinhand.c:load_command().
+****************************************************************************/
+struct section_file *savegame2_load_delta(struct section_file *delta,
+                                          const char *filename)
+{
+  struct section_file *chain[GAME_MAX_SAVE_DELTAS + 1];
+  struct section_file *file = delta;
+  char path[MAX_LEN_PATH];
+  int num = 0;
+
+  if (!secfile_stream_finish(delta)) {
+    /* The delta is used as a whole. */
+    secfile_destroy(delta);
+    return NULL;
+  }
+
+  sz_strlcpy(path, filename);
+  while (savegame2_is_delta(file)) {
+    const char *prev_name = secfile_lookup_str(file, SAVEGAME2_DELTA_SECTION
+                                               ".previous");
+    char prev_path[MAX_LEN_PATH];
+    const char *slash = strrchr(path, '/');
+
+    chain[num++] = file;
+    if (NULL == prev_name) {
+      log_error(_("%s: the delta savegame doesn't name its previous "
+                  "savegame."), path);
+      file = NULL;
+      break;
+    }
+    if (num >= (int) ARRAY_SIZE(chain)) {
+      log_error(_("%s: too many delta savegames in a row."), path);
+      file = NULL;
+      break;
+    }
+
+    if (NULL == slash || path_is_absolute(prev_name)) {
+      sz_strlcpy(prev_path, prev_name);
+    } else {
+      /* Relative to the directory of the delta savegame. */
+      fc_snprintf(prev_path, sizeof(prev_path), "%.*s/%s",
+                  (int) (slash - path), path, prev_name);
+    }
+    sz_strlcpy(path, prev_path);
+
+    log_verbose("Loading the previous savegame %s.", path);
+    if (!(file = secfile_load(path, FALSE))) {
+      log_error(_("Could not load the previous savegame %s."), path);
+      break;
+    }
+  }
+
+  while (0 < num && NULL != file) {
+    int prev_entries;
+
+    delta = chain[--num];
+    if (!secfile_lookup_int(delta, &prev_entries, SAVEGAME2_DELTA_SECTION
+                            ".previous_entries")
+        || prev_entries != delta_count_entries(file)) {
+      log_error(_("%s doesn't match its previous savegame."),
+                secfile_name(delta));
+      secfile_destroy(file);
+      file = NULL;
+    } else {
+      delta_apply(file, delta);
+    }
+    secfile_destroy(delta);
+  }
+
+  while (0 < num) {
+    secfile_destroy(chain[--num]);
+  }
+
+  return file;
+}
+
 /* =======================================================================
  * Helper functions.
  * ======================================================================= */
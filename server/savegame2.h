@@ -19,4 +19,12 @@ void savegame2_load(struct section_file *file);
 void savegame2_save(struct section_file *file, const char *save_reason,
                     bool scenario);
 
+void savegame2_save_delta(struct section_file *delta,
+                          const struct section_file *prev,
+                          const struct section_file *file,
+                          const char *prev_name);
+bool savegame2_is_delta(const struct section_file *file);
+struct section_file *savegame2_load_delta(struct section_file *delta,
+                                          const char *filename);
+
 #endif /* FC__SAVEGAME2_H */
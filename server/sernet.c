@@ -82,6 +82,7 @@
 #include "connecthand.h"
 #include "console.h"
 #include "ggzserver.h"
+#include "maphand.h"
 #include "meta.h"
 #include "plrhand.h"
 #include "srv_main.h"
@@ -101,6 +102,11 @@ static int listen_count;
 static int socklan;
 #endif
 
+/* Watches the listening sockets, the connections and the standard input. */
+static struct fc_poller *poller = NULL;
+/* Connections with data waiting to be sent. */
+static struct conn_list *pending_write_conns = NULL;
+
 #if defined(__VMS)
 #  if defined(_VAX_)
 #    define lib$stop LIB$STOP
@@ -132,6 +138,10 @@ static void get_lanserver_announcement(void);
 static void send_lanserver_response(void);
 
 static bool no_input = FALSE;
+static bool stdin_polled = FALSE;
+#ifdef GGZ_SERVER
+static bool ggz_polled = FALSE;
+#endif
 
 /* Avoid compiler warning about defined, but unused function
  * by defining it only when needed */
@@ -215,6 +225,11 @@ static void close_connection(struct connection *pconn)
   conn_list_remove(game.all_connections, pconn);
   conn_list_remove(game.est_connections, pconn);
 
+  conn_list_remove(pending_write_conns, pconn);
+  if (pconn->used) {
+    fc_poller_remove(poller, pconn->sock);
+  }
+
   pconn->playing = NULL;
   pconn->access_level = ALLOW_NONE;
   connection_common_close(pconn);
@@ -250,6 +265,11 @@ void close_connections_and_socket(void)
     fc_closesocket(socklan);
   }
 
+  fc_poller_destroy(poller);
+  poller = NULL;
+  conn_list_destroy(pending_write_conns);
+  pending_write_conns = NULL;
+
 #ifdef HAVE_LIBREADLINE
   if (history_file) {
     write_history(history_file);
@@ -307,6 +327,30 @@ static void server_conn_close_callback(struct connection *pconn)
 {
   /* Do as little as possible here to avoid recursive evil. */
   pconn->server.is_closing = TRUE;
+  conn_list_remove(pending_write_conns, pconn);
+}
+
+/****************************************************************************
+  Called when the send buffer of the connection was flushed. Its socket is
+  watched for writability only while some data is waiting to be sent, so
+  the idle connections don't wake up server_sniff_all_input().
+****************************************************************************/
+static void server_conn_notify_writable(struct connection *pconn,
+                                        bool data_available)
+{
+  if (pconn->server.is_closing) {
+    return;
+  }
+
+  if (!data_available) {
+    conn_list_remove(pending_write_conns, pconn);
+  } else if (!conn_list_search(pending_write_conns, pconn)) {
+    conn_list_append(pending_write_conns, pconn);
+  }
+
+  fc_poller_modify(poller, pconn->sock,
+                   FC_POLL_READ | FC_POLL_EXCEPT
+                   | (data_available ? FC_POLL_WRITE : 0));
 }
 
 /****************************************************************************
@@ -334,69 +378,83 @@ static void cut_lagging_connection(struct connection *pconn)
   }
 }
 
+/****************************************************************************
+  Returns TRUE if the socket is one of the listening sockets.
+****************************************************************************/
+static bool is_listen_socket(int sock)
+{
+  int i;
+
+  for (i = 0; i < listen_count; i++) {
+    if (listen_socks[i] == sock) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 /****************************************************************************
   Attempt to flush all information in the send buffers for upto 'netwait'
   seconds.
 *****************************************************************************/
 void flush_packets(void)
 {
-  int i;
-  int max_desc;
-  fd_set writefs, exceptfs;
+  struct fc_poll_event events[MAX_NUM_CONNECTIONS];
+  struct fc_poller *writers;
   struct timeval tv;
   time_t start;
+  int i, num_events;
+
+  if (0 == conn_list_size(pending_write_conns)) {
+    return;
+  }
 
   (void) time(&start);
 
-  for(;;) {
+  /* Watch only the connections which have data to send. */
+  writers = fc_poller_new();
+  conn_list_iterate(pending_write_conns, pconn) {
+    fc_poller_add(writers, pconn->sock, FC_POLL_WRITE | FC_POLL_EXCEPT,
+                  pconn);
+  } conn_list_iterate_end;
+
+  while (0 < conn_list_size(pending_write_conns)) {
     tv.tv_sec = (game.server.netwait - (time(NULL) - start));
     tv.tv_usec=0;
 
-    if (tv.tv_sec < 0)
-      return;
-
-    FC_FD_ZERO(&writefs);
-    FC_FD_ZERO(&exceptfs);
-    max_desc=-1;
-
-    for(i=0; i<MAX_NUM_CONNECTIONS; i++) {
-      struct connection *pconn = &connections[i];
-      if (pconn->used
-          && !pconn->server.is_closing
-          && 0 < pconn->send_buffer->ndata) {
-	FD_SET(pconn->sock, &writefs);
-	FD_SET(pconn->sock, &exceptfs);
-	max_desc=MAX(pconn->sock, max_desc);
-      }
+    if (tv.tv_sec < 0) {
+      break;
     }
 
-    if (max_desc == -1) {
-      return;
+    num_events = fc_poller_wait(writers, events, ARRAY_SIZE(events), &tv);
+    if (num_events <= 0) {
+      break;
     }
 
-    if(fc_select(max_desc+1, NULL, &writefs, &exceptfs, &tv)<=0) {
-      return;
-    }
+    for (i = 0; i < num_events; i++) {   /* check for freaky players */
+      struct connection *pconn = events[i].data;
 
-    for(i=0; i<MAX_NUM_CONNECTIONS; i++) {   /* check for freaky players */
-      struct connection *pconn = &connections[i];
-      if (pconn->used && !pconn->server.is_closing) {
-        if(FD_ISSET(pconn->sock, &exceptfs)) {
-          log_verbose("connection (%s) cut due to exception data",
-                      conn_description(pconn));
-          connection_close_server(pconn, _("network exception"));
-        } else {
-	  if(pconn->send_buffer && pconn->send_buffer->ndata > 0) {
-	    if(FD_ISSET(pconn->sock, &writefs)) {
-	      flush_connection_send_buffer_all(pconn);
-	    } else {
-	      cut_lagging_connection(pconn);
-	    }
-	  }
+      if (pconn->server.is_closing) {
+        fc_poller_remove(writers, events[i].sock);
+      } else if (events[i].events & FC_POLL_EXCEPT) {
+        log_verbose("connection (%s) cut due to exception data",
+                    conn_description(pconn));
+        connection_close_server(pconn, _("network exception"));
+        fc_poller_remove(writers, events[i].sock);
+      } else if (events[i].events & FC_POLL_WRITE) {
+        flush_connection_send_buffer_all(pconn);
+        if (0 == pconn->send_buffer->ndata) {
+          fc_poller_remove(writers, events[i].sock);
         }
       }
     }
+
+    conn_list_iterate(pending_write_conns, pconn) {
+      cut_lagging_connection(pconn);
+    } conn_list_iterate_end;
   }
+
+  fc_poller_destroy(writers);
 }
 
 struct packet_to_handle {
@@ -480,11 +538,14 @@ functions.  That is, other functions should not need to do so.  --dwp
 *****************************************************************************/
 enum server_events server_sniff_all_input(void)
 {
-  int i, s;
-  int max_desc;
-  bool excepting;
-  fd_set readfs, writefs, exceptfs;
+  int i;
+  int num_events;
+  bool excepting, stdin_ready;
+  struct fc_poll_event events[MAX_NUM_CONNECTIONS + 8];
   struct timeval tv;
+#ifdef GGZ_SERVER
+  bool ggz_ready;
+#endif
 #ifdef SOCKET_ZERO_ISNT_STDIN
   char *bufptr;    
 #endif
@@ -529,6 +590,7 @@ enum server_events server_sniff_all_input(void)
     }
 
     get_lanserver_announcement();
+    save_game_poll();
 
     /* end server if no players for 'srvarg.quitidle' seconds,
      * but only if at least one player has previously connected. */
@@ -635,50 +697,37 @@ enum server_events server_sniff_all_input(void)
     tv.tv_sec = 1;
     tv.tv_usec = 0;
 
-    FC_FD_ZERO(&readfs);
-    FC_FD_ZERO(&writefs);
-    FC_FD_ZERO(&exceptfs);
-
     if (!no_input) {
 #ifdef SOCKET_ZERO_ISNT_STDIN
       fc_init_console();
-#else /* SOCKET_ZERO_ISNT_STDIN */
-#   if !defined(__VMS)
-      FD_SET(0, &readfs);
-#   endif /* VMS */	
 #endif /* SOCKET_ZERO_ISNT_STDIN */
     }
 
-    max_desc = 0;
-    for (i = 0; i < listen_count; i++) {
-      FD_SET(listen_socks[i], &readfs);
-      FD_SET(listen_socks[i], &exceptfs);
-      max_desc = MAX(max_desc, listen_socks[i]);
+#if !defined(SOCKET_ZERO_ISNT_STDIN) && !defined(__VMS)
+    /* Watch the standard input as long as it is used. */
+    if (no_input && stdin_polled) {
+      fc_poller_remove(poller, 0);
+      stdin_polled = FALSE;
+    } else if (!no_input && !stdin_polled) {
+      stdin_polled = fc_poller_add(poller, 0, FC_POLL_READ, NULL);
     }
+#endif /* !SOCKET_ZERO_ISNT_STDIN && !VMS */
 
-    if (with_ggz) {
 #ifdef GGZ_SERVER
+    if (with_ggz) {
       int ggz_sock = get_ggz_socket();
 
-      FD_SET(ggz_sock, &readfs);
-      max_desc = MAX(max_desc, ggz_sock);
-#endif /* GGZ_SERVER */
-    }
-
-    for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-      struct connection *pconn = connections + i;
-      if (pconn->used && !pconn->server.is_closing) {
-        FD_SET(pconn->sock, &readfs);
-        if (0 < pconn->send_buffer->ndata) {
-          FD_SET(pconn->sock, &writefs);
-        }
-        FD_SET(pconn->sock, &exceptfs);
-        max_desc = MAX(pconn->sock, max_desc);
+      if (!ggz_polled) {
+        ggz_polled = fc_poller_add(poller, ggz_sock, FC_POLL_READ, NULL);
       }
     }
+#endif /* GGZ_SERVER */
+
     con_prompt_off();		/* output doesn't generate a new prompt */
 
-    if (fc_select(max_desc + 1, &readfs, &writefs, &exceptfs, &tv) == 0) {
+    stdin_ready = FALSE;
+    num_events = fc_poller_wait(poller, events, ARRAY_SIZE(events), &tv);
+    if (num_events == 0) {
       /* timeout */
       call_ai_refresh();
       (void) send_server_info_to_metaserver(META_REFRESH);
@@ -718,7 +767,7 @@ enum server_events server_sniff_all_input(void)
 	    lib$stop(status);
 	  }
 	  if (ttchar.numchars) {
-	    FD_SET(0, &readfs);
+	    stdin_ready = TRUE;
 	  } else {
 	    continue;
 	  }
@@ -730,24 +779,41 @@ enum server_events server_sniff_all_input(void)
 #endif /* SOCKET_ZERO_ISNT_STDIN */
 #endif /* !__VMS */
       }
+    } else if (num_events < 0) {
+      num_events = 0;
     }
 
-    if (!with_ggz) { /* No listening socket when using GGZ. */
-      excepting = FALSE;
-      for (i = 0; i < listen_count; i++) {
-        if (FD_ISSET(listen_socks[i], &exceptfs)) {
-          excepting = TRUE;
-          break;
-        }
+    /* Sort out the sockets which are not connections. */
+    excepting = FALSE;
+#ifdef GGZ_SERVER
+    ggz_ready = FALSE;
+#endif
+    for (i = 0; i < num_events; i++) {
+      if (NULL != events[i].data) {
+        continue;
+      }
+      if (stdin_polled && 0 == events[i].sock) {
+        stdin_ready = TRUE;
+#ifdef GGZ_SERVER
+      } else if (with_ggz && get_ggz_socket() == events[i].sock) {
+        ggz_ready = TRUE;
+#endif /* GGZ_SERVER */
+      } else if (events[i].events & FC_POLL_EXCEPT) {
+        excepting = TRUE;
       }
+    }
+
+    if (!with_ggz) { /* No listening socket when using GGZ. */
       if (excepting) {                  /* handle Ctrl-Z suspend/resume */
 	continue;
       }
-      for (i = 0; i < listen_count; i++) {
-        s = listen_socks[i];
-        if (FD_ISSET(s, &readfs)) {     /* new players connects */
+      for (i = 0; i < num_events; i++) {
+        if (NULL == events[i].data
+            && (events[i].events & FC_POLL_READ)
+            && is_listen_socket(events[i].sock)) {
+          /* new players connects */
           log_verbose("got new connection");
-          if (-1 == server_accept_connection(s)) {
+          if (-1 == server_accept_connection(events[i].sock)) {
             /* There will be a log_error() message from
              * server_accept_connection() if something
              * goes wrong, so no need to make another
@@ -757,13 +823,14 @@ enum server_events server_sniff_all_input(void)
         }
       }
     }
-    for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
+    for (i = 0; i < num_events; i++) {
       /* check for freaky players */
-      struct connection *pconn = &connections[i];
+      struct connection *pconn = events[i].data;
 
-      if (pconn->used
+      if (NULL != pconn
+          && pconn->used
           && !pconn->server.is_closing
-          && FD_ISSET(pconn->sock, &exceptfs)) {
+          && (events[i].events & FC_POLL_EXCEPT)) {
         log_verbose("connection (%s) cut due to exception data",
                     conn_description(pconn));
         connection_close_server(pconn, _("network exception"));
@@ -773,10 +840,8 @@ enum server_events server_sniff_all_input(void)
     if (with_ggz) {
       /* This is intentionally after all the player socket handling because
        * it may cut a client. */
-      int ggz_sock = get_ggz_socket();
-
-      if (FD_ISSET(ggz_sock, &readfs)) {
-	input_from_ggz(ggz_sock);
+      if (ggz_ready) {
+	input_from_ggz(get_ggz_socket());
       }
     }
 #endif /* GGZ_SERVER */
@@ -790,7 +855,7 @@ enum server_events server_sniff_all_input(void)
       free(bufptr_internal);
     }
 #else  /* !SOCKET_ZERO_ISNT_STDIN */
-    if(!no_input && FD_ISSET(0, &readfs)) {    /* input from server operator */
+    if(!no_input && stdin_ready) {    /* input from server operator */
 #ifdef HAVE_LIBREADLINE
       rl_callback_read_char();
       if (readline_handled_input) {
@@ -839,13 +904,14 @@ enum server_events server_sniff_all_input(void)
 #endif /* !SOCKET_ZERO_ISNT_STDIN */
      
     {                             /* input from a player */
-      for(i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-        struct connection *pconn = connections + i;
+      for (i = 0; i < num_events; i++) {
+        struct connection *pconn = events[i].data;
         int nb;
 
-        if (!pconn->used
+        if (NULL == pconn
+            || !pconn->used
             || pconn->server.is_closing
-            || !FD_ISSET(pconn->sock, &readfs)) {
+            || !(events[i].events & FC_POLL_READ)) {
           continue;
 	}
 
@@ -861,20 +927,19 @@ enum server_events server_sniff_all_input(void)
         }
       }
 
-      for (i = 0; i < MAX_NUM_CONNECTIONS; i++) {
-        struct connection *pconn = &connections[i];
+      for (i = 0; i < num_events; i++) {
+        struct connection *pconn = events[i].data;
 
-        if (pconn->used
+        if (NULL != pconn
+            && pconn->used
             && !pconn->server.is_closing
-            && pconn->send_buffer
-	    && pconn->send_buffer->ndata > 0) {
-	  if (FD_ISSET(pconn->sock, &writefs)) {
-	    flush_connection_send_buffer_all(pconn);
-	  } else {
-	    cut_lagging_connection(pconn);
-	  }
+            && (events[i].events & FC_POLL_WRITE)) {
+          flush_connection_send_buffer_all(pconn);
         }
       }
+      conn_list_iterate(pending_write_conns, pconn) {
+        cut_lagging_connection(pconn);
+      } conn_list_iterate_end;
     }
     really_close_connections();
     break;
@@ -1030,13 +1095,19 @@ int server_make_connection(int new_sock, const char *client_addr, const char *cl
   for(i=0; i<MAX_NUM_CONNECTIONS; i++) {
     struct connection *pconn = &connections[i];
     if (!pconn->used) {
+      if (!fc_poller_add(poller, new_sock, FC_POLL_READ | FC_POLL_EXCEPT,
+                         pconn)) {
+        fc_closesocket(new_sock);
+        return -1;
+      }
+
       connection_common_init(pconn);
       pconn->sock = new_sock;
       pconn->observer = FALSE;
       pconn->playing = NULL;
       pconn->capability[0] = '\0';
       pconn->access_level = access_level_for_next_connection();
-      pconn->notify_of_writable_data = NULL;
+      pconn->notify_of_writable_data = server_conn_notify_writable;
       pconn->server.currently_processed_request_id = 0;
       pconn->server.last_request_id_seen = 0;
       pconn->server.auth_tries = 0;
@@ -1178,6 +1249,11 @@ int server_open_socket(void)
 
   fc_sockaddr_list_destroy(list);
 
+  for (j = 0; j < listen_count; j++) {
+    fc_poller_add(poller, listen_socks[j], FC_POLL_READ | FC_POLL_EXCEPT,
+                  NULL);
+  }
+
   connections_set_close_callback(server_conn_close_callback);
 
   if (srvarg.announce == ANNOUNCE_NONE) {
@@ -1281,6 +1357,9 @@ void init_connections(void)
   game.all_connections = conn_list_new();
   game.est_connections = conn_list_new();
 
+  poller = fc_poller_new();
+  pending_write_conns = conn_list_new();
+
   for(i=0; i<MAX_NUM_CONNECTIONS; i++) { 
     struct connection *pconn = &connections[i];
     pconn->used = FALSE;
@@ -1303,6 +1382,9 @@ void init_connections(void)
 static void start_processing_request(struct connection *pconn,
                                      int request_id)
 {
+  /* Thawed by finish_processing_request(). */
+  send_tile_info_freeze();
+
   fc_assert_ret(request_id);
   fc_assert_ret(pconn->server.currently_processed_request_id == 0);
   log_debug("start processing packet %d from connection %d",
@@ -1317,6 +1399,9 @@ static void start_processing_request(struct connection *pconn,
 **************************************************************************/
 static void finish_processing_request(struct connection *pconn)
 {
+  /* The tiles changed by the request are sent before its end. */
+  send_tile_info_thaw();
+
   if (!pconn || !pconn->used) {
     return;
   }
@@ -1394,8 +1479,7 @@ static void get_lanserver_announcement(void)
   char msgbuf[128];
   struct data_in din;
   int type;
-  fd_set readfs, exceptfs;
-  struct timeval tv;
+  int ready;
 
   if (with_ggz) {
     return;
@@ -1405,15 +1489,8 @@ static void get_lanserver_announcement(void)
     return;
   }
 
-  FD_ZERO(&readfs);
-  FD_ZERO(&exceptfs);
-  FD_SET(socklan, &exceptfs);
-  FD_SET(socklan, &readfs);
-
-  tv.tv_sec = 0;
-  tv.tv_usec = 0;
-
-  while (fc_select(socklan + 1, &readfs, NULL, &exceptfs, &tv) == -1) {
+  while ((ready = fc_socket_ready(socklan,
+                                  FC_POLL_READ | FC_POLL_EXCEPT)) == -1) {
     if (errno != EINTR) {
       log_error("select failed: %s", fc_strerror(fc_get_errno()));
       return;
@@ -1422,7 +1499,7 @@ static void get_lanserver_announcement(void)
      * Generally we just want to run select again. */
   }
 
-  if (FD_ISSET(socklan, &readfs)) {
+  if (ready & FC_POLL_READ) {
     if (0 < recvfrom(socklan, msgbuf, sizeof(msgbuf), 0, NULL, NULL)) {
       dio_input_init(&din, msgbuf, 1);
       dio_get_uint8(&din, &type);
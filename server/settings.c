@@ -2302,6 +2302,60 @@ static struct setting settings[] = {
              "client is disconnected."), NULL, NULL,
 	  GAME_MIN_PINGTIMEOUT, GAME_MAX_PINGTIMEOUT, GAME_DEFAULT_PINGTIMEOUT)
 
+  GEN_INT("pfthreads", game.server.pfthreads,
+          SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+          N_("Extra threads for the path-finding of the AI"),
+          N_("Number of additional threads used to compute in advance "
+             "the paths of the auto workers. Zero means everything is "
+             "computed in the main thread. The paths computed in "
+             "advance reflect the state of the game before the workers "
+             "of a player start to move, so the results may differ "
+             "slightly from a game played without extra threads."),
+          NULL, NULL,
+          GAME_MIN_PFTHREADS, GAME_MAX_PFTHREADS, GAME_DEFAULT_PFTHREADS)
+
+  GEN_INT("citythreads", game.server.citythreads,
+          SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+          N_("Extra threads refreshing the cities at turn end"),
+          N_("Number of additional threads used to refresh in advance "
+             "the cities of a player before they are updated at turn "
+             "end. Zero means the cities are refreshed one by one in "
+             "the main thread while they are updated. Once the update "
+             "of a city changes what the others depend on (a building, "
+             "a tech, a tile, the government or the rates), the cities "
+             "left are refreshed one by one again, so the results are "
+             "the same with any value."),
+          NULL, NULL,
+          GAME_MIN_CITYTHREADS, GAME_MAX_CITYTHREADS,
+          GAME_DEFAULT_CITYTHREADS)
+
+  GEN_INT("mapimgthreads", game.server.mapimg_threads,
+          SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+          N_("Extra threads drawing each map image"),
+          /* TRANS: 'mapimg' is a server command and shouldn't be
+           * translated. */
+          N_("Number of additional threads used to draw the images "
+             "defined with the 'mapimg' command. Each image is split "
+             "into bands of rows drawn at the same time. Zero means "
+             "each image is drawn by a single thread. The images are "
+             "the same whatever this setting."),
+          NULL, NULL, GAME_MIN_MAPIMG_THREADS, GAME_MAX_MAPIMG_THREADS,
+          GAME_DEFAULT_MAPIMG_THREADS)
+
+  GEN_BOOL("mapimgbackground", game.server.mapimg_background,
+           SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+           N_("Save the map images in the background"),
+           /* TRANS: The strings between single quotes are server command
+            * or setting names and shouldn't be translated. */
+           N_("If this is turned on, the map images saved each turn by "
+              "the 'mapimg' definitions are drawn and saved by another "
+              "thread, from a copy of the map data taken at the start of "
+              "the turn, so the turn is not delayed. Errors are then only "
+              "written to the server log. Images of the 'magick' toolkit "
+              "are still made in the main thread. Images created with "
+              "'mapimg create' are always made at once."),
+           NULL, NULL, GAME_DEFAULT_MAPIMG_BACKGROUND)
+
   GEN_BOOL("turnblock", game.server.turnblock,
            SSET_META, SSET_INTERNAL, SSET_SITUATIONAL, SSET_TO_CLIENT,
            N_("Turn-blocking game play mode"),
@@ -2391,6 +2445,34 @@ static struct setting settings[] = {
                  "- \"Timer\" (TIMER): Save every 'savefrequency' minutes."),
               autosaves_callback, NULL, autosaves_name, GAME_DEFAULT_AUTOSAVES)
 
+  GEN_BOOL("asyncsave", game.server.save_async,
+           SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+           N_("Write the autosaves in the background"),
+           /* TRANS: The strings between double quotes are also translated
+            * separately (they must match!). The string between single
+            * quotes is a setting name and shouldn't be translated. */
+           N_("If this is turned on, the \"New turn\" and \"Timer\" "
+              "autosaves (see the 'autosaves' setting) are compressed and "
+              "written to disk in the background, while the game goes on. "
+              "The game is still saved as it was when the save started. "
+              "The other saves are always written at once."),
+           NULL, NULL, GAME_DEFAULT_SAVE_ASYNC)
+
+  GEN_INT("savedeltas", game.server.save_deltas,
+          SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+          N_("Number of delta savegames between full ones"),
+          /* TRANS: The strings between double quotes are also translated
+           * separately (they must match!). */
+          N_("If non-zero, only one \"New turn\" autosave out of this "
+             "number plus one is a full savegame. The ones in between "
+             "only hold what changed since the previous savegame, which "
+             "is needed to load them: the loading goes back through the "
+             "previous savegames to the full one. The server keeps the "
+             "content of the last savegame in memory to find what "
+             "changed."),
+          NULL, NULL, GAME_MIN_SAVE_DELTAS, GAME_MAX_SAVE_DELTAS,
+          GAME_DEFAULT_SAVE_DELTAS)
+
   GEN_INT("compress", game.server.save_compress_level,
           SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
           N_("Savegame compression level"),
@@ -2407,6 +2489,18 @@ static struct setting settings[] = {
            N_("Compression library to use for savegames."),
            NULL, NULL, compresstype_name, GAME_DEFAULT_COMPRESS_TYPE)
 
+  GEN_BOOL("binarysave", game.server.save_binary,
+           SSET_META, SSET_INTERNAL, SSET_RARE, SSET_SERVER_ONLY,
+           N_("Save games in the binary format"),
+           /* TRANS: The strings between single quotes are setting names
+            * and shouldn't be translated. */
+           N_("If this is turned on, games are saved in a binary format "
+              "instead of the text format. Such savegames are much faster "
+              "to write and load. The 'compress' level applies to them, "
+              "but 'compresstype' does not. The freeciv-savconv tool "
+              "converts between the two formats."),
+           NULL, NULL, GAME_DEFAULT_SAVE_BINARY)
+
   GEN_STRING("savename", game.server.save_name,
              SSET_META, SSET_INTERNAL, SSET_VITAL, SSET_SERVER_ONLY,
              N_("Definition of the save file name"),
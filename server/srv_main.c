@@ -49,6 +49,7 @@
 #include "capability.h"
 #include "fciconv.h"
 #include "fcintl.h"
+#include "fcthread.h"
 #include "log.h"
 #include "mem.h"
 #include "netintf.h"
@@ -60,6 +61,8 @@
 
 /* common/aicore */
 #include "citymap.h"
+#include "path_finding.h"
+#include "pf_regions.h"
 
 /* common */
 #include "achievements.h"
@@ -126,6 +129,7 @@
 
 /* server/advisors */
 #include "advdata.h"
+#include "advgoto.h"
 #include "autosettlers.h"
 #include "advbuilding.h"
 #include "infracache.h"
@@ -180,6 +184,30 @@ bv_identity_numbers identity_numbers_used;
 /* server initialized flag */
 static bool has_been_srv_init = FALSE;
 
+/* A savegame written in the background, see save_game_auto(). */
+struct save_job {
+  struct section_file *file;
+  char filepath[600];
+  int compress_level;
+  enum fz_method compress_type;
+  bool binary;
+  bool keep_file;               /* 'file' is last_save.file. */
+  bool success;
+  bool done;                    /* Protected by save_job_mutex. */
+};
+
+static struct save_job *save_job = NULL;
+static fc_thread *save_thread = NULL;
+static fc_mutex save_job_mutex;
+
+/* The last "New turn" autosave, base of the next delta savegame. See the
+ * 'savedeltas' setting. */
+static struct {
+  struct section_file *file;    /* Its full content. */
+  char filepath[600];
+  int deltas;                   /* Delta savegames since the full one. */
+} last_save = { NULL, "", 0 };
+
 /**************************************************************************
   Initialize the game seed.  This may safely be called multiple times.
 **************************************************************************/
@@ -260,6 +288,7 @@ void srv_init(void)
 
   /* Initialize global mutexes */
   fc_init_mutex(&game.server.mutexes.city_list);
+  fc_init_mutex(&save_job_mutex);
 
   /* done */
   return;
@@ -785,6 +814,7 @@ static void update_diplomatics(void)
             state2->type = DS_WAR;
             state->turns_left = 0;
             state2->turns_left = 0;
+            pf_map_game_changed();
 
             enter_war(plr1, plr2);
 
@@ -954,6 +984,8 @@ static void begin_phase(bool is_new_phase)
   log_debug("Begin phase");
 
   conn_list_do_buffer(game.est_connections);
+  conn_list_batch_begin(game.est_connections);
+  send_tile_info_freeze();
 
   phase_players_iterate(pplayer) {
     pplayer->phase_done = FALSE;
@@ -963,6 +995,9 @@ static void begin_phase(bool is_new_phase)
 
   dlsend_packet_start_phase(game.est_connections, game.info.phase);
 
+  /* Paths computed during the previous phase are outdated. */
+  adv_pf_cache_clear();
+
   /* Must be the first thing as it is needed for lots of functions below! */
   phase_players_iterate(pplayer) {
     /* human players also need this for building advice */
@@ -1001,7 +1036,9 @@ static void begin_phase(bool is_new_phase)
     send_player_cities(pplayer);
   } phase_players_iterate_end;
 
+  send_tile_info_thaw();
   flush_packets();  /* to curb major city spam */
+  conn_list_batch_end(game.est_connections);
   conn_list_do_unbuffer(game.est_connections);
 
   phase_players_iterate(pplayer) {
@@ -1017,7 +1054,9 @@ static void begin_phase(bool is_new_phase)
     } phase_players_iterate_end;
 
     log_debug("Aistartturn");
+    send_tile_info_freeze();
     ai_start_phase();
+    send_tile_info_thaw();
   } else {
     phase_players_iterate(pplayer) {
       if (pplayer->ai_controlled) {
@@ -1137,6 +1176,8 @@ static void end_phase(void)
        is initialized for human players also. */
     adv_data_phase_done(pplayer);
   } phase_players_iterate_end;
+
+  adv_pf_cache_clear();
 }
 
 /**************************************************************************
@@ -1280,21 +1321,169 @@ static void end_turn(void)
 
   log_debug("Sendyeartoclients");
   send_year_to_clients(game.info.year);
+
+  city_refresh_counts_log();
+}
+
+/**************************************************************************
+  Forget the last savegame, so that the next one is a full savegame.
+**************************************************************************/
+static void save_game_delta_reset(void)
+{
+  if (NULL != last_save.file) {
+    secfile_destroy(last_save.file);
+    last_save.file = NULL;
+  }
+  last_save.filepath[0] = '\0';
+  last_save.deltas = 0;
+}
+
+/**************************************************************************
+  Returns the name under which a delta savegame written as 'filepath'
+  refers to the last savegame, or NULL if the savegame can't be a delta.
+  Both must be in the same directory, and have different names.
+**************************************************************************/
+static const char *save_game_delta_base(const char *filepath)
+{
+  const char *base, *name;
+
+  if (NULL == last_save.file
+      || last_save.deltas >= game.server.save_deltas) {
+    return NULL;
+  }
+
+  base = strrchr(last_save.filepath, '/');
+  base = (NULL != base ? base + 1 : last_save.filepath);
+  name = strrchr(filepath, '/');
+  name = (NULL != name ? name + 1 : filepath);
+
+  if (base - last_save.filepath != name - filepath
+      || 0 != strncmp(last_save.filepath, filepath, name - filepath)
+      || 0 == strcmp(base, name)) {
+    return NULL;
+  }
+
+  return base;
+}
+
+/**************************************************************************
+  Print the result of saving the game as 'filepath'.
+**************************************************************************/
+static void save_game_report(const char *filepath, bool success)
+{
+  if (!success) {
+    con_write(C_FAIL, _("Failed saving game as %s"), filepath);
+    /* The following delta savegames would refer to it. */
+    save_game_delta_reset();
+  } else {
+    con_write(C_OK, _("Game saved as %s"), filepath);
+  }
+
+  ggz_game_saved(filepath);
+}
+
+/**************************************************************************
+  Write the savegame file, in the binary format or as an ini file.
+**************************************************************************/
+static bool save_game_write(const struct section_file *file,
+                            const char *filepath, int compress_level,
+                            enum fz_method compress_type, bool binary)
+{
+  if (binary) {
+    return binfile_save(file, filepath, compress_level);
+  }
+
+  return secfile_save(file, filepath, compress_level, compress_type);
+}
+
+/**************************************************************************
+  Write the savegame of the job. This runs in its own thread.
+**************************************************************************/
+static void save_game_thread(void *arg)
+{
+  struct save_job *job = (struct save_job *) arg;
+  bool success = save_game_write(job->file, job->filepath,
+                                 job->compress_level, job->compress_type,
+                                 job->binary);
+
+  if (!job->keep_file) {
+    secfile_destroy(job->file);
+  }
+  job->file = NULL;
+
+  fc_allocate_mutex(&save_job_mutex);
+  job->success = success;
+  job->done = TRUE;
+  fc_release_mutex(&save_job_mutex);
+}
+
+/**************************************************************************
+  End the savegame written in the background, if any, and report it. If
+  'wait' is FALSE, does nothing while it is still being written.
+**************************************************************************/
+static void save_game_job_end(bool wait)
+{
+  if (NULL == save_job) {
+    return;
+  }
+
+  if (!wait) {
+    bool done;
+
+    fc_allocate_mutex(&save_job_mutex);
+    done = save_job->done;
+    fc_release_mutex(&save_job_mutex);
+    if (!done) {
+      return;
+    }
+  }
+
+  fc_thread_wait(save_thread);
+  free(save_thread);
+  save_thread = NULL;
+
+  save_game_report(save_job->filepath, save_job->success);
+  free(save_job);
+  save_job = NULL;
+}
+
+/**************************************************************************
+  Report the savegame written in the background if it is done. Called
+  regularly from the main loop.
+**************************************************************************/
+void save_game_poll(void)
+{
+  save_game_job_end(FALSE);
+}
+
+/**************************************************************************
+  Wait until the savegame written in the background, if any, is done.
+**************************************************************************/
+void save_game_wait(void)
+{
+  save_game_job_end(TRUE);
 }
 
 /**************************************************************************
 Unconditionally save the game, with specified filename.
 Always prints a message: either save ok, or failed.
 
+If 'async' is set, the savegame is only built here; it is compressed and
+written in a background thread, and the message is printed from
+save_game_poll() once this is done.
+
+If 'delta' is set, the savegame is a "New turn" autosave, which may be
+written as a delta of the previous one (see the 'savedeltas' setting).
+
 Note that if !HAVE_LIBZ, then game.server.save_compress_level should never
 become non-zero, so no need to check HAVE_LIBZ explicitly here as well.
 **************************************************************************/
-void save_game(const char *orig_filename, const char *save_reason,
-               bool scenario)
+static void save_game_real(const char *orig_filename, const char *save_reason,
+                           bool scenario, bool async, bool delta)
 {
   char filepath[600];
   char *dot, *filename;
-  struct section_file *file;
+  struct section_file *file, *write_file;
   struct timer *timer_cpu, *timer_user;
 
   if (!orig_filename) {
@@ -1317,7 +1506,8 @@ void save_game(const char *orig_filename, const char *save_reason,
       filename[0] = '\0';
     } else {
       char *end_dot;
-      char *strip_extensions[] = { ".sav", ".gz", ".bz2", ".xz", NULL };
+      char *strip_extensions[] = { ".sav", ".gz", ".bz2", ".xz",
+                                   "." FCBIN_SUFFIX, NULL };
       bool stripped = TRUE;
 
       while ((end_dot = strrchr(dot, '.')) && stripped) {
@@ -1341,6 +1531,9 @@ void save_game(const char *orig_filename, const char *save_reason,
                        sizeof(filepath) + filepath - filename, "manual");
   }
 
+  /* One savegame at a time. */
+  save_game_wait();
+
   timer_cpu = timer_new(TIMER_CPU, TIMER_ACTIVE);
   timer_start(timer_cpu);
   timer_user = timer_new(TIMER_USER, TIMER_ACTIVE);
@@ -1354,7 +1547,10 @@ void save_game(const char *orig_filename, const char *save_reason,
   /* Append ".sav" to filename. */
   sz_strlcat(filepath, ".sav");
 
-  if (game.server.save_compress_level > 0) {
+  if (game.server.save_binary) {
+    /* The binary format compresses its blocks itself. */
+    sz_strlcat(filepath, "." FCBIN_SUFFIX);
+  } else if (game.server.save_compress_level > 0) {
     switch (game.server.save_compress_type) {
 #ifdef HAVE_LIBZ
     case FZ_ZLIB:
@@ -1408,14 +1604,59 @@ void save_game(const char *orig_filename, const char *save_reason,
     sz_strlcpy(filepath, tmpname);
   }
 
-  if (!secfile_save(file, filepath, game.server.save_compress_level,
-                    game.server.save_compress_type)) {
-    con_write(C_FAIL, _("Failed saving game as %s"), filepath);
-  } else {
-    con_write(C_OK, _("Game saved as %s"), filepath);
+  write_file = file;
+  if (delta) {
+    const char *base = save_game_delta_base(filepath);
+
+    if (NULL != base) {
+      write_file = secfile_new(TRUE);
+      savegame2_save_delta(write_file, last_save.file, file, base);
+      last_save.deltas++;
+    } else {
+      last_save.deltas = 0;
+    }
+
+    if (NULL != last_save.file) {
+      secfile_destroy(last_save.file);
+      last_save.file = NULL;
+    }
+    if (0 < game.server.save_deltas) {
+      /* Keep it for the next delta. */
+      last_save.file = file;
+      sz_strlcpy(last_save.filepath, filepath);
+    }
   }
 
-  secfile_destroy(file);
+  if (async) {
+    save_job = fc_calloc(1, sizeof(*save_job));
+    save_job->file = write_file;
+    save_job->keep_file = (write_file == last_save.file);
+    sz_strlcpy(save_job->filepath, filepath);
+    save_job->compress_level = game.server.save_compress_level;
+    save_job->compress_type = game.server.save_compress_type;
+    save_job->binary = game.server.save_binary;
+
+    save_thread = fc_malloc(sizeof(*save_thread));
+    if (0 != fc_thread_start(save_thread, save_game_thread, save_job)) {
+      log_error("Can't start a thread to save the game; saving now.");
+      free(save_thread);
+      save_thread = NULL;
+      save_game_thread(save_job);
+      save_game_report(save_job->filepath, save_job->success);
+      free(save_job);
+      save_job = NULL;
+    }
+  } else {
+    bool success = save_game_write(write_file, filepath,
+                                   game.server.save_compress_level,
+                                   game.server.save_compress_type,
+                                   game.server.save_binary);
+
+    if (write_file != last_save.file) {
+      secfile_destroy(write_file);
+    }
+    save_game_report(filepath, success);
+  }
 
 #ifdef LOG_TIMERS
   log_verbose("Save time: %g seconds (%g apparent)",
@@ -1424,8 +1665,16 @@ void save_game(const char *orig_filename, const char *save_reason,
 
   timer_destroy(timer_cpu);
   timer_destroy(timer_user);
+}
 
-  ggz_game_saved(filepath);
+/**************************************************************************
+Unconditionally save the game, with specified filename.
+Always prints a message: either save ok, or failed.
+**************************************************************************/
+void save_game(const char *orig_filename, const char *save_reason,
+               bool scenario)
+{
+  save_game_real(orig_filename, save_reason, scenario, FALSE, FALSE);
 }
 
 /**************************************************************************
@@ -1466,7 +1715,12 @@ void save_game_auto(const char *save_reason, enum autosave_type type)
   } else {
     fc_snprintf(filename, sizeof(filename), "%s-timer", game.server.save_name);
   }
-  save_game(filename, save_reason, FALSE);
+  /* The other autosaves are followed by the end of the game or of the
+   * server; don't leave them in the background. */
+  save_game_real(filename, save_reason, FALSE,
+                 game.server.save_async
+                 && (AS_TURN == type || AS_TIMER == type),
+                 AS_TURN == type);
 }
 
 /**************************************************************************
@@ -1510,6 +1764,7 @@ void start_game(void)
 **************************************************************************/
 void server_quit(void)
 {
+  save_game_wait();
   set_server_state(S_S_OVER);
   mapimg_free();
   server_game_free();
@@ -1531,6 +1786,7 @@ void server_quit(void)
   close_connections_and_socket();
   registry_module_close();
   fc_destroy_mutex(&game.server.mutexes.city_list);
+  fc_destroy_mutex(&save_job_mutex);
   free_nls();
   con_log_close();
   exit(EXIT_SUCCESS);
@@ -2449,11 +2705,13 @@ static void srv_running(void)
 
         if (!skip_mapimg) {
           /* Save map image(s). */
+          mapimg_set_threads(game.server.mapimg_threads);
           for (i = 0; i < mapimg_count(); i++) {
             struct mapdef *pmapdef = mapimg_isvalid(i);
             if (pmapdef != NULL) {
               mapimg_create(pmapdef, FALSE, game.server.save_name,
-                            srvarg.saves_pathname);
+                            srvarg.saves_pathname,
+                            game.server.mapimg_background);
             } else {
               log_error("%s", mapimg_error());
             }
@@ -2474,6 +2732,7 @@ static void srv_running(void)
       timer_start(eot_timer);
 
       conn_list_do_buffer(game.est_connections);
+      conn_list_batch_begin(game.est_connections);
 
       sanity_check();
 
@@ -2482,15 +2741,22 @@ static void srv_running(void)
        */
       lsend_packet_freeze_client(game.est_connections);
 
+      send_tile_info_freeze();
       end_phase();
+      send_tile_info_thaw();
 
+      conn_list_batch_end(game.est_connections);
       conn_list_do_unbuffer(game.est_connections);
 
       if (S_S_OVER == server_state()) {
 	break;
       }
     }
+    conn_list_batch_begin(game.est_connections);
+    send_tile_info_freeze();
     end_turn();
+    send_tile_info_thaw();
+    conn_list_batch_end(game.est_connections);
     log_debug("Sendinfotometaserver");
     (void) send_server_info_to_metaserver(META_REFRESH);
 
@@ -2876,6 +3142,12 @@ void server_game_init(void)
 **************************************************************************/
 void server_game_free(void)
 {
+  /* The next savegame will be of another game. */
+  save_game_wait();
+  save_game_delta_reset();
+  /* The map images being saved use the map. */
+  mapimg_wait();
+
   CALL_FUNC_EACH_AI(game_free);
 
   /* Free all the treaties that were left open when game finished. */
@@ -2909,10 +3181,15 @@ void server_game_free(void)
     server_remove_player(pplayer);
   } players_iterate_end;
 
+  adv_pf_cache_free();
+  city_refresh_workers_free();
   event_cache_free();
   log_civ_score_free();
   playercolor_free();
   citymap_free();
+  pf_regions_free();
+  pf_map_changes_free();
+  map_borders_free();
   game_free();
 }
 
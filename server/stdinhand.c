@@ -3622,6 +3622,7 @@ bool load_command(struct connection *caller, const char *filename, bool check)
   struct section_file *file;
   char arg[MAX_LEN_PATH];
   struct conn_list *global_observers;
+  bool loaded;
 
   if (!filename || filename[0] == '\0') {
     cmd_reply(CMD_LOAD, caller, C_FAIL, _("Usage:\n%s"),
@@ -3648,7 +3649,7 @@ bool load_command(struct connection *caller, const char *filename, bool check)
       get_save_dirs(), get_scenario_dirs(), NULL
     };
     const char *exts[] = {
-      "sav", "gz", "bz2", "sav.gz", "sav.bz2", NULL
+      "sav", "gz", "bz2", "sav.gz", "sav.bz2", "sav." FCBIN_SUFFIX, NULL
     };
     const char **ext, *found = NULL;
     const struct strvec **path;
@@ -3673,18 +3674,41 @@ bool load_command(struct connection *caller, const char *filename, bool check)
     }
   }
 
-  /* attempt to parse the file */
+  /* attempt to parse the file; a streamed savegame is only read while
+   * loading it, after the current game is freed, so it is streamed only
+   * when there are no players to lose, e.g. at server start. */
 
-  if (!(file = secfile_load(arg, FALSE))) {
+  if (0 == player_count() && 0 == conn_list_size(game.est_connections)) {
+    file = secfile_load_streamed(arg, FALSE);
+  } else {
+    file = secfile_load(arg, FALSE);
+  }
+
+  if (NULL == file || NULL == secfile_section_first(file)) {
     cmd_reply(CMD_LOAD, caller, C_FAIL, _("Could not load savefile: %s"),
               arg);
     log_debug("Error loading savefile '%s':\n%s", arg, secfile_error());
     dlsend_packet_game_load(game.est_connections, TRUE, arg);
+    if (NULL != file) {
+      secfile_destroy(file);
+    }
+    return FALSE;
+  }
+
+  if (savegame2_is_delta(file)
+      && !(file = savegame2_load_delta(file, arg))) {
+    cmd_reply(CMD_LOAD, caller, C_FAIL,
+              _("Could not load the savegames preceding the delta "
+                "savegame %s."), arg);
+    dlsend_packet_game_load(game.est_connections, TRUE, arg);
     return FALSE;
   }
 
   if (check) {
-    return TRUE;
+    bool ok = secfile_stream_finish(file);
+
+    secfile_destroy(file);
+    return ok;
   }
 
   /* Detach current players, before we blow them away. */
@@ -3712,6 +3736,7 @@ bool load_command(struct connection *caller, const char *filename, bool check)
   sz_strlcpy(srvarg.load_filename, arg);
 
   savegame2_load(file);
+  loaded = secfile_stream_finish(file);
   secfile_check_unused(file);
   secfile_destroy(file);
 
@@ -3720,6 +3745,20 @@ bool load_command(struct connection *caller, const char *filename, bool check)
   timer_destroy(loadtimer);
   timer_destroy(uloadtimer);
 
+  if (!loaded) {
+    /* A syntax error in a streamed savegame. There was no game to keep,
+     * start from a new one. */
+    server_game_free();
+    server_game_init();
+    load_rulesets(NULL, TRUE, FALSE);
+    player_info_thaw();
+    conn_list_destroy(global_observers);
+    cmd_reply(CMD_LOAD, caller, C_FAIL, _("Could not load savefile: %s"),
+              arg);
+    dlsend_packet_game_load(game.est_connections, TRUE, arg);
+    return FALSE;
+  }
+
   sanity_check();
 
   log_verbose("load_command() does send_rulesets()");
@@ -5442,12 +5481,14 @@ static bool mapimg_command(struct connection *caller, char *arg, bool check)
         goto cleanup;
       }
 
+      mapimg_set_threads(game.server.mapimg_threads);
+
       for (id = 0; id < mapimg_count(); id++) {
         struct mapdef *pmapdef = mapimg_isvalid(id);
 
         if (pmapdef == NULL
             || !mapimg_create(pmapdef, TRUE, game.server.save_name,
-                              srvarg.saves_pathname)) {
+                              srvarg.saves_pathname, FALSE)) {
           cmd_reply(CMD_MAPIMG, caller, C_FAIL,
                 _("Error saving map image %d: %s."), id, mapimg_error());
           ret = FALSE;
@@ -5461,10 +5502,12 @@ static bool mapimg_command(struct connection *caller, char *arg, bool check)
         goto cleanup;
       }
 
+      mapimg_set_threads(game.server.mapimg_threads);
+
       pmapdef = mapimg_isvalid(id);
       if (pmapdef == NULL
           || !mapimg_create(pmapdef, TRUE, game.server.save_name,
-                            srvarg.saves_pathname)) {
+                            srvarg.saves_pathname, FALSE)) {
         cmd_reply(CMD_MAPIMG, caller, C_FAIL,
               _("Error saving map image %d: %s."), id, mapimg_error());
         ret = FALSE;
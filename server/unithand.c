@@ -588,12 +588,12 @@ void unit_change_homecity_handling(struct unit *punit, struct city *new_pcity)
     send_unit_info(NULL, punit);    
   }
 
-  city_refresh(new_pcity);
+  city_refresh_partial(new_pcity, CD_UNITS);
   send_city_info(new_owner, new_pcity);
 
   if (old_pcity) {
     fc_assert(city_owner(old_pcity) == old_owner);
-    city_refresh(old_pcity);
+    city_refresh_partial(old_pcity, CD_UNITS);
     send_city_info(old_owner, old_pcity);
   }
 
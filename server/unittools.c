@@ -1475,11 +1475,12 @@ struct unit *create_unit_full(struct player *pplayer, struct tile *ptile,
 
   unit_list_prepend(pplayer->units, punit);
   unit_list_prepend(ptile->units, punit);
+  adv_pf_cache_clear();
   if (pcity && !utype_has_flag(type, UTYF_NOHOME)) {
     fc_assert(city_owner(pcity) == pplayer);
     unit_list_prepend(pcity->units_supported, punit);
     /* Refresh the unit's homecity. */
-    city_refresh(pcity);
+    city_refresh_partial(pcity, CD_UNITS);
     send_city_info(pplayer, pcity);
   }
 
@@ -1575,6 +1576,7 @@ static void server_remove_unit(struct unit *punit, enum unit_loss_reason reason)
   script_server_remove_exported_object(punit);
   game_remove_unit(punit);
   punit = NULL;
+  adv_pf_cache_clear();
 
   if (NULL != ptrans) {
     /* Update the occupy info. */
@@ -1586,12 +1588,12 @@ static void server_remove_unit(struct unit *punit, enum unit_loss_reason reason)
   sync_cities();
 
   if (phomecity) {
-    city_refresh(phomecity);
+    city_refresh_partial(phomecity, CD_UNITS);
     send_city_info(city_owner(phomecity), phomecity);
   }
 
   if (pcity && pcity != phomecity) {
-    city_refresh(pcity);
+    city_refresh_partial(pcity, CD_UNITS);
     send_city_info(city_owner(pcity), pcity);
   }
 
@@ -2799,6 +2801,7 @@ void unit_transport_load_send(struct unit *punit, struct unit *ptrans)
   fc_assert_ret(ptrans != NULL);
 
   unit_transport_load(punit, ptrans, FALSE);
+  adv_pf_cache_clear();
 
   send_unit_info(NULL, punit);
   send_unit_info(NULL, ptrans);
@@ -2840,6 +2843,7 @@ void unit_transport_unload_send(struct unit *punit)
   fc_assert_ret(ptrans);
 
   unit_transport_unload(punit);
+  adv_pf_cache_clear();
 
   send_unit_info(NULL, punit);
   send_unit_info(NULL, ptrans);
@@ -3127,7 +3131,7 @@ static bool unit_move_consequences(struct unit *punit,
   if (tocity) { /* entering a city */
     if (tocity->owner == pplayer_end_pos) {
       if (tocity != homecity_end_pos && !pplayer_end_pos->ai_controlled) {
-        city_refresh(tocity);
+        city_refresh_partial(tocity, CD_UNITS);
         send_city_info(pplayer_end_pos, tocity);
       }
     }
@@ -3143,7 +3147,7 @@ static bool unit_move_consequences(struct unit *punit,
     if (fromcity != homecity_start_pos
         && fromcity->owner == pplayer_start_pos
         && !pplayer_start_pos->ai_controlled) {
-      city_refresh(fromcity);
+      city_refresh_partial(fromcity, CD_UNITS);
       send_city_info(pplayer_start_pos, fromcity);
     }
   }
@@ -3165,14 +3169,14 @@ static bool unit_move_consequences(struct unit *punit,
   }
 
   if (refresh_homecity_start_pos && !pplayer_start_pos->ai_controlled) {
-    city_refresh(homecity_start_pos);
+    city_refresh_partial(homecity_start_pos, CD_UNITS);
     send_city_info(pplayer_start_pos, homecity_start_pos);
   }
   if (refresh_homecity_end_pos
       && (!refresh_homecity_start_pos
           || homecity_start_pos != homecity_end_pos)
       && !pplayer_end_pos->ai_controlled) {
-    city_refresh(homecity_end_pos);
+    city_refresh_partial(homecity_end_pos, CD_UNITS);
     send_city_info(pplayer_end_pos, homecity_end_pos);
   }
 
@@ -3281,6 +3285,9 @@ bool unit_move(struct unit *punit, struct tile *pdesttile, int move_cost)
   unit_tile_set(punit, pdesttile);
   unit_list_prepend(pdesttile->units, punit);
 
+  /* The shared path-finding maps may be wrong now. */
+  adv_pf_cache_clear();
+
   /* Check unit activity. */
   check_unit_activity(punit);
   unit_did_action(punit);
@@ -3305,7 +3312,7 @@ bool unit_move(struct unit *punit, struct tile *pdesttile, int move_cost)
                get_unit_vision_at(punit, pdesttile, V_INVIS));
   new_vision = vision_new(unit_owner(punit), pdesttile);
   punit->server.vision = new_vision;
-  vision_change_sight(new_vision, radius_sq);
+  vision_move_sight(new_vision, radius_sq, old_vision);
   ASSERT_VISION(new_vision);
 
   /* Claim ownership of fortress? */
@@ -3457,7 +3464,7 @@ static void unit_move_transported(struct unit_list *units,
     }
 
     pcargo->server.vision = new_vision;
-    vision_change_sight(new_vision, radius_sq);
+    vision_move_sight(new_vision, radius_sq, old_vision);
     ASSERT_VISION(new_vision);
 
     /* Silently free orders since they won't be applicable anymore. */
@@ -0,0 +1,171 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+/**************************************************************************
+  Converts savegames between the text (ini) format and the binary format
+  of registry_bin.c. The conversion works on the section file, so the
+  result loads exactly as the original does.
+**************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/* utility */
+#include "fciconv.h"
+#include "fcintl.h"
+#include "ioz.h"
+#include "log.h"
+#include "mem.h"
+#include "registry.h"
+#include "shared.h"
+#include "support.h"
+
+/* common */
+#include "fc_cmdhelp.h"
+#include "version.h"
+
+/**************************************************************************
+  Returns the compression method of a text savegame, chosen from the
+  extension of its file name.
+**************************************************************************/
+static enum fz_method savconv_text_method(const char *filename)
+{
+  const char *ext = strrchr(filename, '.');
+
+  if (NULL == ext) {
+    return FZ_PLAIN;
+  }
+#ifdef HAVE_LIBZ
+  if (0 == strcmp(ext, ".gz")) {
+    return FZ_ZLIB;
+  }
+#endif /* HAVE_LIBZ */
+#ifdef HAVE_LIBBZ2
+  if (0 == strcmp(ext, ".bz2")) {
+    return FZ_BZIP2;
+  }
+#endif /* HAVE_LIBBZ2 */
+#ifdef HAVE_LIBLZMA
+  if (0 == strcmp(ext, ".xz")) {
+    return FZ_XZ;
+  }
+#endif /* HAVE_LIBLZMA */
+
+  return FZ_PLAIN;
+}
+
+/**************************************************************************
+  Entry point of the freeciv-savconv program
+**************************************************************************/
+int main(int argc, char *argv[])
+{
+  const char *files[2] = { NULL, NULL };
+  struct section_file *secfile;
+  char *option;
+  int num_files = 0;
+  int level = 6;
+  int inx;
+  bool binary, to_binary = FALSE, to_text = FALSE;
+  bool ok;
+
+  init_nls();
+  init_character_encodings(FC_DEFAULT_DATA_ENCODING, FALSE);
+  registry_module_init();
+  log_init(NULL, LOG_NORMAL, NULL, NULL, -1);
+
+  for (inx = 1; inx < argc; inx++) {
+    if (is_option("--help", argv[inx])) {
+      struct cmdhelp *help = cmdhelp_new(argv[0]);
+
+      cmdhelp_add(help, "b", "binary",
+                  _("Write the binary format (default for a text input)"));
+      cmdhelp_add(help, "c",
+                  /* TRANS: "compress" is exactly what user must type, do not translate. */
+                  _("compress LEVEL"),
+                  _("Compression level of the output, 0 to 9 (default 6). "
+                    "A text output is compressed according to the "
+                    "extension of its name (.gz, .bz2 or .xz)"));
+      cmdhelp_add(help, "h", "help",
+                  _("Print a summary of the options"));
+      cmdhelp_add(help, "t", "text",
+                  _("Write the text format (default for a binary input)"));
+      cmdhelp_add(help, "v", "version",
+                  _("Print the version number"));
+
+      /* The function below prints a header and footer for the options.
+       * Furthermore, the options are sorted. */
+      cmdhelp_display(help, TRUE, FALSE, TRUE);
+      cmdhelp_destroy(help);
+      fc_fprintf(stderr, _("The input file and the output file follow "
+                           "the options.\n"));
+
+      exit(EXIT_SUCCESS);
+    } else if (is_option("--version", argv[inx])) {
+      fc_fprintf(stderr, "%s \n", freeciv_name_version());
+      exit(EXIT_SUCCESS);
+    } else if (is_option("--binary", argv[inx])) {
+      to_binary = TRUE;
+    } else if (is_option("--text", argv[inx])) {
+      to_text = TRUE;
+    } else if ((option = get_option_malloc("--compress", argv, &inx,
+                                           argc))) {
+      if (!str_to_int(option, &level) || level < 0 || level > 9) {
+        fc_fprintf(stderr, _("Invalid compression level \"%s\".\n"),
+                   option);
+        exit(EXIT_FAILURE);
+      }
+      free(option);
+    } else if ('-' != argv[inx][0]
+               && num_files < (int) ARRAY_SIZE(files)) {
+      files[num_files++] = argv[inx];
+    } else {
+      fc_fprintf(stderr, _("Unrecognized option: \"%s\"\n"), argv[inx]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (2 != num_files || (to_binary && to_text)) {
+    fc_fprintf(stderr, _("Usage: %s [option ...] INPUT OUTPUT\n"), argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  binary = binfile_is_binary(files[0]);
+  secfile = secfile_load(files[0], TRUE);
+  if (NULL == secfile) {
+    log_error(_("Could not load %s: %s"), files[0], secfile_error());
+    exit(EXIT_FAILURE);
+  }
+
+  if (to_binary || (!to_text && !binary)) {
+    ok = binfile_save(secfile, files[1], level);
+  } else {
+    enum fz_method method = savconv_text_method(files[1]);
+
+    ok = secfile_save(secfile, files[1], FZ_PLAIN == method ? 0 : level,
+                      method);
+  }
+  secfile_destroy(secfile);
+
+  if (!ok) {
+    log_error(_("Could not save %s: %s"), files[1], secfile_error());
+  }
+
+  log_close();
+  registry_module_close();
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,189 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+/***********************************************************************
+  Arena (bump pointer) allocator.
+
+  Memory is taken from big blocks by moving a pointer forward. There is
+  no way to free a single allocation: everything goes at once with
+  arena_destroy(). This suits data built in bulk and freed in bulk,
+  like the entries of a loaded section file, where it saves one malloc()
+  and one free() per object, and their overhead.
+***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+#include <stddef.h>             /* offsetof() */
+#include <string.h>
+
+/* utility */
+#include "log.h"                /* fc_assert. */
+#include "mem.h"
+#include "shared.h"             /* MAX() */
+
+#include "arena.h"
+
+/* Alignment of the memory returned by arena_alloc(). */
+union arena_align {
+  void *ptr;
+  long l;
+  double d;
+};
+#define ARENA_ALIGN sizeof(union arena_align)
+
+struct arena_block {
+  struct arena_block *next;
+  union arena_align data[1];    /* Really of the block size. */
+};
+
+#define ARENA_BLOCK_HEADER offsetof(struct arena_block, data)
+
+struct arena {
+  struct arena_block *blocks;   /* Most recent first. */
+  char *pos;                    /* Free space of the current block. */
+  char *end;
+  size_t block_size;
+  size_t size;                  /* Total of the allocations. */
+};
+
+/**********************************************************************
+  Create a new arena. Memory is allocated in blocks of 'block_size'
+  bytes; bigger requests get a block of their own.
+***********************************************************************/
+struct arena *arena_new(size_t block_size)
+{
+  struct arena *parena = fc_malloc(sizeof(*parena));
+
+  parena->blocks = NULL;
+  parena->pos = NULL;
+  parena->end = NULL;
+  parena->block_size = MAX(block_size, 16 * ARENA_ALIGN);
+  parena->size = 0;
+
+  return parena;
+}
+
+/**********************************************************************
+  Free the arena and everything allocated from it.
+***********************************************************************/
+void arena_destroy(struct arena *parena)
+{
+  struct arena_block *pblock, *pnext;
+
+  fc_assert_ret(NULL != parena);
+
+  for (pblock = parena->blocks; NULL != pblock; pblock = pnext) {
+    pnext = pblock->next;
+    free(pblock);
+  }
+  free(parena);
+}
+
+/**********************************************************************
+  Allocate 'size' bytes which don't need any alignment.
+***********************************************************************/
+static void *arena_alloc_bytes(struct arena *parena, size_t size)
+{
+  struct arena_block *pblock;
+  char *ptr;
+
+  if (size <= (size_t) (parena->end - parena->pos)) {
+    ptr = parena->pos;
+    parena->pos += size;
+    parena->size += size;
+    return ptr;
+  }
+
+  if (size > parena->block_size / 4) {
+    /* Own block, behind the current one, so that the free space of the
+     * current block remains usable. */
+    pblock = fc_malloc(ARENA_BLOCK_HEADER + size);
+    if (NULL != parena->blocks) {
+      pblock->next = parena->blocks->next;
+      parena->blocks->next = pblock;
+    } else {
+      pblock->next = NULL;
+      parena->blocks = pblock;
+    }
+    parena->size += size;
+    return pblock->data;
+  }
+
+  pblock = fc_malloc(ARENA_BLOCK_HEADER + parena->block_size);
+  pblock->next = parena->blocks;
+  parena->blocks = pblock;
+  parena->pos = (char *) pblock->data + size;
+  parena->end = (char *) pblock->data + parena->block_size;
+  parena->size += size;
+
+  return pblock->data;
+}
+
+/**********************************************************************
+  Allocate 'size' bytes from the arena, aligned for any type.
+***********************************************************************/
+void *arena_alloc(struct arena *parena, size_t size)
+{
+  size_t skip;
+
+  fc_assert_ret_val(NULL != parena, NULL);
+
+  skip = (size_t) parena->pos % ARENA_ALIGN;
+  if (0 != skip) {
+    skip = ARENA_ALIGN - skip;
+    if (skip <= (size_t) (parena->end - parena->pos)) {
+      parena->pos += skip;
+    } else {
+      parena->pos = parena->end;
+    }
+  }
+
+  return arena_alloc_bytes(parena, MAX(size, 1));
+}
+
+/**********************************************************************
+  Copy the 'len' first bytes of 'str' in the arena, with a terminating
+  nul.
+***********************************************************************/
+char *arena_strndup(struct arena *parena, const char *str, size_t len)
+{
+  char *copy;
+
+  fc_assert_ret_val(NULL != parena, NULL);
+
+  copy = arena_alloc_bytes(parena, len + 1);
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+/**********************************************************************
+  Copy a string in the arena.
+***********************************************************************/
+char *arena_strdup(struct arena *parena, const char *str)
+{
+  return arena_strndup(parena, str, strlen(str));
+}
+
+/**********************************************************************
+  Returns the number of bytes allocated from the arena.
+***********************************************************************/
+size_t arena_size(const struct arena *parena)
+{
+  fc_assert_ret_val(NULL != parena, 0);
+
+  return parena->size;
+}
@@ -0,0 +1,43 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+#ifndef FC__ARENA_H
+#define FC__ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>             /* size_t */
+
+/* utility */
+#include "support.h"            /* fc__warn_unused_result */
+
+struct arena;
+
+struct arena *arena_new(size_t block_size) fc__warn_unused_result;
+void arena_destroy(struct arena *parena);
+
+void *arena_alloc(struct arena *parena, size_t size)
+     fc__warn_unused_result;
+char *arena_strdup(struct arena *parena, const char *str)
+     fc__warn_unused_result;
+char *arena_strndup(struct arena *parena, const char *str, size_t len)
+     fc__warn_unused_result;
+
+size_t arena_size(const struct arena *parena);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FC__ARENA_H */
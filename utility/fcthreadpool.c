@@ -0,0 +1,202 @@
+/********************************************************************** 
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+/* utility */
+#include "fcthread.h"
+#include "log.h"
+#include "mem.h"
+#include "shared.h"
+#include "support.h"
+
+#include "fcthreadpool.h"
+
+struct fc_threadpool {
+  int threads_num;
+  fc_thread *threads;
+
+  fc_mutex mutex;               /* Protects all the fields below. */
+  fc_thread_cond work_cond;     /* Jobs are available, or 'quit' is set. */
+  fc_thread_cond done_cond;     /* The last job of the batch is done. */
+  bool quit;
+
+  /* The current batch. */
+  fc_threadpool_job_fn_t job;
+  void *data;
+  int jobs_num;
+  int jobs_next;                /* Next job to take. */
+  int jobs_done;
+};
+
+/**********************************************************************
+  Take and run the jobs of the current batch until there is none left.
+  Must be called with the mutex locked, which is released while the
+  jobs are running.
+***********************************************************************/
+static void fc_threadpool_take_jobs(struct fc_threadpool *pool)
+{
+  while (pool->jobs_next < pool->jobs_num) {
+    int index = pool->jobs_next++;
+
+    fc_release_mutex(&pool->mutex);
+    pool->job(index, pool->data);
+    fc_allocate_mutex(&pool->mutex);
+
+    if (++pool->jobs_done == pool->jobs_num) {
+      fc_thread_cond_signal(&pool->done_cond);
+    }
+  }
+}
+
+/**********************************************************************
+  Main function of the worker threads.
+***********************************************************************/
+static void fc_threadpool_worker(void *arg)
+{
+  struct fc_threadpool *pool = (struct fc_threadpool *) arg;
+
+  fc_allocate_mutex(&pool->mutex);
+  while (TRUE) {
+    while (!pool->quit && pool->jobs_next >= pool->jobs_num) {
+      fc_thread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    if (pool->quit) {
+      break;
+    }
+    fc_threadpool_take_jobs(pool);
+  }
+  fc_release_mutex(&pool->mutex);
+}
+
+/**********************************************************************
+  Create a pool of 'threads_num' worker threads. The thread calling
+  fc_threadpool_run() works too, so 'threads_num' is the number of
+  extra threads. With 0 (or when the platform lacks the thread
+  conditions), the jobs are simply run in the calling thread.
+***********************************************************************/
+struct fc_threadpool *fc_threadpool_new(int threads_num)
+{
+  struct fc_threadpool *pool = fc_malloc(sizeof(*pool));
+  int i;
+
+  if (0 > threads_num || !has_thread_cond_impl()) {
+    threads_num = 0;
+  }
+
+  pool->threads = (0 < threads_num
+                   ? fc_malloc(threads_num * sizeof(*pool->threads))
+                   : NULL);
+  pool->threads_num = 0;
+  fc_init_mutex(&pool->mutex);
+  fc_thread_cond_init(&pool->work_cond);
+  fc_thread_cond_init(&pool->done_cond);
+  pool->quit = FALSE;
+  pool->job = NULL;
+  pool->data = NULL;
+  pool->jobs_num = 0;
+  pool->jobs_next = 0;
+  pool->jobs_done = 0;
+
+  for (i = 0; i < threads_num; i++) {
+    if (0 != fc_thread_start(&pool->threads[pool->threads_num],
+                             fc_threadpool_worker, pool)) {
+      log_error("Could only start %d worker threads out of %d.",
+                pool->threads_num, threads_num);
+      break;
+    }
+    pool->threads_num++;
+  }
+
+  return pool;
+}
+
+/**********************************************************************
+  Stop the worker threads and free the pool.
+***********************************************************************/
+void fc_threadpool_destroy(struct fc_threadpool *pool)
+{
+  int i;
+
+  fc_assert_ret(NULL != pool);
+
+  fc_allocate_mutex(&pool->mutex);
+  pool->quit = TRUE;
+  for (i = 0; i < pool->threads_num; i++) {
+    fc_thread_cond_signal(&pool->work_cond);
+  }
+  fc_release_mutex(&pool->mutex);
+
+  for (i = 0; i < pool->threads_num; i++) {
+    fc_thread_wait(&pool->threads[i]);
+  }
+
+  fc_thread_cond_destroy(&pool->done_cond);
+  fc_thread_cond_destroy(&pool->work_cond);
+  fc_destroy_mutex(&pool->mutex);
+  if (NULL != pool->threads) {
+    free(pool->threads);
+  }
+  free(pool);
+}
+
+/**********************************************************************
+  Returns the number of worker threads of the pool.
+***********************************************************************/
+int fc_threadpool_size(const struct fc_threadpool *pool)
+{
+  return (NULL != pool ? pool->threads_num : 0);
+}
+
+/**********************************************************************
+  Call job(index, data) for every index from 0 to 'jobs_num' - 1, in
+  any order and possibly at the same time, and wait for all of them
+  to be done. Must not be called from a job.
+***********************************************************************/
+void fc_threadpool_run(struct fc_threadpool *pool, int jobs_num,
+                       fc_threadpool_job_fn_t job, void *data)
+{
+  int i;
+
+  if (NULL == pool || 0 == pool->threads_num || 1 >= jobs_num) {
+    for (i = 0; i < jobs_num; i++) {
+      job(i, data);
+    }
+    return;
+  }
+
+  fc_allocate_mutex(&pool->mutex);
+  fc_assert(pool->jobs_next >= pool->jobs_num);
+  pool->job = job;
+  pool->data = data;
+  pool->jobs_num = jobs_num;
+  pool->jobs_next = 0;
+  pool->jobs_done = 0;
+  for (i = 0; i < MIN(pool->threads_num, jobs_num - 1); i++) {
+    fc_thread_cond_signal(&pool->work_cond);
+  }
+
+  fc_threadpool_take_jobs(pool);
+  while (pool->jobs_done < pool->jobs_num) {
+    fc_thread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+
+  pool->job = NULL;
+  pool->data = NULL;
+  pool->jobs_num = 0;
+  pool->jobs_next = 0;
+  pool->jobs_done = 0;
+  fc_release_mutex(&pool->mutex);
+}
@@ -0,0 +1,43 @@
+/********************************************************************** 
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+#ifndef FC__FCTHREADPOOL_H
+#define FC__FCTHREADPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "support.h" /* fc__warn_unused_result */
+
+/* A pool of worker threads, running batches of independent jobs. The
+ * jobs must only read the shared data, or write to data no other job
+ * uses. A pool with no worker (or a NULL pool) runs the jobs in the
+ * calling thread. */
+struct fc_threadpool;
+
+typedef void (*fc_threadpool_job_fn_t) (int index, void *data);
+
+struct fc_threadpool *fc_threadpool_new(int threads_num)
+                      fc__warn_unused_result;
+void fc_threadpool_destroy(struct fc_threadpool *pool);
+int fc_threadpool_size(const struct fc_threadpool *pool);
+
+void fc_threadpool_run(struct fc_threadpool *pool, int jobs_num,
+                       fc_threadpool_job_fn_t job, void *data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FC__FCTHREADPOOL_H */
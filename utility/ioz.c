@@ -25,6 +25,11 @@
   - Flexibility to add other methods if desired (eg, bzip2, arbitrary
     external filter program, etc).
 
+  Compressed files are written in independent blocks: gzip members,
+  bzip2 streams or xz streams, which concatenated are still a valid
+  file of the format. The blocks are compressed by a few worker threads
+  while the caller goes on formatting the next one.
+
   FIXME: when zlib support _not_ included, should sanity check whether
   the first few bytes are gzip marker and complain if so.
 **********************************************************************/
@@ -37,6 +42,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>             /* sysconf() */
+#endif
 
 #ifdef HAVE_LIBZ
 #include <zlib.h>
@@ -51,6 +59,7 @@
 #endif
 
 /* utility */
+#include "fcthread.h"
 #include "log.h"
 #include "mem.h"
 #include "shared.h"
@@ -103,10 +112,62 @@ struct xz_struct {
   bool hack_byte_used;
 };
 
-static bool xz_outbuffer_to_file(fz_FILE *fp, lzma_action action);
-
 #endif /* HAVE_LIBLZMA */
 
+/* Uncompressed size of the blocks of a gzip or xz file. bzip2 uses its
+ * own block size, 100k times the compression level. */
+#define FZ_BLOCK_SIZE (512 * 1024)
+
+/* Most blocks compressed at the same time. */
+#define FZ_MAX_WORKERS 8
+#define FZ_MAX_PENDING (2 * FZ_MAX_WORKERS)
+
+/* Longest output of a single fz_fprintf(). */
+#define FZ_MAX_PRINTF (16 * 1024 * 1024)
+
+/* One block of a compressed file being written. */
+struct fz_block {
+  unsigned char *data;          /* Uncompressed. */
+  size_t size;
+  unsigned char *out;           /* Compressed. */
+  size_t out_size;
+  bool error;
+  bool done;                    /* Protected by the writer mutex. */
+};
+
+/* Writing of a compressed file. */
+struct fz_writer {
+  FILE *plain;
+  enum fz_method method;
+  int level;
+  size_t block_size;
+
+  /* The block being filled. */
+  unsigned char *buf;
+  size_t used;
+  bool any_block;
+
+  /* Queued blocks, by sequence number. Blocks from 'next_write' to
+   * 'next_queue' are in the queue; those from 'next_claim' on are not
+   * taken by a worker yet. Protected by the mutex. */
+  struct fz_block blocks[FZ_MAX_PENDING];
+  int next_write;
+  int next_claim;
+  int next_queue;
+  int max_pending;
+
+  fc_thread threads[FZ_MAX_WORKERS];
+  int num_threads;
+  int max_threads;
+  bool quit;
+  fc_mutex mutex;
+  fc_thread_cond work_cond;     /* A block was queued, or quit. */
+  fc_thread_cond done_cond;     /* A block was compressed. */
+
+  bool error;
+  char errmsg[128];
+};
+
 struct mem_fzFILE {
   bool control;
   char *buffer;
@@ -118,6 +179,7 @@ struct fz_FILE_s {
   enum fz_method method;
   char mode;
   bool memory;
+  struct fz_writer *writer;     /* Compressed file being written. */
   union {
     struct mem_fzFILE mem;
     FILE *plain;		/* FZ_PLAIN */
@@ -161,6 +223,381 @@ static inline bool fz_method_is_valid(enum fz_method method)
                       method), FZ_PLAIN))
 
 
+#ifdef HAVE_LIBBZ2
+/***************************************************************
+  At the end of a bzip2 stream, start reading the next stream of
+  the file, if any. Files written in blocks consist of several
+  streams. Returns TRUE if there is a next stream.
+***************************************************************/
+static bool bz2_next_stream(fz_FILE *fp)
+{
+  char unused[BZ_MAX_UNUSED];
+  void *unused_ptr;
+  int num_unused;
+  int tmp_err;
+
+  BZ2_bzReadGetUnused(&tmp_err, fp->u.bz2.file, &unused_ptr, &num_unused);
+  if (BZ_OK != tmp_err) {
+    return FALSE;
+  }
+  memcpy(unused, unused_ptr, num_unused);
+
+  if (0 == num_unused) {
+    int c = fgetc(fp->u.bz2.plain);
+
+    if (EOF == c) {
+      return FALSE;
+    }
+    ungetc(c, fp->u.bz2.plain);
+  }
+
+  BZ2_bzReadClose(&tmp_err, fp->u.bz2.file);
+  fp->u.bz2.file = BZ2_bzReadOpen(&fp->u.bz2.error, fp->u.bz2.plain, 0, 0,
+                                  unused, num_unused);
+
+  return NULL != fp->u.bz2.file && BZ_OK == fp->u.bz2.error;
+}
+
+/***************************************************************
+  Read one byte of a bzip2 file, going on with the next stream
+  at the end of one. Returns the number of bytes read.
+***************************************************************/
+static int bz2_read_byte(fz_FILE *fp, char *dest)
+{
+  int len;
+
+  do {
+    len = BZ2_bzRead(&fp->u.bz2.error, fp->u.bz2.file, dest, 1);
+  } while (BZ_STREAM_END == fp->u.bz2.error && bz2_next_stream(fp)
+           && 0 == len);
+
+  return len;
+}
+#endif /* HAVE_LIBBZ2 */
+
+/***************************************************************
+  Compress the block independently of the others. This runs in
+  the worker threads.
+***************************************************************/
+static void fz_block_compress(const struct fz_writer *writer,
+                              struct fz_block *blk)
+{
+  int level = CLIP(1, writer->level, 9);
+
+  blk->out = NULL;
+  blk->out_size = 0;
+  blk->error = TRUE;
+
+  switch (writer->method) {
+#ifdef HAVE_LIBZ
+  case FZ_ZLIB:
+    {
+      z_stream zs;
+      uLong bound;
+
+      memset(&zs, 0, sizeof(zs));
+      /* 16 added to the window bits gives a gzip header and trailer. */
+      if (Z_OK != deflateInit2(&zs, level, Z_DEFLATED, MAX_WBITS + 16, 8,
+                               Z_DEFAULT_STRATEGY)) {
+        return;
+      }
+      bound = deflateBound(&zs, blk->size) + 32;
+      blk->out = fc_malloc(bound);
+      zs.next_in = blk->data;
+      zs.avail_in = blk->size;
+      zs.next_out = blk->out;
+      zs.avail_out = bound;
+      blk->error = (Z_STREAM_END != deflate(&zs, Z_FINISH));
+      blk->out_size = zs.total_out;
+      deflateEnd(&zs);
+    }
+    return;
+#endif /* HAVE_LIBZ */
+#ifdef HAVE_LIBBZ2
+  case FZ_BZIP2:
+    {
+      unsigned int len = blk->size + blk->size / 100 + 600;
+
+      blk->out = fc_malloc(len);
+      blk->error = (BZ_OK != BZ2_bzBuffToBuffCompress((char *) blk->out,
+                                                      &len,
+                                                      (char *) blk->data,
+                                                      blk->size, level,
+                                                      0, 0));
+      blk->out_size = len;
+    }
+    return;
+#endif /* HAVE_LIBBZ2 */
+#ifdef HAVE_LIBLZMA
+  case FZ_XZ:
+    {
+      lzma_options_lzma options;
+      lzma_filter filters[2];
+      size_t len = lzma_stream_buffer_bound(blk->size);
+      size_t pos = 0;
+
+      if (lzma_lzma_preset(&options, level)) {
+        return;
+      }
+      /* A dictionary larger than the block would only waste memory,
+       * once per worker. */
+      options.dict_size = MAX(LZMA_DICT_SIZE_MIN,
+                              MIN(options.dict_size, writer->block_size));
+      filters[0].id = LZMA_FILTER_LZMA2;
+      filters[0].options = &options;
+      filters[1].id = LZMA_VLI_UNKNOWN;
+
+      blk->out = fc_malloc(len);
+      blk->error = (LZMA_OK
+                    != lzma_stream_buffer_encode(filters, LZMA_CHECK_CRC32,
+                                                 NULL, blk->data, blk->size,
+                                                 blk->out, &pos, len));
+      blk->out_size = pos;
+    }
+    return;
+#endif /* HAVE_LIBLZMA */
+  case FZ_PLAIN:
+    break;
+  }
+
+  fc_assert_msg(FALSE, "Internal error in %s() (method = %d)",
+                __FUNCTION__, writer->method);
+}
+
+/***************************************************************
+  Worker thread of a writer: compress the queued blocks until
+  the writer is closed.
+***************************************************************/
+static void fz_writer_thread(void *arg)
+{
+  struct fz_writer *writer = (struct fz_writer *) arg;
+
+  fc_allocate_mutex(&writer->mutex);
+  for (;;) {
+    if (writer->next_claim < writer->next_queue) {
+      struct fz_block *blk =
+        writer->blocks + writer->next_claim++ % FZ_MAX_PENDING;
+
+      fc_release_mutex(&writer->mutex);
+      fz_block_compress(writer, blk);
+      fc_allocate_mutex(&writer->mutex);
+      blk->done = TRUE;
+      fc_thread_cond_signal(&writer->done_cond);
+    } else if (writer->quit) {
+      break;
+    } else {
+      fc_thread_cond_wait(&writer->work_cond, &writer->mutex);
+    }
+  }
+  fc_release_mutex(&writer->mutex);
+}
+
+/***************************************************************
+  Write the compressed block to the file and free it.
+***************************************************************/
+static void fz_block_write(struct fz_writer *writer, struct fz_block *blk)
+{
+  if (writer->error) {
+    /* Nothing more is written after an error. */
+  } else if (blk->error) {
+    writer->error = TRUE;
+    fc_snprintf(writer->errmsg, sizeof(writer->errmsg),
+                "Compression of a %lu bytes block failed",
+                (unsigned long) blk->size);
+  } else if (blk->out_size != fwrite(blk->out, 1, blk->out_size,
+                                     writer->plain)) {
+    writer->error = TRUE;
+    sz_strlcpy(writer->errmsg, fc_strerror(fc_get_errno()));
+  }
+
+  free(blk->data);
+  free(blk->out);
+  blk->data = blk->out = NULL;
+}
+
+/***************************************************************
+  Write the compressed blocks in order until at most
+  'max_pending' blocks are left in the queue. While waiting, the
+  caller compresses blocks no worker took yet itself.
+***************************************************************/
+static void fz_writer_flush(struct fz_writer *writer, int max_pending)
+{
+  fc_allocate_mutex(&writer->mutex);
+  while (writer->next_write < writer->next_queue) {
+    struct fz_block *blk =
+      writer->blocks + writer->next_write % FZ_MAX_PENDING;
+
+    if (blk->done) {
+      writer->next_write++;
+      fc_release_mutex(&writer->mutex);
+      fz_block_write(writer, blk);
+      fc_allocate_mutex(&writer->mutex);
+    } else if (writer->next_queue - writer->next_write <= max_pending) {
+      break;
+    } else if (writer->next_claim < writer->next_queue) {
+      struct fz_block *own =
+        writer->blocks + writer->next_claim++ % FZ_MAX_PENDING;
+
+      fc_release_mutex(&writer->mutex);
+      fz_block_compress(writer, own);
+      fc_allocate_mutex(&writer->mutex);
+      own->done = TRUE;
+    } else {
+      fc_thread_cond_wait(&writer->done_cond, &writer->mutex);
+    }
+  }
+  fc_release_mutex(&writer->mutex);
+}
+
+/***************************************************************
+  Queue the block being filled for compression. Unless it is the
+  'last' one, start a new block.
+***************************************************************/
+static void fz_writer_submit(struct fz_writer *writer, bool last)
+{
+  struct fz_block *blk;
+
+  /* Make room in the queue. */
+  fz_writer_flush(writer, writer->max_pending - 1);
+
+  fc_allocate_mutex(&writer->mutex);
+  blk = writer->blocks + writer->next_queue % FZ_MAX_PENDING;
+  blk->data = writer->buf;
+  blk->size = writer->used;
+  blk->out = NULL;
+  blk->done = FALSE;
+  writer->next_queue++;
+
+  /* Start the workers as they are needed, so that files of a single
+   * block are compressed by the caller alone. */
+  if (!last && writer->num_threads < writer->max_threads
+      && writer->num_threads < writer->next_queue - writer->next_claim) {
+    if (0 == fc_thread_start(writer->threads + writer->num_threads,
+                             fz_writer_thread, writer)) {
+      writer->num_threads++;
+    } else {
+      writer->max_threads = writer->num_threads;
+    }
+  }
+  fc_thread_cond_signal(&writer->work_cond);
+  fc_release_mutex(&writer->mutex);
+
+  writer->buf = (last ? NULL : fc_malloc(writer->block_size));
+  writer->used = 0;
+  writer->any_block = TRUE;
+
+  /* Write what is ready, without waiting. */
+  fz_writer_flush(writer, writer->max_pending);
+}
+
+/***************************************************************
+  Append data to the file being written.
+***************************************************************/
+static void fz_writer_append(struct fz_writer *writer, const char *data,
+                             size_t len)
+{
+  while (len > 0) {
+    size_t part = MIN(len, writer->block_size - writer->used);
+
+    memcpy(writer->buf + writer->used, data, part);
+    writer->used += part;
+    data += part;
+    len -= part;
+    if (writer->used == writer->block_size) {
+      fz_writer_submit(writer, FALSE);
+    }
+  }
+}
+
+/***************************************************************
+  Setup the writer of a compressed file. Returns FALSE on error.
+***************************************************************/
+static bool fz_writer_open(fz_FILE *fp, const char *filename,
+                           int compress_level)
+{
+  struct fz_writer *writer;
+  FILE *plain = fc_fopen(filename, "wb");
+  int cpus = 1;
+
+  if (NULL == plain) {
+    return FALSE;
+  }
+
+#ifdef _SC_NPROCESSORS_ONLN
+  cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+  writer = fc_calloc(1, sizeof(*writer));
+  writer->plain = plain;
+  writer->method = fp->method;
+  writer->level = compress_level;
+#ifdef HAVE_LIBBZ2
+  if (FZ_BZIP2 == fp->method) {
+    /* About one bzip2 block each. */
+    writer->block_size = CLIP(1, compress_level, 9) * 100000;
+  } else
+#endif /* HAVE_LIBBZ2 */
+  {
+    writer->block_size = FZ_BLOCK_SIZE;
+  }
+  writer->buf = fc_malloc(writer->block_size);
+
+  /* The caller compresses blocks itself while waiting for the workers,
+   * so with a single cpu no worker is started. */
+  if (cpus > 1 && has_thread_cond_impl()) {
+    writer->max_threads = MIN(cpus, FZ_MAX_WORKERS);
+  }
+  writer->max_pending = MAX(1, 2 * writer->max_threads);
+  fc_init_mutex(&writer->mutex);
+  fc_thread_cond_init(&writer->work_cond);
+  fc_thread_cond_init(&writer->done_cond);
+
+  fp->writer = writer;
+
+  return TRUE;
+}
+
+/***************************************************************
+  Finish writing the compressed file and free the writer.
+  Returns 0 on success.
+***************************************************************/
+static int fz_writer_close(fz_FILE *fp)
+{
+  struct fz_writer *writer = fp->writer;
+  bool error;
+  int i;
+
+  /* Even an empty file gets a valid (empty) block. */
+  if (0 < writer->used || !writer->any_block) {
+    fz_writer_submit(writer, TRUE);
+  }
+  fz_writer_flush(writer, 0);
+
+  fc_allocate_mutex(&writer->mutex);
+  writer->quit = TRUE;
+  for (i = 0; i < writer->num_threads; i++) {
+    fc_thread_cond_signal(&writer->work_cond);
+  }
+  fc_release_mutex(&writer->mutex);
+  for (i = 0; i < writer->num_threads; i++) {
+    fc_thread_wait(writer->threads + i);
+  }
+
+  fc_thread_cond_destroy(&writer->work_cond);
+  fc_thread_cond_destroy(&writer->done_cond);
+  fc_destroy_mutex(&writer->mutex);
+
+  error = writer->error;
+  if (0 != fclose(writer->plain)) {
+    error = TRUE;
+  }
+  free(writer->buf);
+  free(writer);
+  free(fp);
+
+  return error ? 1 : 0;
+}
+
 /***************************************************************
   Open memory buffer for reading as fz_FILE.
   If control is TRUE, caller gives up control of the buffer
@@ -172,6 +609,7 @@ fz_FILE *fz_from_memory(char *buffer, int size, bool control)
 
   fp = (fz_FILE *)fc_malloc(sizeof(*fp));
   fp->memory = TRUE;
+  fp->writer = NULL;
   fp->u.mem.control = control;
   fp->u.mem.buffer = buffer;
   fp->u.mem.pos = 0;
@@ -201,11 +639,23 @@ fz_FILE *fz_from_file(const char *filename, const char *in_mode,
 
   fp = (fz_FILE *)fc_malloc(sizeof(*fp));
   fp->memory = FALSE;
+  fp->writer = NULL;
   sz_strlcpy(mode, in_mode);
 
   if (mode[0] == 'w') {
     /* Writing: */
     fp->mode = 'w';
+    if (0 >= compress_level) {
+      method = FZ_PLAIN;
+    }
+    fp->method = fz_method_validate(method);
+    if (FZ_PLAIN != fp->method) {
+      if (!fz_writer_open(fp, filename, compress_level)) {
+        free(fp);
+        return NULL;
+      }
+      return fp;
+    }
   } else {
 #if defined(HAVE_LIBBZ2) || defined(HAVE_LIBLZMA)
     char test_mode[4];
@@ -243,7 +693,7 @@ fz_FILE *fz_from_file(const char *filename, const char *in_mode,
        * and not what happened in error recovery. */
       int tmp_err;
 
-      read_len = BZ2_bzRead(&fp->u.bz2.error, fp->u.bz2.file, &tmp, 1);
+      read_len = bz2_read_byte(fp, &tmp);
       if (fp->u.bz2.error != BZ_DATA_ERROR_MAGIC) {
         /* bzip2 file */
         if (fp->u.bz2.error == BZ_STREAM_END) {
@@ -338,63 +788,10 @@ fz_FILE *fz_from_file(const char *filename, const char *in_mode,
   fp->method = fz_method_validate(method);
 
   switch (fp->method) {
-#ifdef HAVE_LIBLZMA
-  case FZ_XZ:
-    {
-      lzma_ret ret;
-
-      /*  xz files are binary files, so we should add "b" to mode! */
-      sz_strlcat(mode,"b");
-      memset(&fp->u.xz.stream, 0, sizeof(lzma_stream));
-      ret = lzma_easy_encoder(&fp->u.xz.stream, compress_level, LZMA_CHECK_CRC32);
-      fp->u.xz.error = ret;
-      if (ret != LZMA_OK) {
-        return NULL;
-      }
-      fp->u.xz.in_buf = fc_malloc(PLAIN_FILE_BUF_SIZE);
-      fp->u.xz.stream.next_in = fp->u.xz.in_buf;
-      fp->u.xz.out_buf = fc_malloc(PLAIN_FILE_BUF_SIZE);
-      fp->u.xz.stream.next_out = fp->u.xz.out_buf;
-      fp->u.xz.stream.avail_out = PLAIN_FILE_BUF_SIZE;
-      fp->u.xz.out_index = 0;
-      fp->u.xz.total_read = 0;
-      fp->u.xz.plain = fc_fopen(filename, mode);
-    }
-    return fp;
-#endif /* HAVE_LIBLZMA */
-#ifdef HAVE_LIBBZ2
-  case FZ_BZIP2:
-    /*  bz2 files are binary files, so we should add "b" to mode! */
-    sz_strlcat(mode,"b");
-    fp->u.bz2.plain = fc_fopen(filename, mode);
-    if (fp->u.bz2.plain) {
-      /*  Open for read handled earlier */
-      fc_assert_ret_val('w' == mode[0], NULL);
-      fp->u.bz2.file = BZ2_bzWriteOpen(&fp->u.bz2.error, fp->u.bz2.plain,
-                                       compress_level, 1, 15);
-      if (fp->u.bz2.error != BZ_OK) {
-        int tmp_err; /* See comments for similar variable
-                      * near BZ2_bzReadOpen() */
-        BZ2_bzWriteClose(&tmp_err, fp->u.bz2.file, 0, NULL, NULL);
-        fp->u.bz2.file = NULL;
-      }
-    }
-    if (!fp->u.bz2.file) {
-      if (fp->u.bz2.plain) {
-        fclose(fp->u.bz2.plain);
-      }
-      free(fp);
-      fp = NULL;
-    }
-    return fp;
-#endif /* HAVE_LIBBZ2 */
 #ifdef HAVE_LIBZ
   case FZ_ZLIB:
     /*  gz files are binary files, so we should add "b" to mode! */
     sz_strlcat(mode,"b");
-    if (mode[0] == 'w') {
-      cat_snprintf(mode, sizeof(mode), "%d", compress_level);
-    }
     fp->u.zlib = fc_gzopen(filename, mode);
     if (!fp->u.zlib) {
       free(fp);
@@ -402,6 +799,14 @@ fz_FILE *fz_from_file(const char *filename, const char *in_mode,
     }
     return fp;
 #endif /* HAVE_LIBZ */
+#ifdef HAVE_LIBBZ2
+  case FZ_BZIP2:
+#endif
+#ifdef HAVE_LIBLZMA
+  case FZ_XZ:
+#endif
+    /* Only reached when writing, which fz_writer_open() handles. */
+    break;
   case FZ_PLAIN:
     fp->u.plain = fc_fopen(filename, mode);
     if (!fp->u.plain) {
@@ -432,6 +837,7 @@ fz_FILE *fz_from_stream(FILE *stream)
   fp = fc_malloc(sizeof(*fp));
   fp->method = FZ_PLAIN;
   fp->memory = FALSE;
+  fp->writer = NULL;
   fp->u.plain = stream;
   return fp;
 }
@@ -459,12 +865,13 @@ int fz_fclose(fz_FILE *fp)
     return 0;
   }
 
+  if (NULL != fp->writer) {
+    return fz_writer_close(fp);
+  }
+
   switch (fz_method_validate(fp->method)) {
 #ifdef HAVE_LIBLZMA
   case FZ_XZ:
-    if (fp->mode == 'w' && !xz_outbuffer_to_file(fp, LZMA_FINISH)) {
-      error = 1;
-    }
     lzma_end(&fp->u.xz.stream);
     free(fp->u.xz.in_buf);
     free(fp->u.xz.out_buf);
@@ -473,11 +880,7 @@ int fz_fclose(fz_FILE *fp)
 #endif /* HAVE_LIBLZMA */
 #ifdef HAVE_LIBBZ2
   case FZ_BZIP2:
-    if ('w' == fp->mode) {
-      BZ2_bzWriteClose(&fp->u.bz2.error, fp->u.bz2.file, 0, NULL, NULL);
-    } else {
-      BZ2_bzReadClose(&fp->u.bz2.error, fp->u.bz2.file);
-    }
+    BZ2_bzReadClose(&fp->u.bz2.error, fp->u.bz2.file);
     error = fp->u.bz2.error;
     fclose(fp->u.bz2.plain);
     free(fp);
@@ -650,7 +1053,7 @@ char *fz_fgets(char *buffer, int size, fz_FILE *fp)
         i++;
       } else {
         if (!fp->u.bz2.eof) {
-          last_read = BZ2_bzRead(&fp->u.bz2.error, fp->u.bz2.file, buffer + i, 1);
+          last_read = bz2_read_byte(fp, buffer + i);
           i += last_read; /* 0 or 1 */
         }
       }
@@ -659,8 +1062,7 @@ char *fz_fgets(char *buffer, int size, fz_FILE *fp)
         for (; i < size - 1
                && fp->u.bz2.error == BZ_OK && buffer[i - 1] != '\n' ;
              i += last_read) {
-          last_read = BZ2_bzRead(&fp->u.bz2.error, fp->u.bz2.file,
-                                 buffer + i, 1);
+          last_read = bz2_read_byte(fp, buffer + i);
         }
         if (fp->u.bz2.error != BZ_OK &&
             (fp->u.bz2.error != BZ_STREAM_END ||
@@ -692,48 +1094,12 @@ char *fz_fgets(char *buffer, int size, fz_FILE *fp)
   return NULL;
 }
 
-#ifdef HAVE_LIBLZMA
-
-/***************************************************************
-  Helper function to do given compression action and writing
-  results from output buffer to file.
-***************************************************************/
-static bool xz_outbuffer_to_file(fz_FILE *fp, lzma_action action)
-{
-  do {
-    ssize_t len;
-    ssize_t total = 0;
-
-    fp->u.xz.error = lzma_code(&fp->u.xz.stream, action);
-
-    if (fp->u.xz.error != LZMA_OK && fp->u.xz.error != LZMA_STREAM_END) {
-      return FALSE;
-    }
-
-    while (total < PLAIN_FILE_BUF_SIZE - fp->u.xz.stream.avail_out) {
-      len = fwrite(fp->u.xz.out_buf, 1,
-                   PLAIN_FILE_BUF_SIZE - fp->u.xz.stream.avail_out - total,
-                   fp->u.xz.plain);
-      total += len;
-      if (len <= 0) {
-        return FALSE;
-      }
-    }
-    fp->u.xz.stream.avail_out = PLAIN_FILE_BUF_SIZE;
-    fp->u.xz.stream.next_out = fp->u.xz.out_buf;
-  } while (fp->u.xz.stream.avail_in > 0);
-
-  return TRUE;
-}
-#endif /* HAVE_LIBLZMA */
-
 /***************************************************************
   Print formated, like fprintf.
-  
-  Note: zlib doesn't have gzvfprintf, but thats ok because its
-  fprintf only does similar to what we do here (print to fixed
-  buffer), and in addition this way we get to use our safe
-  snprintf.
+
+  Compressed files are formatted directly into the block being
+  filled; only output that does not fit in a block needs a
+  temporary buffer.
 
   Returns number of (uncompressed) bytes actually written, or
   0 on error.
@@ -746,78 +1112,77 @@ int fz_fprintf(fz_FILE *fp, const char *format, ...)
   fc_assert_ret_val(NULL != fp, 0);
   fc_assert_ret_val(!fp->memory, 0);
 
-  switch (fz_method_validate(fp->method)) {
-#ifdef HAVE_LIBLZMA
-  case FZ_XZ:
-    {
-      int num;
+  if (NULL != fp->writer) {
+    struct fz_writer *writer = fp->writer;
+    char *buffer = NULL;
+    size_t size = writer->block_size;
 
+    for (;;) {
       va_start(ap, format);
-      num = fc_vsnprintf((char *)fp->u.xz.in_buf, PLAIN_FILE_BUF_SIZE, format, ap);
+      num = fc_vsnprintf((char *) writer->buf + writer->used,
+                         writer->block_size - writer->used, format, ap);
       va_end(ap);
-
-      if (num == -1) {
-        log_error("Too much data: truncated in fz_fprintf (%u)",
-                  PLAIN_FILE_BUF_SIZE);
-        num = PLAIN_FILE_BUF_SIZE;
+      if (0 <= num) {
+        writer->used += num;
+        if (writer->used + 1 >= writer->block_size) {
+          fz_writer_submit(writer, FALSE);
+        }
+        return num;
       }
-      fp->u.xz.stream.next_in = fp->u.xz.in_buf;
-      fp->u.xz.stream.avail_in = num;
-
-      if (!xz_outbuffer_to_file(fp, LZMA_RUN)) {
-        return 0;
-      } else {
-        return strlen((char *)fp->u.xz.in_buf);
+      if (0 == writer->used) {
+        break;
       }
+      fz_writer_submit(writer, FALSE);
     }
-    break;
-#endif /* HAVE_LIBLZMA */
-#ifdef HAVE_LIBBZ2
-  case FZ_BZIP2:
-    {
-      char buffer[65536];
 
+    /* Larger than a block. */
+    do {
+      size *= 2;
+      buffer = fc_realloc(buffer, size);
       va_start(ap, format);
-      num = fc_vsnprintf(buffer, sizeof(buffer), format, ap);
+      num = fc_vsnprintf(buffer, size, format, ap);
       va_end(ap);
-      if (num == -1) {
-        log_error("Too much data: truncated in fz_fprintf (%lu)",
-                  (unsigned long) sizeof(buffer));
-      }
-      BZ2_bzWrite(&fp->u.bz2.error, fp->u.bz2.file, buffer, strlen(buffer));
-      if (fp->u.bz2.error != BZ_OK) {
-        return 0;
-      } else {
-        return strlen(buffer);
-      }
+    } while (0 > num && size < FZ_MAX_PRINTF);
+    if (0 > num) {
+      log_error("Too much data: truncated in fz_fprintf (%lu)",
+                (unsigned long) size);
+      num = strlen(buffer);
     }
-#endif /* HAVE_LIBBZ2 */
-#ifdef HAVE_LIBZ
-  case FZ_ZLIB:
-    {
-      char buffer[65536];
+    fz_writer_append(writer, buffer, num);
+    free(buffer);
 
-      va_start(ap, format);
-      num = fc_vsnprintf(buffer, sizeof(buffer), format, ap);
-      va_end(ap);
-      if (num == -1) {
-        log_error("Too much data: truncated in fz_fprintf (%lu)",
-                  (unsigned long) sizeof(buffer));
-      }
-      return gzwrite(fp->u.zlib, buffer, (unsigned int)strlen(buffer));
-    }
-#endif /* HAVE_LIBZ */
-  case FZ_PLAIN:
-    va_start(ap, format);
-    num = vfprintf(fp->u.plain, format, ap);
-    va_end(ap);
     return num;
   }
 
-  /* Should never happen */
-  fc_assert_msg(FALSE, "Internal error in %s() (method = %d)",
-                __FUNCTION__, fp->method);
-  return 0;
+  fc_assert_ret_val(FZ_PLAIN == fp->method, 0);
+
+  va_start(ap, format);
+  num = vfprintf(fp->u.plain, format, ap);
+  va_end(ap);
+
+  return num;
+}
+
+/***************************************************************
+  Write a string, like fputs, but without formatting it.
+  Returns number of (uncompressed) bytes actually written, or
+  0 on error.
+***************************************************************/
+int fz_fputs(fz_FILE *fp, const char *str)
+{
+  size_t len = strlen(str);
+
+  fc_assert_ret_val(NULL != fp, 0);
+  fc_assert_ret_val(!fp->memory, 0);
+
+  if (NULL != fp->writer) {
+    fz_writer_append(fp->writer, str, len);
+    return len;
+  }
+
+  fc_assert_ret_val(FZ_PLAIN == fp->method, 0);
+
+  return EOF == fputs(str, fp->u.plain) ? 0 : len;
 }
 
 /***************************************************************
@@ -832,6 +1197,10 @@ int fz_ferror(fz_FILE *fp)
     return 0;
   }
 
+  if (NULL != fp->writer) {
+    return fp->writer->error ? 1 : 0;
+  }
+
   switch (fz_method_validate(fp->method)) {
 #ifdef HAVE_LIBLZMA
   case FZ_XZ:
@@ -881,6 +1250,10 @@ const char *fz_strerror(fz_FILE *fp)
   fc_assert_ret_val(NULL != fp, NULL);
   fc_assert_ret_val(!fp->memory, NULL);
 
+  if (NULL != fp->writer) {
+    return fp->writer->errmsg;
+  }
+
   switch (fz_method_validate(fp->method)) {
 #ifdef HAVE_LIBLZMA
   case FZ_XZ:
@@ -52,6 +52,7 @@ int fz_fclose(fz_FILE *fp);
 char *fz_fgets(char *buffer, int size, fz_FILE *fp);
 int fz_fprintf(fz_FILE *fp, const char *format, ...)
      fc__attribute((__format__ (__printf__, 2, 3)));
+int fz_fputs(fz_FILE *fp, const char *str);
 
 int fz_ferror(fz_FILE *fp);     
 const char *fz_strerror(fz_FILE *fp);
@@ -36,13 +36,22 @@
 #endif
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
 #endif 
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_SIGNAL_H
 #include <sys/signal.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef HAVE_WINSOCK
 #include <winsock.h>
 #endif
@@ -52,8 +61,10 @@
 
 /* utility */
 #include "fcintl.h"
+#include "genhash.h"
 #include "log.h"
 #include "mem.h"
+#include "shared.h"
 #include "support.h"
 
 #include "netintf.h"
@@ -134,6 +145,416 @@ int fc_select(int n, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
   return result;       
 }
 
+/***************************************************************
+  Returns which of the FC_POLL_* events are ready on the socket,
+  without waiting, or -1 on error. Unlike fc_select(), it works
+  whatever the socket number.
+***************************************************************/
+int fc_socket_ready(int sock, int events)
+{
+#ifdef HAVE_POLL_H
+  struct pollfd pfd;
+  int result, ready = 0;
+
+  pfd.fd = sock;
+  pfd.events = 0;
+  pfd.revents = 0;
+  if (events & FC_POLL_READ) {
+    pfd.events |= POLLIN;
+  }
+  if (events & FC_POLL_WRITE) {
+    pfd.events |= POLLOUT;
+  }
+  if (events & FC_POLL_EXCEPT) {
+    pfd.events |= POLLPRI;
+  }
+
+  result = poll(&pfd, 1, 0);
+  if (0 >= result) {
+    return result;
+  }
+
+  if (pfd.revents & POLLIN) {
+    ready |= FC_POLL_READ;
+  }
+  if (pfd.revents & POLLOUT) {
+    ready |= FC_POLL_WRITE;
+  }
+  if (pfd.revents & POLLPRI) {
+    ready |= FC_POLL_EXCEPT;
+  }
+  if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    /* Like select(), let the next read or write find the error. */
+    ready |= events & (FC_POLL_READ | FC_POLL_WRITE);
+  }
+
+  return ready;
+#else  /* HAVE_POLL_H */
+  fd_set readfs, writefs, exceptfs;
+  struct timeval tv;
+  int result, ready = 0;
+
+#ifndef HAVE_WINSOCK
+  if (sock >= FD_SETSIZE) {
+    errno = EBADF;
+    return -1;
+  }
+#endif /* HAVE_WINSOCK */
+
+  FC_FD_ZERO(&readfs);
+  FC_FD_ZERO(&writefs);
+  FC_FD_ZERO(&exceptfs);
+  if (events & FC_POLL_READ) {
+    FD_SET(sock, &readfs);
+  }
+  if (events & FC_POLL_WRITE) {
+    FD_SET(sock, &writefs);
+  }
+  if (events & FC_POLL_EXCEPT) {
+    FD_SET(sock, &exceptfs);
+  }
+
+  tv.tv_sec = 0;
+  tv.tv_usec = 0;
+  result = fc_select(sock + 1, &readfs, &writefs, &exceptfs, &tv);
+  if (0 >= result) {
+    return result;
+  }
+
+  if (FD_ISSET(sock, &readfs)) {
+    ready |= FC_POLL_READ;
+  }
+  if (FD_ISSET(sock, &writefs)) {
+    ready |= FC_POLL_WRITE;
+  }
+  if (FD_ISSET(sock, &exceptfs)) {
+    ready |= FC_POLL_EXCEPT;
+  }
+
+  return ready;
+#endif /* HAVE_POLL_H */
+}
+
+/* A socket watched by a poller. */
+struct fc_poll_entry {
+  int sock;
+  int events;
+  void *data;
+#ifdef HAVE_SYS_EPOLL_H
+  bool always_ready;            /* epoll doesn't watch regular files. */
+#endif
+};
+
+/* Watches a set of sockets. Uses epoll where available, and select()
+ * otherwise. Unlike with fc_select(), the set of sockets is kept from one
+ * wait to the next, so only the changes need to be told. */
+struct fc_poller {
+  struct genhash *entries;      /* Socket -> struct fc_poll_entry. */
+#ifdef HAVE_SYS_EPOLL_H
+  int epoll_fd;                 /* -1 if epoll is not usable. */
+  struct epoll_event *ready;
+  int ready_size;
+  int num_always_ready;
+#endif /* HAVE_SYS_EPOLL_H */
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+/***************************************************************
+  Returns the epoll events matching the poller events.
+***************************************************************/
+static uint32_t poll_events_to_epoll(int events)
+{
+  uint32_t epoll_events = 0;
+
+  if (events & FC_POLL_READ) {
+    epoll_events |= EPOLLIN;
+  }
+  if (events & FC_POLL_WRITE) {
+    epoll_events |= EPOLLOUT;
+  }
+  if (events & FC_POLL_EXCEPT) {
+    epoll_events |= EPOLLPRI;
+  }
+
+  return epoll_events;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+/***************************************************************
+  Create a new poller, watching no socket.
+***************************************************************/
+struct fc_poller *fc_poller_new(void)
+{
+  struct fc_poller *poller = fc_malloc(sizeof(*poller));
+
+  poller->entries = genhash_new_full(NULL, NULL, NULL, NULL, NULL, free);
+#ifdef HAVE_SYS_EPOLL_H
+  /* If the kernel doesn't support it, use select() instead. */
+  poller->epoll_fd = epoll_create(16);
+  poller->ready = NULL;
+  poller->ready_size = 0;
+  poller->num_always_ready = 0;
+#endif /* HAVE_SYS_EPOLL_H */
+
+  return poller;
+}
+
+/***************************************************************
+  Free a poller. The sockets are not closed.
+***************************************************************/
+void fc_poller_destroy(struct fc_poller *poller)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  if (-1 != poller->epoll_fd) {
+    close(poller->epoll_fd);
+  }
+  free(poller->ready);
+#endif /* HAVE_SYS_EPOLL_H */
+  genhash_destroy(poller->entries);
+  free(poller);
+}
+
+/***************************************************************
+  Start watching the socket for the events (bit field of
+  enum fc_poll_flag). 'data' is returned with its events by
+  fc_poller_wait(). Returns TRUE on success.
+***************************************************************/
+bool fc_poller_add(struct fc_poller *poller, int sock, int events,
+                   void *data)
+{
+  struct fc_poll_entry *pentry;
+
+  fc_assert_ret_val(!genhash_lookup(poller->entries, FC_INT_TO_PTR(sock),
+                                    NULL), FALSE);
+
+  pentry = fc_malloc(sizeof(*pentry));
+  pentry->sock = sock;
+  pentry->events = events;
+  pentry->data = data;
+
+#ifdef HAVE_SYS_EPOLL_H
+  pentry->always_ready = FALSE;
+  if (-1 != poller->epoll_fd) {
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = poll_events_to_epoll(events);
+    event.data.ptr = pentry;
+    if (-1 != epoll_ctl(poller->epoll_fd, EPOLL_CTL_ADD, sock, &event)) {
+      /* Watched. */
+    } else if (EPERM == errno) {
+      /* A regular file, as the standard input may be. Like select(), tell
+       * it is always ready. */
+      pentry->always_ready = TRUE;
+      poller->num_always_ready++;
+    } else {
+      log_error("epoll_ctl failed: %s", fc_strerror(fc_get_errno()));
+      free(pentry);
+      return FALSE;
+    }
+  } else
+#endif /* HAVE_SYS_EPOLL_H */
+  {
+#ifndef HAVE_WINSOCK
+    if (sock >= FD_SETSIZE) {
+      log_error("Socket %d is too big to be watched.", sock);
+      free(pentry);
+      return FALSE;
+    }
+#endif /* HAVE_WINSOCK */
+  }
+
+  genhash_insert(poller->entries, FC_INT_TO_PTR(sock), pentry);
+
+  return TRUE;
+}
+
+/***************************************************************
+  Change the events the socket is watched for. Returns TRUE on
+  success.
+***************************************************************/
+bool fc_poller_modify(struct fc_poller *poller, int sock, int events)
+{
+  struct fc_poll_entry *pentry;
+
+  fc_assert_ret_val(genhash_lookup(poller->entries, FC_INT_TO_PTR(sock),
+                                   (void **) &pentry), FALSE);
+
+  if (pentry->events == events) {
+    return TRUE;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (-1 != poller->epoll_fd && !pentry->always_ready) {
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = poll_events_to_epoll(events);
+    event.data.ptr = pentry;
+    if (-1 == epoll_ctl(poller->epoll_fd, EPOLL_CTL_MOD, sock, &event)) {
+      log_error("epoll_ctl failed: %s", fc_strerror(fc_get_errno()));
+      return FALSE;
+    }
+  }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  pentry->events = events;
+
+  return TRUE;
+}
+
+/***************************************************************
+  Stop watching the socket. Must be called before closing it.
+***************************************************************/
+void fc_poller_remove(struct fc_poller *poller, int sock)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  struct fc_poll_entry *pentry;
+
+  if (-1 != poller->epoll_fd
+      && genhash_lookup(poller->entries, FC_INT_TO_PTR(sock),
+                        (void **) &pentry)) {
+    if (pentry->always_ready) {
+      poller->num_always_ready--;
+    } else {
+      struct epoll_event event; /* Needed by old kernels. */
+
+      memset(&event, 0, sizeof(event));
+      epoll_ctl(poller->epoll_fd, EPOLL_CTL_DEL, sock, &event);
+    }
+  }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  genhash_remove(poller->entries, FC_INT_TO_PTR(sock));
+}
+
+/***************************************************************
+  Wait for at most 'timeout' (or forever if NULL) for some of the
+  watched sockets to be ready. Fills 'events' with up to
+  'max_events' ready sockets. Returns the number of them, 0 on
+  timeout, or -1 on error.
+***************************************************************/
+int fc_poller_wait(struct fc_poller *poller, struct fc_poll_event *events,
+                   int max_events, struct timeval *timeout)
+{
+  fd_set readfs, writefs, exceptfs;
+  int max_desc = -1;
+  int num = 0;
+  int result;
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (-1 != poller->epoll_fd) {
+    int i;
+
+    if (poller->ready_size < max_events) {
+      poller->ready = fc_realloc(poller->ready,
+                                 max_events * sizeof(*poller->ready));
+      poller->ready_size = max_events;
+    }
+
+    result = epoll_wait(poller->epoll_fd, poller->ready, max_events,
+                        (0 < poller->num_always_ready ? 0
+                         : NULL != timeout
+                         ? timeout->tv_sec * 1000 + timeout->tv_usec / 1000
+                         : -1));
+    if (0 > result) {
+      return result;
+    }
+    for (i = 0; i < result; i++) {
+      const struct fc_poll_entry *pentry = poller->ready[i].data.ptr;
+      uint32_t ready = poller->ready[i].events;
+
+      events[i].sock = pentry->sock;
+      events[i].data = pentry->data;
+      events[i].events = 0;
+      if (ready & EPOLLIN) {
+        events[i].events |= FC_POLL_READ;
+      }
+      if (ready & EPOLLOUT) {
+        events[i].events |= FC_POLL_WRITE;
+      }
+      if (ready & EPOLLPRI) {
+        events[i].events |= FC_POLL_EXCEPT;
+      }
+      if (ready & (EPOLLERR | EPOLLHUP)) {
+        /* Like select(), let the next read or write find the error. */
+        events[i].events |= pentry->events & (FC_POLL_READ | FC_POLL_WRITE);
+      }
+    }
+
+    if (0 < poller->num_always_ready) {
+      genhash_values_iterate(poller->entries, pentry) {
+        const struct fc_poll_entry *pe = pentry;
+
+        if (result >= max_events) {
+          break;
+        }
+        if (pe->always_ready
+            && 0 != (pe->events & (FC_POLL_READ | FC_POLL_WRITE))) {
+          events[result].sock = pe->sock;
+          events[result].events = pe->events & (FC_POLL_READ
+                                                | FC_POLL_WRITE);
+          events[result].data = pe->data;
+          result++;
+        }
+      } genhash_values_iterate_end;
+    }
+
+    return result;
+  }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  FC_FD_ZERO(&readfs);
+  FC_FD_ZERO(&writefs);
+  FC_FD_ZERO(&exceptfs);
+
+  genhash_values_iterate(poller->entries, pentry) {
+    const struct fc_poll_entry *pe = pentry;
+
+    if (pe->events & FC_POLL_READ) {
+      FD_SET(pe->sock, &readfs);
+    }
+    if (pe->events & FC_POLL_WRITE) {
+      FD_SET(pe->sock, &writefs);
+    }
+    if (pe->events & FC_POLL_EXCEPT) {
+      FD_SET(pe->sock, &exceptfs);
+    }
+    max_desc = MAX(pe->sock, max_desc);
+  } genhash_values_iterate_end;
+
+  result = fc_select(max_desc + 1, &readfs, &writefs, &exceptfs, timeout);
+  if (0 >= result) {
+    return result;
+  }
+
+  genhash_values_iterate(poller->entries, pentry) {
+    const struct fc_poll_entry *pe = pentry;
+    int ready = 0;
+
+    if (num >= max_events) {
+      break;
+    }
+    if (FD_ISSET(pe->sock, &readfs)) {
+      ready |= FC_POLL_READ;
+    }
+    if (FD_ISSET(pe->sock, &writefs)) {
+      ready |= FC_POLL_WRITE;
+    }
+    if (FD_ISSET(pe->sock, &exceptfs)) {
+      ready |= FC_POLL_EXCEPT;
+    }
+    if (0 != ready) {
+      events[num].sock = pe->sock;
+      events[num].events = ready;
+      events[num].data = pe->data;
+      num++;
+    }
+  } genhash_values_iterate_end;
+
+  return num;
+}
+
 /***************************************************************
   Read from a socket.
 ***************************************************************/
@@ -176,6 +597,56 @@ int fc_writesocket(int sock, const void *buf, size_t size)
   return result;
 }
 
+/***************************************************************
+  Write the parts of data described by 'iov' to the socket, in
+  one system call where possible. At most FC_MAX_IOVEC parts
+  are written. Returns the number of bytes written, or -1 on
+  error, like fc_writesocket().
+***************************************************************/
+int fc_writevsocket(int sock, const struct fc_iovec *iov, int iovcnt)
+{
+#if defined(HAVE_SYS_UIO_H) && !defined(HAVE_WINSOCK)
+  struct iovec vec[FC_MAX_IOVEC];
+  int i;
+
+  iovcnt = MIN(iovcnt, FC_MAX_IOVEC);
+  for (i = 0; i < iovcnt; i++) {
+    vec[i].iov_base = (void *) iov[i].base;
+    vec[i].iov_len = iov[i].len;
+  }
+
+#  ifdef MSG_NOSIGNAL
+  {
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
+    return sendmsg(sock, &msg, MSG_NOSIGNAL);
+  }
+#  else  /* MSG_NOSIGNAL */
+  return writev(sock, vec, iovcnt);
+#  endif /* MSG_NOSIGNAL */
+#else  /* HAVE_SYS_UIO_H && !HAVE_WINSOCK */
+  int result = 0;
+  int i;
+
+  for (i = 0; i < MIN(iovcnt, FC_MAX_IOVEC); i++) {
+    int nput = fc_writesocket(sock, iov[i].base, iov[i].len);
+
+    if (-1 == nput) {
+      return (0 < result ? result : -1);
+    }
+    result += nput;
+    if (nput < iov[i].len) {
+      break;
+    }
+  }
+
+  return result;
+#endif /* HAVE_SYS_UIO_H && !HAVE_WINSOCK */
+}
+
 /***************************************************************
   Close a socket.
 ***************************************************************/
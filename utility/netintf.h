@@ -113,11 +113,47 @@ enum fc_addr_family {
   FC_ADDR_ANY
 };
 
+/* Events a socket is watched for by a poller, see fc_poller_new(). */
+enum fc_poll_flag {
+  FC_POLL_READ = (1 << 0),
+  FC_POLL_WRITE = (1 << 1),
+  FC_POLL_EXCEPT = (1 << 2)
+};
+
+struct fc_poll_event {
+  int sock;
+  int events;                   /* Bit field of enum fc_poll_flag. */
+  void *data;                   /* As given to fc_poller_add(). */
+};
+
+struct fc_poller;               /* Opaque type. */
+
+/* A part of the data written by fc_writevsocket(). */
+struct fc_iovec {
+  const void *base;
+  size_t len;
+};
+
+/* Max number of parts fc_writevsocket() writes in one call. */
+#define FC_MAX_IOVEC 16
+
 int fc_connect(int sockfd, const struct sockaddr *serv_addr, socklen_t addrlen);
 int fc_select(int n, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
               struct timeval *timeout);
+int fc_socket_ready(int sock, int events);
+
+struct fc_poller *fc_poller_new(void);
+void fc_poller_destroy(struct fc_poller *poller);
+bool fc_poller_add(struct fc_poller *poller, int sock, int events,
+                   void *data);
+bool fc_poller_modify(struct fc_poller *poller, int sock, int events);
+void fc_poller_remove(struct fc_poller *poller, int sock);
+int fc_poller_wait(struct fc_poller *poller, struct fc_poll_event *events,
+                   int max_events, struct timeval *timeout);
+
 int fc_readsocket(int sock, void *buf, size_t size);
 int fc_writesocket(int sock, const void *buf, size_t size);
+int fc_writevsocket(int sock, const struct fc_iovec *iov, int iovcnt);
 void fc_closesocket(int sock);
 void fc_init_network(void);
 void fc_shutdown_network(void);
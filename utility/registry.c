@@ -52,7 +52,13 @@ struct section_file *secfile_load(const char *filename,
 {
 #ifdef HAVE_XML_REGISTRY
   xmlDoc *sec_doc;
+#endif /* HAVE_XML_REGISTRY */
+
+  if (binfile_is_binary(filename)) {
+    return binfile_load(filename, allow_duplicates);
+  }
 
+#ifdef HAVE_XML_REGISTRY
   sec_doc = xmlReadFile(filename, NULL, XML_PARSE_NOERROR);
   if (sec_doc != NULL) {
     return xmlfile_load(sec_doc, filename);
@@ -61,3 +67,29 @@ struct section_file *secfile_load(const char *filename,
 
   return secfile_load_section(filename, NULL, allow_duplicates);
 }
+
+/**************************************************************************
+  Open a section file to read its sections only when they are looked up.
+  See secfile_stream_from_file(). The binary files are memory mapped, and
+  loaded at once.  Returns NULL on error.
+**************************************************************************/
+struct section_file *secfile_load_streamed(const char *filename,
+                                           bool allow_duplicates)
+{
+#ifdef HAVE_XML_REGISTRY
+  xmlDoc *sec_doc;
+#endif /* HAVE_XML_REGISTRY */
+
+  if (binfile_is_binary(filename)) {
+    return binfile_load(filename, allow_duplicates);
+  }
+
+#ifdef HAVE_XML_REGISTRY
+  sec_doc = xmlReadFile(filename, NULL, XML_PARSE_NOERROR);
+  if (sec_doc != NULL) {
+    return xmlfile_load(sec_doc, filename);
+  }
+#endif /* HAVE_XML_REGISTRY */
+
+  return secfile_stream_from_file(filename, allow_duplicates);
+}
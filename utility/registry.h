@@ -28,6 +28,8 @@ struct section_file *secfile_new(bool allow_duplicates);
 void secfile_destroy(struct section_file *secfile);
 struct section_file *secfile_load(const char *filename,
                                   bool allow_duplicates);
+struct section_file *secfile_load_streamed(const char *filename,
+                                           bool allow_duplicates);
 
 void secfile_allow_digital_boolean(struct section_file *secfile,
                                    bool allow_digital_boolean);
@@ -35,6 +37,7 @@ void secfile_allow_digital_boolean(struct section_file *secfile,
 const char *secfile_error(void);
 const char *section_name(const struct section *psection);
 
+#include "registry_bin.h"
 #include "registry_ini.h"
 
 #ifdef __cplusplus
@@ -0,0 +1,1233 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+
+/**************************************************************************
+  Binary, column oriented representation of a section file.
+
+  The savegame code builds a section file where most of the data lives in
+  long runs of similar entries: one string per map row and layer
+  ("t0000", "t0001", ...), vectors ("name", "name,1", ...) and tables of
+  units and cities ("u0.id", "u0.x", ..., "u1.id", ...). In the ini
+  format each of those has to be written, tokenized and parsed again one
+  entry at a time. Here such runs are stored as typed columns instead,
+  and each block can be used directly from a memory mapped file.
+
+  All numbers are stored little endian. The file starts with a header:
+
+    magic[8]        FCBIN_MAGIC
+    uint32 version  FCBIN_VERSION
+    uint32 flags    Reserved, 0
+
+  followed by blocks until the end of file:
+
+    uint8  kind     enum bin_block
+    uint8  codec    enum bin_codec
+    uint16 reserved 0
+    uint32 size     Size of the payload once decoded.
+    uint32 stored   Size of the payload in the file.
+    payload
+
+  A BIN_SECTION block starts a new section; the other blocks add entries
+  to the last section started. Strings are stored as an uint32 length
+  followed by the bytes, without terminating zero.
+**************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <fc_config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+/* utility */
+#include "fcintl.h"
+#include "log.h"
+#include "mem.h"
+#include "registry.h"
+#include "section_file.h"
+#include "shared.h"
+#include "support.h"
+
+#include "registry_bin.h"
+
+#define FCBIN_MAGIC "\211FCBIN\r\n"
+#define FCBIN_MAGIC_LEN 8
+#define FCBIN_HEADER_LEN (FCBIN_MAGIC_LEN + 8)
+#define FCBIN_BLOCK_HEADER_LEN 12
+
+/* Entry runs shorter than this are stored as single entries. */
+#define FCBIN_RUN_MIN 4
+/* Blocks smaller than this are never compressed. */
+#define FCBIN_COMPRESS_MIN 128
+/* Deflate cannot inflate more than this from a byte (plus the stream
+ * overhead), so a larger size in a block header is corrupt. */
+#define FCBIN_ZLIB_RATIO_MAX 1032
+
+enum bin_block {
+  BIN_SECTION = 1,      /* Section name. */
+  BIN_ENTRIES = 2,      /* Single entries with names, values, comments. */
+  BIN_COLUMN = 3,       /* Run of entries named <prefix><index>. */
+  BIN_TABLE = 4         /* Rows of entries named <prefix><row>.<field>. */
+};
+
+enum bin_codec {
+  BIN_CODEC_NONE = 0,
+  BIN_CODEC_ZLIB = 1
+};
+
+/* Layouts of a string column. */
+enum bin_str_layout {
+  BIN_STR_VARIABLE = 0, /* uint32 length per value, then the bytes. */
+  BIN_STR_FIXED = 1     /* uint32 width, then width bytes per value. */
+};
+
+/* Growable byte buffer. */
+struct bin_buffer {
+  unsigned char *data;
+  size_t size;
+  size_t alloc;
+};
+
+/* Bounds checked reading of a block payload. */
+struct bin_reader {
+  const unsigned char *pos;
+  const unsigned char *end;
+  bool error;
+};
+
+/* A column being read back. */
+struct bin_column {
+  enum entry_type type;
+  bool escaped;
+  enum bin_str_layout layout;
+  unsigned int width;
+  const unsigned char *lengths;
+  const unsigned char *values;
+};
+
+/* The file contents, mapped or read into memory. */
+struct bin_mapping {
+  const unsigned char *data;
+  size_t size;
+  bool mapped;
+};
+
+/**************************************************************************
+  Make room for 'len' more bytes at the end of the buffer and return a
+  pointer to them. The size is updated by the caller.
+**************************************************************************/
+static unsigned char *bin_buffer_grow(struct bin_buffer *buf, size_t len)
+{
+  if (buf->size + len > buf->alloc) {
+    buf->alloc = MAX(buf->alloc * 2, buf->size + len + 256);
+    buf->data = fc_realloc(buf->data, buf->alloc);
+  }
+
+  return buf->data + buf->size;
+}
+
+/**************************************************************************
+  Free the memory of the buffer.
+**************************************************************************/
+static void bin_buffer_free(struct bin_buffer *buf)
+{
+  free(buf->data);
+  buf->data = NULL;
+  buf->size = buf->alloc = 0;
+}
+
+/**************************************************************************
+  Append the bytes to the buffer.
+**************************************************************************/
+static void bin_put_bytes(struct bin_buffer *buf, const void *data,
+                          size_t len)
+{
+  if (len > 0) {
+    memcpy(bin_buffer_grow(buf, len), data, len);
+    buf->size += len;
+  }
+}
+
+/**************************************************************************
+  Append one byte to the buffer.
+**************************************************************************/
+static void bin_put_uint8(struct bin_buffer *buf, unsigned int value)
+{
+  *bin_buffer_grow(buf, 1) = value & 0xff;
+  buf->size++;
+}
+
+/**************************************************************************
+  Write 'value' little endian to 'dest'.
+**************************************************************************/
+static void bin_store_uint32(unsigned char *dest, unsigned int value)
+{
+  dest[0] = value & 0xff;
+  dest[1] = (value >> 8) & 0xff;
+  dest[2] = (value >> 16) & 0xff;
+  dest[3] = (value >> 24) & 0xff;
+}
+
+/**************************************************************************
+  Read a little endian 32 bit value from 'src'.
+**************************************************************************/
+static unsigned int bin_load_uint32(const unsigned char *src)
+{
+  return ((unsigned int) src[0]) | ((unsigned int) src[1] << 8)
+         | ((unsigned int) src[2] << 16) | ((unsigned int) src[3] << 24);
+}
+
+/**************************************************************************
+  Append a 32 bit value to the buffer.
+**************************************************************************/
+static void bin_put_uint32(struct bin_buffer *buf, unsigned int value)
+{
+  bin_store_uint32(bin_buffer_grow(buf, 4), value);
+  buf->size += 4;
+}
+
+/**************************************************************************
+  Append a string to the buffer.
+**************************************************************************/
+static void bin_put_string(struct bin_buffer *buf, const char *str)
+{
+  size_t len = strlen(str);
+
+  bin_put_uint32(buf, len);
+  bin_put_bytes(buf, str, len);
+}
+
+/**************************************************************************
+  Consume 'len' bytes from the reader. Returns NULL if the payload is too
+  short.
+**************************************************************************/
+static const unsigned char *bin_get_bytes(struct bin_reader *rd, size_t len)
+{
+  const unsigned char *ret = rd->pos;
+
+  if (rd->error || len > (size_t) (rd->end - rd->pos)) {
+    rd->error = TRUE;
+    return NULL;
+  }
+  rd->pos += len;
+
+  return ret;
+}
+
+/**************************************************************************
+  Read one byte.
+**************************************************************************/
+static unsigned int bin_get_uint8(struct bin_reader *rd)
+{
+  const unsigned char *p = bin_get_bytes(rd, 1);
+
+  return NULL != p ? p[0] : 0;
+}
+
+/**************************************************************************
+  Read a 32 bit value.
+**************************************************************************/
+static unsigned int bin_get_uint32(struct bin_reader *rd)
+{
+  const unsigned char *p = bin_get_bytes(rd, 4);
+
+  return NULL != p ? bin_load_uint32(p) : 0;
+}
+
+/**************************************************************************
+  Read a string into 'out', which is reused between calls. Returns NULL
+  on error.
+**************************************************************************/
+static const char *bin_get_string(struct bin_reader *rd,
+                                  struct bin_buffer *out)
+{
+  size_t len = bin_get_uint32(rd);
+  const unsigned char *p = bin_get_bytes(rd, len);
+
+  if (NULL == p || NULL != memchr(p, '\0', len)) {
+    rd->error = TRUE;
+    return NULL;
+  }
+  out->size = 0;
+  bin_put_bytes(out, p, len);
+  bin_put_uint8(out, '\0');
+
+  return (const char *) out->data;
+}
+
+/**************************************************************************
+  Build "<prefix><index><suffix>" in 'out', the index zero padded to
+  'width' digits.
+**************************************************************************/
+static const char *bin_make_name(struct bin_buffer *out, const char *prefix,
+                                 int width, int index, const char *suffix)
+{
+  size_t len = strlen(prefix) + strlen(suffix) + MAX(width, 12) + 1;
+
+  out->size = 0;
+  bin_buffer_grow(out, len);
+  fc_snprintf((char *) out->data, len, "%s%0*d%s", prefix, width, index,
+              suffix);
+
+  return (const char *) out->data;
+}
+
+/**************************************************************************
+  Returns whether the entries 'a' and 'b' have the same type (and for
+  strings, the same escaping) and neither has a comment.
+**************************************************************************/
+static bool bin_entries_match(const struct entry *a, const struct entry *b)
+{
+  if (entry_type(a) != entry_type(b)
+      || NULL != entry_comment(a) || NULL != entry_comment(b)) {
+    return FALSE;
+  }
+
+  return (ENTRY_STR != entry_type(a)
+          || entry_str_escaped(a) == entry_str_escaped(b));
+}
+
+/**************************************************************************
+  Split 'name' as "<prefix><digits>" so that the name can be rebuilt from
+  the prefix, the index and the returned width. Returns FALSE if the name
+  does not end with an index.
+**************************************************************************/
+static bool bin_split_index(const char *name, size_t *prefix_len,
+                            int *width, int *index)
+{
+  size_t len = strlen(name);
+  size_t start = len;
+
+  while (start > 0 && fc_isdigit(name[start - 1])) {
+    start--;
+  }
+  if (start == len || len - start > 9) {
+    return FALSE;
+  }
+
+  *prefix_len = start;
+  *index = atoi(name + start);
+  /* With leading zeros the index was printed with a fixed width. */
+  *width = ('0' == name[start] ? len - start : 0);
+
+  return TRUE;
+}
+
+/**************************************************************************
+  Returns whether 'name' is "<prefix><index>", or "<prefix><index><sep>"
+  followed by more text when 'sep' is not '\0'. 'rest' is set to the text
+  following the index and the separator.
+**************************************************************************/
+static bool bin_name_has_index(const char *name, const char *prefix,
+                               size_t prefix_len, int width, int index,
+                               char sep, const char **rest)
+{
+  char num[16];
+  size_t num_len;
+
+  if (0 != strncmp(name, prefix, prefix_len)) {
+    return FALSE;
+  }
+  num_len = fc_snprintf(num, sizeof(num), "%0*d", width, index);
+  if (0 != strncmp(name + prefix_len, num, num_len)) {
+    return FALSE;
+  }
+  name += prefix_len + num_len;
+  if ('\0' == sep) {
+    return '\0' == name[0];
+  }
+  if (sep != name[0]) {
+    return FALSE;
+  }
+  *rest = name + 1;
+
+  return TRUE;
+}
+
+/**************************************************************************
+  Returns the length of the column run starting at entries[0], or 0 if
+  there is none.
+**************************************************************************/
+static int bin_column_run(struct entry **entries, int num,
+                          size_t *prefix_len, int *width, int *first)
+{
+  const char *name = entry_name(entries[0]);
+  int i;
+
+  if (num < FCBIN_RUN_MIN || NULL != entry_comment(entries[0])
+      || !bin_split_index(name, prefix_len, width, first)) {
+    return 0;
+  }
+
+  for (i = 1; i < num; i++) {
+    if (!bin_entries_match(entries[0], entries[i])
+        || !bin_name_has_index(entry_name(entries[i]), name, *prefix_len,
+                               *width, *first + i, '\0', NULL)) {
+      break;
+    }
+  }
+
+  return i >= FCBIN_RUN_MIN ? i : 0;
+}
+
+/**************************************************************************
+  Returns the number of rows of the table starting at entries[0], or 0 if
+  there is none. 'fields' is set to the number of entries per row.
+**************************************************************************/
+static int bin_table_run(struct entry **entries, int num,
+                         size_t *prefix_len, int *first, int *fields)
+{
+  const char *name = entry_name(entries[0]);
+  const char *dot = strchr(name, '.');
+  const char *rest;
+  char *row_name;
+  int width, rows, i, f;
+
+  if (NULL == dot || NULL != entry_comment(entries[0])) {
+    return 0;
+  }
+
+  /* Split "<prefix><row>" before the dot. */
+  row_name = fc_strdup(name);
+  row_name[dot - name] = '\0';
+  if (!bin_split_index(row_name, prefix_len, &width, first)
+      || 1 < width) {
+    free(row_name);
+    return 0;
+  }
+  free(row_name);
+
+  /* The first row defines the fields. */
+  for (f = 1; f < num; f++) {
+    if (!bin_name_has_index(entry_name(entries[f]), name, *prefix_len, 0,
+                            *first, '.', &rest)
+        || NULL != entry_comment(entries[f])) {
+      break;
+    }
+  }
+  *fields = f;
+  if (num < *fields * 2) {
+    return 0;
+  }
+
+  /* The following rows must have the same fields in the same order. */
+  for (rows = 1; (rows + 1) * *fields <= num; rows++) {
+    for (i = 0; i < *fields; i++) {
+      struct entry *pentry = entries[rows * *fields + i];
+      const char *field = entry_name(entries[i]) + (dot - name) + 1;
+
+      if (!bin_entries_match(entries[i], pentry)
+          || !bin_name_has_index(entry_name(pentry), name, *prefix_len, 0,
+                                 *first + rows, '.', &rest)
+          || 0 != strcmp(rest, field)) {
+        break;
+      }
+    }
+    if (i < *fields) {
+      break;
+    }
+  }
+
+  return rows >= 2 && rows * *fields >= FCBIN_RUN_MIN ? rows : 0;
+}
+
+/**************************************************************************
+  Append the values of 'num' entries to the buffer, taking every
+  'stride'th entry.
+**************************************************************************/
+static void bin_put_column(struct bin_buffer *buf, struct entry **entries,
+                           int num, int stride)
+{
+  enum entry_type type = entry_type(entries[0]);
+  const char *str;
+  size_t width;
+  int i, ival;
+  bool bval;
+
+  switch (type) {
+  case ENTRY_INT:
+    for (i = 0; i < num; i++) {
+      entry_int_get(entries[i * stride], &ival);
+      bin_put_uint32(buf, ival);
+    }
+    return;
+  case ENTRY_BOOL:
+    for (i = 0; i < num; i++) {
+      entry_bool_get(entries[i * stride], &bval);
+      bin_put_uint8(buf, bval ? 1 : 0);
+    }
+    return;
+  case ENTRY_STR:
+    /* Map rows all have the same length; store them as a matrix. */
+    entry_str_get(entries[0], &str);
+    width = strlen(str);
+    for (i = 1; i < num; i++) {
+      entry_str_get(entries[i * stride], &str);
+      if (strlen(str) != width) {
+        break;
+      }
+    }
+
+    if (i == num) {
+      bin_put_uint8(buf, BIN_STR_FIXED);
+      bin_put_uint32(buf, width);
+    } else {
+      bin_put_uint8(buf, BIN_STR_VARIABLE);
+      for (i = 0; i < num; i++) {
+        entry_str_get(entries[i * stride], &str);
+        bin_put_uint32(buf, strlen(str));
+      }
+    }
+    for (i = 0; i < num; i++) {
+      entry_str_get(entries[i * stride], &str);
+      bin_put_bytes(buf, str, strlen(str));
+    }
+    return;
+  }
+
+  fc_assert_msg(FALSE, "Unknown entry type %d.", type);
+}
+
+/**************************************************************************
+  Append a single entry to the buffer.
+**************************************************************************/
+static void bin_put_entry(struct bin_buffer *buf, const struct entry *pentry)
+{
+  const char *comment = entry_comment(pentry);
+  const char *str;
+  int ival;
+  bool bval;
+
+  bin_put_string(buf, entry_name(pentry));
+  bin_put_uint8(buf, entry_type(pentry));
+  bin_put_uint8(buf, (ENTRY_STR == entry_type(pentry)
+                      && entry_str_escaped(pentry) ? 1 : 0)
+                     | (NULL != comment ? 2 : 0));
+
+  switch (entry_type(pentry)) {
+  case ENTRY_INT:
+    entry_int_get(pentry, &ival);
+    bin_put_uint32(buf, ival);
+    break;
+  case ENTRY_BOOL:
+    entry_bool_get(pentry, &bval);
+    bin_put_uint8(buf, bval ? 1 : 0);
+    break;
+  case ENTRY_STR:
+    entry_str_get(pentry, &str);
+    bin_put_string(buf, str);
+    break;
+  }
+
+  if (NULL != comment) {
+    bin_put_string(buf, comment);
+  }
+}
+
+/**************************************************************************
+  Write one block to the file, compressing it when worthwhile. 'packed'
+  is scratch space.
+**************************************************************************/
+static bool bin_write_block(FILE *fp, enum bin_block kind,
+                            const struct bin_buffer *raw,
+                            struct bin_buffer *packed,
+                            int compression_level)
+{
+  unsigned char header[FCBIN_BLOCK_HEADER_LEN];
+  const unsigned char *data = raw->data;
+  size_t stored = raw->size;
+  enum bin_codec codec = BIN_CODEC_NONE;
+
+#ifdef HAVE_LIBZ
+  if (compression_level > 0 && raw->size >= FCBIN_COMPRESS_MIN) {
+    uLongf len = compressBound(raw->size);
+
+    packed->size = 0;
+    bin_buffer_grow(packed, len);
+    if (Z_OK == compress2(packed->data, &len, raw->data, raw->size,
+                          MIN(compression_level, 9))
+        && len < raw->size) {
+      codec = BIN_CODEC_ZLIB;
+      data = packed->data;
+      stored = len;
+    }
+  }
+#endif /* HAVE_LIBZ */
+
+  header[0] = kind;
+  header[1] = codec;
+  header[2] = header[3] = 0;
+  bin_store_uint32(header + 4, raw->size);
+  bin_store_uint32(header + 8, stored);
+
+  return (1 == fwrite(header, sizeof(header), 1, fp)
+          && (0 == stored || 1 == fwrite(data, stored, 1, fp)));
+}
+
+/**************************************************************************
+  Write the entries of one section as blocks.
+**************************************************************************/
+static bool bin_write_section(FILE *fp, const struct section *psection,
+                              struct bin_buffer *raw,
+                              struct bin_buffer *single,
+                              struct bin_buffer *packed,
+                              int compression_level)
+{
+  const struct entry_list *plist = section_entries(psection);
+  struct entry **entries;
+  int num = entry_list_size(plist);
+  int num_single = 0;
+  int i = 0, j, run, fields, first, width;
+  size_t prefix_len;
+  bool ok;
+
+  raw->size = 0;
+  bin_put_string(raw, section_name(psection));
+  ok = bin_write_block(fp, BIN_SECTION, raw, packed, compression_level);
+
+  entries = fc_malloc(MAX(num, 1) * sizeof(*entries));
+  entry_list_iterate(plist, pentry) {
+    entries[i++] = pentry;
+  } entry_list_iterate_end;
+
+  single->size = 0;
+  for (i = 0; ok && i <= num; i += run) {
+    enum bin_block kind = BIN_TABLE;
+
+    if (i == num) {
+      run = 1;
+    } else if (0 < (run = bin_table_run(entries + i, num - i, &prefix_len,
+                                        &first, &fields))) {
+      /* Table, run counts rows. */
+    } else if (0 < (run = bin_column_run(entries + i, num - i,
+                                         &prefix_len, &width, &first))) {
+      kind = BIN_COLUMN;
+    } else {
+      bin_put_entry(single, entries[i]);
+      num_single++;
+      run = 1;
+      continue;
+    }
+
+    /* Flush the single entries collected before the run. */
+    if (0 < num_single) {
+      raw->size = 0;
+      bin_put_uint32(raw, num_single);
+      bin_put_bytes(raw, single->data, single->size);
+      ok = bin_write_block(fp, BIN_ENTRIES, raw, packed, compression_level);
+      single->size = 0;
+      num_single = 0;
+    }
+    if (i == num || !ok) {
+      break;
+    }
+
+    raw->size = 0;
+    bin_put_uint32(raw, prefix_len);
+    bin_put_bytes(raw, entry_name(entries[i]), prefix_len);
+    if (BIN_COLUMN == kind) {
+      bin_put_uint8(raw, width);
+      bin_put_uint32(raw, first);
+      bin_put_uint32(raw, run);
+      bin_put_uint8(raw, entry_type(entries[i]));
+      bin_put_uint8(raw, ENTRY_STR == entry_type(entries[i])
+                         && entry_str_escaped(entries[i]));
+      bin_put_column(raw, entries + i, run, 1);
+    } else {
+      size_t skip = strchr(entry_name(entries[i]), '.')
+                    - entry_name(entries[i]) + 1;
+
+      bin_put_uint32(raw, first);
+      bin_put_uint32(raw, run);
+      bin_put_uint32(raw, fields);
+      for (j = 0; j < fields; j++) {
+        bin_put_string(raw, entry_name(entries[i + j]) + skip);
+        bin_put_uint8(raw, entry_type(entries[i + j]));
+        bin_put_uint8(raw, ENTRY_STR == entry_type(entries[i + j])
+                           && entry_str_escaped(entries[i + j]));
+      }
+      for (j = 0; j < fields; j++) {
+        bin_put_column(raw, entries + i + j, run, fields);
+      }
+      run *= fields;
+    }
+    ok = bin_write_block(fp, kind, raw, packed, compression_level);
+  }
+
+  free(entries);
+
+  return ok;
+}
+
+/**************************************************************************
+  Save the section file in the binary format. Blocks are compressed with
+  zlib at 'compression_level'; 0 means no compression.
+**************************************************************************/
+bool binfile_save(const struct section_file *secfile, const char *filename,
+                  int compression_level)
+{
+  char real_filename[1024];
+  unsigned char header[FCBIN_HEADER_LEN];
+  struct bin_buffer raw = { NULL, 0, 0 };
+  struct bin_buffer single = { NULL, 0, 0 };
+  struct bin_buffer packed = { NULL, 0, 0 };
+  FILE *fp;
+  bool ok;
+
+  SECFILE_RETURN_VAL_IF_FAIL(secfile, NULL, NULL != secfile, FALSE);
+
+  if (NULL == filename) {
+    filename = secfile->name;
+  }
+
+  interpret_tilde(real_filename, sizeof(real_filename), filename);
+  fp = fc_fopen(real_filename, "wb");
+  if (NULL == fp) {
+    log_error(_("Could not open %s for writing"), real_filename);
+    return FALSE;
+  }
+
+  memcpy(header, FCBIN_MAGIC, FCBIN_MAGIC_LEN);
+  bin_store_uint32(header + FCBIN_MAGIC_LEN, FCBIN_VERSION);
+  bin_store_uint32(header + FCBIN_MAGIC_LEN + 4, 0);
+  ok = (1 == fwrite(header, sizeof(header), 1, fp));
+
+  section_list_iterate(secfile->sections, psection) {
+    if (!ok) {
+      break;
+    }
+    ok = bin_write_section(fp, psection, &raw, &single, &packed,
+                           compression_level);
+  } section_list_iterate_end;
+
+  bin_buffer_free(&raw);
+  bin_buffer_free(&single);
+  bin_buffer_free(&packed);
+
+  if (0 != fclose(fp) || !ok) {
+    log_error(_("Error writing to %s"), real_filename);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**************************************************************************
+  Returns whether the file starts with the binary magic.
+**************************************************************************/
+bool binfile_is_binary(const char *filename)
+{
+  char magic[FCBIN_MAGIC_LEN];
+  FILE *fp = fc_fopen(filename, "rb");
+  bool ret;
+
+  if (NULL == fp) {
+    return FALSE;
+  }
+  ret = (1 == fread(magic, sizeof(magic), 1, fp)
+         && 0 == memcmp(magic, FCBIN_MAGIC, FCBIN_MAGIC_LEN));
+  fclose(fp);
+
+  return ret;
+}
+
+/**************************************************************************
+  Map the file into memory, or read it if mapping is not possible.
+**************************************************************************/
+static bool bin_map_file(const char *filename, struct bin_mapping *map)
+{
+  FILE *fp;
+  long size;
+  unsigned char *data;
+
+  map->data = NULL;
+  map->size = 0;
+  map->mapped = FALSE;
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  {
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+
+    if (0 <= fd) {
+      if (0 == fstat(fd, &st) && 0 < st.st_size) {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (MAP_FAILED != addr) {
+          map->data = addr;
+          map->size = st.st_size;
+          map->mapped = TRUE;
+        }
+      }
+      close(fd);
+      if (map->mapped) {
+        return TRUE;
+      }
+    }
+  }
+#endif /* HAVE_MMAP && HAVE_SYS_MMAN_H */
+
+  fp = fc_fopen(filename, "rb");
+  if (NULL == fp) {
+    return FALSE;
+  }
+  if (0 != fseek(fp, 0, SEEK_END) || 0 >= (size = ftell(fp))
+      || 0 != fseek(fp, 0, SEEK_SET)) {
+    fclose(fp);
+    return FALSE;
+  }
+
+  data = fc_malloc(size);
+  if (1 != fread(data, size, 1, fp)) {
+    free(data);
+    fclose(fp);
+    return FALSE;
+  }
+  fclose(fp);
+
+  map->data = data;
+  map->size = size;
+
+  return TRUE;
+}
+
+/**************************************************************************
+  Release the memory of bin_map_file().
+**************************************************************************/
+static void bin_unmap_file(struct bin_mapping *map)
+{
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  if (map->mapped) {
+    munmap((void *) map->data, map->size);
+    return;
+  }
+#endif /* HAVE_MMAP && HAVE_SYS_MMAN_H */
+
+  free((void *) map->data);
+}
+
+/**************************************************************************
+  Read the description of a column of 'num' values. The values stay in
+  the payload and are decoded by bin_column_entry_new().
+**************************************************************************/
+static bool bin_column_init(struct bin_reader *rd, struct bin_column *col,
+                            unsigned int type, bool escaped, size_t num)
+{
+  size_t total, i;
+
+  col->escaped = escaped;
+  col->lengths = NULL;
+  col->width = 0;
+  col->layout = BIN_STR_FIXED;
+
+  switch (type) {
+  case ENTRY_INT:
+    col->type = ENTRY_INT;
+    if (num > (size_t) (rd->end - rd->pos) / 4) {
+      return FALSE;
+    }
+    col->values = bin_get_bytes(rd, num * 4);
+    break;
+  case ENTRY_BOOL:
+    col->type = ENTRY_BOOL;
+    col->values = bin_get_bytes(rd, num);
+    break;
+  case ENTRY_STR:
+    col->type = ENTRY_STR;
+    col->layout = bin_get_uint8(rd);
+    if (BIN_STR_FIXED == col->layout) {
+      col->width = bin_get_uint32(rd);
+      if (0 < num && col->width > (size_t) (rd->end - rd->pos) / num) {
+        return FALSE;
+      }
+      total = col->width * num;
+    } else if (BIN_STR_VARIABLE == col->layout) {
+      if (num > (size_t) (rd->end - rd->pos) / 4) {
+        return FALSE;
+      }
+      col->lengths = bin_get_bytes(rd, num * 4);
+      for (i = 0, total = 0; NULL != col->lengths && i < num; i++) {
+        total += bin_load_uint32(col->lengths + i * 4);
+        if (total > (size_t) (rd->end - rd->pos)) {
+          return FALSE;
+        }
+      }
+    } else {
+      return FALSE;
+    }
+    col->values = bin_get_bytes(rd, total);
+    break;
+  default:
+    return FALSE;
+  }
+
+  return !rd->error && NULL != col->values;
+}
+
+/**************************************************************************
+  Add the next value of the column to the section as entry 'name'.
+**************************************************************************/
+static bool bin_column_entry_new(struct bin_column *col,
+                                 struct section *psection, const char *name,
+                                 struct bin_buffer *scratch)
+{
+  size_t len;
+
+  switch (col->type) {
+  case ENTRY_INT:
+    len = 4;
+    if (NULL == section_entry_int_new(psection, name,
+                                      (int) bin_load_uint32(col->values))) {
+      return FALSE;
+    }
+    break;
+  case ENTRY_BOOL:
+    len = 1;
+    if (NULL == section_entry_bool_new(psection, name,
+                                       0 != col->values[0])) {
+      return FALSE;
+    }
+    break;
+  case ENTRY_STR:
+    if (BIN_STR_FIXED == col->layout) {
+      len = col->width;
+    } else {
+      len = bin_load_uint32(col->lengths);
+      col->lengths += 4;
+    }
+    if (NULL != memchr(col->values, '\0', len)) {
+      return FALSE;
+    }
+    scratch->size = 0;
+    bin_put_bytes(scratch, col->values, len);
+    bin_put_uint8(scratch, '\0');
+    if (NULL == section_entry_str_new(psection, name,
+                                      (const char *) scratch->data,
+                                      col->escaped)) {
+      return FALSE;
+    }
+    break;
+  default:
+    return FALSE;
+  }
+  col->values += len;
+
+  return TRUE;
+}
+
+/**************************************************************************
+  Read a BIN_ENTRIES block.
+**************************************************************************/
+static bool bin_read_entries(struct bin_reader *rd, struct section *psection,
+                             struct bin_buffer *scratch)
+{
+  struct bin_buffer name = { NULL, 0, 0 };
+  struct bin_buffer comment = { NULL, 0, 0 };
+  unsigned int num = bin_get_uint32(rd);
+  unsigned int i, type, flags;
+  struct entry *pentry = NULL;
+  bool ok = TRUE;
+
+  for (i = 0; ok && i < num; i++) {
+    ok = (NULL != bin_get_string(rd, &name));
+    type = bin_get_uint8(rd);
+    flags = bin_get_uint8(rd);
+    if (!ok || rd->error) {
+      ok = FALSE;
+      break;
+    }
+
+    switch (type) {
+    case ENTRY_INT:
+      pentry = section_entry_int_new(psection, (const char *) name.data,
+                                     (int) bin_get_uint32(rd));
+      break;
+    case ENTRY_BOOL:
+      pentry = section_entry_bool_new(psection, (const char *) name.data,
+                                      0 != bin_get_uint8(rd));
+      break;
+    case ENTRY_STR:
+      pentry = (NULL == bin_get_string(rd, scratch) ? NULL
+                : section_entry_str_new(psection, (const char *) name.data,
+                                        (const char *) scratch->data,
+                                        0 != (flags & 1)));
+      break;
+    default:
+      pentry = NULL;
+      break;
+    }
+
+    if (NULL == pentry || rd->error) {
+      ok = FALSE;
+    } else if (0 != (flags & 2)) {
+      ok = (NULL != bin_get_string(rd, &comment));
+      if (ok) {
+        entry_set_comment(pentry, (const char *) comment.data);
+      }
+    }
+  }
+
+  bin_buffer_free(&name);
+  bin_buffer_free(&comment);
+
+  return ok;
+}
+
+/**************************************************************************
+  Read a BIN_COLUMN block.
+**************************************************************************/
+static bool bin_read_column(struct bin_reader *rd, struct section *psection,
+                            struct bin_buffer *scratch)
+{
+  struct bin_buffer prefix = { NULL, 0, 0 };
+  struct bin_buffer name = { NULL, 0, 0 };
+  struct bin_column col;
+  unsigned int width, first, num, type, i;
+  bool escaped, ok;
+
+  ok = (NULL != bin_get_string(rd, &prefix));
+  width = bin_get_uint8(rd);
+  first = bin_get_uint32(rd);
+  num = bin_get_uint32(rd);
+  type = bin_get_uint8(rd);
+  escaped = (0 != bin_get_uint8(rd));
+  ok = ok && !rd->error && width <= 9 && first <= 999999999
+       && num <= 999999999 - first
+       && bin_column_init(rd, &col, type, escaped, num);
+
+  for (i = 0; ok && i < num; i++) {
+    ok = bin_column_entry_new(&col, psection,
+                              bin_make_name(&name,
+                                            (const char *) prefix.data,
+                                            width, first + i, ""),
+                              scratch);
+  }
+
+  bin_buffer_free(&prefix);
+  bin_buffer_free(&name);
+
+  return ok;
+}
+
+/**************************************************************************
+  Read a BIN_TABLE block.
+**************************************************************************/
+static bool bin_read_table(struct bin_reader *rd, struct section *psection,
+                           struct bin_buffer *scratch)
+{
+  struct bin_buffer prefix = { NULL, 0, 0 };
+  struct bin_buffer name = { NULL, 0, 0 };
+  struct bin_buffer field = { NULL, 0, 0 };
+  struct bin_column *cols = NULL;
+  char **fields = NULL;
+  unsigned int *types = NULL;
+  unsigned int first, rows, num, row, i;
+  bool ok;
+
+  ok = (NULL != bin_get_string(rd, &prefix));
+  first = bin_get_uint32(rd);
+  rows = bin_get_uint32(rd);
+  num = bin_get_uint32(rd);
+  /* Each field takes at least 6 bytes of description. */
+  ok = ok && !rd->error && first <= 999999999 && rows <= 999999999 - first
+       && num <= (size_t) (rd->end - rd->pos) / 6;
+
+  if (ok) {
+    cols = fc_calloc(MAX(num, 1), sizeof(*cols));
+    fields = fc_calloc(MAX(num, 1), sizeof(*fields));
+    types = fc_calloc(MAX(num, 1), sizeof(*types));
+  }
+  for (i = 0; ok && i < num; i++) {
+    const char *str = bin_get_string(rd, &field);
+
+    if (NULL == str) {
+      ok = FALSE;
+      break;
+    }
+    fields[i] = fc_malloc(strlen(str) + 2);
+    fields[i][0] = '.';
+    strcpy(fields[i] + 1, str);
+    types[i] = bin_get_uint8(rd);
+    cols[i].escaped = (0 != bin_get_uint8(rd));
+  }
+  for (i = 0; ok && i < num; i++) {
+    ok = bin_column_init(rd, cols + i, types[i], cols[i].escaped, rows);
+  }
+
+  for (row = 0; ok && row < rows; row++) {
+    for (i = 0; ok && i < num; i++) {
+      ok = bin_column_entry_new(cols + i, psection,
+                                bin_make_name(&name,
+                                              (const char *) prefix.data,
+                                              0, first + row, fields[i]),
+                                scratch);
+    }
+  }
+
+  if (NULL != fields) {
+    for (i = 0; i < num; i++) {
+      free(fields[i]);
+    }
+  }
+  free(fields);
+  free(types);
+  free(cols);
+  bin_buffer_free(&prefix);
+  bin_buffer_free(&name);
+  bin_buffer_free(&field);
+
+  return ok;
+}
+
+/**************************************************************************
+  Load a section file saved by binfile_save(). Returns NULL on error.
+**************************************************************************/
+struct section_file *binfile_load(const char *filename,
+                                  bool allow_duplicates)
+{
+  struct bin_mapping map;
+  struct bin_buffer inflated = { NULL, 0, 0 };
+  struct bin_buffer scratch = { NULL, 0, 0 };
+  struct section_file *secfile;
+  struct section *psection = NULL;
+  const unsigned char *pos, *end;
+  unsigned int version;
+  int block = 0;
+  bool ok = TRUE;
+
+  if (!bin_map_file(filename, &map)) {
+    log_error(_("Could not open %s for reading"), filename);
+    return NULL;
+  }
+
+  if (map.size < FCBIN_HEADER_LEN
+      || 0 != memcmp(map.data, FCBIN_MAGIC, FCBIN_MAGIC_LEN)) {
+    log_error(_("%s is not a binary freeciv file."), filename);
+    bin_unmap_file(&map);
+    return NULL;
+  }
+
+  version = bin_load_uint32(map.data + FCBIN_MAGIC_LEN);
+  if (version > FCBIN_VERSION) {
+    log_error(_("%s uses binary format version %u, only %d is supported."),
+              filename, version, FCBIN_VERSION);
+    bin_unmap_file(&map);
+    return NULL;
+  }
+
+  /* Duplicates are checked when building the hash table, at the end. */
+  secfile = secfile_new_arena(TRUE);
+  secfile->name = fc_strdup(filename);
+
+  pos = map.data + FCBIN_HEADER_LEN;
+  end = map.data + map.size;
+  while (ok && pos < end) {
+    struct bin_reader rd;
+    unsigned int kind, codec, size, stored;
+
+    block++;
+    if (end - pos < FCBIN_BLOCK_HEADER_LEN) {
+      ok = FALSE;
+      break;
+    }
+    kind = pos[0];
+    codec = pos[1];
+    size = bin_load_uint32(pos + 4);
+    stored = bin_load_uint32(pos + 8);
+    pos += FCBIN_BLOCK_HEADER_LEN;
+    if (stored > (size_t) (end - pos)) {
+      ok = FALSE;
+      break;
+    }
+
+    if (BIN_CODEC_NONE == codec && stored == size) {
+      /* Used in place. */
+      rd.pos = pos;
+#ifdef HAVE_LIBZ
+    } else if (BIN_CODEC_ZLIB == codec) {
+      uLongf len = size;
+
+      /* Check the size before allocating it, don't trust the file. */
+      if (size > FC_INFINITY
+          || size > (size_t) stored * FCBIN_ZLIB_RATIO_MAX + 64) {
+        ok = FALSE;
+        break;
+      }
+      inflated.size = 0;
+      bin_buffer_grow(&inflated, MAX(size, 1));
+      if (Z_OK != uncompress(inflated.data, &len, pos, stored)
+          || len != size) {
+        ok = FALSE;
+        break;
+      }
+      rd.pos = inflated.data;
+#endif /* HAVE_LIBZ */
+    } else {
+      ok = FALSE;
+      break;
+    }
+    rd.end = rd.pos + size;
+    rd.error = FALSE;
+    pos += stored;
+
+    if (BIN_SECTION == kind) {
+      const char *name = bin_get_string(&rd, &scratch);
+
+      psection = (NULL != name ? secfile_section_new(secfile, name) : NULL);
+      ok = (NULL != psection);
+    } else if (NULL == psection) {
+      ok = FALSE;
+    } else if (BIN_ENTRIES == kind) {
+      ok = bin_read_entries(&rd, psection, &scratch);
+    } else if (BIN_COLUMN == kind) {
+      ok = bin_read_column(&rd, psection, &scratch);
+    } else if (BIN_TABLE == kind) {
+      ok = bin_read_table(&rd, psection, &scratch);
+    } else {
+      log_verbose("%s: skipping unknown block kind %u.", filename, kind);
+      rd.pos = rd.end;
+    }
+    ok = ok && !rd.error && rd.pos == rd.end;
+  }
+
+  bin_buffer_free(&inflated);
+  bin_buffer_free(&scratch);
+  bin_unmap_file(&map);
+
+  if (!ok) {
+    log_error(_("%s: corrupt binary file (block %d)."), filename, block);
+    secfile_destroy(secfile);
+    return NULL;
+  }
+
+  if (!secfile_hash_build(secfile, allow_duplicates)) {
+    secfile_destroy(secfile);
+    return NULL;
+  }
+
+  return secfile;
+}
@@ -0,0 +1,42 @@
+/**********************************************************************
+ Freeciv - Copyright (C) 1996 - A Kjeldberg, L Gregersen, P Unold
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+***********************************************************************/
+#ifndef FC__REGISTRY_BIN_H
+#define FC__REGISTRY_BIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* utility */
+#include "support.h"            /* bool type */
+
+struct section_file;
+
+/* Extension used for the binary files. */
+#define FCBIN_SUFFIX "fcb"
+
+/* Format version written to the header. Files with a newer version
+ * are refused. */
+#define FCBIN_VERSION 1
+
+bool binfile_is_binary(const char *filename);
+struct section_file *binfile_load(const char *filename,
+                                  bool allow_duplicates);
+bool binfile_save(const struct section_file *secfile, const char *filename,
+                  int compression_level);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  /* FC__REGISTRY_BIN_H */
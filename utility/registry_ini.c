@@ -154,6 +154,7 @@
 #include <string.h>
 
 /* utility */
+#include "arena.h"
 #include "astring.h"
 #include "fcintl.h"
 #include "inputfile.h"
@@ -163,6 +164,7 @@
 #include "registry.h"
 #include "section_file.h"
 #include "shared.h"
+#include "string_vector.h"
 #include "support.h"
 
 #include "registry_ini.h"
@@ -246,6 +248,7 @@ static bool secfile_hash_insert(struct section_file *secfile,
                                 struct entry *pentry)
 {
   char buf[256];
+  char *key = buf;
   struct entry *hentry;
 
   if (NULL == secfile->hash.entries) {
@@ -255,7 +258,11 @@ static bool secfile_hash_insert(struct section_file *secfile,
   }
 
   entry_path(pentry, buf, sizeof(buf));
-  if (entry_hash_replace_full(secfile->hash.entries, buf, pentry,
+  if (NULL != secfile->arena) {
+    /* The hash table doesn't copy the keys then. */
+    key = arena_strdup(secfile->arena, buf);
+  }
+  if (entry_hash_replace_full(secfile->hash.entries, key, pentry,
                               NULL, &hentry)) {
     entry_use(hentry);
     if (!secfile->allow_duplicates) {
@@ -287,16 +294,63 @@ static bool secfile_hash_delete(struct section_file *secfile,
 }
 
 /**************************************************************************
-  Base function to load a section file.  Note it closes the inputfile.
+  Build the entry hash table of a secfile filled while loading, and start
+  checking the duplicates if they are not allowed.  Returns FALSE if a
+  duplicate was found.
 **************************************************************************/
-static struct section_file *secfile_from_input_file(struct inputfile *inf,
-                                                    const char *filename,
-                                                    const char *section,
-                                                    bool allow_duplicates)
+bool secfile_hash_build(struct section_file *secfile, bool allow_duplicates)
 {
-  struct section_file *secfile;
-  struct section *psection = NULL;
-  struct section *single_section = NULL;
+  fc_assert_ret_val(NULL == secfile->hash.entries, FALSE);
+
+  secfile->allow_duplicates = allow_duplicates;
+  if (NULL != secfile->arena) {
+    /* Keys are allocated in the arena by secfile_hash_insert(). */
+    secfile->hash.entries =
+        entry_hash_new_nentries_full(genhash_str_val_func,
+                                     genhash_str_comp_func,
+                                     NULL, NULL, NULL, NULL,
+                                     secfile->num_entries);
+  } else {
+    secfile->hash.entries = entry_hash_new_nentries(secfile->num_entries);
+  }
+
+  section_list_iterate(secfile->sections, psection) {
+    entry_list_iterate(section_entries(psection), pentry) {
+      if (!secfile_hash_insert(secfile, pentry)) {
+        return FALSE;
+      }
+    } entry_list_iterate_end;
+  } section_list_iterate_end;
+
+  return TRUE;
+}
+
+/* The reading of a section file. For a streamed file, it is kept between
+ * the sections, which are read when they are first looked up. */
+struct secfile_reader {
+  struct inputfile *inf;        /* NULL once the whole file is read. */
+  const char *section;          /* If not NULL, only read this section. */
+  struct section *psection;     /* Section being read. */
+  struct section *single_section;
+  bool found_my_section;
+  bool streamed;
+  bool allow_duplicates;        /* The value set once the file is read. */
+  struct arena *arena;          /* Arena of the secfile when streamed. */
+  struct strvec *released;      /* See secfile_section_release(). */
+  bool error;
+};
+
+/**************************************************************************
+  Read the input file of the reader into the secfile. For a streamed
+  file, stop at the start of the next section, so that the previous
+  sections are complete. Returns TRUE if stopped so, FALSE if the whole
+  file is read (or an error was found), and then closes the inputfile.
+**************************************************************************/
+static bool secfile_reader_read(struct secfile_reader *reader,
+                                struct section_file *secfile)
+{
+  struct inputfile *inf = reader->inf;
+  struct section *psection = reader->psection;
   bool table_state = FALSE;     /* TRUE when within tabular format. */
   int table_lineno = 0;         /* Row number in tabular, 0 top data row. */
   const char *tok;
@@ -304,27 +358,17 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
   struct astring base_name = ASTRING_INIT;    /* for table or single entry */
   struct astring entry_name = ASTRING_INIT;
   struct astring_vector columns;    /* astrings for column headings */
-  bool found_my_section = FALSE;
-  bool error = FALSE;
-
-  if (!inf) {
-    return NULL;
-  }
-
-  /* Assign the real value later, to speed up the creation of new entries. */
-  secfile = secfile_new(TRUE);
-  if (filename) {
-    secfile->name = fc_strdup(filename);
-  } else {
-    secfile->name = NULL;
-  }
+  bool finished = TRUE;
 
   astring_vector_init(&columns);
 
-  if (filename) {
-    log_verbose("Reading registry from \"%s\"", filename);
-  } else {
-    log_verbose("Reading registry");
+  if (reader->streamed) {
+    /* Allocate in the arena of the section being read. */
+    secfile->arena = (NULL != psection && NULL != psection->arena
+                      ? psection->arena : reader->arena);
+    /* Duplicates are checked by counting, see below, rather than looking
+     * up the section for each new entry. */
+    secfile->allow_duplicates = TRUE;
   }
 
   while (!inf_at_eof(inf)) {
@@ -337,7 +381,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
     }
     tok = inf_token(inf, INF_TOK_SECTION_NAME);
     if (tok) {
-      if (found_my_section) {
+      if (reader->found_my_section) {
         /* This shortcut will stop any further loading after the requested
          * section has been loaded (i.e., at the start of a new section).
          * This is needed to make the behavior useful, since the whole
@@ -351,7 +395,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
       if (table_state) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "New section during table"));
-        error = TRUE;
+        reader->error = TRUE;
         goto END;
       }
       /* Check if we already have a section with this name.
@@ -361,18 +405,38 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
       */
       psection = secfile_section_by_name(secfile, tok);
       if (!psection) {
-        if (!section || strcmp(tok, section) == 0) {
+        if (reader->streamed) {
+          /* Each section gets its own arena, so that it can be released
+           * alone. */
+          struct arena *parena = arena_new(SECFILE_ARENA_BLOCK_SIZE);
+
+          secfile->arena = parena;
+          psection = secfile_section_new(secfile, tok);
+          if (NULL != psection) {
+            psection->arena = parena;
+          } else {
+            secfile->arena = reader->arena;
+            arena_destroy(parena);
+          }
+        } else if (!reader->section || strcmp(tok, reader->section) == 0) {
           psection = secfile_section_new(secfile, tok);
-          if (section) {
-            single_section = psection;
-            found_my_section = TRUE;
+          if (reader->section) {
+            reader->single_section = psection;
+            reader->found_my_section = TRUE;
           }
         }
+      } else if (reader->streamed) {
+        secfile->arena = (NULL != psection->arena
+                          ? psection->arena : reader->arena);
       }
       if (!inf_token(inf, INF_TOK_EOL)) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "Expected end of line"));
-        error = TRUE;
+        reader->error = TRUE;
+        goto END;
+      }
+      if (reader->streamed) {
+        finished = FALSE;
         goto END;
       }
       continue;
@@ -381,13 +445,13 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
       if (!table_state) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "Misplaced \"}\""));
-        error = TRUE;
+        reader->error = TRUE;
         goto END;
       }
       if (!inf_token(inf, INF_TOK_EOL)) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "Expected end of line"));
-        error = TRUE;
+        reader->error = TRUE;
         goto END;
       }
       table_state = FALSE;
@@ -403,7 +467,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
         if (!(tok = inf_token(inf, INF_TOK_VALUE))) {
           SECFILE_LOG(secfile, psection, "%s",
                       inf_log_str(inf, "Expected value"));
-          error = TRUE;
+          reader->error = TRUE;
           goto END;
         }
 
@@ -421,7 +485,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
       if (!inf_token(inf, INF_TOK_EOL)) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "Expected end of line"));
-        error = TRUE;
+        reader->error = TRUE;
         goto END;
       }
       table_lineno++;
@@ -431,7 +495,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
     if (!(tok = inf_token(inf, INF_TOK_ENTRY_NAME))) {
       SECFILE_LOG(secfile, psection, "%s",
                   inf_log_str(inf, "Expected entry name"));
-      error = TRUE;
+      reader->error = TRUE;
       goto END;
     }
 
@@ -448,13 +512,13 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
         if (!(tok = inf_token(inf, INF_TOK_VALUE))) {
           SECFILE_LOG(secfile, psection, "%s",
                       inf_log_str(inf, "Expected value"));
-          error = TRUE;
+          reader->error = TRUE;
           goto END;
         }
         if (tok[0] != '\"') {
           SECFILE_LOG(secfile, psection, "%s",
                       inf_log_str(inf, "Table column header non-string"));
-          error = TRUE;
+          reader->error = TRUE;
           goto END;
         }
         {       /* expand columns: */
@@ -475,7 +539,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
       if (!inf_token(inf, INF_TOK_EOL)) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "Expected end of line"));
-        error = TRUE;
+        reader->error = TRUE;
         goto END;
       }
       table_state = TRUE;
@@ -490,7 +554,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
       if (!(tok = inf_token(inf, INF_TOK_VALUE))) {
         SECFILE_LOG(secfile, psection, "%s",
                     inf_log_str(inf, "Expected value"));
-        error = TRUE;
+        reader->error = TRUE;
         goto END;
       }
       if (i == 0) {
@@ -503,7 +567,7 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
     if (!inf_token(inf, INF_TOK_EOL)) {
       SECFILE_LOG(secfile, psection, "%s",
                   inf_log_str(inf, "Expected end of line"));
-      error = TRUE;
+      reader->error = TRUE;
       goto END;
     }
   }
@@ -511,11 +575,10 @@ static struct section_file *secfile_from_input_file(struct inputfile *inf,
   if (table_state) {
     SECFILE_LOG(secfile, psection,
                 "Finished registry before end of table");
-    error = TRUE;
+    reader->error = TRUE;
   }
 
 END:
-  inf_close(inf);
   astr_free(&base_name);
   astr_free(&entry_name);
   for (i = 0; i < astring_vector_size(&columns); i++) {
@@ -523,15 +586,91 @@ END:
   }
   astring_vector_free(&columns);
 
+  if (reader->streamed) {
+    secfile->arena = reader->arena;
+    secfile->allow_duplicates = reader->allow_duplicates;
+    if (!reader->allow_duplicates && !reader->error
+        && (entry_hash_size(secfile->hash.entries)
+            != secfile->num_entries)) {
+      SECFILE_LOG(secfile, reader->psection,
+                  "Same entry found twice in the section.");
+      reader->error = TRUE;
+    }
+    if (reader->error) {
+      /* The caller won't get the error from the lookups. */
+      log_error("%s", secfile_error());
+      finished = TRUE;
+    }
+  }
+
+  if (finished) {
+    inf_close(inf);
+    reader->inf = NULL;
+    reader->psection = NULL;
+  } else {
+    reader->psection = psection;
+  }
+
+  return !finished;
+}
+
+/**************************************************************************
+  Free a reader, closing its inputfile if the reading didn't finish.
+**************************************************************************/
+void secfile_reader_destroy(struct secfile_reader *reader)
+{
+  if (NULL != reader->inf) {
+    inf_close(reader->inf);
+  }
+  if (NULL != reader->released) {
+    strvec_destroy(reader->released);
+  }
+  free(reader);
+}
+
+/**************************************************************************
+  Base function to load a section file.  Note it closes the inputfile.
+**************************************************************************/
+static struct section_file *secfile_from_input_file(struct inputfile *inf,
+                                                    const char *filename,
+                                                    const char *section,
+                                                    bool allow_duplicates)
+{
+  struct section_file *secfile;
+  struct secfile_reader reader;
+
+  if (!inf) {
+    return NULL;
+  }
+
+  /* Assign the real value later, to speed up the creation of new entries. */
+  secfile = secfile_new_arena(TRUE);
+  if (filename) {
+    secfile->name = fc_strdup(filename);
+  } else {
+    secfile->name = NULL;
+  }
+
+  if (filename) {
+    log_verbose("Reading registry from \"%s\"", filename);
+  } else {
+    log_verbose("Reading registry");
+  }
+
+  memset(&reader, 0, sizeof(reader));
+  reader.inf = inf;
+  reader.section = section;
+  (void) secfile_reader_read(&reader, secfile);
+
   if (section != NULL) {
-    if (!found_my_section) {
+    if (!reader.found_my_section) {
       secfile_destroy(secfile);
       return NULL;
     }
 
     /* Build the entry hash table with single section information */
     secfile->allow_duplicates = allow_duplicates;
-    entry_list_iterate(section_entries(single_section), pentry) {
+    entry_list_iterate(section_entries(reader.single_section), pentry) {
       if (!secfile_hash_insert(secfile, pentry)) {
         secfile_destroy(secfile);
         return NULL;
@@ -541,24 +680,11 @@ END:
     return secfile;
   }
 
-  if (!error) {
+  if (!reader.error) {
     /* Build the entry hash table. */
-    secfile->allow_duplicates = allow_duplicates;
-    secfile->hash.entries = entry_hash_new_nentries(secfile->num_entries);
-
-    section_list_iterate(secfile->sections, psection) {
-      entry_list_iterate(section_entries(psection), pentry) {
-        if (!secfile_hash_insert(secfile, pentry)) {
-          error = TRUE;
-          break;
-        }
-      } entry_list_iterate_end;
-      if (error) {
-        break;
-      }
-    } section_list_iterate_end;
+    reader.error = !secfile_hash_build(secfile, allow_duplicates);
   }
-  if (error) {
+  if (reader.error) {
     secfile_destroy(secfile);
     return NULL;
   } else {
@@ -566,6 +692,138 @@ END:
   }
 }
 
+/**************************************************************************
+  Read one more section of a streamed secfile. Returns FALSE if there is
+  nothing more to read. The sections are read when they are looked up,
+  so this is called with the const secfile of the lookup functions.
+**************************************************************************/
+static bool secfile_stream_step(const struct section_file *secfile)
+{
+  struct section_file *streamed = (struct section_file *) secfile;
+  struct secfile_reader *reader = secfile->reader;
+
+  if (NULL == reader || NULL == reader->inf) {
+    return FALSE;
+  }
+
+  /* The lookups made while reading must not read further. */
+  streamed->reader = NULL;
+  (void) secfile_reader_read(reader, streamed);
+  streamed->reader = reader;
+
+  return NULL != reader->inf;
+}
+
+/**************************************************************************
+  Returns TRUE if the section was released from the streamed secfile.
+**************************************************************************/
+static bool secfile_stream_released(const struct secfile_reader *reader,
+                                    const char *name)
+{
+  size_t i;
+
+  if (NULL == reader->released) {
+    return FALSE;
+  }
+
+  for (i = 0; i < strvec_size(reader->released); i++) {
+    if (0 == strcmp(strvec_get(reader->released, i), name)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**************************************************************************
+  Read a streamed secfile until the section 'name' is complete, or to its
+  end if 'name' is NULL or there is no such section. A section released
+  before is an error, and nothing is read for it. Does nothing for the
+  other section files.
+**************************************************************************/
+static void secfile_stream_read(const struct section_file *secfile,
+                                const char *name)
+{
+  struct section *psection;
+
+  if (NULL == secfile->reader) {
+    return;
+  }
+
+  if (NULL != name
+      && !section_hash_lookup(secfile->hash.sections, name, &psection)
+      && secfile_stream_released(secfile->reader, name)) {
+    log_error("%s: section [%s] is looked up after being released.",
+              secfile->name, name);
+    return;
+  }
+
+  while (NULL != secfile->reader->inf
+         && (NULL == name
+             || !section_hash_lookup(secfile->hash.sections, name,
+                                     &psection)
+             || psection == secfile->reader->psection)) {
+    secfile_stream_step(secfile);
+  }
+}
+
+/**************************************************************************
+  Open a section file to read it as a stream: the sections are only read
+  when they are first looked up, and can then be released one by one with
+  secfile_section_release(), so that the whole file never needs to be in
+  memory at once. The file is read forward only: looking up a missing
+  section reads it to its end, looking up a released one is an error, and
+  a section must not be split in several parts. Syntax errors are found while reading; secfile_stream_finish()
+  tells whether there was one. Returns NULL if the file can't be opened.
+**************************************************************************/
+struct section_file *secfile_stream_from_file(const char *filename,
+                                              bool allow_duplicates)
+{
+  char real_filename[1024];
+  struct inputfile *inf;
+  struct section_file *secfile;
+  struct secfile_reader *reader;
+
+  interpret_tilde(real_filename, sizeof(real_filename), filename);
+  inf = inf_from_file(real_filename, datafilename);
+  if (NULL == inf) {
+    return NULL;
+  }
+
+  log_verbose("Streaming registry from \"%s\"", filename);
+
+  secfile = secfile_new(allow_duplicates);
+  secfile->name = fc_strdup(filename);
+  /* For the data inserted rather than read. There is no name table, as
+   * the names live in the arena of their section. */
+  secfile->arena = arena_new(SECFILE_ARENA_BLOCK_SIZE);
+  (void) secfile_hash_build(secfile, allow_duplicates);
+
+  reader = fc_calloc(1, sizeof(*reader));
+  reader->inf = inf;
+  reader->streamed = TRUE;
+  reader->allow_duplicates = allow_duplicates;
+  reader->arena = secfile->arena;
+  secfile->reader = reader;
+
+  return secfile;
+}
+
+/**************************************************************************
+  Read the rest of a streamed secfile. Returns FALSE if a syntax error was
+  found in it, now or before. Always TRUE for the other section files.
+**************************************************************************/
+bool secfile_stream_finish(struct section_file *secfile)
+{
+  SECFILE_RETURN_VAL_IF_FAIL(secfile, NULL, NULL != secfile, FALSE);
+
+  if (NULL == secfile->reader) {
+    return TRUE;
+  }
+
+  secfile_stream_read(secfile, NULL);
+  return !secfile->reader->error;
+}
+
 /**************************************************************************
   Create a section file from a file, read only one particular section.
   Returns NULL on error.
@@ -623,6 +881,8 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
 
   SECFILE_RETURN_VAL_IF_FAIL(secfile, NULL, NULL != secfile, FALSE);
 
+  secfile_stream_read(secfile, NULL);
+
   if (NULL == filename) {
     filename = secfile->name;
   }
@@ -643,9 +903,9 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
 
         fc_assert(!strcmp(entry_name(pentry), "file"));
 
-        fz_fprintf(fs, "*include ");
+        fz_fputs(fs, "*include ");
         entry_to_file(pentry, fs);
-        fz_fprintf(fs, "\n");
+        fz_fputs(fs, "\n");
       }
     } else {
       fz_fprintf(fs, "\n[%s]\n", section_name(psection));
@@ -718,7 +978,7 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
                        col_entry_name + offset);
             ncol++;
           }
-          fz_fprintf(fs, "\n");
+          fz_fputs(fs, "\n");
 
           /* Iterate over rows and columns, incrementing ent_iter as we go,
            * and writing values to the table.  Have a separate iterator
@@ -755,14 +1015,14 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
                           real_filename, section_name(psection), expect);
                 /* TRANS: No full stop after the URL, could cause confusion. */
                 log_error(_("Please report this message at %s"), BUG_URL);
-                fz_fprintf(fs, "\n");
+                fz_fputs(fs, "\n");
               }
-              fz_fprintf(fs, "}\n");
+              fz_fputs(fs, "}\n");
               break;
             }
 
             if (icol > 0) {
-              fz_fprintf(fs, ",");
+              fz_fputs(fs, ",");
             }
             entry_to_file(pentry, fs);
 
@@ -771,7 +1031,7 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
 
             icol++;
             if (icol == ncol) {
-              fz_fprintf(fs, "\n");
+              fz_fputs(fs, "\n");
               irow++;
               icol = 0;
               col_iter = save_iter;
@@ -787,7 +1047,8 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
 
         /* Classic entry. */
         col_entry_name = entry_name(pentry);
-        fz_fprintf(fs, "%s=", col_entry_name);
+        fz_fputs(fs, col_entry_name);
+        fz_fputs(fs, "=");
         entry_to_file(pentry, fs);
 
         /* Check for vector. */
@@ -802,7 +1063,7 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
           if (0 != strcmp(pentry_name, entry_name(col_pentry))) {
             break;
           }
-          fz_fprintf(fs, ",");
+          fz_fputs(fs, ",");
           entry_to_file(col_pentry, fs);
           ent_iter = col_iter;
         }
@@ -810,7 +1071,7 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
         if (entry_comment(pentry)) {
           fz_fprintf(fs, "#%s\n", entry_comment(pentry));
         } else {
-          fz_fprintf(fs, "\n");
+          fz_fputs(fs, "\n");
         }
       }
     }
@@ -830,6 +1091,25 @@ bool secfile_save(const struct section_file *secfile, const char *filename,
   return TRUE;
 }
 
+/**************************************************************************
+  Print log messages for the unused entries of the section. 'any' tells
+  whether the header line was already printed.
+**************************************************************************/
+static void section_check_unused(const struct section *psection,
+                                 bool *any)
+{
+  entry_list_iterate(section_entries(psection), pentry) {
+    if (!entry_used(pentry)) {
+      if (!*any && psection->secfile->name) {
+        log_verbose("Unused entries in file %s:", psection->secfile->name);
+        *any = TRUE;
+      }
+      log_verbose("  unused entry: %s.%s",
+                  section_name(psection), entry_name(pentry));
+    }
+  } entry_list_iterate_end;
+}
+
 /**************************************************************************
   Print log messages for any entries in the file which have
   not been looked up -- ie, unused or unrecognised entries.
@@ -842,16 +1122,7 @@ void secfile_check_unused(const struct section_file *secfile)
   bool any = FALSE;
 
   section_list_iterate(secfile_sections(secfile), psection) {
-    entry_list_iterate(section_entries(psection), pentry) {
-      if (!entry_used(pentry)) {
-        if (!any && secfile->name) {
-          log_verbose("Unused entries in file %s:", secfile->name);
-          any = TRUE;
-        }
-        log_verbose("  unused entry: %s.%s",
-                    section_name(psection), entry_name(pentry));
-      }
-    } entry_list_iterate_end;
+    section_check_unused(psection, &any);
   } section_list_iterate_end;
 }
 
@@ -1569,6 +1840,13 @@ struct entry *secfile_entry_by_path(const struct section_file *secfile,
     fullpath[len - 2] = '\0';
   }
 
+  if (NULL != secfile->reader && (ent_name = strchr(fullpath, '.'))) {
+    /* Make sure the section was read. */
+    *ent_name = '\0';
+    secfile_stream_read(secfile, fullpath);
+    *ent_name = '.';
+  }
+
   if (NULL != secfile->hash.entries) {
     struct entry *pentry;
 
@@ -2537,8 +2815,18 @@ int *secfile_lookup_enum_vec_data(const struct section_file *secfile,
 struct section *secfile_section_by_name(const struct section_file *secfile,
                                         const char *name)
 {
+  struct section *psection;
+
   SECFILE_RETURN_VAL_IF_FAIL(secfile, NULL, NULL != secfile, NULL);
 
+  secfile_stream_read(secfile, name);
+
+  if (NULL != secfile->hash.sections) {
+    /* Section names are unique, see secfile_section_new(). */
+    return (section_hash_lookup(secfile->hash.sections, name, &psection)
+            ? psection : NULL);
+  }
+
   section_list_iterate(secfile->sections, psection) {
     if (0 == strcmp(section_name(psection), name)) {
       return psection;
@@ -2573,7 +2861,12 @@ struct section *secfile_section_lookup(const struct section_file *secfile,
 const struct section_list *
 secfile_sections(const struct section_file *secfile)
 {
-  return (NULL != secfile ? secfile->sections : NULL);
+  if (NULL == secfile) {
+    return NULL;
+  }
+
+  secfile_stream_read(secfile, NULL);
+  return secfile->sections;
 }
 
 /**************************************************************************
@@ -2596,6 +2889,8 @@ secfile_sections_by_name_prefix(const struct section_file *secfile,
     return NULL;
   }
 
+  secfile_stream_read(secfile, NULL);
+
   section_list_iterate(secfile->sections, psection) {
     if (0 == strncmp(section_name(psection), prefix, len)) {
       if (NULL == matches) {
@@ -2636,10 +2931,15 @@ struct section *secfile_section_new(struct section_file *secfile,
     return NULL;
   }
 
-  psection = fc_malloc(sizeof(struct section));
+  if (NULL != secfile->arena) {
+    psection = arena_alloc(secfile->arena, sizeof(struct section));
+  } else {
+    psection = fc_malloc(sizeof(struct section));
+  }
   psection->include = FALSE;
-  psection->name = fc_strdup(name);
+  psection->name = secfile_name_intern(secfile, name);
   psection->entries = entry_list_new_full(entry_destroy);
+  psection->arena = NULL;
 
   /* Append to secfile. */
   psection->secfile = secfile;
@@ -2652,12 +2952,65 @@ struct section *secfile_section_new(struct section_file *secfile,
   return psection;
 }
 
+/**************************************************************************
+  Returns the first section of the secfile, or NULL if it is empty. For a
+  streamed file, only the first section is read.
+**************************************************************************/
+struct section *secfile_section_first(const struct section_file *secfile)
+{
+  SECFILE_RETURN_VAL_IF_FAIL(secfile, NULL, NULL != secfile, NULL);
+
+  while (NULL != secfile->reader
+         && (0 == section_list_size(secfile->sections)
+             || (section_list_get(secfile->sections, 0)
+                 == secfile->reader->psection))
+         && secfile_stream_step(secfile)) {
+    /* Read until the first section is complete. */
+  }
+
+  return section_list_get(secfile->sections, 0);
+}
+
+/**************************************************************************
+  Remove the section once it won't be looked up anymore, to give back its
+  memory before the whole secfile is destroyed. Made for the streamed
+  files, whose sections are allocated separately. Its unused entries are
+  reported as in secfile_check_unused().
+**************************************************************************/
+void secfile_section_release(struct section_file *secfile,
+                             const char *path, ...)
+{
+  char fullpath[MAX_LEN_SECPATH];
+  struct section *psection;
+  va_list args;
+  bool any = FALSE;
+
+  SECFILE_RETURN_IF_FAIL(secfile, NULL, NULL != secfile);
+
+  va_start(args, path);
+  fc_vsnprintf(fullpath, sizeof(fullpath), path, args);
+  va_end(args);
+
+  if (NULL != (psection = secfile_section_by_name(secfile, fullpath))) {
+    section_check_unused(psection, &any);
+    section_destroy(psection);
+  }
+
+  if (NULL != secfile->reader) {
+    if (NULL == secfile->reader->released) {
+      secfile->reader->released = strvec_new();
+    }
+    strvec_append(secfile->reader->released, fullpath);
+  }
+}
+
 /**************************************************************************
   Remove this section from the secfile.
 **************************************************************************/
 void section_destroy(struct section *psection)
 {
   struct section_file *secfile;
+  struct arena *parena;
 
   SECFILE_RETURN_IF_FAIL(NULL, psection, NULL != psection);
 
@@ -2675,8 +3028,15 @@ void section_destroy(struct section *psection)
   }
 
   entry_list_destroy(psection->entries);
-  free(psection->name);
-  free(psection);
+  parena = psection->arena;
+  if (NULL == secfile || NULL == secfile->arena) {
+    free(psection->name);
+    free(psection);
+  }
+  if (NULL != parena) {
+    /* The section itself was allocated there. */
+    arena_destroy(parena);
+  }
 }
 
 /**************************************************************************
@@ -2739,8 +3099,8 @@ bool section_set_name(struct section *psection, const char *name)
   }
 
   /* Really rename. */
-  free(psection->name);
-  psection->name = fc_strdup(name);
+  secfile_strfree(secfile, psection->name);
+  psection->name = secfile_name_intern(secfile, name);
 
   /* Reinsert new references into the hash tables. */
   if (NULL != secfile->hash.sections) {
@@ -2818,7 +3178,9 @@ struct entry *section_entry_lookup(const struct section *psection,
  */
 struct entry {
   struct section *psection;     /* Parent section. */
-  char *name;                   /* Name, not including section prefix. */
+  char *name;                   /* Name, not including section prefix.
+                                 * Shared with other entries when interned
+                                 * in the secfile. */
   enum entry_type type;         /* The type of the entry. */
   int used;                     /* Number of times entry looked up. */
   char *comment;                /* Comment, may be NULL. */
@@ -2834,7 +3196,7 @@ struct entry {
     } integer;
     /* ENTRY_STR */
     struct {
-      char *value;              /* Malloced string. */
+      char *value;              /* Malloced string, or from the arena. */
       bool escaped;             /* " or $. Usually TRUE */
     } string;
   };
@@ -2868,8 +3230,12 @@ static struct entry *entry_new(struct section *psection, const char *name)
     return NULL;
   }
 
-  pentry = fc_malloc(sizeof(struct entry));
-  pentry->name = fc_strdup(name);
+  if (NULL != secfile->arena) {
+    pentry = arena_alloc(secfile->arena, sizeof(struct entry));
+  } else {
+    pentry = fc_malloc(sizeof(struct entry));
+  }
+  pentry->name = secfile_name_intern(secfile, name);
   pentry->type = -1;    /* Invalid case. */
   pentry->used = 0;
   pentry->comment = NULL;
@@ -2928,7 +3294,8 @@ struct entry *section_entry_str_new(struct section *psection,
 
   if (NULL != pentry) {
     pentry->type = ENTRY_STR;
-    pentry->string.value = fc_strdup(NULL != value ? value : "");
+    pentry->string.value = secfile_strdup(psection->secfile,
+                                          NULL != value ? value : "");
     pentry->string.escaped = escaped;
   }
 
@@ -2940,7 +3307,7 @@ struct entry *section_entry_str_new(struct section *psection,
 **************************************************************************/
 void entry_destroy(struct entry *pentry)
 {
-  struct section_file *secfile;
+  struct section_file *secfile = NULL;
   struct section *psection;
 
   if (NULL == pentry) {
@@ -2960,6 +3327,11 @@ void entry_destroy(struct entry *pentry)
     }
   }
 
+  if (NULL != secfile && NULL != secfile->arena) {
+    /* Freed with the arena. */
+    return;
+  }
+
   /* Specific type free. */
   switch (pentry->type) {
   case ENTRY_BOOL:
@@ -3053,8 +3425,8 @@ bool entry_set_name(struct entry *pentry, const char *name)
   secfile_hash_delete(secfile, pentry);
 
   /* Really rename the entry. */
-  free(pentry->name);
-  pentry->name = fc_strdup(name);
+  secfile_strfree(secfile, pentry->name);
+  pentry->name = secfile_name_intern(secfile, name);
 
   /* Insert into hash table the new path. */
   secfile_hash_insert(secfile, pentry);
@@ -3074,15 +3446,19 @@ const char *entry_comment(const struct entry *pentry)
 **************************************************************************/
 void entry_set_comment(struct entry *pentry, const char *comment)
 {
+  struct section_file *secfile;
+
   if (NULL == pentry) {
     return;
   }
 
+  secfile = pentry->psection->secfile;
   if (NULL != pentry->comment) {
-    free(pentry->comment);
+    secfile_strfree(secfile, pentry->comment);
   }
 
-  pentry->comment = (NULL != comment ? fc_strdup(comment) : NULL);
+  pentry->comment = (NULL != comment ? secfile_strdup(secfile, comment)
+                     : NULL);
 }
 
 /**************************************************************************
@@ -3189,12 +3565,28 @@ bool entry_str_get(const struct entry *pentry, const char **value)
 **************************************************************************/
 bool entry_str_set(struct entry *pentry, const char *value)
 {
+  struct section_file *secfile;
+  size_t len;
+
   SECFILE_RETURN_VAL_IF_FAIL(NULL, NULL, NULL != pentry, FALSE);
-  SECFILE_RETURN_VAL_IF_FAIL(pentry->psection->secfile, pentry->psection,
+  secfile = pentry->psection->secfile;
+  SECFILE_RETURN_VAL_IF_FAIL(secfile, pentry->psection,
                              ENTRY_STR == pentry->type, FALSE);
 
-  free(pentry->string.value);
-  pentry->string.value = fc_strdup(NULL != value ? value : "");
+  if (NULL == value) {
+    value = "";
+  }
+  len = strlen(value);
+
+  if (NULL != secfile->arena && len <= strlen(pentry->string.value)) {
+    /* Reuse the arena memory. */
+    memmove(pentry->string.value, value, len + 1);
+  } else {
+    char *old = pentry->string.value;
+
+    pentry->string.value = secfile_strdup(secfile, value);
+    secfile_strfree(secfile, old);
+  }
   return TRUE;
 }
 
@@ -3232,7 +3624,7 @@ static void entry_to_file(const struct entry *pentry, fz_FILE *fs)
 
   switch (pentry->type) {
   case ENTRY_BOOL:
-    fz_fprintf(fs, "%s", pentry->boolean.value ? "TRUE" : "FALSE");
+    fz_fputs(fs, pentry->boolean.value ? "TRUE" : "FALSE");
     break;
   case ENTRY_INT:
     fz_fprintf(fs, "%d", pentry->integer.value);
@@ -3240,9 +3632,13 @@ static void entry_to_file(const struct entry *pentry, fz_FILE *fs)
   case ENTRY_STR:
     if (pentry->string.escaped) {
       make_escapes(pentry->string.value, buf, sizeof(buf));
-      fz_fprintf(fs, "\"%s\"", buf);
+      fz_fputs(fs, "\"");
+      fz_fputs(fs, buf);
+      fz_fputs(fs, "\"");
     } else {
-      fz_fprintf(fs, "$%s$", pentry->string.value);
+      fz_fputs(fs, "$");
+      fz_fputs(fs, pentry->string.value);
+      fz_fputs(fs, "$");
     }
     break;
   }
@@ -61,6 +61,9 @@ struct section_file *secfile_load_section(const char *filename,
                                           bool allow_duplicates);
 struct section_file *secfile_from_stream(fz_FILE *stream,
                                          bool allow_duplicates);
+struct section_file *secfile_stream_from_file(const char *filename,
+                                              bool allow_duplicates);
+bool secfile_stream_finish(struct section_file *secfile);
 
 bool secfile_save(const struct section_file *secfile, const char *filename,
                   int compression_level, enum fz_method compression_method);
@@ -540,7 +543,10 @@ secfile_sections_by_name_prefix(const struct section_file *secfile,
                                 const char *prefix);
 struct section *secfile_section_new(struct section_file *secfile,
                                     const char *section_name);
-
+struct section *secfile_section_first(const struct section_file *secfile);
+void secfile_section_release(struct section_file *secfile,
+                             const char *path, ...)
+                             fc__attribute((__format__ (__printf__, 2, 3)));
 
 /* Independant section functions. */
 void section_destroy(struct section *psection);
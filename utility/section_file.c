@@ -18,6 +18,7 @@
 #include <stdarg.h>
 
 /* utility */
+#include "arena.h"
 #include "mem.h"
 #include "registry.h"
 
@@ -85,6 +86,27 @@ struct section_file *secfile_new(bool allow_duplicates)
   /* Maybe allocated later. */
   secfile->hash.entries = NULL;
 
+  secfile->arena = NULL;
+  secfile->names = NULL;
+  secfile->reader = NULL;
+
+  return secfile;
+}
+
+/**************************************************************************
+  Create a new empty section file, whose sections and entries are
+  allocated from an arena. This is much faster to fill and to free, and
+  uses less memory, but the memory of removed or modified entries is
+  only given back when the whole secfile is destroyed. Fits files which
+  are loaded, read and thrown away.
+**************************************************************************/
+struct section_file *secfile_new_arena(bool allow_duplicates)
+{
+  struct section_file *secfile = secfile_new(allow_duplicates);
+
+  secfile->arena = arena_new(SECFILE_ARENA_BLOCK_SIZE);
+  secfile->names = secfile_name_hash_new();
+
   return secfile;
 }
 
@@ -95,6 +117,11 @@ void secfile_destroy(struct section_file *secfile)
 {
   SECFILE_RETURN_IF_FAIL(secfile, NULL, secfile != NULL);
 
+  if (NULL != secfile->reader) {
+    secfile_reader_destroy(secfile->reader);
+    secfile->reader = NULL;
+  }
+
   section_hash_destroy(secfile->hash.sections);
   /* Mark it NULL to be sure to don't try to make operations when
    * deleting the entries. */
@@ -108,6 +135,13 @@ void secfile_destroy(struct section_file *secfile)
 
   section_list_destroy(secfile->sections);
 
+  if (NULL != secfile->names) {
+    secfile_name_hash_destroy(secfile->names);
+  }
+  if (NULL != secfile->arena) {
+    arena_destroy(secfile->arena);
+  }
+
   if (NULL != secfile->name) {
     free(secfile->name);
   }
@@ -115,6 +149,48 @@ void secfile_destroy(struct section_file *secfile)
   free(secfile);
 }
 
+/**************************************************************************
+  Copy a string owned by the secfile, from its arena if it has one.
+**************************************************************************/
+char *secfile_strdup(struct section_file *secfile, const char *str)
+{
+  if (NULL != secfile->arena) {
+    return arena_strdup(secfile->arena, str);
+  } else {
+    return fc_strdup(str);
+  }
+}
+
+/**************************************************************************
+  Free a string made by secfile_strdup() or secfile_name_intern().
+**************************************************************************/
+void secfile_strfree(struct section_file *secfile, char *str)
+{
+  if (NULL == secfile->arena) {
+    free(str);
+  }
+}
+
+/**************************************************************************
+  Returns a copy of a section or entry name, owned by the secfile. With
+  an arena and a name table, all the equal names share the same copy.
+**************************************************************************/
+char *secfile_name_intern(struct section_file *secfile, const char *name)
+{
+  char *interned;
+
+  if (NULL == secfile->names) {
+    return secfile_strdup(secfile, name);
+  }
+
+  if (!secfile_name_hash_lookup(secfile->names, name, &interned)) {
+    interned = arena_strdup(secfile->arena, name);
+    secfile_name_hash_insert(secfile->names, interned, interned);
+  }
+
+  return interned;
+}
+
 /****************************************************************************
   Set if we could consider values 0 and 1 as boolean. By default, this is
   not allowed, but we need to keep compatibility with old Freeciv version
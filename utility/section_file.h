@@ -21,12 +21,21 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/* Size of the arena blocks of the loaded files. */
+#define SECFILE_ARENA_BLOCK_SIZE (64 * 1024)
+
+struct secfile_reader;
+
 /* Section structure. */
 struct section {
   struct section_file *secfile; /* Parent structure. */
   bool include;
   char *name;                   /* Name of the section. */
   struct entry_list *entries;   /* The list of the children. */
+  /* If not NULL, the section and the entries read with it are allocated
+   * from this arena, which is freed with the section. Used by the
+   * streamed files, whose sections can be released one by one. */
+  struct arena *arena;
 };
 
 /* The section file struct itself. */
@@ -44,6 +53,15 @@ struct section_file {
     struct section_hash *sections;
     struct entry_hash *entries;
   } hash;
+  /* If not NULL, the sections and the entries, with their names and
+   * values, are allocated from this arena and freed with the secfile.
+   * Section and entry names are then interned in 'names', and must not
+   * be modified in place. */
+  struct arena *arena;
+  struct secfile_name_hash *names;
+  /* If not NULL, the file is streamed: the sections are read from it
+   * when they are first looked up. See secfile_load_streamed(). */
+  struct secfile_reader *reader;
 };
 
 void secfile_log(const struct section_file *secfile,
@@ -76,6 +94,19 @@ void secfile_log(const struct section_file *secfile,
 #define SPECHASH_IDATA_TYPE struct entry *
 #include "spechash.h"
 
+#define SPECHASH_TAG secfile_name
+#define SPECHASH_CSTR_KEY_TYPE
+#define SPECHASH_IDATA_TYPE char *
+#include "spechash.h"
+
+struct section_file *secfile_new_arena(bool allow_duplicates);
+char *secfile_strdup(struct section_file *secfile, const char *str);
+void secfile_strfree(struct section_file *secfile, char *str);
+char *secfile_name_intern(struct section_file *secfile, const char *name);
+bool secfile_hash_build(struct section_file *secfile,
+                        bool allow_duplicates);
+void secfile_reader_destroy(struct secfile_reader *reader);
+
 bool entry_from_token(struct section *psection, const char *name,
                       const char *tok);
 